@@ -1460,6 +1460,11 @@ API char* notcurses_at_yx(struct notcurses* nc, unsigned yoff, unsigned xoff,
 // plane with this flag is equivalent to immediately calling
 // ncplane_set_scrolling(p, true) following plane creation.
 #define NCPLANE_OPTION_VSCROLL      0x0020ull
+// Intern EGCs of more than four bytes, so that identical clusters written to
+// many cells of the plane share a single copy. Looking up an EGC which is
+// already present is O(1). Useful for planes heavy with repeated emoji,
+// CJK, or combining sequences.
+#define NCPLANE_OPTION_INTERN       0x0040ull
 
 typedef struct ncplane_options {
   int y;            // vertical placement relative to parent plane
@@ -1818,6 +1823,7 @@ typedef struct ncstats {
   // current state -- these can decrease
   uint64_t fbbytes;          // total bytes devoted to all active framebuffers
   unsigned planes;           // number of planes currently in existence
+  uint64_t rasterbufbytes;   // bytes allocated to the raster buffer
 } ncstats;
 
 // Allocate an ncstats object. Use this rather than allocating your own, since
@@ -2267,6 +2273,17 @@ ncplane_putwegc_yx(struct ncplane* n, int y, int x, const wchar_t* gclust,
 API int ncplane_putwegc_stained(struct ncplane* n, const wchar_t* gclust, size_t* sbytes)
   __attribute__ ((nonnull (1, 2)));
 
+// Write one or more EGCs from 'gclusters' (but no more than 's' bytes) to the
+// specified location, using the current style. As many EGCs are written as
+// can be handled in a single operation: a run of printable ASCII is written in
+// bulk, but never across the end of a line. Otherwise, a single EGC is written
+// as with ncplane_putegc_yx(). The number of bytes consumed is written to
+// '*sbytes'. Returns the number of columns advanced, or -1 on error. This is
+// the engine behind ncplane_putstr_yx() and ncplane_putnstr_yx().
+API int ncplane_putegcs_yx(struct ncplane* n, int y, int x, const char* gclusters,
+                           size_t s, size_t* sbytes)
+  __attribute__ ((nonnull (1, 4, 6)));
+
 // Write a series of EGCs to the current location, using the current style.
 // They will be interpreted as a series of columns (according to the definition
 // of ncplane_putc()). Advances the cursor by some positive number of columns
@@ -2278,7 +2295,7 @@ ncplane_putstr_yx(struct ncplane* n, int y, int x, const char* gclusters){
   int ret = 0;
   while(*gclusters){
     size_t wcs;
-    int cols = ncplane_putegc_yx(n, y, x, gclusters, &wcs);
+    int cols = ncplane_putegcs_yx(n, y, x, gclusters, (size_t)-1, &wcs);
 //fprintf(stderr, "wrote %.*s %d cols %zu bytes\n", (int)wcs, gclusters, cols, wcs);
     if(cols < 0){
       return -ret;
@@ -2349,7 +2366,7 @@ ncplane_putnstr_yx(struct ncplane* n, int y, int x, size_t s, const char* gclust
 //fprintf(stderr, "PUT %zu at %d/%d [%.*s]\n", s, y, x, (int)s, gclusters);
   while(offset < s && gclusters[offset]){
     size_t wcs;
-    int cols = ncplane_putegc_yx(n, y, x, gclusters + offset, &wcs);
+    int cols = ncplane_putegcs_yx(n, y, x, gclusters + offset, s - offset, &wcs);
     if(cols < 0){
       return -ret;
     }
@@ -2759,6 +2776,15 @@ API int ncplane_mergedown(struct ncplane* RESTRICT src,
 API void ncplane_erase(struct ncplane* n)
   __attribute__ ((nonnull (1)));
 
+// Compact the storage backing the plane's extended EGCs, relocating those in
+// use to a fresh, right-sized pool. Storage only grows as a plane is written
+// to, so long-lived planes which once held a great deal of complex text can
+// benefit from this. All cells associated with this ncplane are invalidated,
+// *excluding* the plane's own cells and its base cell. Returns -1 on error
+// (in which case the plane is unchanged), 0 otherwise.
+API int ncplane_compact(struct ncplane* n)
+  __attribute__ ((nonnull (1)));
+
 // Erase every cell in the region starting at {ystart, xstart} and having size
 // {|ylen|x|xlen|} for non-zero lengths. If ystart and/or xstart are -1, the current
 // cursor position along that axis is used; other negative values are an error. A
@@ -3345,6 +3371,14 @@ API ALLOC struct ncvisual* ncvisual_from_sixel(const char* s, unsigned leny, uns
 #define NCVISUAL_OPTION_ADDALPHA      0x0010ull // transcolor is in effect
 #define NCVISUAL_OPTION_CHILDPLANE    0x0020ull // interpret n as parent
 #define NCVISUAL_OPTION_NOINTERPOLATE 0x0040ull // non-interpolative scaling
+// how NCBLIT_PIXEL chooses a palette, where the terminal requires one (i.e.
+// Sixel). by default, an octree adapts the palette to the image. the fixed
+// palette is a color cube plus greys, requiring no analysis of the image, and
+// is thus well-suited to video. median cut is slower, but more faithful. the
+// fixed palette can be dithered. these are otherwise ignored.
+#define NCVISUAL_OPTION_FIXEDPALETTE  0x0080ull // fixed color cube palette
+#define NCVISUAL_OPTION_MEDIANCUT     0x0100ull // median cut palette
+#define NCVISUAL_OPTION_DITHER        0x0200ull // ordered dither (fixed palette)
 
 struct ncvisual_options {
   // if no ncplane is provided, one will be created using the exact size
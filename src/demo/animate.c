@@ -237,7 +237,7 @@ animate(struct notcurses* nc, struct ncprogbar* left, struct ncprogbar* right,
     DEMO_RENDER(nc);
     struct timespec now;
     expect_ns += iterns;
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     uint64_t nowns = timespec_to_ns(&now);
     if(nowns < expect_ns){
       ns_to_timespec(expect_ns - nowns, &delay);
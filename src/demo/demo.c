@@ -10,6 +10,10 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <stdatomic.h>
+#ifndef __MINGW32__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#endif
 #include "demo.h"
 
 // (non-)ansi terminal definition-4-life
@@ -19,10 +23,14 @@ static const unsigned MIN_SUPPORTED_COLS = 76; // allow a bit of margin, sigh
 static char *datadir;
 static int democount;
 static demoresult* results;
+static int curdemo = -1; // index into results of the running demo
+static ncstats benchprev; // stats as of the last recorded benchmark frame
+static atomic_uint_fast64_t benchclock; // virtual time in benchmark mode
 
 static const char DEFAULT_DEMO[] = "ixetunchdmbkywjgarvlsfqzo";
 
 atomic_bool interrupted = false;
+bool benchmarking = false;
 // checked following demos, whether aborted, failed, or otherwise
 static atomic_bool restart_demos = false;
 
@@ -35,6 +43,47 @@ void interrupt_and_restart_demos(void){
   atomic_store(&interrupted, true);
 }
 
+int demo_record_frame(struct notcurses* nc){
+  if(curdemo < 0){ // rendering outside of any demo (menu, HUD setup, etc.)
+    return 0;
+  }
+  ncstats cur;
+  notcurses_stats(nc, &cur);
+  if(cur.renders == benchprev.renders){
+    return 0;
+  }
+  demoresult* r = &results[curdemo];
+  if(r->framecount == r->framealloc){
+    size_t na = r->framealloc ? r->framealloc * 2 : 512;
+    demoframe* tmp = realloc(r->frames, sizeof(*tmp) * na);
+    if(tmp == NULL){
+      return -1;
+    }
+    r->frames = tmp;
+    r->framealloc = na;
+  }
+  demoframe* f = &r->frames[r->framecount++];
+  f->render_ns = cur.render_ns - benchprev.render_ns;
+  f->raster_ns = cur.raster_ns - benchprev.raster_ns;
+  f->writeout_ns = cur.writeout_ns - benchprev.writeout_ns;
+  f->bytes = cur.raster_bytes - benchprev.raster_bytes;
+  benchprev = cur;
+  return 0;
+}
+
+uint64_t demo_getns(void){
+  if(benchmarking){
+    return atomic_load(&benchclock);
+  }
+  return clock_getns(CLOCK_MONOTONIC);
+}
+
+void demo_clock_advance(uint64_t ns){
+  if(benchmarking){
+    atomic_fetch_add(&benchclock, ns);
+  }
+}
+
 const demoresult* demoresult_lookup(int idx){
   if(idx < 0 || idx >= democount){
     return NULL;
@@ -66,37 +115,40 @@ int jungle_demo(struct notcurses* nc, uint64_t startns){
 
 // Demos can be disabled either due to a DFSG build (any non-free material must
 // be disabled) or a non-multimedia build (all images/videos must be disabled).
+// Demos whose output depends on thread scheduling can't be reproduced from
+// run to run, and are skipped in benchmark mode.
 static struct {
   const char* name;
   int (*fxn)(struct notcurses*, uint64_t startns);
   bool dfsg_disabled;             // disabled for DFSG builds
+  bool bench_disabled;            // skipped in benchmark mode
 } demos[26] = {
-  { "animate", animate_demo, false, },
-  { "box", box_demo, false, },
-  { "chunli", chunli_demo, true, },
-  { "dragon", dragon_demo, false, },
-  { "eagle", eagle_demo, true, },
-  { "fission", fission_demo, false, },
-  { "grid", grid_demo, false, },
-  { "highcon", highcon_demo, false, },
-  { "intro", intro_demo, false, },
-  { "jungle", jungle_demo, true, },
-  { "keller", keller_demo, true, },
-  { "luigi", luigi_demo, true, },
-  { "mojibake", mojibake_demo, false, },
-  { "normal", normal_demo, false, },
-  { "outro", outro_demo, false, },
-  { NULL, NULL, false, }, // it's a secret to everyone
-  { "qrcode", qrcode_demo, false, }, // is blank without USE_QRCODEGEN
-  { "reel", reel_demo, false, },
-  { "sliders", sliders_demo, false, },
-  { "trans", trans_demo, false, },
-  { "uniblock", uniblock_demo, false, },
-  { "view", view_demo, true, },
-  { "whiteout", whiteout_demo, false, },
-  { "xray", xray_demo, false, },
-  { "yield", yield_demo, false, },
-  { "zoo", zoo_demo, false, },
+  { "animate", animate_demo, false, false, },
+  { "box", box_demo, false, false, },
+  { "chunli", chunli_demo, true, false, },
+  { "dragon", dragon_demo, false, false, },
+  { "eagle", eagle_demo, true, false, },
+  { "fission", fission_demo, false, false, },
+  { "grid", grid_demo, false, false, },
+  { "highcon", highcon_demo, false, false, },
+  { "intro", intro_demo, false, false, },
+  { "jungle", jungle_demo, true, false, },
+  { "keller", keller_demo, true, false, },
+  { "luigi", luigi_demo, true, false, },
+  { "mojibake", mojibake_demo, false, false, },
+  { "normal", normal_demo, false, false, },
+  { "outro", outro_demo, false, false, },
+  { NULL, NULL, false, false, }, // it's a secret to everyone
+  { "qrcode", qrcode_demo, false, false, }, // is blank without USE_QRCODEGEN
+  { "reel", reel_demo, false, true, }, // tablets are updated by free-running threads
+  { "sliders", sliders_demo, false, false, },
+  { "trans", trans_demo, false, false, },
+  { "uniblock", uniblock_demo, false, false, },
+  { "view", view_demo, true, false, },
+  { "whiteout", whiteout_demo, false, false, },
+  { "xray", xray_demo, false, false, },
+  { "yield", yield_demo, false, false, },
+  { "zoo", zoo_demo, false, false, },
 };
 
 static void
@@ -134,7 +186,7 @@ usage(const char* exe, int status){
   ncplane_putstr(n, "usage: ");
   ncplane_set_fg_rgb8(n, 0x80, 0xff, 0x80);
   ncplane_printf(n, "%s ", exe);
-  const char* options[] = { "-hVkc", "-m margins", "-p path", "-l loglevel",
+  const char* options[] = { "-hVkcb", "-m margins", "-p path", "-l loglevel",
                             "-d mult", "-J jsonfile", "demospec",
                             NULL };
   for(const char** op = options ; *op ; ++op){
@@ -149,6 +201,7 @@ usage(const char* exe, int status){
     "-d", "delay multiplier (non-negative float)",
     "-J", "emit JSON summary to file",
     "-c", "constant PRNG seed, useful for benchmarking",
+    "-b", "benchmark: no delays, constant seed, fixed geometry",
     "-m", "margin, or 4 comma-separated margins",
     NULL
   };
@@ -216,14 +269,23 @@ ext_demos(struct notcurses* nc, const char* spec){
       continue;
     }
 #endif
+    if(benchmarking && demos[idx].bench_disabled){
+      continue;
+    }
     // set the standard plane's base character to an opaque black, but don't
     // erase the plane (we let one demo bleed through to the next, an effect
     // we exploit in a few transitions).
     uint64_t stdc = NCCHANNELS_INITIALIZER(0, 0, 0, 0, 0, 0);
     ncplane_set_base(n, "", 0, stdc);
 
-    hud_schedule(demos[idx].name, prevns);
-    ret = demos[idx].fxn(nc, prevns);
+    // demos pace themselves against demo_getns(), which is virtual when
+    // benchmarking; the reported time is always the true runtime.
+    const uint64_t startns = demo_getns();
+    hud_schedule(demos[idx].name, startns);
+    curdemo = (int)i;
+    memset(&benchprev, 0, sizeof(benchprev));
+    ret = demos[idx].fxn(nc, startns);
+    curdemo = -1;
     notcurses_stats_reset(nc, &results[i].stats);
     uint64_t nowns = clock_getns(CLOCK_MONOTONIC);
     results[i].timens = nowns - prevns;
@@ -251,7 +313,7 @@ handle_opts(int argc, char** argv, notcurses_options* opts, FILE** json_output){
     { .name = NULL, .has_arg = 0, .flag = NULL, .val = 0, },
   };
   int lidx;
-  while((c = getopt_long(argc, argv, "VhckJ:l:d:p:m:", longopts, &lidx)) != EOF){
+  while((c = getopt_long(argc, argv, "VhcbkJ:l:d:p:m:", longopts, &lidx)) != EOF){
     switch(c){
       case 'h':
         usage(*argv, EXIT_SUCCESS);
@@ -293,6 +355,10 @@ handle_opts(int argc, char** argv, notcurses_options* opts, FILE** json_output){
       case 'c':
         constant_seed = true;
         break;
+      case 'b':
+        benchmarking = true;
+        constant_seed = true;
+        break;
       case 'k':
         opts->flags |= NCOPTION_NO_ALTERNATE_SCREEN;
         break;
@@ -325,6 +391,10 @@ handle_opts(int argc, char** argv, notcurses_options* opts, FILE** json_output){
     fprintf(stderr, "Extra argument: %s\n", argv[optind + 1]);
     usage(*argv, EXIT_FAILURE);
   }
+  if(benchmarking && (opts->margin_t || opts->margin_r || opts->margin_b || opts->margin_l)){
+    fprintf(stderr, "Margins cannot be supplied in benchmark mode\n");
+    usage(*argv, EXIT_FAILURE);
+  }
   if(datadir == NULL){
     datadir = notcurses_data_dir();
   }
@@ -375,13 +445,29 @@ summary_json(FILE* f, const char* spec, int rows, int cols){
   int ret = 0;
   ret |= (fprintf(f, "{\"notcurses-demo\":{\"spec\":\"%s\",\"TERM\":\"%s\",\"rows\":\"%d\",\"cols\":\"%d\",\"runs\":{",
                   spec, getenv("TERM"), rows, cols) < 0);
+  bool first = true;
   for(size_t i = 0 ; i < strlen(spec) ; ++i){
     if(results[i].result || !results[i].stats.renders){
       continue;
     }
-    ret |= (fprintf(f, "\"%s\":{\"bytes\":\"%"PRIu64"\",\"frames\":\"%"PRIu64"\",\"ns\":\"%"PRIu64"\"}%s",
+    // skipped demos can follow, so separate from the previous entry instead
+    ret |= (fprintf(f, "%s", first ? "" : ",") < 0);
+    first = false;
+    ret |= (fprintf(f, "\"%s\":{\"bytes\":\"%"PRIu64"\",\"frames\":\"%"PRIu64"\",\"ns\":\"%"PRIu64"\"%s",
                     demos[results[i].selector - 'a'].name, results[i].stats.raster_bytes,
-                    results[i].stats.renders, results[i].timens, i < strlen(spec) - 1 ? "," : "") < 0);
+                    results[i].stats.renders, results[i].timens, benchmarking ? "," : "") < 0);
+    if(benchmarking){
+      // per-frame records are [render ns, raster ns, writeout ns, bytes]
+      ret |= (fprintf(f, "\"perframe\":[") < 0);
+      for(size_t j = 0 ; j < results[i].framecount ; ++j){
+        const demoframe* df = &results[i].frames[j];
+        ret |= (fprintf(f, "[%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"]%s",
+                        df->render_ns, df->raster_ns, df->writeout_ns, df->bytes,
+                        j < results[i].framecount - 1 ? "," : "") < 0);
+      }
+      ret |= (fprintf(f, "]") < 0);
+    }
+    ret |= (fprintf(f, "}") < 0);
   }
   ret |= (fprintf(f, "}}}\n") < 0);
   ret |= fclose(f);
@@ -498,6 +584,45 @@ summary_table(struct notcurses* nc, const char* spec, bool canimage, bool canvid
   return failed;
 }
 
+// pin the standard plane to BENCHMARK_ROWS x BENCHMARK_COLS using the bottom
+// and right margins, so that benchmark runs are comparable across terminals.
+// without any terminal (i.e. a headless run), notcurses falls back to the
+// LINES and COLUMNS environment variables, so we set those instead.
+static int
+benchmark_geometry(notcurses_options* opts){
+#ifndef __MINGW32__
+  // notcurses uses stdout if it's a terminal, and otherwise /dev/tty
+  struct winsize ws;
+  bool havetty = !ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
+  if(!havetty){
+    int fd = open("/dev/tty", O_RDWR | O_CLOEXEC | O_NOCTTY);
+    if(fd >= 0){
+      havetty = !ioctl(fd, TIOCGWINSZ, &ws);
+      close(fd);
+    }
+  }
+  if(!havetty){
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", BENCHMARK_ROWS);
+    setenv("LINES", buf, 1);
+    snprintf(buf, sizeof(buf), "%d", BENCHMARK_COLS);
+    setenv("COLUMNS", buf, 1);
+    return 0;
+  }
+  if(ws.ws_row < BENCHMARK_ROWS || ws.ws_col < BENCHMARK_COLS){
+    fprintf(stderr, "Benchmarking requires a %dx%d terminal (current: %dx%d)\n",
+            BENCHMARK_ROWS, BENCHMARK_COLS, ws.ws_row, ws.ws_col);
+    return -1;
+  }
+  opts->margin_b = ws.ws_row - BENCHMARK_ROWS;
+  opts->margin_r = ws.ws_col - BENCHMARK_COLS;
+#else
+  (void)opts;
+  fprintf(stderr, "Warning: can't pin geometry on this platform\n");
+#endif
+  return 0;
+}
+
 static int
 scrub_stdplane(struct notcurses* nc){
   struct ncplane* n = notcurses_stdplane(nc);
@@ -536,6 +661,9 @@ int main(int argc, char** argv){
       return EXIT_FAILURE;
     }
   }
+  if(benchmarking && benchmark_geometry(&nopts)){
+    return EXIT_FAILURE;
+  }
   struct timespec starttime;
   clock_gettime(CLOCK_MONOTONIC, &starttime);
   struct notcurses* nc;
@@ -553,7 +681,7 @@ int main(int argc, char** argv){
   if(dimy < MIN_SUPPORTED_ROWS || dimx < MIN_SUPPORTED_COLS){
     goto err;
   }
-  if((nopts.flags & NCOPTION_NO_ALTERNATE_SCREEN)){ // no one cares. 1s max.
+  if((nopts.flags & NCOPTION_NO_ALTERNATE_SCREEN) && !benchmarking){ // no one cares. 1s max.
     if(demodelay.tv_sec >= 1){
       sleep(1);
     }else{
@@ -597,13 +725,16 @@ int main(int argc, char** argv){
   notcurses_render(nc); // rid ourselves of any remaining demo output
   int r = summary_table(nc, spec, canimage, canvideo);
   notcurses_render(nc); // render our summary table
-  free(results);
   if(notcurses_stop(nc)){
     return EXIT_FAILURE;
   }
   if(json && summary_json(json, spec, dimy, dimx)){
     return EXIT_FAILURE;
   }
+  for(int i = 0 ; i < democount ; ++i){
+    free(results[i].frames);
+  }
+  free(results);
   free(datadir);
   return r ? EXIT_FAILURE : EXIT_SUCCESS;
 
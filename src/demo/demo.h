@@ -22,6 +22,25 @@ extern float delaymultiplier; // scales demodelay (applied internally)
 // checked in demo_render() and between demos
 extern atomic_bool interrupted;
 
+// -b: benchmark mode. pacing sleeps are elided, the PRNG gets a constant
+// seed, the standard plane is pinned to BENCHMARK_ROWS x BENCHMARK_COLS, and
+// per-frame statistics are recorded for the JSON summary.
+extern bool benchmarking;
+#define BENCHMARK_ROWS 24
+#define BENCHMARK_COLS 80
+// virtual time accrued by each demo_render() in benchmark mode
+#define BENCHMARK_FRAMENS (NANOSECS_IN_SEC / 60)
+
+// the clock against which demos pace themselves. demos must use this rather
+// than clock_gettime(). in benchmark mode, it's a virtual clock, advanced by
+// BENCHMARK_FRAMENS with each demo_render(), and by the requested interval
+// with each demo_nanosleep() or demo_getc() timeout, so that every run sees
+// the same frames. otherwise, it's CLOCK_MONOTONIC.
+uint64_t demo_getns(void);
+
+// advance the virtual clock by |ns|. a no-op unless benchmarking.
+void demo_clock_advance(uint64_t ns);
+
 // heap-allocated, caller must free. locates data files per command line args.
 char* find_data(const char* datum);
 
@@ -87,6 +106,11 @@ demo_getc_blocking(struct notcurses* nc, ncinput* ni){
 /*-------------------------------time helpers----------------------------*/
 #define MAXSLEEP (NANOSECS_IN_SEC / 80) // nanoseconds
 
+static inline void
+demo_gettime(struct timespec* ts){
+  ns_to_timespec(demo_getns(), ts);
+}
+
 static inline int64_t
 timespec_subtract_ns(const struct timespec* time1, const struct timespec* time0){
   int64_t ns = timespec_to_ns(time1);
@@ -165,6 +189,9 @@ demo_simple_streamer(struct ncvisual* ncv __attribute__ ((unused)),
                      struct ncvisual_options* vopts,
                      const struct timespec* tspec, void* curry __attribute__ ((unused))){
   DEMO_RENDER(ncplane_notcurses(vopts->n));
+  if(benchmarking){ // tspec is on the library's clock, not ours
+    return 0;
+  }
   return demo_nanosleep_abstime(ncplane_notcurses(vopts->n), tspec);
 }
 
@@ -173,9 +200,20 @@ static inline int
 demo_fader(struct notcurses* nc, struct ncplane* ncp __attribute__ ((unused)),
            const struct timespec* abstime, void* curry __attribute__ ((unused))){
   DEMO_RENDER(nc);
+  if(benchmarking){ // abstime is on the library's clock, not ours
+    return 0;
+  }
   return demo_nanosleep_abstime(nc, abstime);
 }
 
+// ncplane_fadeout(), ncplane_fadein(), and ncplane_pulse() pace themselves
+// using the real clock. in benchmark mode, these pace the same iterations
+// using demo_getns(), and thus require a fader which calls demo_render()
+// (such as demo_fader()).
+int demo_fadeout(struct ncplane* n, const struct timespec* ts, fadecb fader, void* curry);
+int demo_fadein(struct ncplane* n, const struct timespec* ts, fadecb fader, void* curry);
+int demo_pulse(struct ncplane* n, const struct timespec* ts, fadecb fader, void* curry);
+
 
 // grab the hud with the mouse
 int hud_grab(int y, int x);
@@ -183,13 +221,28 @@ int hud_grab(int y, int x);
 // release the hud
 int hud_release(void);
 
+// statistics accumulated over one demo_render() in benchmark mode
+typedef struct demoframe {
+  uint64_t render_ns;
+  uint64_t raster_ns;
+  uint64_t writeout_ns;
+  uint64_t bytes;
+} demoframe;
+
 typedef struct demoresult {
   char selector;
   struct ncstats stats;
   uint64_t timens;
   int result; // positive == aborted, negative == failed
+  demoframe* frames; // only populated in benchmark mode
+  size_t framecount;
+  size_t framealloc;
 } demoresult;
 
+// in benchmark mode, attribute the statistics accumulated since the last
+// call to a new frame of the running demo. called from demo_render().
+int demo_record_frame(struct notcurses* nc);
+
 // let the HUD know that a demo has completed, reporting the stats
 int hud_completion_notify(const demoresult* result);
 
@@ -212,7 +265,7 @@ pulser(struct notcurses* nc, struct ncplane* ncp __attribute__ ((unused)),
        const struct timespec* ts __attribute__ ((unused)), void* curry){
   struct timespec* start = curry;
   struct timespec now;
-  clock_gettime(CLOCK_MONOTONIC, &now);
+  demo_gettime(&now);
   if(timespec_to_ns(&now) - timespec_to_ns(start) >= timespec_to_ns(&demodelay)){
     return 2;
   }
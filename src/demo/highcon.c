@@ -95,7 +95,7 @@ int highcon_demo(struct notcurses* nc, uint64_t startns){
   // bottom right.
   int offset = 0;
   struct timespec start;
-  clock_gettime(CLOCK_MONOTONIC, &start);
+  demo_gettime(&start);
   uint64_t totalns = timespec_to_ns(&demodelay) * 2;
   uint64_t iterns = totalns / (totcells / 2);
   do{
@@ -121,7 +121,7 @@ int highcon_demo(struct notcurses* nc, uint64_t startns){
     DEMO_RENDER(nc);
     uint64_t targns = timespec_to_ns(&start) + offset * iterns;
     struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     if(targns > timespec_to_ns(&now)){
       struct timespec abstime;
       ns_to_timespec(targns, &abstime);
@@ -515,7 +515,8 @@ int fpsplot_release(void){
 // currently running demo is always at y = HUD_ROWS-2
 int hud_completion_notify(const demoresult* result){
   if(elems){
-    elems->totalns = result->timens;
+    // not result->timens, which is always the true runtime
+    elems->totalns = demo_getns() - elems->startns;
     elems->frames = result->stats.renders;
   }
   return 0;
@@ -537,12 +538,19 @@ int hud_schedule(const char* demoname, uint64_t startns){
 }
 
 // wake up every 10ms and render a frame so the HUD doesn't appear locked up.
-// provide an absolute deadline calculated via CLOCK_MONOTONIC.
+// provide an absolute deadline calculated via demo_getns().
 static int
 demo_nanosleep_abstime_ns(struct notcurses* nc, uint64_t deadline){
   struct timespec fsleep;
   struct timespec now;
 
+  if(benchmarking){ // run flat out; input is still handled in demo_render()
+    uint64_t nowns = demo_getns();
+    if(deadline > nowns){
+      demo_clock_advance(deadline - nowns);
+    }
+    return interrupted ? 1 : 0;
+  }
   clock_gettime(CLOCK_MONOTONIC, &now);
   while(deadline > timespec_to_ns(&now)){
     fsleep.tv_sec = 0;
@@ -570,7 +578,7 @@ int demo_nanosleep(struct notcurses* nc, const struct timespec *ts){
   uint64_t deadline;
   struct timespec now;
   uint64_t nstotal = timespec_to_ns(ts);
-  clock_gettime(CLOCK_MONOTONIC, &now);
+  demo_gettime(&now);
   deadline = timespec_to_ns(&now) + nstotal;
   return demo_nanosleep_abstime_ns(nc, deadline);
 }
@@ -579,6 +587,75 @@ int demo_nanosleep_abstime(struct notcurses* nc, const struct timespec* abstime)
   return demo_nanosleep_abstime_ns(nc, timespec_to_ns(abstime));
 }
 
+// the iterations of ncplane_fade{in, out}(), paced by demo_getns(). the fader
+// must advance the clock, i.e. call demo_render().
+static int
+demo_fade(struct ncplane* n, struct ncfadectx* nctx, const struct timespec* ts,
+          bool fadein, fadecb fader, void* curry){
+  const int maxsteps = ncfadectx_iterations(nctx);
+  uint64_t stepns = timespec_to_ns(ts) / maxsteps;
+  if(stepns == 0){
+    stepns = 1;
+  }
+  const uint64_t startns = demo_getns();
+  int iter;
+  while((iter = (demo_getns() - startns) / stepns + 1) <= maxsteps){
+    int r = fadein ? ncplane_fadein_iteration(n, nctx, iter, fader, curry) :
+                     ncplane_fadeout_iteration(n, nctx, iter, fader, curry);
+    if(r){
+      return r;
+    }
+  }
+  return 0;
+}
+
+int demo_fadeout(struct ncplane* n, const struct timespec* ts, fadecb fader, void* curry){
+  if(!benchmarking){
+    return ncplane_fadeout(n, ts, fader, curry);
+  }
+  struct ncfadectx* nctx = ncfadectx_setup(n);
+  if(nctx == NULL){
+    return -1;
+  }
+  int ret = demo_fade(n, nctx, ts, false, fader, curry);
+  ncfadectx_free(nctx);
+  return ret;
+}
+
+int demo_fadein(struct ncplane* n, const struct timespec* ts, fadecb fader, void* curry){
+  if(!benchmarking){
+    return ncplane_fadein(n, ts, fader, curry);
+  }
+  struct ncfadectx* nctx = ncfadectx_setup(n);
+  if(nctx == NULL){
+    struct timespec now;
+    demo_gettime(&now);
+    fader(ncplane_notcurses(n), n, &now, curry);
+    return -1;
+  }
+  int ret = demo_fade(n, nctx, ts, true, fader, curry);
+  ncfadectx_free(nctx);
+  return ret;
+}
+
+int demo_pulse(struct ncplane* n, const struct timespec* ts, fadecb fader, void* curry){
+  if(!benchmarking){
+    return ncplane_pulse(n, ts, fader, curry);
+  }
+  struct ncfadectx* nctx = ncfadectx_setup(n);
+  if(nctx == NULL){
+    return -1;
+  }
+  int ret;
+  do{
+    if((ret = demo_fade(n, nctx, ts, true, fader, curry)) == 0){
+      ret = demo_fadeout(n, ts, fader, curry);
+    }
+  }while(ret == 0);
+  ncfadectx_free(nctx);
+  return ret;
+}
+
 // FIXME needs to pass back any ncinput read, if requested...hrmmm
 int demo_render(struct notcurses* nc){
   if(interrupted){
@@ -591,7 +668,7 @@ int demo_render(struct notcurses* nc){
     ncplane_move_top(debug);
   }
   struct timespec ts;
-  clock_gettime(CLOCK_MONOTONIC, &ts);
+  demo_gettime(&ts);
   if(plot){
     if(!plot_hidden){
       ncplane_move_family_top(ncuplot_plane(plot));
@@ -641,6 +718,12 @@ int demo_render(struct notcurses* nc){
   if(ret){
     return ret;
   }
+  if(benchmarking){
+    if(demo_record_frame(nc)){
+      return -1;
+    }
+    demo_clock_advance(BENCHMARK_FRAMENS);
+  }
   if(id == 'q'){
     return 1;
   }
@@ -694,9 +777,7 @@ int fpsgraph_init(struct notcurses* nc){
     return EXIT_FAILURE;
   }
   plot = fpsplot;
-  struct timespec ts;
-  clock_gettime(CLOCK_MONOTONIC, &ts);
-  plottimestart = timespec_to_ns(&ts);
+  plottimestart = demo_getns();
   if(plot_hidden){
     ncplane_reparent_family(ncuplot_plane(plot), ncuplot_plane(plot));
   }
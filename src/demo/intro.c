@@ -208,7 +208,7 @@ int intro_demo(struct notcurses* nc, uint64_t startns){
     ncplane_off_styles(ncp, NCSTYLE_BOLD);
   }
   struct timespec now;
-  clock_gettime(CLOCK_MONOTONIC, &now);
+  demo_gettime(&now);
   // there ought be 20 iterations
   const int expected_iter = 20;
   uint64_t deadline = timespec_to_ns(&now) + timespec_to_ns(&demodelay) * 2;
@@ -218,7 +218,7 @@ int intro_demo(struct notcurses* nc, uint64_t startns){
   struct ncplane* on = NULL;
   do{
     demo_nanosleep(nc, &iter);
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     int err;
     if(!on){
       if(notcurses_canopen_images(nc)){
@@ -239,7 +239,7 @@ int intro_demo(struct notcurses* nc, uint64_t startns){
   if(notcurses_canfade(nc)){
     struct timespec fade = demodelay;
     int err;
-    if( (err = ncplane_fadeout(ncp, &fade, demo_fader, NULL)) ){
+    if( (err = demo_fadeout(ncp, &fade, demo_fader, NULL)) ){
       return err;
     }
   }
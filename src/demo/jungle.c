@@ -26653,7 +26653,7 @@ int jungle_demo(struct notcurses* nc, uint64_t startns){
       demo_nanosleep(nc, &sleepts);
     }
     cycle_palettes(nc, pal);
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     nsrunning = timespec_to_ns(&now) - startns;
   }while(nsrunning > 0 && (uint64_t)nsrunning < 5 * timespec_to_ns(&demodelay));
   ncpalette_free(pal);
@@ -3811,7 +3811,7 @@ int mojibake_demo(struct notcurses* nc, uint64_t startns){
   struct timespec stepdelay, starttime;
   // two seconds onscreen per plane at standard (1s) delay
   timespec_div(&demodelay, dimy / 2, &stepdelay);
-  clock_gettime(CLOCK_MONOTONIC, &starttime);
+  demo_gettime(&starttime);
   do{
     unsigned u = topmost;
     do{
@@ -3849,7 +3849,7 @@ int mojibake_demo(struct notcurses* nc, uint64_t startns){
     ++iters;
     uint64_t targtime = iters * timespec_to_ns(&stepdelay) + timespec_to_ns(&starttime);
     struct timespec curtime;
-    clock_gettime(CLOCK_MONOTONIC, &curtime);
+    demo_gettime(&curtime);
     if(timespec_to_ns(&curtime) < targtime){
       struct timespec abs;
       ns_to_timespec(targtime, &abs);
@@ -22,7 +22,9 @@ perframe(struct ncvisual* ncv __attribute__ ((unused)),
     --y;
     *three = 3;
   }
-  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, abstime, NULL);
+  if(!benchmarking){
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, abstime, NULL);
+  }
   return 0;
 }
 
@@ -73,7 +75,7 @@ videothread(void* vnc){
   if(samoactx == NULL){
     return NULL;
   }
-  if(ncplane_fadeout(vopts.n, &fade, changes_fadeout, samoactx) < 0){
+  if(demo_fadeout(vopts.n, &fade, changes_fadeout, samoactx) < 0){
     ncfadectx_free(samoactx);
     ncplane_destroy(vopts.n);
     ncvisual_destroy(ncv);
@@ -229,7 +231,7 @@ int outro_demo(struct notcurses* nc, uint64_t startns){
   }
   // fade out the closing message, which has reached the top (if we ran the
   // video) or is sitting at the bottom (if we didn't).
-  ncplane_fadeout(on, &demodelay, demo_fader, NULL);
+  demo_fadeout(on, &demodelay, demo_fader, NULL);
   ncplane_destroy(on);
   ncvisual_destroy(chncv);
   return on ? 0 : -1;
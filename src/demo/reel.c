@@ -177,7 +177,7 @@ handle_input(struct notcurses* nc, const struct timespec* deadline,
              ncinput* ni){
   int64_t deadlinens = timespec_to_ns(deadline);
   struct timespec pollspec, cur;
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   int64_t curns = timespec_to_ns(&cur);
   if(curns > deadlinens){
     return 0;
@@ -323,7 +323,7 @@ ncreel_demo_core(struct notcurses* nc, uint64_t startns){
       tctxs = newtablet;
     }
     struct timespec cur;
-    clock_gettime(CLOCK_MONOTONIC, &cur);
+    demo_gettime(&cur);
     if(timespec_subtract_ns(&cur, &deadline) >= 0){
       break;
     }
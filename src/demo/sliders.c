@@ -56,7 +56,7 @@ play(struct notcurses* nc, struct ncplane** chunks, uint64_t startns){
   int m;
   int lastdir = -1;
   for(m = 0 ; m < MOVES ; ++m){
-    uint64_t now = clock_getns(CLOCK_MONOTONIC);
+    uint64_t now = demo_getns();
     if(now >= deadline_ns){
       break;
     }
@@ -91,7 +91,7 @@ slideitslideit(struct notcurses* nc, struct ncplane* n, uint64_t deadline,
     }
     ncplane_move_yx(n, yoff, xoff);
     demo_nanosleep(nc, &iterdelay);
-    clock_gettime(CLOCK_MONOTONIC, &cur);
+    demo_gettime(&cur);
   }while(timespec_to_ns(&cur) < deadline);
   return 0;
 }
@@ -123,7 +123,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   nccell c = NCCELL_CHAR_INITIALIZER(' ');
   struct timespec cur;
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   uint64_t deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   int velx = rand() % 4 + 1;
   int vely = rand() % 4 + 1;
@@ -138,7 +138,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
 
   nccell_load_char(n, &c, '\0');
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   l = legend(nc, "default background, all opaque, no glyph");
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -152,7 +152,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   // be seen in their natural colors. Our background remains opaque+default.
   nccell_set_fg_alpha(&c, NCALPHA_TRANSPARENT);
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   l = legend(nc, "default background, fg transparent, no glyph");
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -167,7 +167,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   nccell_set_fg_rgb(&c, 0x80c080);
   nccell_set_fg_alpha(&c, NCALPHA_BLEND);
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   l = legend(nc, "default background, fg blended, no glyph");
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -182,7 +182,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   nccell_set_fg_rgb(&c, 0x80c080);
   nccell_set_fg_alpha(&c, NCALPHA_OPAQUE);
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   l = legend(nc, "default background, fg colored opaque, no glyph");
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -199,7 +199,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   nccell_set_fg_alpha(&c, NCALPHA_TRANSPARENT);
   nccell_set_bg_alpha(&c, NCALPHA_OPAQUE);
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   l = legend(nc, "default colors, fg transparent, print glyph");
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -214,7 +214,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   nccell_set_fg_alpha(&c, NCALPHA_TRANSPARENT);
   nccell_set_bg_alpha(&c, NCALPHA_TRANSPARENT);
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   l = legend(nc, "all transparent, print glyph");
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -231,7 +231,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
   nccell_set_fg_rgb(&c, 0x80c080);
   nccell_set_bg_rgb(&c, 0x204080);
   ncplane_set_base_cell(n, &c);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   l = legend(nc, "all blended, print glyph");
   deadlinens = timespec_to_ns(&cur) + timespec_to_ns(&demodelay);
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -258,7 +258,7 @@ slidepanel(struct notcurses* nc, struct ncplane* stdn){
     return err;
   }
   ncvisual_destroy(ncv);
-  clock_gettime(CLOCK_MONOTONIC, &cur);
+  demo_gettime(&cur);
   l = legend(nc, "partially-transparent image");
   deadlinens = timespec_to_ns(&cur) + 2 * timespec_to_ns(&demodelay);
   if( (err = slideitslideit(nc, n, deadlinens, &vely, &velx)) ){
@@ -306,9 +306,9 @@ int trans_demo(struct notcurses* nc, uint64_t startns){
     struct ncplane* l = legend(nc, "what say we explore transparency together?");
     DEMO_RENDER(nc);
     struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     int err;
-    if( (err = ncplane_pulse(l, &demodelay, pulser, &now)) != 2){
+    if( (err = demo_pulse(l, &demodelay, pulser, &now)) != 2){
       return err;
     }
     ncplane_destroy(l);
@@ -509,7 +509,7 @@ int whiteout_demo(struct notcurses* nc, uint64_t startns){
     uint32_t key = NCKEY_INVALID;
     nccell c;
     struct timespec screenend;
-    clock_gettime(CLOCK_MONOTONIC, &screenend);
+    demo_gettime(&screenend);
     ns_to_timespec(timespec_to_ns(&screenend) + timespec_to_ns(&demodelay), &screenend);
     do{ // (re)draw a screen
       const int start = starts[i];
@@ -569,7 +569,7 @@ int whiteout_demo(struct notcurses* nc, uint64_t startns){
         }else{
           ns_to_timespec(delay, &tv);
         }
-        ncplane_fadein(n, &tv, demo_fader, NULL);
+        demo_fadein(n, &tv, demo_fader, NULL);
       }
 
       struct worm_ctx wctx;
@@ -584,7 +584,7 @@ int whiteout_demo(struct notcurses* nc, uint64_t startns){
         struct timespec ts;
         ns_to_timespec(timespec_to_ns(&demodelay) / 10000, &ts);
         key = demo_getc(nc, &ts, NULL);
-        clock_gettime(CLOCK_MONOTONIC, &cur);
+        demo_gettime(&cur);
         if(timespec_to_ns(&screenend) < timespec_to_ns(&cur)){
           break;
         }
@@ -73,7 +73,7 @@ struct marsh {
   struct ncplane* slider;   // text plane at top, sliding to the left
   float dm;                 // delay multiplier
   int next_frame;
-  uint64_t startns;         // when we started (CLOCK_MONOTONIC) for frame dropping
+  uint64_t startns;         // when we started (demo_getns()) for frame dropping
   int* frame_to_render;     // shared; protected by renderlock
   int* dropped;             // shared; protected by renderlock
   struct ncplane** lplane;  // shared; plane to destroy, renderlocked
@@ -112,13 +112,13 @@ get_next_frame(struct marsh* m, struct ncvisual_options* vopts){
   if(ncvisual_decode(m->ncv)){
     return -1;
   }
-  uint64_t ns = clock_getns(CLOCK_MONOTONIC);
+  uint64_t ns = demo_getns();
   int ret = m->next_frame;
   uint64_t deadline = m->startns + (m->next_frame + 1) * MAX_SECONDS * (NANOSECS_IN_SEC / VIDEO_FRAMES);
   // if we've missed the deadline, drop the frame 99% of the time (you've still
   // got to draw now and again, or else there's just the initial frame hanging
-  // there for ~900 frames of crap).
-  if(ns > deadline && (rand() % 100)){
+  // there for ~900 frames of crap). benchmarks must draw every frame.
+  if(!benchmarking && ns > deadline && (rand() % 100)){
     ncplane_destroy(vopts->n);
     vopts->n = NULL;
   }else if(ncvisual_blit(m->nc, m->ncv, vopts) == NULL){
@@ -147,7 +147,7 @@ static int
 reader_post(struct notcurses* nc, struct ncselector* selector, struct ncmultiselector* mselector){
   int ret;
   struct timespec ts;
-  clock_gettime(CLOCK_MONOTONIC, &ts);
+  demo_gettime(&ts);
   uint64_t cur = timespec_to_ns(&ts);
   uint64_t targ = cur + timespec_to_ns(&demodelay);
   do{
@@ -160,7 +160,7 @@ reader_post(struct notcurses* nc, struct ncselector* selector, struct ncmultisel
     }else if(wc){
       ncmultiselector_offer_input(mselector, &ni);
     }
-    clock_gettime(CLOCK_MONOTONIC, &ts);
+    demo_gettime(&ts);
     cur = timespec_to_ns(&ts);
     if( (ret = demo_render(nc)) ){
       return ret;
@@ -169,10 +169,10 @@ reader_post(struct notcurses* nc, struct ncselector* selector, struct ncmultisel
   struct timespec fadedelay;
   ns_to_timespec(timespec_to_ns(&demodelay) * 2, &fadedelay);
   if(notcurses_canfade(nc)){
-    if(ncplane_fadeout(ncselector_plane(selector), &fadedelay, demo_fader, NULL)){
+    if(demo_fadeout(ncselector_plane(selector), &fadedelay, demo_fader, NULL)){
       return -1;
     }
-    if(ncplane_fadeout(ncmultiselector_plane(mselector), &fadedelay, demo_fader, NULL)){
+    if(demo_fadeout(ncmultiselector_plane(mselector), &fadedelay, demo_fader, NULL)){
       return -1;
     }
   }
@@ -258,7 +258,7 @@ selector_run(struct notcurses* nc, struct ncplane* p, struct ncselector* selecto
   struct timespec iterdelay, start;
   timespec_div(&demodelay, iters / 4, &iterdelay);
   size_t textpos = 0;
-  clock_gettime(CLOCK_MONOTONIC, &start);
+  demo_gettime(&start);
   for(int i = 0 ; i < iters ; ++i){
     if(i == (int)(xi * eachx)){
       if(ncplane_move_yx(ncselector_plane(selector), sy, --sx)){
@@ -281,7 +281,7 @@ selector_run(struct notcurses* nc, struct ncplane* p, struct ncselector* selecto
     struct timespec targettime, now;
     timespec_mul(&iterdelay, i + 1, &targettime);
     const uint64_t deadline_ns = timespec_to_ns(&start) + timespec_to_ns(&targettime);
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     while(timespec_to_ns(&now) < deadline_ns){
       if( (ret = demo_render(nc)) ){
         return ret;
@@ -295,7 +295,7 @@ selector_run(struct notcurses* nc, struct ncplane* p, struct ncselector* selecto
       }else if(wc){
         ncselector_offer_input(selector, &ni);
       }
-      clock_gettime(CLOCK_MONOTONIC, &now);
+      demo_gettime(&now);
     }
   }
   return run_out_text(p, text, &textpos, &iterdelay);
@@ -332,7 +332,7 @@ mselector_run(struct notcurses* nc, struct ncplane* p, struct ncmultiselector* m
   int ti = 1;
   struct timespec iterdelay, start;
   timespec_div(&demodelay, iters / 4, &iterdelay);
-  clock_gettime(CLOCK_MONOTONIC, &start);
+  demo_gettime(&start);
   size_t textpos = 0;
   for(int i = 0 ; i < iters ; ++i){
     if(i == (int)(ti * eacht)){
@@ -356,7 +356,7 @@ mselector_run(struct notcurses* nc, struct ncplane* p, struct ncmultiselector* m
     struct timespec targettime, now;
     timespec_mul(&iterdelay, i + 1, &targettime);
     const uint64_t deadline_ns = timespec_to_ns(&start) + timespec_to_ns(&targettime);
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    demo_gettime(&now);
     while(timespec_to_ns(&now) < deadline_ns){
       if( (ret = demo_render(nc)) ){
         return ret;
@@ -370,7 +370,7 @@ mselector_run(struct notcurses* nc, struct ncplane* p, struct ncmultiselector* m
       }else if(wc){
         ncmultiselector_offer_input(mselector, &ni);
       }
-      clock_gettime(CLOCK_MONOTONIC, &now);
+      demo_gettime(&now);
     }
   }
   return run_out_text(p, text, &textpos, &iterdelay);
@@ -187,6 +187,8 @@ legacy_viz(struct ncplane* n, const char* indent, const wchar_t* eighths,
   return 0;
 }
 
+// 31 sextants from |sex|. the 62 between NCSEXBLOCKS' leading space and
+// trailing full block make up two rows.
 static int
 sex_viz(struct ncplane* n, const wchar_t* sex, wchar_t r, const wchar_t* post){
   for(int i = 0 ; i < 31 ; ++i){
@@ -276,7 +278,7 @@ unicodedumper(struct notcurses* nc, struct ncplane* n, const char* indent){
     ncplane_printf(n, "%s%ls⎧", indent, NCQUADBLOCKS);
     // 🯰🯱🯲🯳🯴🯵🯶🯷🯸🯹 (on Windows, these will be encoded as UTF-16 surrogate
     // pairs due to a 16-bit wchar_t.
-    sex_viz(n, NCSEXBLOCKS, L'⎫', L"♠♥" NCSEGDIGITS L"\u2157\u2158\u2159\u215a\u215b");
+    sex_viz(n, &NCSEXBLOCKS[1], L'⎫', L"♠♥" NCSEGDIGITS L"\u2157\u2158\u2159\u215a\u215b");
     vertviz(n, L'⎧', NCEIGHTHSR[0], NCEIGHTHSL[0], L'⎫', L"┌╥─╥─╥┐🭩⎛⎞");
     ncplane_printf(n, "%s╲╿╱ ◨◧ ◪◩ ◖◗ ⫷⫸ ⎩", indent);
     sex_viz(n, &NCSEXBLOCKS[32], L'⎭', L"♦♣\u00bc\u00bd\u00be\u2150\u2151\u2152\u2153\u2154\u2155\u2156\u215c\u215d\u215e\u215f\u2189");
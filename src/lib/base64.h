@@ -5,6 +5,16 @@
 extern "C" {
 #endif
 
+// on x86 we select SSSE3 or AVX2 at runtime, so that they're available without
+// building for a particular microarchitecture. AArch64 always has NEON.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NCBASE64_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NCBASE64_NEON
+#endif
+
 // convert a base64 character into its equivalent integer 0..63
 static inline int
 b64idx(char b64){
@@ -25,69 +35,25 @@ b64idx(char b64){
 static unsigned const char b64subs[] =
  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-// every 3 RGBA pixels (96 bits) become 16 base64-encoded bytes (128 bits). if
-// there are only 2 pixels available, those 64 bits become 12 bytes. if there
-// is only 1 pixel available, those 32 bits become 8 bytes. (pcount + 1) * 4
-// bytes are used, plus a null terminator. we thus must receive 17.
-// wipe is referring to the sprixcell state, i.e. whether it was annihilated.
-// it always makes a pixel transparent (by setting alpha to 0). otherwise, we
-// check the pixel against the transcolor. matches (and sufficiently low alpha)
-// are likewise flattened to alpha=0.
+// stage up to 3 RGBA pixels (96 bits, which become 16 base64-encoded bytes)
+// for base64_encode(). wipe is referring to the sprixcell state, i.e. whether
+// it was annihilated. it always makes a pixel transparent (by setting alpha to
+// 0). otherwise, we check the pixel against the transcolor. matches (and
+// sufficiently low alpha) are likewise flattened to alpha=0. we go ahead and
+// take advantage of kitty's ability to reproduce 8-bit alphas by copying the
+// first pixel's in directly, but the second and third are opaque otherwise.
 static inline void
-base64_rgba3(const uint32_t pixels[static 3], size_t pcount,
-             char b64[static 17], bool wipe[static 3], uint32_t transcolor){
-  uint32_t pixel = pixels[0];
-  unsigned r = ncpixel_r(pixel);
-  unsigned g = ncpixel_g(pixel);
-  unsigned b = ncpixel_b(pixel);
-  // we go ahead and take advantage of kitty's ability to reproduce 8-bit
-  // alphas by copying it in directly, rather than mapping to {0, 255}.
-  unsigned a = ncpixel_a(pixel);
-  if(wipe[0] || rgba_trans_p(pixel, transcolor)){
-    a = 0;
-  }
-  b64[0] = b64subs[(r & 0xfc) >> 2];
-  b64[1] = b64subs[(r & 0x3 << 4) | ((g & 0xf0) >> 4)];
-  b64[2] = b64subs[((g & 0xf) << 2) | ((b & 0xc0) >> 6)];
-  b64[3] = b64subs[b & 0x3f];
-  b64[4] = b64subs[(a & 0xfc) >> 2];
-  if(pcount == 1){
-    b64[5] = b64subs[(a & 0x3) << 4];
-    b64[6] = '=';
-    b64[7] = '=';
-    b64[8] = '\0';
-    return;
+base64_stage_rgba3(uint32_t dst[static 3], const uint32_t pixels[static 3],
+                   size_t pcount, const bool wipe[static 3], uint32_t transcolor){
+  for(size_t p = 0 ; p < pcount ; ++p){
+    uint32_t pixel = pixels[p];
+    if(wipe[p] || rgba_trans_p(pixel, transcolor)){
+      ncpixel_set_a(&pixel, 0);
+    }else if(p){
+      ncpixel_set_a(&pixel, 0xff);
+    }
+    dst[p] = pixel;
   }
-  b64[5] = (a & 0x3) << 4;
-  pixel = pixels[1];
-  r = ncpixel_r(pixel);
-  g = ncpixel_g(pixel);
-  b = ncpixel_b(pixel);
-  a = wipe[1] ? 0 : rgba_trans_p(pixel, transcolor) ? 0 : 255;
-  b64[5] = b64subs[b64[5] | ((r & 0xf0) >> 4)];
-  b64[6] = b64subs[((r & 0xf) << 2) | ((g & 0xc0) >> 6u)];
-  b64[7] = b64subs[g & 0x3f];
-  b64[8] = b64subs[(b & 0xfc) >> 2];
-  b64[9] = b64subs[((b & 0x3) << 4) | ((a & 0xf0) >> 4)];
-  if(pcount == 2){
-    b64[10] = b64subs[(a & 0xf) << 2];
-    b64[11] = '=';
-    b64[12] = '\0';
-    return;
-  }
-  b64[10] = (a & 0xf) << 2;
-  pixel = pixels[2];
-  r = ncpixel_r(pixel);
-  g = ncpixel_g(pixel);
-  b = ncpixel_b(pixel);
-  a = wipe[2] ? 0 : rgba_trans_p(pixel, transcolor) ? 0 : 255;
-  b64[10] = b64subs[b64[10] | ((r & 0xc0) >> 6)];
-  b64[11] = b64subs[r & 0x3f];
-  b64[12] = b64subs[(g & 0xfc) >> 2];
-  b64[13] = b64subs[((g & 0x3) << 4) | ((b & 0xf0) >> 4)];
-  b64[14] = b64subs[((b & 0xf) << 2) | ((a & 0xc0) >> 6)];
-  b64[15] = b64subs[a & 0x3f];
-  b64[16] = '\0';
 }
 
 // convert 3 8-bit bytes into 4 base64-encoded characters
@@ -126,6 +92,138 @@ base64final(const unsigned char* src, char* b64, size_t b){
   }
 }
 
+#ifdef NCBASE64_X86
+// encode 12 bytes (loaded into the low 3/4 of |in|) into 16 base64 bytes. the
+// 6-bit fields are shifted into place with multiplies, and then mapped to
+// ASCII by adding an offset which depends only on the range of the field.
+// see Wojciech Muła, "Base64 encoding with SIMD instructions".
+__attribute__ ((target("ssse3")))
+static inline __m128i
+base64_ssse3_lane(__m128i in){
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  const __m128i idx = _mm_or_si128(t1, t3);
+  // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+  __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+  const __m128i lt26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+  r = _mm_or_si128(r, _mm_and_si128(lt26, _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_mm_shuffle_epi8(offsets, r), idx);
+}
+
+// each iteration reads 16 bytes, but consumes only 12. returns the number of
+// bytes consumed (a multiple of 3).
+__attribute__ ((target("ssse3")))
+static inline size_t
+base64_ssse3(const unsigned char* src, size_t len, char* b64){
+  size_t i = 0;
+  while(len - i >= 16){
+    __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_si128((__m128i*)b64, base64_ssse3_lane(in));
+    b64 += 16;
+    i += 12;
+  }
+  return i;
+}
+
+// the same, operating on 24 bytes (two lanes of 12) at a time
+__attribute__ ((target("avx2")))
+static inline size_t
+base64_avx2(const unsigned char* src, size_t len, char* b64){
+  const __m256i shuf = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                       4, 5, 3, 4, 1, 2, 0, 1,
+                                       10, 11, 9, 10, 7, 8, 6, 7,
+                                       4, 5, 3, 4, 1, 2, 0, 1);
+  const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  size_t i = 0;
+  while(len - i >= 28){
+    const __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+    const __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    in = _mm256_shuffle_epi8(in, shuf);
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    const __m256i idx = _mm256_or_si256(t1, t3);
+    __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    const __m256i lt26 = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+    r = _mm256_or_si256(r, _mm256_and_si256(lt26, _mm256_set1_epi8(13)));
+    r = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, r), idx);
+    _mm256_storeu_si256((__m256i*)b64, r);
+    b64 += 32;
+    i += 24;
+  }
+  return i + base64_ssse3(src + i, len - i, b64);
+}
+#endif
+
+#ifdef NCBASE64_NEON
+// 48 bytes are deinterleaved into three vectors, split into four vectors of
+// 6-bit fields, looked up in the 64-byte alphabet, and interleaved back out.
+static inline size_t
+base64_neon(const unsigned char* src, size_t len, char* b64){
+  uint8x16x4_t lut;
+  for(int t = 0 ; t < 4 ; ++t){
+    lut.val[t] = vld1q_u8(b64subs + t * 16);
+  }
+  const uint8x16_t mask = vdupq_n_u8(0x3f);
+  size_t i = 0;
+  while(len - i >= 48){
+    const uint8x16x3_t in = vld3q_u8(src + i);
+    uint8x16x4_t out;
+    out.val[0] = vshrq_n_u8(in.val[0], 2);
+    out.val[1] = vorrq_u8(vshrq_n_u8(in.val[1], 4), vandq_u8(vshlq_n_u8(in.val[0], 4), mask));
+    out.val[2] = vorrq_u8(vshrq_n_u8(in.val[2], 6), vandq_u8(vshlq_n_u8(in.val[1], 2), mask));
+    out.val[3] = vandq_u8(in.val[2], mask);
+    for(int t = 0 ; t < 4 ; ++t){
+      out.val[t] = vqtbl4q_u8(lut, out.val[t]);
+    }
+    vst4q_u8((uint8_t*)b64, out);
+    b64 += 64;
+    i += 48;
+  }
+  return i;
+}
+#endif
+
+// base64-encode |len| bytes from |src| into |b64|, padding the final group
+// as necessary. returns the number of bytes written, always 4 * ceil(len / 3).
+// no NUL terminator is written.
+static inline size_t
+base64_encode(const unsigned char* src, size_t len, char* b64){
+  size_t i = 0;
+#ifdef NCBASE64_X86
+  if(__builtin_cpu_supports("avx2")){
+    i = base64_avx2(src, len, b64);
+  }else if(__builtin_cpu_supports("ssse3")){
+    i = base64_ssse3(src, len, b64);
+  }
+#elif defined(NCBASE64_NEON)
+  i = base64_neon(src, len, b64);
+#endif
+  char* out = b64 + i / 3 * 4;
+  for( ; len - i >= 3 ; i += 3, out += 4){
+    base64x3(src + i, out);
+  }
+  if(i < len){
+    base64final(src + i, out, len - i);
+    out += 4;
+  }
+  return out - b64;
+}
+
 #ifdef __cplusplus
 }
 #endif
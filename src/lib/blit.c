@@ -2,6 +2,16 @@
 #include <inttypes.h>
 #include "internal.h"
 
+// as in base64.h, on x86 we select SSE2 or AVX2 at runtime. AArch64 always
+// has NEON.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NCBLIT_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NCBLIT_NEON
+#endif
+
 static const uint32_t zeroes32;
 static const unsigned char zeroes[] = "\x00\x00\x00\x00";
 
@@ -451,9 +461,6 @@ quadrant_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
   const unsigned char* dat = data;
   int visy = bargs->begy;
   for(y = bargs->u.cell.placey ; visy < (bargs->begy + leny) && y < dimy ; ++y, visy += 2){
-    if(ncplane_cursor_move_yx(nc, y, bargs->u.cell.placex < 0 ? 0 : bargs->u.cell.placex)){
-      return -1;
-    }
     int visx = bargs->begx;
     for(x = bargs->u.cell.placex ; visx < (bargs->begx + lenx) && x < dimx ; ++x, visx += 2){
       const unsigned char* rgbbase_tl = dat + (linesize * visy) + (visx * 4);
@@ -508,49 +515,277 @@ quadrant_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
   return total;
 }
 
+// take general lerps over the members of |part| (l0) and the nonmembers (l1)
+// among the |pixels| colors of |rgbas|. with |nointerpolate|, each set takes
+// its first member's color.
+static inline void
+hires_lerps(const uint32_t* rgbas, unsigned pixels, unsigned part,
+            unsigned nointerpolate, uint32_t* l0, uint32_t* l1){
+  unsigned rsum0 = 0, rsum1 = 0;
+  unsigned gsum0 = 0, gsum1 = 0;
+  unsigned bsum0 = 0, bsum1 = 0;
+  int insum = 0;
+  int outsum = 0;
+  for(unsigned mask = 0 ; mask < pixels ; ++mask){
+    if(part & (1u << mask)){
+      if(!nointerpolate || !insum){
+        rsum0 += ncpixel_r(rgbas[mask]);
+        gsum0 += ncpixel_g(rgbas[mask]);
+        bsum0 += ncpixel_b(rgbas[mask]);
+        ++insum;
+      }
+    }else{
+      if(!nointerpolate || !outsum){
+        rsum1 += ncpixel_r(rgbas[mask]);
+        gsum1 += ncpixel_g(rgbas[mask]);
+        bsum1 += ncpixel_b(rgbas[mask]);
+        ++outsum;
+      }
+    }
+  }
+  *l0 = generalerp(rsum0, gsum0, bsum0, insum);
+  *l1 = generalerp(rsum1, gsum1, bsum1, outsum);
+}
+
+// the vector solvers evaluate one partition per 16-bit lane. generalerp()'s
+// division by the member count becomes a multiply, taking the high half of
+// (sum + count - 1) * 2 * ceil(32768 / count). this is exact for sums of up
+// to eight 8-bit channels. a count of 0 gets a multiplier of 0, and thus 0.
+typedef struct hireslanes {
+  uint16_t part[128];   // partitions, as in hires_solver()
+  uint16_t bias0[128];  // count - 1 for members (foreground), 0 if none
+  uint16_t mul0[128];   // ceil(32768 / count) for members, 0 if none
+  uint16_t bias1[128];  // the same for nonmembers (background)
+  uint16_t mul1[128];
+  // the best solver for this processor, chosen by hireslanes_init()
+  void (*diffs)(const struct hireslanes* hl, unsigned parcount, unsigned pixels,
+                const uint16_t px[3][8], const uint16_t sums[3], uint16_t* diffs);
+} hireslanes;
+
+#ifdef NCBLIT_X86
+// fill in |diffs| with the total difference of each partition of the
+// |pixels| colors, provided as one lane per color channel in |px|, given
+// by |sums| in total.
+__attribute__ ((target("sse2")))
+static void
+hires_diffs_sse2(const hireslanes* hl, unsigned parcount, unsigned pixels,
+                 const uint16_t px[3][8], const uint16_t sums[3], uint16_t* diffs){
+  __m128i v[3][8];
+  for(unsigned i = 0 ; i < pixels ; ++i){
+    for(int c = 0 ; c < 3 ; ++c){
+      v[c][i] = _mm_set1_epi16(px[c][i]);
+    }
+  }
+  for(unsigned g = 0 ; g < parcount ; g += 8){
+    const __m128i part = _mm_loadu_si128((const __m128i*)(hl->part + g));
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)(hl->bias0 + g));
+    const __m128i m0 = _mm_loadu_si128((const __m128i*)(hl->mul0 + g));
+    const __m128i b1 = _mm_loadu_si128((const __m128i*)(hl->bias1 + g));
+    const __m128i m1 = _mm_loadu_si128((const __m128i*)(hl->mul1 + g));
+    __m128i in[8];
+    __m128i s0[3] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), };
+    for(unsigned i = 0 ; i < pixels ; ++i){
+      const __m128i bit = _mm_set1_epi16(1u << i);
+      in[i] = _mm_cmpeq_epi16(_mm_and_si128(part, bit), bit);
+      for(int c = 0 ; c < 3 ; ++c){
+        s0[c] = _mm_add_epi16(s0[c], _mm_and_si128(in[i], v[c][i]));
+      }
+    }
+    __m128i l0[3], l1[3];
+    for(int c = 0 ; c < 3 ; ++c){
+      const __m128i s1 = _mm_sub_epi16(_mm_set1_epi16(sums[c]), s0[c]);
+      l0[c] = _mm_mulhi_epu16(_mm_slli_epi16(_mm_add_epi16(s0[c], b0), 1), m0);
+      l1[c] = _mm_mulhi_epu16(_mm_slli_epi16(_mm_add_epi16(s1, b1), 1), m1);
+    }
+    __m128i total = _mm_setzero_si128();
+    for(unsigned i = 0 ; i < pixels ; ++i){
+      for(int c = 0 ; c < 3 ; ++c){
+        const __m128i l = _mm_or_si128(_mm_and_si128(in[i], l0[c]),
+                                       _mm_andnot_si128(in[i], l1[c]));
+        total = _mm_add_epi16(total, _mm_or_si128(_mm_subs_epu16(v[c][i], l),
+                                                  _mm_subs_epu16(l, v[c][i])));
+      }
+    }
+    _mm_storeu_si128((__m128i*)(diffs + g), total);
+  }
+}
+
+// as hires_diffs_sse2(), but sixteen partitions at a time.
+__attribute__ ((target("avx2")))
+static void
+hires_diffs_avx2(const hireslanes* hl, unsigned parcount, unsigned pixels,
+                 const uint16_t px[3][8], const uint16_t sums[3], uint16_t* diffs){
+  __m256i v[3][8];
+  for(unsigned i = 0 ; i < pixels ; ++i){
+    for(int c = 0 ; c < 3 ; ++c){
+      v[c][i] = _mm256_set1_epi16(px[c][i]);
+    }
+  }
+  for(unsigned g = 0 ; g < parcount ; g += 16){
+    const __m256i part = _mm256_loadu_si256((const __m256i*)(hl->part + g));
+    const __m256i b0 = _mm256_loadu_si256((const __m256i*)(hl->bias0 + g));
+    const __m256i m0 = _mm256_loadu_si256((const __m256i*)(hl->mul0 + g));
+    const __m256i b1 = _mm256_loadu_si256((const __m256i*)(hl->bias1 + g));
+    const __m256i m1 = _mm256_loadu_si256((const __m256i*)(hl->mul1 + g));
+    __m256i in[8];
+    __m256i s0[3] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), };
+    for(unsigned i = 0 ; i < pixels ; ++i){
+      const __m256i bit = _mm256_set1_epi16(1u << i);
+      in[i] = _mm256_cmpeq_epi16(_mm256_and_si256(part, bit), bit);
+      for(int c = 0 ; c < 3 ; ++c){
+        s0[c] = _mm256_add_epi16(s0[c], _mm256_and_si256(in[i], v[c][i]));
+      }
+    }
+    __m256i l0[3], l1[3];
+    for(int c = 0 ; c < 3 ; ++c){
+      const __m256i s1 = _mm256_sub_epi16(_mm256_set1_epi16(sums[c]), s0[c]);
+      l0[c] = _mm256_mulhi_epu16(_mm256_slli_epi16(_mm256_add_epi16(s0[c], b0), 1), m0);
+      l1[c] = _mm256_mulhi_epu16(_mm256_slli_epi16(_mm256_add_epi16(s1, b1), 1), m1);
+    }
+    __m256i total = _mm256_setzero_si256();
+    for(unsigned i = 0 ; i < pixels ; ++i){
+      for(int c = 0 ; c < 3 ; ++c){
+        const __m256i l = _mm256_blendv_epi8(l1[c], l0[c], in[i]);
+        total = _mm256_add_epi16(total, _mm256_abs_epi16(_mm256_sub_epi16(v[c][i], l)));
+      }
+    }
+    _mm256_storeu_si256((__m256i*)(diffs + g), total);
+  }
+}
+#elif defined(NCBLIT_NEON)
+static inline uint16x8_t
+hires_mulhi_neon(uint16x8_t a, uint16x8_t b){
+  return vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(a), vget_low_u16(b)), 16),
+                      vshrn_n_u32(vmull_high_u16(a, b), 16));
+}
+
+// as hires_diffs_sse2().
+static void
+hires_diffs_neon(const hireslanes* hl, unsigned parcount, unsigned pixels,
+                 const uint16_t px[3][8], const uint16_t sums[3], uint16_t* diffs){
+  uint16x8_t v[3][8];
+  for(unsigned i = 0 ; i < pixels ; ++i){
+    for(int c = 0 ; c < 3 ; ++c){
+      v[c][i] = vdupq_n_u16(px[c][i]);
+    }
+  }
+  for(unsigned g = 0 ; g < parcount ; g += 8){
+    const uint16x8_t part = vld1q_u16(hl->part + g);
+    const uint16x8_t b0 = vld1q_u16(hl->bias0 + g);
+    const uint16x8_t m0 = vld1q_u16(hl->mul0 + g);
+    const uint16x8_t b1 = vld1q_u16(hl->bias1 + g);
+    const uint16x8_t m1 = vld1q_u16(hl->mul1 + g);
+    uint16x8_t in[8];
+    uint16x8_t s0[3] = { vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0), };
+    for(unsigned i = 0 ; i < pixels ; ++i){
+      in[i] = vtstq_u16(part, vdupq_n_u16(1u << i));
+      for(int c = 0 ; c < 3 ; ++c){
+        s0[c] = vaddq_u16(s0[c], vandq_u16(in[i], v[c][i]));
+      }
+    }
+    uint16x8_t l0[3], l1[3];
+    for(int c = 0 ; c < 3 ; ++c){
+      const uint16x8_t s1 = vsubq_u16(vdupq_n_u16(sums[c]), s0[c]);
+      l0[c] = hires_mulhi_neon(vshlq_n_u16(vaddq_u16(s0[c], b0), 1), m0);
+      l1[c] = hires_mulhi_neon(vshlq_n_u16(vaddq_u16(s1, b1), 1), m1);
+    }
+    uint16x8_t total = vdupq_n_u16(0);
+    for(unsigned i = 0 ; i < pixels ; ++i){
+      for(int c = 0 ; c < 3 ; ++c){
+        total = vabaq_u16(total, v[c][i], vbslq_u16(in[i], l0[c], l1[c]));
+      }
+    }
+    vst1q_u16(diffs + g, total);
+  }
+}
+#endif
+
+// prepare |hl| for the |parcount| partitions of |pixels| colors. returns NULL
+// if we have no vector solver, in which case the scalar solver must be used.
+static const hireslanes*
+hireslanes_init(hireslanes* hl, const unsigned* partitions, unsigned parcount,
+                unsigned pixels){
+#ifdef NCBLIT_X86
+  if(__builtin_cpu_supports("avx2")){
+    hl->diffs = hires_diffs_avx2;
+  }else if(__builtin_cpu_supports("sse2")){
+    hl->diffs = hires_diffs_sse2;
+  }else{
+    return NULL;
+  }
+#elif defined(NCBLIT_NEON)
+  hl->diffs = hires_diffs_neon;
+#else
+  return NULL;
+#endif
+  assert(parcount <= sizeof(hl->part) / sizeof(*hl->part));
+  for(unsigned p = 0 ; p < parcount ; ++p){
+    const unsigned in = __builtin_popcount(partitions[p]);
+    const unsigned out = pixels - in;
+    hl->part[p] = partitions[p];
+    hl->bias0[p] = in ? in - 1 : 0;
+    hl->mul0[p] = in ? (32768 + in - 1) / in : 0;
+    hl->bias1[p] = out ? out - 1 : 0;
+    hl->mul1[p] = out ? (32768 + out - 1) / out : 0;
+  }
+  return hl;
+}
+
+// returns the index of the partition with the lowest total difference (the
+// first such, as found by the scalar solver).
+static unsigned
+hires_best_lanes(const hireslanes* hl, const uint32_t* rgbas, unsigned pixels,
+                 unsigned parcount){
+  uint16_t px[3][8];
+  uint16_t sums[3] = { 0, 0, 0, };
+  for(unsigned i = 0 ; i < pixels ; ++i){
+    px[0][i] = ncpixel_r(rgbas[i]);
+    px[1][i] = ncpixel_g(rgbas[i]);
+    px[2][i] = ncpixel_b(rgbas[i]);
+    for(int c = 0 ; c < 3 ; ++c){
+      sums[c] += px[c][i];
+    }
+  }
+  uint16_t diffs[sizeof(hl->part) / sizeof(*hl->part)];
+  hl->diffs(hl, parcount, pixels, (const uint16_t(*)[8])px, sums, diffs);
+  unsigned best = 0;
+  for(unsigned p = 1 ; p < parcount ; ++p){
+    if(diffs[p] < diffs[best]){
+      best = p;
+    }
+  }
+  return best;
+}
+
 // Solve for the cell rendered by this cellheightX2 sample. None of the input
 // pixels may be transparent (that ought already have been handled). We use
 // exhaustive search, which might be quite computationally intensive for the
 // worst case (all pixels are different colors). We want to solve for the
 // 2-partition of pixels that minimizes total source distance from the
-// resulting lerps.
+// resulting lerps. If |lanes| is non-NULL, the search is vectorized.
 static const char*
 hires_solver(const uint32_t rgbas[6], uint64_t* channels, unsigned blendcolors,
              unsigned nointerpolate, unsigned cellheight,
-             const char* const* transegcs, const unsigned* partitions){
+             const char* const* transegcs, const unsigned* partitions,
+             const hireslanes* lanes){
   const unsigned parcount = 1u << (cellheight * 2 - 1);
+  int best = -1;
+  if(lanes){
+    uint32_t l0, l1;
+    best = hires_best_lanes(lanes, rgbas, cellheight * 2, parcount);
+    hires_lerps(rgbas, cellheight * 2, partitions[best], nointerpolate, &l0, &l1);
+    ncchannels_set_fchannel(channels, l0);
+    ncchannels_set_bchannel(channels, l1);
+  }
   // we loop over the bitstrings, dividing the pixels into two sets, and then
   // taking a general lerp over each set. we then compute the sum of absolute
   // differences, and see if it's the new minimum.
-  int best = -1;
   uint32_t mindiff = UINT_MAX;
 //fprintf(stderr, "%06x %06x\n%06x %06x\n%06x %06x\n", rgbas[0], rgbas[1], rgbas[2], rgbas[3], rgbas[4], rgbas[5]);
-  for(size_t glyph = 0 ; glyph < parcount ; ++glyph){
-    unsigned rsum0 = 0, rsum1 = 0;
-    unsigned gsum0 = 0, gsum1 = 0;
-    unsigned bsum0 = 0, bsum1 = 0;
-    int insum = 0;
-    int outsum = 0;
-    for(unsigned mask = 0 ; mask < cellheight * 2 ; ++mask){
-      if(partitions[glyph] & (1u << mask)){
-        if(!nointerpolate || !insum){
-          rsum0 += ncpixel_r(rgbas[mask]);
-          gsum0 += ncpixel_g(rgbas[mask]);
-          bsum0 += ncpixel_b(rgbas[mask]);
-          ++insum;
-        }
-      }else{
-        if(!nointerpolate || !outsum){
-          rsum1 += ncpixel_r(rgbas[mask]);
-          gsum1 += ncpixel_g(rgbas[mask]);
-          bsum1 += ncpixel_b(rgbas[mask]);
-          ++outsum;
-        }
-      }
-    }
-    uint32_t l0 = generalerp(rsum0, gsum0, bsum0, insum);
-    uint32_t l1 = generalerp(rsum1, gsum1, bsum1, outsum);
-//fprintf(stderr, "sum0: %06x sum1: %06x insum: %d\n", l0 & 0xffffffu, l1 & 0xffffffu, insum);
+  for(size_t glyph = 0 ; lanes == NULL && glyph < parcount ; ++glyph){
+    uint32_t l0, l1;
+    hires_lerps(rgbas, cellheight * 2, partitions[glyph], nointerpolate, &l0, &l1);
+//fprintf(stderr, "sum0: %06x sum1: %06x\n", l0 & 0xffffffu, l1 & 0xffffffu);
     uint32_t totaldiff = 0;
     for(unsigned mask = 0 ; mask < cellheight * 2 ; ++mask){
       unsigned r, g, b;
@@ -562,7 +797,7 @@ hires_solver(const uint32_t rgbas[6], uint64_t* channels, unsigned blendcolors,
       uint32_t rdiff = rgb_diff(ncpixel_r(rgbas[mask]), ncpixel_g(rgbas[mask]),
                                 ncpixel_b(rgbas[mask]), r, g, b);
       totaldiff += rdiff;
-//fprintf(stderr, "mask: %u totaldiff: %u insum: %d (%08x / %08x)\n", mask, totaldiff, insum, l0, l1);
+//fprintf(stderr, "mask: %u totaldiff: %u (%08x / %08x)\n", mask, totaldiff, l0, l1);
     }
 //fprintf(stderr, "bits: %u %zu totaldiff: %f best: %f (%d)\n", partitions[glyph], glyph, totaldiff, mindiff, best);
     if(totaldiff < mindiff){
@@ -929,10 +1164,11 @@ hires_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
   const unsigned char* dat = data;
   int visy = bargs->begy;
   assert(cellheight <= 4); // due to rgbas[] array below
+  // the vector solver doesn't handle nointerpolate, which is rarely used
+  hireslanes hl;
+  const hireslanes* lanes = nointerpolate ? NULL :
+    hireslanes_init(&hl, partitions, 1u << (cellheight * 2 - 1), cellheight * 2);
   for(y = bargs->u.cell.placey ; visy < (bargs->begy + leny) && y < dimy ; ++y, visy += cellheight){
-    if(ncplane_cursor_move_yx(nc, y, bargs->u.cell.placex < 0 ? 0 : bargs->u.cell.placex)){
-      return -1;
-    }
     int visx = bargs->begx;
     for(x = bargs->u.cell.placex ; visx < (bargs->begx + lenx) && x < dimx ; ++x, visx += 2){
       uint32_t rgbas[8]; // row-major
@@ -960,7 +1196,7 @@ hires_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
                                           nointerpolate, cellheight, transegcs);
       if(egc == NULL){ // no transparency; run a full solver
         egc = hires_solver(rgbas, &c->channels, blendcolors, nointerpolate,
-                           cellheight, transegcs, partitions);
+                           cellheight, transegcs, partitions, lanes);
         cell_set_blitquadrants(c, 1, 1, 1, 1);
       }
 //fprintf(stderr, "hires EGC: %s channels: %016lx\n", egc, c->channels);
@@ -1114,9 +1350,6 @@ braille_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
   const unsigned char* dat = data;
   int visy = bargs->begy;
   for(y = bargs->u.cell.placey ; visy < (bargs->begy + leny) && y < dimy ; ++y, visy += 4){
-    if(ncplane_cursor_move_yx(nc, y, bargs->u.cell.placex < 0 ? 0 : bargs->u.cell.placex)){
-      return -1;
-    }
     int visx = bargs->begx;
     for(x = bargs->u.cell.placex ; visx < (bargs->begx + lenx) && x < dimx ; ++x, visx += 2){
       const uint32_t* rgbbase_l0 = (const uint32_t*)(dat + (linesize * visy) + (visx * 4));
@@ -1220,6 +1453,145 @@ braille_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
   return total;
 }
 
+// the quadrant, sextant, octant, and braille blitters solve each cell from
+// its own pixels alone, and their glyphs are always stored inline, so large
+// visuals are split into bands of cell rows, each blitted by a thread of the
+// worker pool. these blitters thus leave the cursor to banded_blit().
+#define BLIT_BANDCELLS 1024 // fewest cells worth a thread
+
+typedef int (*bandblitter)(ncplane* nc, int linesize, const void* data,
+                           int leny, int lenx, const blitterargs* bargs);
+
+typedef struct blitband {
+  ncplane* nc;
+  int linesize;
+  const void* data;
+  int leny;
+  int lenx;
+  blitterargs bargs;
+  bandblitter blit;
+  int ret;          // cells written, or -1 on error
+} blitband;
+
+static pthread_once_t blit_population_once = PTHREAD_ONCE_INIT;
+static unsigned blit_population; // threads beyond the calling one
+
+// NOTCURSES_BLIT_THREADS counts threads beyond the calling one
+static void
+blit_population_init(void){
+  blit_population = ncthread_helpers("NOTCURSES_BLIT_THREADS",
+                                     NCWORKERS_MAXTHREADS - 1);
+}
+
+static void
+blitband_worker(void* vbands, unsigned idx){
+  blitband* b = (blitband*)vbands + idx;
+  b->ret = b->blit(b->nc, b->linesize, b->data, b->leny, b->lenx, &b->bargs);
+}
+
+// blit |leny|x|lenx| pixels of |cellheight|x2 at a time using |blit|,
+// splitting the cell rows among threads when there are enough cells.
+static int
+banded_blit(ncplane* nc, int linesize, const void* data, int leny, int lenx,
+            const blitterargs* bargs, int cellheight, bandblitter blit){
+  unsigned dimy, dimx;
+  ncplane_dim_yx(nc, &dimy, &dimx);
+  const int placey = bargs->u.cell.placey;
+  const int placex = bargs->u.cell.placex;
+  if(placey < 0 || (unsigned)placey >= dimy || leny <= 0){
+    return 0;
+  }
+  unsigned rows = (leny + cellheight - 1) / cellheight;
+  if(rows > dimy - placey){
+    rows = dimy - placey;
+  }
+  // leave the cursor at the start of the last row, as row-by-row blitting
+  // always did. this also checks the column.
+  if(ncplane_cursor_move_yx(nc, placey + rows - 1, placex < 0 ? 0 : placex)){
+    return -1;
+  }
+  if(placex < 0 || lenx <= 0){
+    return blit(nc, linesize, data, leny, lenx, bargs);
+  }
+  unsigned cols = (lenx + 1) / 2;
+  if(cols > dimx - placex){
+    cols = dimx - placex;
+  }
+  pthread_once(&blit_population_once, blit_population_init);
+  unsigned threads = blit_population + 1;
+  if(threads > rows * cols / BLIT_BANDCELLS){
+    threads = rows * cols / BLIT_BANDCELLS;
+  }
+  if(threads > rows){
+    threads = rows;
+  }
+  if(threads <= 1){
+    return blit(nc, linesize, data, leny, lenx, bargs);
+  }
+  // blitted glyphs are inline, but they might replace spilled EGCs, which
+  // must be released from the pool here, on the calling thread.
+  for(unsigned y = placey ; y < placey + rows ; ++y){
+    for(unsigned x = placex ; x < placex + cols ; ++x){
+      nccell* c = ncplane_cell_ref_yx(nc, y, x);
+      if(cell_extended_p(c)){
+        nccell_release(nc, c);
+      }
+    }
+  }
+  blitband bands[NCWORKERS_MAXTHREADS];
+  for(unsigned t = 0 ; t < threads ; ++t){
+    blitband* b = &bands[t];
+    const int first = rows * t / threads;
+    const int last = rows * (t + 1) / threads;
+    b->nc = nc;
+    b->linesize = linesize;
+    b->data = data;
+    b->leny = leny - first * cellheight;
+    if(b->leny > (last - first) * cellheight){
+      b->leny = (last - first) * cellheight;
+    }
+    b->lenx = lenx;
+    b->bargs = *bargs;
+    b->bargs.begy += first * cellheight;
+    b->bargs.u.cell.placey += first;
+    b->blit = blit;
+  }
+  ncworkers_run(threads, threads, blitband_worker, bands);
+  int total = 0;
+  for(unsigned t = 0 ; t < threads ; ++t){
+    if(bands[t].ret < 0){
+      total = -1;
+    }else if(total >= 0){
+      total += bands[t].ret;
+    }
+  }
+  return total;
+}
+
+static int
+quadrant_bands(ncplane* nc, int linesize, const void* data, int leny, int lenx,
+               const blitterargs* bargs){
+  return banded_blit(nc, linesize, data, leny, lenx, bargs, 2, quadrant_blit);
+}
+
+static int
+sextant_bands(ncplane* nc, int linesize, const void* data, int leny, int lenx,
+              const blitterargs* bargs){
+  return banded_blit(nc, linesize, data, leny, lenx, bargs, 3, sextant_blit);
+}
+
+static int
+octant_bands(ncplane* nc, int linesize, const void* data, int leny, int lenx,
+             const blitterargs* bargs){
+  return banded_blit(nc, linesize, data, leny, lenx, bargs, 4, octant_blit);
+}
+
+static int
+braille_bands(ncplane* nc, int linesize, const void* data, int leny, int lenx,
+              const blitterargs* bargs){
+  return banded_blit(nc, linesize, data, leny, lenx, bargs, 4, braille_blit);
+}
+
 // NCBLIT_DEFAULT is not included, as it has no defined properties. It ought
 // be replaced with some real blitter implementation by the calling widget.
 // The order of contents is critical for 'egcs': ncplane_as_rgba() uses these
@@ -1236,10 +1608,10 @@ static struct blitset notcurses_blitters[] = {
      .blit = tria_blit,      .name = "half",          .fill = false, },
    { .geom = NCBLIT_2x2,     .width = 2, .height = 2,
      .egcs = NCQUADBLOCKS,   .plotegcs = L" ▗▐▖▄▟▌▙█",
-     .blit = quadrant_blit,  .name = "quad",          .fill = false, },
+     .blit = quadrant_bands, .name = "quad",          .fill = false, },
    { .geom = NCBLIT_3x2,     .width = 2, .height = 3,
      .egcs = NCSEXBLOCKS,    .plotegcs = L" 🬞🬦▐🬏🬭🬵🬷🬓🬱🬹🬻▌🬲🬺█",
-     .blit = sextant_blit,   .name = "sex",           .fill = false, },
+     .blit = sextant_bands,  .name = "sex",           .fill = false, },
    { .geom = NCBLIT_4x2,     .width = 2, .height = 4,
      .egcs = NCOCTBLOCKS,
      .plotegcs = (L"\0x20"
@@ -1267,11 +1639,11 @@ static struct blitset notcurses_blitters[] = {
                   L"\U00002599"
                   L"\U0001CDE4"
                   L"\U0001CDE0"),
-     .blit = octant_blit,    .name = "oct",           .fill = false, },
+     .blit = octant_bands,   .name = "oct",           .fill = false, },
    { .geom = NCBLIT_BRAILLE, .width = 2, .height = 4,
      .egcs = NCBRAILLEEGCS,
      .plotegcs = L"⠀⢀⢠⢰⢸⡀⣀⣠⣰⣸⡄⣄⣤⣴⣼⡆⣆⣦⣶⣾⡇⣇⣧⣷⣿",
-     .blit = braille_blit,   .name = "braille",       .fill = true,  },
+     .blit = braille_bands,  .name = "braille",       .fill = true,  },
    { .geom = NCBLIT_PIXEL,   .width = 1, .height = 1,
      .egcs = L"", .plotegcs = NULL,
      .blit = NULL,           .name = "pixel",         .fill = true,  },
@@ -1,5 +1,120 @@
 #include <lib/egcpool.h>
 
+#define INTERN_MINIMUM_SLOTS 64
+
+// FNV-1a over the |len| bytes of the EGC. never returns 0, but that's not
+// load-bearing; empty slots are indicated by refs == 0.
+static inline uint32_t
+egc_hash(const char* egc, size_t len){
+  uint32_t h = 2166136261lu;
+  for(size_t i = 0 ; i < len ; ++i){
+    h ^= (unsigned char)egc[i];
+    h *= 16777619lu;
+  }
+  return h;
+}
+
+// does the slot refer to the |len|-byte EGC 'egc'?
+__attribute__ ((nonnull (1, 2, 3))) static inline bool
+intern_match(const egcpool* pool, const egcintern* slot, const char* egc,
+             size_t len, uint32_t hash){
+  if(slot->hash != hash){
+    return false;
+  }
+  const char* stored = pool->pool + slot->offset;
+  return strncmp(stored, egc, len) == 0 && stored[len] == '\0';
+}
+
+// find the slot holding 'egc', or the empty slot where it would be placed.
+// requires a non-empty index.
+__attribute__ ((nonnull (1, 2))) static egcintern*
+intern_find(const egcpool* pool, const char* egc, size_t len, uint32_t hash){
+  const unsigned mask = pool->slotcount - 1;
+  unsigned idx = hash & mask;
+  while(pool->slots[idx].refs){
+    if(intern_match(pool, &pool->slots[idx], egc, len, hash)){
+      break;
+    }
+    idx = (idx + 1) & mask;
+  }
+  return &pool->slots[idx];
+}
+
+// double the index (or create it), rehashing all present slots. we keep load
+// at or below 50%, so that probe sequences stay short.
+__attribute__ ((nonnull (1))) static int
+intern_grow(egcpool* pool){
+  unsigned newcount = pool->slotcount ? pool->slotcount * 2 : INTERN_MINIMUM_SLOTS;
+  egcintern* newslots = (egcintern*)calloc(newcount, sizeof(*newslots));
+  if(newslots == NULL){
+    return -1;
+  }
+  for(unsigned i = 0 ; i < pool->slotcount ; ++i){
+    const egcintern* s = &pool->slots[i];
+    if(s->refs){
+      unsigned idx = s->hash & (newcount - 1);
+      while(newslots[idx].refs){
+        idx = (idx + 1) & (newcount - 1);
+      }
+      newslots[idx] = *s;
+    }
+  }
+  free(pool->slots);
+  pool->slots = newslots;
+  pool->slotcount = newcount;
+  return 0;
+}
+
+// index a freshly-stashed EGC. on allocation failure, the EGC simply goes
+// unindexed; it will be released in the traditional fashion.
+__attribute__ ((nonnull (1, 2))) static void
+intern_insert(egcpool* pool, const char* egc, size_t len, uint32_t hash, int offset){
+  if((pool->slotsused + 1) * 2 > pool->slotcount){
+    if(intern_grow(pool)){
+      return;
+    }
+  }
+  egcintern* slot = intern_find(pool, egc, len, hash);
+  slot->hash = hash;
+  slot->offset = offset;
+  slot->refs = 1;
+  ++pool->slotsused;
+}
+
+// remove the slot at |idx| using backward-shift deletion, so that no
+// tombstones are required for linear probing.
+__attribute__ ((nonnull (1))) static void
+intern_remove(egcpool* pool, unsigned idx){
+  const unsigned mask = pool->slotcount - 1;
+  unsigned next = (idx + 1) & mask;
+  while(pool->slots[next].refs){
+    unsigned home = pool->slots[next].hash & mask;
+    // can the entry at next be moved back to idx without passing its home?
+    if(((next - home) & mask) >= ((next - idx) & mask)){
+      pool->slots[idx] = pool->slots[next];
+      idx = next;
+    }
+    next = (next + 1) & mask;
+  }
+  pool->slots[idx].refs = 0;
+  --pool->slotsused;
+}
+
+bool egcpool_unintern(egcpool* pool, int offset){
+  const char* egc = pool->pool + offset;
+  size_t len = strlen(egc);
+  uint32_t hash = egc_hash(egc, len);
+  egcintern* slot = intern_find(pool, egc, len, hash);
+  if(slot->refs == 0 || slot->offset != (uint32_t)offset){
+    return false; // an unindexed (duplicate or pre-interning) EGC
+  }
+  if(--slot->refs){
+    return true;
+  }
+  intern_remove(pool, slot - pool->slots);
+  return false;
+}
+
 // if we're inserting a EGC of |len| bytes, ought we proactively realloc?
 __attribute__ ((nonnull (1))) static inline bool
 egcpool_alloc_justified(const egcpool* pool, int len){
@@ -24,8 +139,82 @@ stash(egcpool* pool, const char* egc, int curpos, int len){
   return curpos;
 }
 
+__attribute__ ((nonnull (1, 2))) static int
+egcpool_stash_ring(egcpool* pool, const char* egc, size_t ulen);
+
 __attribute__ ((nonnull (1, 2))) int
 egcpool_stash(egcpool* pool, const char* egc, size_t ulen){
+  if(!pool->interning){
+    return egcpool_stash_ring(pool, egc, ulen);
+  }
+  uint32_t hash = egc_hash(egc, ulen);
+  if(pool->slotsused){
+    egcintern* slot = intern_find(pool, egc, ulen, hash);
+    if(slot->refs){
+      if(slot->refs == UINT32_MAX){ // saturated; spill into a new copy
+        return egcpool_stash_ring(pool, egc, ulen);
+      }
+      ++slot->refs;
+      return slot->offset;
+    }
+  }
+  int offset = egcpool_stash_ring(pool, egc, ulen);
+  if(offset >= 0){
+    intern_insert(pool, pool->pool + offset, ulen, hash, offset);
+  }
+  return offset;
+}
+
+int egcpool_compact(egcpool* pool, nccell* cells, size_t count, nccell* extra){
+  egcpool np;
+  egcpool_init(&np);
+  np.interning = pool->interning;
+  if(pool->poolused){
+    // leave the pool at most half full, so we don't immediately grow again
+    int target = POOL_MINIMUM_ALLOC;
+    while(target < pool->poolused * 2 && target < POOL_MAXIMUM_BYTES){
+      target *= 2;
+    }
+    if((np.pool = (char*)calloc(target, 1)) == NULL){
+      return -1;
+    }
+    np.poolsize = target;
+  }
+  // stash everything before touching any cell, so that we can back out
+  int* offsets = (int*)malloc(sizeof(*offsets) * (count + 1));
+  if(offsets == NULL){
+    egcpool_dump(&np);
+    return -1;
+  }
+  for(size_t i = 0 ; i <= count ; ++i){
+    const nccell* c = i < count ? &cells[i] : extra;
+    if(c && cell_extended_p(c)){
+      const char* egc = egcpool_extended_gcluster(pool, c);
+      if((offsets[i] = egcpool_stash(&np, egc, strlen(egc))) < 0){
+        free(offsets);
+        egcpool_dump(&np);
+        return -1;
+      }
+    }
+  }
+  for(size_t i = 0 ; i <= count ; ++i){
+    nccell* c = i < count ? &cells[i] : extra;
+    if(c && cell_extended_p(c)){
+      set_gcluster_egc(c, offsets[i]);
+    }
+  }
+  free(offsets);
+  loginfo("compacted egcpool %d/%d -> %d/%d", pool->poolused, pool->poolsize,
+          np.poolused, np.poolsize);
+  free(pool->pool);
+  free(pool->slots);
+  *pool = np;
+  return 0;
+}
+
+// find space within the ring for a new copy of the EGC, and store it there.
+__attribute__ ((nonnull (1, 2))) static int
+egcpool_stash_ring(egcpool* pool, const char* egc, size_t ulen){
   int len = ulen + 1; // count the NUL terminator
   if(len <= 2){ // should never be empty, nor a single byte + NUL
     return -1;
@@ -10,7 +10,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <unigbrk.h>
 #include <unictype.h>
 #include "notcurses/notcurses.h"
 #include "compat/compat.h"
@@ -24,16 +23,36 @@ extern "C" {
 // anything more than that, it's spilled into the egcpool, and the nccell
 // records the offset. when an nccell is released, the egcpool memory it
 // owned is zeroed out, and made usable by another nccell.
+//
+// a pool can optionally intern its EGCs. an interned pool keeps a hash index
+// over its contents, so that stashing an EGC already present is an O(1)
+// lookup returning the existing offset, and identical EGCs share storage.
+// each stash takes a reference; release only zeroes the storage once the
+// last reference has been dropped. offsets remain stable across growth, so
+// nccells are none the wiser.
+
+// a slot in the interning index. refs == 0 indicates an empty slot.
+typedef struct egcintern {
+  uint32_t hash;      // hash of the EGC's bytes
+  uint32_t offset;    // offset of the EGC within the pool
+  uint32_t refs;      // number of outstanding stashes
+} egcintern;
 
 typedef struct egcpool {
   char* pool;         // ringbuffer of attached extension storage
   int poolsize;       // total number of bytes in pool
   int poolused;       // bytes actively used, grow when this gets too large
   int poolwrite;      // next place to *look for* a place to write
+  egcintern* slots;   // open-addressed interning index (power of 2 slots)
+  unsigned slotcount; // total slots in the interning index
+  unsigned slotsused; // occupied slots in the interning index
+  bool interning;     // share storage among identical EGCs
 } egcpool;
 
 #define POOL_MINIMUM_ALLOC BUFSIZ
 #define POOL_MAXIMUM_BYTES (1 << 24) // max 16MiB (assumes 32 bits)
+// a pool is worth compacting once less than 1/POOL_COMPACT_RATIO of it is used
+#define POOL_COMPACT_RATIO 4
 
 static inline void
 egcpool_init(egcpool* p){
@@ -41,6 +60,17 @@ egcpool_init(egcpool* p){
   p->poolsize = 0;
   p->poolwrite = 0;
   p->poolused = 0;
+  p->slots = NULL;
+  p->slotcount = 0;
+  p->slotsused = 0;
+  p->interning = false;
+}
+
+// enable interning on this pool. EGCs already present are not indexed, but
+// remain valid (and are released in the usual manner).
+static inline void
+egcpool_set_interning(egcpool* p){
+  p->interning = true;
 }
 
 static inline int
@@ -93,66 +123,14 @@ utf8_codepoint_length(unsigned char c){
   }
 }
 
-// Eat an EGC from the UTF-8 string input, counting bytes and columns. We use
-// libunistring's uc_is_grapheme_break() to segment EGCs. Writes the number of
-// columns to '*colcount'. Returns the number of bytes consumed, not including
-// any NUL terminator. Neither the number of bytes nor columns is necessarily
-// equal to the number of decoded code points. Such are the ways of Unicode.
-// uc_is_grapheme_break() wants UTF-32, which is fine, because we need wchar_t
-// to use wcwidth() anyway FIXME except this doesn't work with 16-bit wchar_t!
-static inline int
-utf8_egc_len(const char* gcluster, int* colcount){
-  size_t ret = 0;
-  *colcount = 0;
-  int r;
-  mbstate_t mbt;
-  memset(&mbt, 0, sizeof(mbt));
-  wchar_t wc, prevw = 0;
-  bool injoin = false;
-  do{
-    r = mbrtowc(&wc, gcluster, MB_LEN_MAX, &mbt);
-    if(r < 0){
-      // FIXME probably ought escape this somehow
-      logerror("invalid UTF8: %s", gcluster);
-      return -1;
-    }
-    if(prevw && !injoin && uc_is_grapheme_break(prevw, wc)){
-      break; // starts a new EGC, exit and do not claim
-    }
-    int cols;
-    if(uc_is_property_variation_selector(wc)){ // ends EGC
-      ret += r;
-      break;
-    }else if(wc == L'\u200d' || injoin){ // ZWJ is iswcntrl, so check it first
-      injoin = true;
-      cols = 0;
-    }else{
-      cols = wcwidth(wc);
-      if(cols < 0){
-        injoin = false;
-        if(iswspace(wc)){ // newline or tab
-          *colcount = 1;
-          return ret + 1;
-        }
-        cols = 1;
-        if(iswcntrl(wc)){
-          logerror("prohibited or invalid unicode: 0x%08x", (unsigned)wc);
-          return -1;
-        }
-      }
-    }
-    if(*colcount == 0){
-      *colcount += cols;
-    }
-    ret += r;
-    gcluster += r;
-    if(!prevw){
-      prevw = wc;
-    }
-  }while(r);
-  // FIXME what if injoin is set? incomplete EGC!
-  return ret;
-}
+// Eat an EGC from the UTF-8 string input, counting bytes and columns. EGCs
+// are segmented according to UAX #29, using the tables in unitables.h (no
+// locale is consulted). Writes the number of columns to '*colcount'. Returns
+// the number of bytes consumed, not including any NUL terminator. Neither the
+// number of bytes nor columns is necessarily equal to the number of decoded
+// code points. Such are the ways of Unicode. Implemented in unicode.c.
+__attribute__ ((nonnull (1, 2)))
+int utf8_egc_len(const char* gcluster, int* colcount);
 
 // stash away the provided UTF8, NUL-terminated grapheme cluster. the cluster
 // should not be less than 2 bytes (such a cluster should be directly stored in
@@ -161,11 +139,20 @@ utf8_egc_len(const char* gcluster, int* colcount){
 __attribute__ ((nonnull (1, 2)))
 int egcpool_stash(egcpool* pool, const char* egc, size_t ulen);
 
+// drop a reference to the interned egc at offset. returns true if references
+// remain, in which case the storage must not be zeroed. returns false if that
+// was the last reference, or if the egc at offset was never interned.
+__attribute__ ((nonnull (1)))
+bool egcpool_unintern(egcpool* pool, int offset);
+
 // remove the egc from the pool. start at offset, and zero out everything until
 // we find a zero (our own NUL terminator). remove that number of bytes from
 // the usedcount.
 static inline void
 egcpool_release(egcpool* pool, int offset){
+  if(pool->slotsused && egcpool_unintern(pool, offset)){
+    return; // still referenced by other cells
+  }
   size_t freed = 1; // account for free(d) NUL terminator
   while(pool->pool[offset]){
     pool->pool[offset] = '\0';
@@ -177,10 +164,14 @@ egcpool_release(egcpool* pool, int offset){
   // FIXME ought we update pool->poolwrite?
 }
 
+// free all storage. the pool remains interning if it was before.
 static inline void
 egcpool_dump(egcpool* pool){
+  bool interning = pool->interning;
   free(pool->pool);
+  free(pool->slots);
   egcpool_init(pool);
+  pool->interning = interning;
 }
 
 // get the offset into the egcpool for this cell's EGC. returns meaningless and
@@ -196,6 +187,12 @@ cell_extended_p(const nccell* c){
   return (htole(c->gcluster) & 0xff000000ul) == 0x01000000ul;
 }
 
+// set the nccell 'c' to point into the egcpool at location 'eoffset'
+static inline void
+set_gcluster_egc(nccell* c, int eoffset){
+  c->gcluster = htole(0x01000000ul) + htole(eoffset);
+}
+
 // Is the cell simple (a UTF8-encoded EGC of four bytes or fewer)?
 static inline bool
 cell_simple_p(const nccell* c){
@@ -222,12 +219,40 @@ egcpool_dup(egcpool* dst, const egcpool* src){
     dst->pool = tmp;
     memcpy(dst->pool, src->pool, src->poolsize);
   }
+  egcintern* slots = NULL;
+  if(src->slots){
+    size_t slotbytes = sizeof(*src->slots) * src->slotcount;
+    if((slots = (egcintern*)malloc(slotbytes)) == NULL){
+      return -1;
+    }
+    memcpy(slots, src->slots, slotbytes);
+  }
+  free(dst->slots);
+  dst->slots = slots;
+  dst->slotcount = src->slotcount;
+  dst->slotsused = src->slotsused;
+  dst->interning = src->interning;
   dst->poolsize = src->poolsize;
   dst->poolused = src->poolused;
   dst->poolwrite = src->poolwrite;
   return 0;
 }
 
+// is the pool large and sparse enough that compaction would be worthwhile?
+static inline bool
+egcpool_compact_wanted(const egcpool* pool){
+  return pool->poolsize > POOL_MINIMUM_ALLOC &&
+         pool->poolused * POOL_COMPACT_RATIO < pool->poolsize;
+}
+
+// relocate the live EGCs referenced by the 'count' nccells at 'cells' (plus
+// 'extra', if not NULL) to the front of a fresh, right-sized pool, rewriting
+// the cells' offsets, and replace 'pool' with it. any other cells referencing
+// 'pool' are invalidated. on failure, -1 is returned, and neither the pool
+// nor the cells are modified.
+__attribute__ ((nonnull (1)))
+int egcpool_compact(egcpool* pool, nccell* cells, size_t count, nccell* extra);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,12 +7,16 @@ extern "C" {
 
 #include <errno.h>
 #include <assert.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <inttypes.h>
 #include "compat/compat.h"
 #include "logging.h"
+#ifndef __MINGW32__
+#include <sys/uio.h>
+#endif
 
 // a growable buffer into which one can perform formatted i/o, like the
 // ten thousand that came before it, and the ten trillion which shall
@@ -21,13 +25,38 @@ extern "C" {
 // *not* maintain a NUL terminator, and can hold binary data.
 // on Windows, we're using VirtualAlloc(). on BSD, we're using realloc().
 // on Linux, we're using mmap()+mremap().
+//
+// an fbuf can additionally be put into splicing mode, in which large
+// external buffers (i.e. sprixel glyphs) handed to fbuf_splice() are not
+// copied, but referenced, and emitted in place with writev(2) when the fbuf
+// is written out. the referenced memory must remain valid and unchanged until
+// then. a splicing fbuf's buf does not hold the complete output, so it must
+// not be handed to anything but fbuf_flush()/fbuf_finalize()/fbuf_write().
+
+// a reference to |len| bytes at |buf|, to be emitted after the first |off|
+// bytes of the fbuf's own buffer.
+typedef struct fbufsplice {
+  uint64_t off;
+  const char* buf;
+  size_t len;
+} fbufsplice;
 
 typedef struct fbuf {
   uint64_t size;
   uint64_t used;
   char* buf;
+  fbufsplice* splices;  // external references, in order of offset
+  unsigned splicecount;
+  unsigned splicealloc;
+  uint64_t splicebytes; // total bytes referenced by splices
+  uint64_t highwater;   // decaying high-water mark of usage, see fbuf_trim()
+  bool splicing;        // reference large external buffers rather than copy
 } fbuf;
 
+// external buffers smaller than this are copied even when splicing; the
+// memcpy() is cheaper than an additional iovec.
+#define FBUF_SPLICE_MIN 4096
+
 // header-only so that we can test it from notcurses-tester
 
 #ifdef MAP_POPULATE
@@ -81,6 +110,12 @@ fbuf_grow(fbuf* f, size_t n){
   return -1;
 }
 
+// initial sizes of small and large fbufs. we start large ones with 2MiB, the
+// huge page size on all of x86+PAE, ARMv7+LPAE, ARMv8, and x86-64.
+// FIXME use GetLargePageMinimum() and sysconf
+#define FBUF_SMALL_SIZE (4096 > BUFSIZ ? 4096 : BUFSIZ)
+#define FBUF_LARGE_SIZE 0x200000lu
+
 // prepare (a significant amount of) initial space for the fbuf.
 // pass 1 for |small| if it ought be...small.
 static inline int
@@ -88,10 +123,7 @@ fbuf_initgrow(fbuf* f, unsigned small){
   assert(NULL == f->buf);
   assert(0 == f->used);
   assert(0 == f->size);
-  // we start with 2MiB, the huge page size on all of x86+PAE,
-  // ARMv7+LPAE, ARMv8, and x86-64.
-  // FIXME use GetLargePageMinimum() and sysconf
-  size_t size = small ? (4096 > BUFSIZ ? 4096 : BUFSIZ) : 0x200000lu;
+  size_t size = small ? FBUF_SMALL_SIZE : FBUF_LARGE_SIZE;
 #if defined(__linux__)
   /*static bool hugepages_failed = false; // FIXME atomic
   if(!hugepages_failed && !small){
@@ -123,28 +155,107 @@ fbuf_initgrow(fbuf* f, unsigned small){
 }
 #undef MAPFLAGS
 
-// prepare f with a small initial buffer.
-static inline int
-fbuf_init_small(fbuf* f){
+static inline void
+fbuf_zero(fbuf* f){
   f->used = 0;
   f->size = 0;
   f->buf = NULL;
+  f->splices = NULL;
+  f->splicecount = 0;
+  f->splicealloc = 0;
+  f->splicebytes = 0;
+  f->highwater = 0;
+  f->splicing = false;
+}
+
+// prepare f with a small initial buffer.
+static inline int
+fbuf_init_small(fbuf* f){
+  fbuf_zero(f);
   return fbuf_initgrow(f, 1);
 }
 
 // prepare f with a large initial buffer.
 static inline int
 fbuf_init(fbuf* f){
-  f->used = 0;
-  f->size = 0;
-  f->buf = NULL;
+  fbuf_zero(f);
   return fbuf_initgrow(f, 0);
 }
 
+// enable or disable splicing (see above). splicing ought not be disabled
+// while splices are outstanding.
+static inline void
+fbuf_set_splicing(fbuf* f, bool splicing){
+  assert(!f->splicecount);
+#ifdef __MINGW32__
+  splicing = false; // no writev()
+#endif
+  f->splicing = splicing;
+}
+
+// the high-water mark decays by 1/FBUF_TRIM_DECAY of itself with each call to
+// fbuf_trim(), and the buffer is shrunk once the mark falls below
+// 1/FBUF_TRIM_SLACK of its size. together, these require a drop in usage to be
+// sustained over a dozen or more trims before we give up any memory.
+#define FBUF_TRIM_DECAY 16
+#define FBUF_TRIM_SLACK 4
+
+// give back memory we've grown into, but don't appear to need anymore. call
+// this when |f| holds a complete unit of output (a frame, a glyph), before
+// it is reset. |f|'s high-water mark is decayed, and raised to the current
+// usage if necessary. if the mark is well below the size of the buffer, the
+// buffer is shrunk to the smallest doubling of |floor| holding twice the
+// mark, but never below |floor| (which ought be a multiple of the page size).
+// contents are preserved. returns 1 if the buffer shrank, 0 if it did not,
+// and -1 on error (in which case the buffer remains valid and unchanged).
+static inline int
+fbuf_trim(fbuf* f, size_t floor){
+  assert(floor);
+  uint64_t hw = f->highwater - f->highwater / FBUF_TRIM_DECAY;
+  if(hw < f->used){
+    hw = f->used;
+  }
+  f->highwater = hw;
+  if(f->buf == NULL || f->size <= floor || hw * FBUF_TRIM_SLACK >= f->size){
+    return 0;
+  }
+  size_t size = floor;
+  while(size < hw * 2){
+    size *= 2;
+  }
+  if(size >= f->size){
+    return 0;
+  }
+  void* tmp;
+#ifdef __linux__
+  // shrinking never needs to move the mapping
+  tmp = mremap(f->buf, f->size, size, 0);
+  if(tmp == MAP_FAILED){
+    return -1;
+  }
+#else
+  tmp = realloc(f->buf, size);
+  if(tmp == NULL){
+    return -1;
+  }
+#endif
+  f->buf = (char*)tmp; // cast for c++ callers
+  f->size = size;
+  return 1;
+}
+
 // reset usage, but don't shrink the buffer or anything
 static inline void
 fbuf_reset(fbuf* f){
   f->used = 0;
+  f->splicecount = 0;
+  f->splicebytes = 0;
+}
+
+// total bytes of output represented by |f|, including splices
+static inline uint64_t
+fbuf_total(const fbuf* f){
+  return f->used + f->splicebytes;
 }
 
 static inline int
@@ -159,6 +270,10 @@ static inline void
 fbuf_chop(fbuf* f, size_t len){
   assert(len <= f->size);
   f->used = len;
+  // drop any splices which followed the chop point
+  while(f->splicecount && f->splices[f->splicecount - 1].off > len){
+    f->splicebytes -= f->splices[--f->splicecount].len;
+  }
 }
 
 static inline int
@@ -180,6 +295,31 @@ fbuf_putn(fbuf* f, const char* s, size_t len){
   return len;
 }
 
+// add |len| bytes from |s| to the output. if |f| is splicing, and |len| is
+// sufficiently large, |s| is referenced rather than copied, and must remain
+// valid until |f| has been written out.
+static inline int
+fbuf_splice(fbuf* f, const char* s, size_t len){
+  if(!f->splicing || len < FBUF_SPLICE_MIN){
+    return fbuf_putn(f, s, len);
+  }
+  if(f->splicecount == f->splicealloc){
+    unsigned na = f->splicealloc ? f->splicealloc * 2 : 8;
+    fbufsplice* tmp = (fbufsplice*)realloc(f->splices, sizeof(*tmp) * na);
+    if(tmp == NULL){
+      return fbuf_putn(f, s, len);
+    }
+    f->splices = tmp;
+    f->splicealloc = na;
+  }
+  fbufsplice* sp = &f->splices[f->splicecount++];
+  sp->off = f->used;
+  sp->buf = s;
+  sp->len = len;
+  f->splicebytes += len;
+  return len;
+}
+
 static inline int
 fbuf_puts(fbuf* f, const char* s){
   size_t slen = strlen(s);
@@ -262,6 +402,12 @@ fbuf_free(fbuf* f){
     }
     f->size = 0;
     f->used = 0;
+    free(f->splices);
+    f->splices = NULL;
+    f->splicecount = 0;
+    f->splicealloc = 0;
+    f->splicebytes = 0;
+    f->highwater = 0;
   }
 }
 
@@ -296,15 +442,86 @@ blocking_write(int fd, const char* buf, size_t buflen){
   return 0;
 }
 
+#ifndef __MINGW32__
+// writev(2) until we've written it all. |iov| is modified.
+static inline int
+blocking_writev(int fd, struct iovec* iov, int iovcnt){
+  while(iovcnt){
+    ssize_t w = writev(fd, iov, iovcnt);
+    if(w < 0){
+      if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != EBUSY){
+        logerror("Error writing out data on %d (%s)", fd, strerror(errno));
+        return -1;
+      }
+      w = 0;
+    }
+    while(iovcnt && (size_t)w >= iov->iov_len){
+      w -= iov->iov_len;
+      ++iov;
+      --iovcnt;
+    }
+    if(iovcnt){
+      iov->iov_base = (char*)iov->iov_base + w;
+      iov->iov_len -= w;
+      struct pollfd pfd = {
+        .fd = fd,
+        .events = POLLOUT,
+        .revents = 0,
+      };
+      poll(&pfd, 1, -1);
+    }
+  }
+  return 0;
+}
+#endif
+
+// write the output of |f| to |fd|, skipping the first |skip| bytes of its own
+// buffer (|skip| must not extend past the first splice). splices are emitted
+// directly from their own storage. does not reset |f|.
+static inline int
+fbuf_write(int fd, const fbuf* f, size_t skip){
+#ifndef __MINGW32__
+  if(f->splicecount){
+#define FBUF_IOVECS 64
+    struct iovec iov[FBUF_IOVECS];
+    int iovcnt = 0;
+    uint64_t pos = skip;
+    for(unsigned i = 0 ; i <= f->splicecount ; ++i){
+      // our own bytes up through the next splice (or the end)
+      uint64_t end = i < f->splicecount ? f->splices[i].off : f->used;
+      assert(pos <= end);
+      if(end > pos){
+        iov[iovcnt].iov_base = f->buf + pos;
+        iov[iovcnt++].iov_len = end - pos;
+        pos = end;
+      }
+      if(i < f->splicecount){
+        iov[iovcnt].iov_base = (void*)f->splices[i].buf;
+        iov[iovcnt++].iov_len = f->splices[i].len;
+      }
+      if(iovcnt >= FBUF_IOVECS - 1 || i == f->splicecount){
+        if(blocking_writev(fd, iov, iovcnt)){
+          return -1;
+        }
+        iovcnt = 0;
+      }
+    }
+#undef FBUF_IOVECS
+    return 0;
+  }
+#endif
+  return blocking_write(fd, f->buf + skip, f->used - skip);
+}
+
 // attempt to write the contents of |f| to the FILE |fp|, if there are any
 // contents. reset the fbuf either way.
 static inline int
 fbuf_flush(fbuf* f, FILE* fp){
   int ret = 0;
-  if(f->used){
+  if(fbuf_total(f)){
     if(fflush(fp) == EOF){
       ret = -1;
-    }else if(blocking_write(fileno(fp), f->buf, f->used)){
+    }else if(fbuf_write(fileno(fp), f, 0)){
       ret = -1;
     }
   }
@@ -317,10 +534,10 @@ fbuf_flush(fbuf* f, FILE* fp){
 static inline int
 fbuf_finalize(fbuf* f, FILE* fp){
   int ret = 0;
-  if(f->used){
+  if(fbuf_total(f)){
     if(fflush(fp) == EOF){
       ret = -1;
-    }else if(blocking_write(fileno(fp), f->buf, f->used)){
+    }else if(fbuf_write(fileno(fp), f, 0)){
       ret = -1;
     }
   }
@@ -1408,9 +1408,20 @@ da2_cb(inputctx* ictx){
 static int
 kittygraph_cb(inputctx* ictx){
   loginfo("kitty graphics message");
+  char* str = amata_next_string(&ictx->amata, "\x1b_G");
   if(ictx->initdata){
     ictx->initdata->kitty_graphics = 1;
+  }else if(str && strncmp(str, "i=2;", 4) == 0){
+    // i=2 is the reply to our temporary file transmission query, sent with
+    // the first kitty frame (see kitty_probe_frame()).
+    if(strcmp(str + 4, "OK") == 0){
+      ictx->ti->kittyprobereply = 1;
+    }else{
+      loginfo("no kitty file transmission (%s)", str + 4);
+      ictx->ti->kittyprobereply = -1;
+    }
   }
+  free(str);
   return 2;
 }
 
@@ -128,8 +128,9 @@ typedef struct ncplane {
 // instances. initialize everything to 0 on a terminal reset / startup.
 typedef struct rasterstate {
   // we assemble the encoded (rasterized) output in an fbuf (a portable POSIX
-  // memstream, basically), and keep it around between uses. this could be a
-  // problem if it ever tremendously spiked, but that seems unlikely?
+  // memstream, basically), and keep it around between uses. should it ever
+  // tremendously spike, fbuf_trim() shrinks it back down once usage has
+  // remained well below its size for a while.
   fbuf f;         // buffer for preparing raster glyph/escape stream
 
   // the current cursor position. this is independent of whether the cursor is
@@ -390,6 +391,7 @@ typedef struct blitterargs {
       int pxoffx;      // pixel x-offset within origin cell
       int cellpxy;     // targeted cell-pixel geometry. this ought come from the
       int cellpxx;     // target ncpile, or tcache in Direct Mode
+      uint64_t frame;  // if non-zero, identifies the (scaled) source pixels
     } pixel;           // for pixels
   } u;
 } blitterargs;
@@ -699,6 +701,7 @@ void sprixel_invalidate(sprixel* s, int y, int x);
 void sprixel_movefrom(sprixel* s, int y, int x);
 void sprixel_debug(const sprixel* s, FILE* out);
 void sixelmap_free(struct sixelmap *s);
+void sixelpalette_free(struct sixelpalette* p);
 
 // update any necessary cells underneath the sprixel pursuant to its removal.
 // for sixel, this *achieves* the removal, and is performed on every cell.
@@ -765,6 +768,16 @@ sprite_commit(tinfo* ti, fbuf* f, sprixel* s, unsigned forcescroll){
   return 0;
 }
 
+// delete a graphic. only defined for kitty. a sprixel placing a cached image
+// removes only its placement, leaving the image to the cache.
+static inline int
+sprite_remove(const tinfo* ti, fbuf* f, const sprixel* s){
+  if(s->cached){
+    return kitty_unplace(s, f);
+  }
+  return ti->pixel_remove(s->id, f);
+}
+
 static inline void
 cleanup_tam(tament* tam, int ydim, int xdim){
   for(int y = 0 ; y < ydim ; ++y){
@@ -898,12 +911,6 @@ pool_release(egcpool* pool, nccell* c){
   c->width = 0;    // don't subject ourselves to geometric ambiguities
 }
 
-// set the nccell 'c' to point into the egcpool at location 'eoffset'
-static inline void
-set_gcluster_egc(nccell* c, int eoffset){
-  c->gcluster = htole(0x01000000ul) + htole(eoffset);
-}
-
 // Duplicate one nccell onto another, possibly crossing ncplanes.
 static inline int
 cell_duplicate_far(egcpool* tpool, nccell* targ, const ncplane* splane, const nccell* c){
@@ -1883,6 +1890,27 @@ int putenv_term(const char* termname) __attribute__ ((nonnull (1)));
 int set_loglevel_from_env(ncloglevel_e* loglevel)
   __attribute__ ((nonnull (1)));
 
+// the number of processors available to us (always at least 1).
+unsigned ncpu_count(void);
+
+// how many threads beyond the calling one ought help with some parallel
+// work? one fewer than ncpu_count(), unless the environment variable
+// |envvar| supplies a (nonnegative) count. never more than |max|.
+unsigned ncthread_helpers(const char* envvar, unsigned max)
+  __attribute__ ((nonnull (1)));
+
+// the process-wide pool of helper threads (see workers.c) lives so long as
+// any context holds a reference to it.
+#define NCWORKERS_MAXTHREADS 16
+void ncworkers_ref(void);
+void ncworkers_unref(void);
+
+// call |fxn| with |curry| for each job in [0..|jobs|), using no more than
+// |threads| threads (the calling thread among them), and return once all
+// jobs have completed.
+void ncworkers_run(unsigned threads, unsigned jobs,
+                   void (*fxn)(void*, unsigned), void* curry);
+
 // glibc's _nl_normalize_charset() converts to lowercase, removing everything
 // but alnums. furthermore, "cs" is a valid prefix meaning "character set".
 static inline bool
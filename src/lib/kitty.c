@@ -1,3 +1,4 @@
+#include <math.h>
 #include "internal.h"
 #include "base64.h"
 #ifdef USE_DEFLATE
@@ -213,11 +214,50 @@ init_sprixel_animation(sprixel* s){
   return 0;
 }
 
+// a sprixel placing a cached image (see imgcache_create()) places it under
+// a placement id of its own. otherwise, the image is its own, and it is
+// placed once, as placement 1.
+static inline uint32_t
+kitty_image_id(const sprixel* s){
+  return s->cached ? s->cached->imageid : s->id;
+}
+
+static inline uint32_t
+kitty_placement_id(const sprixel* s){
+  return s->cached ? s->id : 1;
+}
+
+static int kitty_unshare(sprixel* s);
+
 #define RGBA_MAXLEN 768 // 768 base64-encoded pixels in 4096 bytes
+
+// find the encoded triplet holding pixel |px| of a static bitmap, using the
+// offsets of its chunks recorded by write_kitty_data(). every 3 pixels are
+// 12 bytes, an even 16 base64 bytes, and a chunk holds up to 768 pixels.
+// |*skip| pixels precede |px| in the triplet, and |*pleft| pixels (starting
+// with the triplet) remain in the chunk. returns NULL if |px| is outside
+// the bitmap.
+static inline char*
+kitty_triplet(const sprixel* s, int px, int* skip, int* pleft){
+  const int totalpixels = s->pixy * s->pixx;
+  if(px >= totalpixels || s->chunkoffs == NULL){
+    return NULL;
+  }
+  const int chunk = px / RGBA_MAXLEN;
+  const int pixoffset = px - chunk * RGBA_MAXLEN;
+  const int triples = pixoffset / 3;
+  int inchunk = totalpixels - chunk * RGBA_MAXLEN;
+  if(inchunk > RGBA_MAXLEN){
+    inchunk = RGBA_MAXLEN;
+  }
+  *skip = pixoffset - triples * 3;
+  *pleft = inchunk - triples * 3;
+  return (char*)s->glyph.buf + s->parse_start + s->chunkoffs[chunk] + triples * 16;
+}
+
 // restore an annihilated sprixcell by copying the alpha values from the
 // auxiliary vector back into the actual data. we then free the auxvector.
 int kitty_rebuild(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
-  const int totalpixels = s->pixy * s->pixx;
   const int xpixels = ncplane_pile(s->n)->cellpxx;
   const int ypixels = ncplane_pile(s->n)->cellpxy;
   int targx = xpixels;
@@ -228,64 +268,29 @@ int kitty_rebuild(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
   if((ycell + 1) * ypixels > s->pixy){
     targy = s->pixy - ycell * ypixels;
   }
-  char* c = (char*)s->glyph.buf + s->parse_start;
-  int nextpixel = (s->pixx * ycell * ypixels) + (xpixels * xcell);
-  int thisrow = targx;
-  int chunkedhandled = 0;
   sprixcell_e state = SPRIXCELL_OPAQUE_KITTY;
-  const int chunks = totalpixels / RGBA_MAXLEN + !!(totalpixels % RGBA_MAXLEN);
   int auxvecidx = 0;
-  while(targy && chunkedhandled < chunks){ // need to null out |targy| rows of |targx| pixels, track with |thisrow|
-    int inchunk = totalpixels - chunkedhandled * RGBA_MAXLEN;
-    if(inchunk > RGBA_MAXLEN){
-      inchunk = RGBA_MAXLEN;
-    }
-    const int curpixel = chunkedhandled * RGBA_MAXLEN;
-    // a full chunk is 4096 + 2 + 7 (5005)
-    while(nextpixel - curpixel < RGBA_MAXLEN && thisrow){
-      // our next pixel is within this chunk. find the pixel offset of the
-      // first pixel (within the chunk).
-      int pixoffset = nextpixel - curpixel;
-      int triples = pixoffset / 3;
-      int tripbytes = triples * 16;
-      int tripskip = pixoffset - triples * 3;
-      // we start within a 16-byte chunk |tripbytes| into the chunk. determine
-      // the number of bits.
-//fprintf(stderr, "pixoffset: %d next: %d tripbytes: %d tripskip: %d thisrow: %d\n", pixoffset, nextpixel, tripbytes, tripskip, thisrow);
-      // the maximum number of pixels we can convert is the minimum of the
-      // pixels remaining in the target row, and the pixels left in the chunk.
-//fprintf(stderr, "inchunk: %d total: %d triples: %d\n", inchunk, totalpixels, triples);
-      int chomped = kitty_restore(c + tripbytes, tripskip, thisrow,
-                                  inchunk - triples * 3, auxvec + auxvecidx,
-                                  &state);
-      assert(chomped >= 0);
+  // restore |targy| rows of |targx| pixels, each row a run of triplets
+  // (possibly broken across a chunk boundary).
+  for(int y = 0 ; y < targy ; ++y){
+    int nextpixel = s->pixx * (ycell * ypixels + y) + xpixels * xcell;
+    int thisrow = targx;
+    while(thisrow){
+      int skip, pleft;
+      char* c = kitty_triplet(s, nextpixel, &skip, &pleft);
+      if(c == NULL){
+        return -1;
+      }
+      int chomped = kitty_restore(c, skip, thisrow, pleft, auxvec + auxvecidx, &state);
+      assert(chomped > 0);
       auxvecidx += chomped;
       thisrow -= chomped;
-//fprintf(stderr, "POSTCHIMP CHOMP: %d pixoffset: %d next: %d tripbytes: %d tripskip: %d thisrow: %d\n", chomped, pixoffset, nextpixel, tripbytes, tripskip, thisrow);
-      if(thisrow == 0){
-//fprintf(stderr, "CLEARED ROW, TARGY: %d\n", targy - 1);
-        if(--targy == 0){
-          s->n->tam[s->dimx * ycell + xcell].state = state;
-          s->invalidated = SPRIXEL_INVALIDATED;
-          return 1;
-        }
-        thisrow = targx;
-//fprintf(stderr, "BUMP IT: %d %d %d %d\n", nextpixel, s->pixx, targx, chomped);
-        nextpixel += s->pixx - targx + chomped;
-      }else{
-        nextpixel += chomped;
-      }
-    }
-    c += RGBA_MAXLEN * 4 * 4 / 3; // 4bpp * 4/3 for base64, 4096b per chunk
-    c += 8; // new chunk header
-    ++chunkedhandled;
-//fprintf(stderr, "LOOKING NOW AT %u [%s]\n", c - s->glyph, c);
-    while(*c != ';'){
-      ++c;
+      nextpixel += chomped;
     }
-    ++c;
   }
-  return -1;
+  s->n->tam[s->dimx * ycell + xcell].state = state;
+  s->invalidated = SPRIXEL_INVALIDATED;
+  return 1;
 }
 
 // does this auxvec correspond to a sprixcell which was nulled out during the
@@ -354,6 +359,7 @@ static int
 kitty_blit_wipe_selfref(sprixel* s, fbuf* f, int ycell, int xcell){
   const int cellpxx = ncplane_pile(s->n)->cellpxx;
   const int cellpxy = ncplane_pile(s->n)->cellpxy;
+  s->wiped = true;
   if(fbuf_printf(f, "\x1b_Ga=f,x=%d,y=%d,s=%d,v=%d,i=%d,X=1,r=2,c=1,q=2;",
                  xcell * cellpxx, ycell * cellpxy, cellpxx, cellpxy, s->id) < 0){
     return -1;
@@ -393,6 +399,9 @@ kitty_blit_wipe_selfref(sprixel* s, fbuf* f, int ycell, int xcell){
 // way, we needn't delete and redraw the entire sprixel.
 int kitty_wipe_animation(sprixel* s, int ycell, int xcell){
   logdebug("wiping sprixel %u at %d/%d", s->id, ycell, xcell);
+  if(s->cached && kitty_unshare(s)){
+    return -1;
+  }
   if(init_sprixel_animation(s)){
     return -1;
   }
@@ -408,6 +417,9 @@ int kitty_wipe_animation(sprixel* s, int ycell, int xcell){
 }
 
 int kitty_wipe_selfref(sprixel* s, int ycell, int xcell){
+  if(s->cached && kitty_unshare(s)){
+    return -1;
+  }
   if(init_sprixel_animation(s)){
     return -1;
   }
@@ -429,8 +441,30 @@ sprixel* kitty_recycle(ncplane* n){
   sprixel* hides = n->sprite;
   int dimy = hides->dimy;
   int dimx = hides->dimx;
+  sprixel* s = sprixel_alloc(n, dimy, dimx);
+  if(s == NULL){
+    sprixel_hide(hides);
+    return NULL;
+  }
+  if(ncplane_notcurses_const(n)->tcache.pixel_implementation >= NCPIXEL_KITTY_ANIMATED){
+    s->keeppx = true;
+    // we can take over the image if it's been loaded, and its root frame is
+    // still what we last sent. the predecessor is then hidden without
+    // removing the image (kitty never uses id 0).
+    if(hides->lastpx && !hides->wiped && !hides->cached &&
+       hides->invalidated != SPRIXEL_UNSEEN &&
+       ncplane_pile(n)){
+      loginfo("sprixel %u takes over image %u", s->id, hides->id);
+      s->id = hides->id;
+      s->lastpx = hides->lastpx;
+      s->lastpxy = hides->lastpxy;
+      s->lastpxx = hides->lastpxx;
+      hides->lastpx = NULL;
+      hides->id = 0;
+    }
+  }
   sprixel_hide(hides);
-  return sprixel_alloc(n, dimy, dimx);
+  return s;
 }
 
 // for pre-animation kitty (NCPIXEL_KITTY_STATIC), we need a byte per pixel,
@@ -447,11 +481,13 @@ kitty_auxiliary_vector(const sprixel* s){
 
 int kitty_wipe(sprixel* s, int ycell, int xcell){
 //fprintf(stderr, "NEW WIPE %d %d/%d\n", s->id, ycell, xcell);
+  if(s->cached && kitty_unshare(s)){
+    return -1;
+  }
   uint8_t* auxvec = kitty_auxiliary_vector(s);
   if(auxvec == NULL){
     return -1;
   }
-  const int totalpixels = s->pixy * s->pixx;
   const int xpixels = ncplane_pile(s->n)->cellpxx;
   const int ypixels = ncplane_pile(s->n)->cellpxy;
   // if the cell is on the right or bottom borders, it might only be partially
@@ -464,81 +500,42 @@ int kitty_wipe(sprixel* s, int ycell, int xcell){
   if((ycell + 1) * ypixels > s->pixy){
     targy = s->pixy - ycell * ypixels;
   }
-  char* c = (char*)s->glyph.buf + s->parse_start;
-//fprintf(stderr, "TARGET AREA: %d x %d @ %dx%d of %d/%d (%d/%d) len %zu\n", targy, targx, ycell, xcell, s->dimy, s->dimx, s->pixy, s->pixx, strlen(c));
-  // every pixel was 4 source bytes, 32 bits, 6.33 base64 bytes. every 3 input pixels is
-  // 12 bytes (96 bits), an even 16 base64 bytes. there is chunking to worry about. there
-  // are up to 768 pixels in a chunk.
-  int nextpixel = (s->pixx * ycell * ypixels) + (xpixels * xcell);
-  int thisrow = targx;
-  int chunkedhandled = 0;
-  const int chunks = totalpixels / RGBA_MAXLEN + !!(totalpixels % RGBA_MAXLEN);
+  // null out |targy| rows of |targx| pixels, each row a run of triplets
+  // (possibly broken across a chunk boundary).
   int auxvecidx = 0;
-  while(targy && chunkedhandled < chunks){ // need to null out |targy| rows of |targx| pixels, track with |thisrow|
-//fprintf(stderr, "PLUCKING FROM [%s]\n", c);
-    int inchunk = totalpixels - chunkedhandled * RGBA_MAXLEN;
-    if(inchunk > RGBA_MAXLEN){
-      inchunk = RGBA_MAXLEN;
-    }
-    const int curpixel = chunkedhandled * RGBA_MAXLEN;
-    // a full chunk is 4096 + 2 + 7 (5005)
-    while(nextpixel - curpixel < RGBA_MAXLEN && thisrow){
-      // our next pixel is within this chunk. find the pixel offset of the
-      // first pixel (within the chunk).
-      int pixoffset = nextpixel - curpixel;
-      int triples = pixoffset / 3;
-      int tripbytes = triples * 16;
-      // we start within a 16-byte chunk |tripbytes| into the chunk. determine
-      // the number of bits.
-      int tripskip = pixoffset - triples * 3;
-//fprintf(stderr, "pixoffset: %d next: %d tripbytes: %d tripskip: %d thisrow: %d\n", pixoffset, nextpixel, tripbytes, tripskip, thisrow);
-      // the maximum number of pixels we can convert is the minimum of the
-      // pixels remaining in the target row, and the pixels left in the chunk.
-//fprintf(stderr, "inchunk: %d total: %d triples: %d\n", inchunk, totalpixels, triples);
-//fprintf(stderr, "PRECHOMP:  [%.16s]\n", c + tripbytes);
-      int chomped = kitty_null(c + tripbytes, tripskip, thisrow,
-                               inchunk - triples * 3, auxvec + auxvecidx);
-//fprintf(stderr, "POSTCHOMP: [%.16s]\n", c + tripbytes);
-      assert(chomped >= 0);
+  for(int y = 0 ; y < targy ; ++y){
+    int nextpixel = s->pixx * (ycell * ypixels + y) + xpixels * xcell;
+    int thisrow = targx;
+    while(thisrow){
+      int skip, pleft;
+      char* c = kitty_triplet(s, nextpixel, &skip, &pleft);
+      if(c == NULL){
+        free(auxvec);
+        return -1;
+      }
+      int chomped = kitty_null(c, skip, thisrow, pleft, auxvec + auxvecidx);
+      assert(chomped > 0);
       auxvecidx += chomped;
       assert(auxvecidx <= ypixels * xpixels);
       thisrow -= chomped;
-//fprintf(stderr, "POSTCHIMP CHOMP: %d pixoffset: %d next: %d tripbytes: %d tripskip: %d thisrow: %d\n", chomped, pixoffset, nextpixel, tripbytes, tripskip, thisrow);
-      if(thisrow == 0){
-//fprintf(stderr, "CLEARED ROW, TARGY: %d\n", targy - 1);
-        if(--targy == 0){
-          s->n->tam[s->dimx * ycell + xcell].auxvector = auxvec;
-          s->invalidated = SPRIXEL_INVALIDATED;
-          return 1;
-        }
-        thisrow = targx;
-//fprintf(stderr, "BUMP IT: %d %d %d %d\n", nextpixel, s->pixx, targx, chomped);
-        nextpixel += s->pixx - targx + chomped;
-      }else{
-        nextpixel += chomped;
-      }
+      nextpixel += chomped;
     }
-    c += RGBA_MAXLEN * 4 * 4 / 3; // 4bpp * 4/3 for base64, 4096b per chunk
-    c += 8; // new chunk header
-    ++chunkedhandled;
-//fprintf(stderr, "LOOKING NOW AT %u [%s]\n", c - s->glyph, c);
-    while(*c != ';'){
-      ++c;
-    }
-    ++c;
   }
-  free(auxvec);
-  return -1;
+  s->n->tam[s->dimx * ycell + xcell].auxvector = auxvec;
+  s->invalidated = SPRIXEL_INVALIDATED;
+  return 1;
 }
 
 int kitty_commit(fbuf* f, sprixel* s, unsigned noscroll){
   loginfo("committing Kitty graphic id %u", s->id);
   int i;
   if(s->pxoffx || s->pxoffy){
-    i = fbuf_printf(f, "\e_Ga=p,i=%u,p=1,X=%u,Y=%u%s,q=2\e\\", s->id,
-                    s->pxoffx, s->pxoffy, noscroll ? ",C=1" : "");
+    i = fbuf_printf(f, "\e_Ga=p,i=%u,p=%u,X=%u,Y=%u%s,q=2\e\\", kitty_image_id(s),
+                    kitty_placement_id(s), s->pxoffx, s->pxoffy,
+                    noscroll ? ",C=1" : "");
   }else{
-    i = fbuf_printf(f, "\e_Ga=p,i=%u,p=1,q=2%s\e\\", s->id, noscroll ? ",C=1" : "");
+    i = fbuf_printf(f, "\e_Ga=p,i=%u,p=%u,q=2%s\e\\", kitty_image_id(s),
+                    kitty_placement_id(s), noscroll ? ",C=1" : "");
   }
   if(i < 0){
     return -1;
@@ -549,15 +546,18 @@ int kitty_commit(fbuf* f, sprixel* s, unsigned noscroll){
 
 // chunkify and write the collected buffer in the animated case. this might
 // or might not be compressed (depends on whether compression was useful).
+// the whole of the output is reserved up front, and each chunk's 3072 bytes
+// are encoded to 4096 in one go.
 static int
 encode_and_chunkify(fbuf* f, const unsigned char* buf, size_t blen, unsigned compressed){
+  const size_t chunklen = 4096 * 3 / 4;
   // need to terminate the header, requiring semicolon
   if(compressed){
     if(fbuf_putn(f, ",o=z", 4) < 0){
       return -1;
     }
   }
-  if(blen > 4096 * 3 / 4){
+  if(blen > chunklen){
     if(fbuf_putn(f, ",m=1", 4) < 0){
       return -1;
     }
@@ -565,112 +565,645 @@ encode_and_chunkify(fbuf* f, const unsigned char* buf, size_t blen, unsigned com
   if(fbuf_putc(f, ';') < 0){
     return -1;
   }
-  bool first = true;
-  unsigned long i = 0;
-  char b64d[4];
-  while(blen - i > 4096 * 3 / 4){
-    if(!first){
-      if(fbuf_putn(f, "\x1b_Gm=1;", 7) < 0){
-        return -1;
-      }
-    }
-    unsigned long max = i + 4096 * 3 / 4;
-    while(i < max){
-      base64x3(buf + i, b64d);
-      if(fbuf_putn(f, b64d, 4) < 0){
-        return -1;
-      }
-      i += 3;
-    }
-    first = false;
-    if(fbuf_putn(f, "\x1b\\", 2) < 0){
-      return -1;
-    }
+  size_t chunks = (blen + chunklen - 1) / chunklen;
+  if(chunks == 0){
+    chunks = 1;
   }
-  if(!first){
-    if(fbuf_putn(f, "\x1b_Gm=0;", 7) < 0){
-      return -1;
-    }
+  // 7 bytes open every chunk but the first, and 2 bytes close each
+  if(fbuf_reserve(f, (blen + 2) / 3 * 4 + chunks * 9)){
+    return -1;
   }
-  while(i < blen){
-    if(blen - i < 3){
-      base64final(buf + i, b64d, blen - i);
-      if(fbuf_putn(f, b64d, 4) < 0){
-        return -1;
-      }
-      i += blen - i;
-    }else{
-      base64x3(buf + i, b64d);
-      if(fbuf_putn(f, b64d, 4) < 0){
-        return -1;
-      }
-      i += 3;
+  char* out = f->buf + f->used;
+  size_t i = 0;
+  for(size_t c = 0 ; c < chunks ; ++c){
+    if(c){
+      memcpy(out, c + 1 < chunks ? "\x1b_Gm=1;" : "\x1b_Gm=0;", 7);
+      out += 7;
     }
+    const size_t n = blen - i > chunklen ? chunklen : blen - i;
+    out += base64_encode(buf + i, n, out);
+    i += n;
+    memcpy(out, "\x1b\\", 2);
+    out += 2;
   }
-  if(fbuf_putn(f, "\x1b\\", 2) < 0){
-    return -1;
-  }
+  f->used = out - f->buf;
   return 0;
 }
 
-static int
-deflate_buf(void* buf, fbuf* f, int dimy, int dimx){
-  const size_t blen = dimx * dimy * 4;
-  void* cbuf = NULL;
-  size_t clen = 0;
+// a compressor, and an arena for its output. the arena grows as necessary,
+// and is retained between uses.
+typedef struct kitty_deflator {
+#ifdef USE_DEFLATE
+  struct libdeflate_compressor* cmp;
+#else
+  z_stream zctx;
+#endif
+  unsigned char* arena;
+  size_t arenalen;
+  struct kitty_deflator* next;
+} kitty_deflator;
+
+// cached in the tinfo across blits. distinct piles can blit concurrently, so
+// idle deflators are taken and returned under the lock.
+typedef struct kitty_engine {
+  pthread_mutex_t lock;
+  kitty_deflator* idle;
+  unsigned threads; // most threads used to compress a single image
+} kitty_engine;
+
+#define KITTY_DEFLATE_MAXTHREADS 8
+// don't split an image into strips of less than 1MiB of RGBA
+#define KITTY_DEFLATE_MINSTRIP (1u << 20)
+// skip deflate if it's unlikely to save at least a quarter of the payload
+#define KITTY_DEFLATE_MAXRATIO 0.75
+// send the whole image rather than deltas once half of it has changed
+#define KITTY_DELTA_MAXCHANGE 0.5
+// don't bother compressing delta runs smaller than this many bytes
+#define KITTY_DELTA_MINDEFLATE 16384
+// sample this many runs of this many pixels to estimate entropy
+#define KITTY_SAMPLE_RUNS 64
+#define KITTY_SAMPLE_RUNLEN 32
+
+static void
+kitty_deflator_destroy(kitty_deflator* d){
+  if(d){
 #ifdef USE_DEFLATE
+    libdeflate_free_compressor(d->cmp);
+#else
+    deflateEnd(&d->zctx);
+#endif
+    free(d->arena);
+    free(d);
+  }
+}
+
+// take an idle deflator from |ke|, or create a new one. |ke| may be NULL.
+static kitty_deflator*
+kitty_deflator_get(kitty_engine* ke){
+  kitty_deflator* d = NULL;
+  if(ke){
+    pthread_mutex_lock(&ke->lock);
+    if( (d = ke->idle) ){
+      ke->idle = d->next;
+    }
+    pthread_mutex_unlock(&ke->lock);
+    if(d){
+      return d;
+    }
+  }
+  if((d = malloc(sizeof(*d))) == NULL){
+    return NULL;
+  }
   // 2 has been shown to work pretty well for things that are actually going
   // to compress; results per unit time fall off quickly after 2.
-  struct libdeflate_compressor* cmp = libdeflate_alloc_compressor(2);
-  if(cmp == NULL){
+#ifdef USE_DEFLATE
+  if((d->cmp = libdeflate_alloc_compressor(2)) == NULL){
     logerror("couldn't get libdeflate context");
-    return -1;
+    free(d);
+    return NULL;
   }
-  // if this allocation fails, just skip compression, no need to bail
-  cbuf = malloc(blen);
-  if(cbuf){
-    clen = libdeflate_zlib_compress(cmp, buf, blen, cbuf, blen);
-  }
-  libdeflate_free_compressor(cmp);
 #else
-  z_stream zctx = {0};
-  int z = deflateInit(&zctx, 2);
+  memset(&d->zctx, 0, sizeof(d->zctx));
+  int z = deflateInit(&d->zctx, 2);
   if(z != Z_OK){
     logerror("couldn't get zlib context");
-    return -1;
+    free(d);
+    return NULL;
   }
-  clen = deflateBound(&zctx, blen);
-  cbuf = malloc(clen);
-  if(cbuf == NULL){
-    logerror("couldn't allocate %" PRIuPTR "B", clen);
-    deflateEnd(&zctx);
-    return -1;
+#endif
+  d->arena = NULL;
+  d->arenalen = 0;
+  d->next = NULL;
+  return d;
+}
+
+// return |d| to |ke|'s idle list, or destroy it if there is no engine.
+static void
+kitty_deflator_put(kitty_engine* ke, kitty_deflator* d){
+  if(ke == NULL){
+    kitty_deflator_destroy(d);
+    return;
+  }
+  pthread_mutex_lock(&ke->lock);
+  d->next = ke->idle;
+  ke->idle = d;
+  pthread_mutex_unlock(&ke->lock);
+}
+
+// deflate |blen| bytes of |buf| into |d|'s arena. returns the compressed
+// length, or 0 if compression failed or didn't shrink the data, in which
+// case the original ought be sent.
+static size_t
+kitty_deflate(kitty_deflator* d, const void* buf, size_t blen){
+#ifdef USE_DEFLATE
+  const size_t need = blen;
+#else
+  if(deflateReset(&d->zctx) != Z_OK){
+    return 0;
   }
-  zctx.avail_out = clen;
-  zctx.next_out = cbuf;
-  zctx.next_in = buf;
-  zctx.avail_in = blen;
-  z = deflate(&zctx, Z_FINISH);
+  const size_t need = deflateBound(&d->zctx, blen);
+#endif
+  if(d->arenalen < need){
+    // if this allocation fails, just skip compression, no need to bail
+    free(d->arena);
+    if((d->arena = malloc(need)) == NULL){
+      d->arenalen = 0;
+      return 0;
+    }
+    d->arenalen = need;
+  }
+#ifdef USE_DEFLATE
+  // libdeflate returns 0 if the output doesn't fit in |blen|
+  return libdeflate_zlib_compress(d->cmp, buf, blen, d->arena, blen);
+#else
+  d->zctx.avail_out = need;
+  d->zctx.next_out = d->arena;
+  d->zctx.next_in = (void*)buf;
+  d->zctx.avail_in = blen;
+  int z = deflate(&d->zctx, Z_FINISH);
   if(z != Z_STREAM_END){
-    logerror("error %d deflating %" PRIuPTR "B -> %" PRIuPTR "B", z, blen, clen);
-    deflateEnd(&zctx);
-    return -1;
+    logwarn("error %d deflating %" PRIuPTR "B", z, blen);
+    return 0;
   }
-  deflateEnd(&zctx);
-  clen -= zctx.avail_out;
+  const size_t clen = need - d->zctx.avail_out;
+  return clen < blen ? clen : 0;
 #endif
+}
+
+// estimate whether deflate will save enough to be worth running, using the
+// order-0 entropy of bytes sampled from across the image. deflate matches
+// repeated pixels very cheaply, so they're not charged at all. photos and
+// video typically come out well above the cutoff, and aren't compressed.
+static bool
+kitty_worth_deflating(const uint32_t* px, size_t count){
+  if(count < KITTY_SAMPLE_RUNS * KITTY_SAMPLE_RUNLEN * 4){
+    return true; // small enough that we might as well just try
+  }
+  unsigned hist[256] = {0};
+  unsigned fresh = 0;
+  for(unsigned r = 0 ; r < KITTY_SAMPLE_RUNS ; ++r){
+    const uint32_t* run = px + count / KITTY_SAMPLE_RUNS * r;
+    for(unsigned i = 0 ; i < KITTY_SAMPLE_RUNLEN ; ++i){
+      if(i && run[i] == run[i - 1]){
+        continue;
+      }
+      const unsigned char* b = (const unsigned char*)&run[i];
+      ++hist[b[0]];
+      ++hist[b[1]];
+      ++hist[b[2]];
+      ++hist[b[3]];
+      ++fresh;
+    }
+  }
+  const double n = fresh * 4.0;
+  double bits = 0;
+  for(unsigned b = 0 ; b < 256 ; ++b){
+    if(hist[b]){
+      bits -= hist[b] * log2(hist[b] / n);
+    }
+  }
+  const double sampled = KITTY_SAMPLE_RUNS * KITTY_SAMPLE_RUNLEN * 4 * 8;
+  logdebug("estimated deflate ratio: %.3f", bits / sampled);
+  return bits / sampled < KITTY_DEFLATE_MAXRATIO;
+}
+
+typedef struct kitty_zbits {
+  unsigned char* out;
+  uint64_t acc;
+  unsigned n;
+} kitty_zbits;
+
+// deflate packs bits starting from the least significant
+static inline void
+kitty_zbits_put(kitty_zbits* z, unsigned v, unsigned n){
+  z->acc |= (uint64_t)v << z->n;
+  z->n += n;
+  while(z->n >= 8){
+    *z->out++ = z->acc;
+    z->acc >>= 8;
+    z->n -= 8;
+  }
+}
+
+// build the zlib stream for |len| zero bytes directly, rather than running
+// the compressor over them (which is surprisingly slow). it's a single
+// fixed-Huffman block: a literal zero, copies of it (length 258, distance 1),
+// and literals for whatever's left. codes are given here bit-reversed.
+static unsigned char*
+kitty_zero_zlib(size_t len, size_t* zlen){
+  const size_t copies = (len - 1) / 258;
+  const size_t lits = len - copies * 258;
+  const size_t bits = 3 + copies * 13 + lits * 8 + 7;
+  unsigned char* z = malloc(2 + (bits + 7) / 8 + 4);
+  if(z == NULL){
+    return NULL;
+  }
+  z[0] = 0x78; // deflate with a 32KiB window, no dictionary
+  z[1] = 0x01;
+  kitty_zbits zb = { .out = z + 2, .acc = 0, .n = 0, };
+  kitty_zbits_put(&zb, 0x3, 3); // BFINAL, fixed Huffman
+  kitty_zbits_put(&zb, 0x0c, 8); // literal 0
+  for(size_t c = 0 ; c < copies ; ++c){
+    kitty_zbits_put(&zb, 0xa3, 13); // length 258 (285), distance 1 (0)
+  }
+  for(size_t l = 1 ; l < lits ; ++l){
+    kitty_zbits_put(&zb, 0x0c, 8);
+  }
+  kitty_zbits_put(&zb, 0, 7); // end of block
+  if(zb.n){
+    kitty_zbits_put(&zb, 0, 8 - zb.n);
+  }
+  const uint32_t adler = ((len % 65521) << 16) | 1;
+  zb.out[0] = adler >> 24;
+  zb.out[1] = adler >> 16;
+  zb.out[2] = adler >> 8;
+  zb.out[3] = adler;
+  *zlen = zb.out + 4 - z;
+  return z;
+}
+
+typedef struct kitty_strip {
+  kitty_deflator* d;
+  const unsigned char* src;
+  size_t len;
+  size_t clen;   // 0 if the strip is to be sent uncompressed
+  int y, rows;
+} kitty_strip;
+
+static void
+kitty_deflate_worker(void* vstrips, unsigned idx){
+  kitty_strip* ks = (kitty_strip*)vstrips + idx;
+  ks->clen = kitty_deflate(ks->d, ks->src, ks->len);
+}
+
+// how many threads ought compress an image of |blen| bytes and |dimy| rows?
+static unsigned
+kitty_deflate_threads(const kitty_engine* ke, size_t blen, int dimy){
+  size_t threads = ke ? ke->threads : 1;
+  if(threads > blen / KITTY_DEFLATE_MINSTRIP){
+    threads = blen / KITTY_DEFLATE_MINSTRIP;
+  }
+  if(threads > (size_t)dimy){
+    threads = dimy;
+  }
+  return threads < 1 ? 1 : threads;
+}
+
+// a zlib stream can't be stitched together from independently deflated
+// pieces, but kitty can edit the root frame of an image. for large images,
+// we transmit a transparent image of the right geometry (which we needn't
+// compress), and then write horizontal strips atop it with X=1, each
+// deflated by its own thread of the worker pool.
+static int
+deflate_strips(kitty_engine* ke, const sprixel* s, const unsigned char* buf,
+               fbuf* f, int dimy, int dimx, unsigned threads){
+  const size_t linelen = dimx * 4;
+  kitty_strip strips[KITTY_DEFLATE_MAXTHREADS];
+  int ret = -1;
+  unsigned t;
+  for(t = 0 ; t < threads ; ++t){
+    if((strips[t].d = kitty_deflator_get(ke)) == NULL){
+      goto done;
+    }
+    strips[t].y = dimy * t / threads;
+    strips[t].rows = dimy * (t + 1) / threads - strips[t].y;
+    strips[t].src = buf + linelen * strips[t].y;
+    strips[t].len = linelen * strips[t].rows;
+  }
+  ncworkers_run(threads, threads, kitty_deflate_worker, strips);
+  size_t zlen;
+  unsigned char* z = kitty_zero_zlib(linelen * dimy, &zlen);
+  if(z == NULL){
+    goto done;
+  }
+  ret = encode_and_chunkify(f, z, zlen, 1);
+  free(z);
+  for(unsigned w = 0 ; ret == 0 && w < threads ; ++w){
+    const kitty_strip* ks = &strips[w];
+    loginfo("deflated strip %u %" PRIuPTR "B to %" PRIuPTR "B", w, ks->len, ks->clen);
+    if(fbuf_printf(f, "\e_Ga=f,r=1,i=%u,x=0,y=%d,s=%d,v=%d,X=1,q=2",
+                   kitty_image_id(s), ks->y, dimx, ks->rows) < 0){
+      ret = -1;
+    }else if(ks->clen){
+      ret = encode_and_chunkify(f, ks->d->arena, ks->clen, 1);
+    }else{
+      ret = encode_and_chunkify(f, ks->src, ks->len, 0);
+    }
+  }
+
+done:
+  while(t--){
+    kitty_deflator_put(ke, strips[t].d);
+  }
+  return ret;
+}
+
+static int
+deflate_buf(kitty_engine* ke, const sprixel* s, void* buf, fbuf* f,
+            int dimy, int dimx){
+  const size_t blen = dimx * dimy * 4;
+  if(!kitty_worth_deflating(buf, (size_t)dimx * dimy)){
+    loginfo("not deflating high-entropy %" PRIuPTR "B", blen);
+    return encode_and_chunkify(f, buf, blen, 0);
+  }
+  const unsigned threads = kitty_deflate_threads(ke, blen, dimy);
+  if(threads > 1){
+    return deflate_strips(ke, s, buf, f, dimy, dimx, threads);
+  }
+  kitty_deflator* d = kitty_deflator_get(ke);
+  if(d == NULL){
+    return -1;
+  }
+  const size_t clen = kitty_deflate(d, buf, blen);
   int ret;
-  if(0 == clen){ // wasn't enough room; compressed data is larger than original
+  if(0 == clen){ // compressed data is no smaller than original
     loginfo("deflated in vain; using original %" PRIuPTR "B", blen);
     ret = encode_and_chunkify(f, buf, blen, 0);
   }else{
     loginfo("deflated %" PRIuPTR "B to %" PRIuPTR "B", blen, clen);
-    ret = encode_and_chunkify(f, cbuf, clen, 1);
+    ret = encode_and_chunkify(f, d->arena, clen, 1);
+  }
+  kitty_deflator_put(ke, d);
+  return ret;
+}
+
+// a sprixel which has taken over its predecessor's image (see
+// kitty_recycle()) compares its frame to the last one sent, a cell-sized tile
+// at a time, and writes each horizontal run of changed tiles atop the root
+// frame. returns 1, having written nothing, if so much has changed that the
+// whole image ought be sent instead.
+static int
+kitty_send_delta(kitty_engine* ke, const sprixel* s, fbuf* f, const uint32_t* buf,
+                 int leny, int lenx, int cdimy, int cdimx){
+  const int tilesy = (leny + cdimy - 1) / cdimy;
+  const int tilesx = (lenx + cdimx - 1) / cdimx;
+  bool* changed = calloc(tilesx, sizeof(*changed));
+  uint32_t* rect = malloc(sizeof(*rect) * lenx * cdimy);
+  kitty_deflator* d = kitty_deflator_get(ke);
+  int ret = -1;
+  if(changed == NULL || rect == NULL || d == NULL){
+    goto done;
+  }
+  // if too much turns out to have changed, we roll back what we've written
+  const uint64_t mark = f->used;
+  size_t changedpx = 0;
+  int runs = 0;
+  for(int ty = 0 ; ty < tilesy ; ++ty){
+    const int y = ty * cdimy;
+    const int rows = y + cdimy > leny ? leny - y : cdimy;
+    memset(changed, 0, sizeof(*changed) * tilesx);
+    for(int r = 0 ; r < rows ; ++r){
+      const uint32_t* cur = buf + (size_t)(y + r) * lenx;
+      const uint32_t* old = s->lastpx + (size_t)(y + r) * lenx;
+      for(int tx = 0 ; tx < tilesx ; ++tx){
+        const int x = tx * cdimx;
+        const int cols = x + cdimx > lenx ? lenx - x : cdimx;
+        if(!changed[tx] && memcmp(cur + x, old + x, cols * sizeof(*cur))){
+          changed[tx] = true;
+        }
+      }
+    }
+    for(int tx = 0 ; tx < tilesx ; ){
+      if(!changed[tx]){
+        ++tx;
+        continue;
+      }
+      const int x = tx * cdimx;
+      while(tx < tilesx && changed[tx]){
+        ++tx;
+      }
+      const int cols = (tx * cdimx > lenx ? lenx : tx * cdimx) - x;
+      for(int r = 0 ; r < rows ; ++r){
+        memcpy(rect + r * cols, buf + (size_t)(y + r) * lenx + x, cols * sizeof(*rect));
+      }
+      changedpx += rows * cols;
+      if(changedpx > (size_t)leny * lenx * KITTY_DELTA_MAXCHANGE){
+        f->used = mark;
+        ret = 1;
+        goto done;
+      }
+      const size_t blen = rows * cols * sizeof(*rect);
+      const size_t clen = blen >= KITTY_DELTA_MINDEFLATE &&
+                          kitty_worth_deflating(rect, rows * cols) ?
+                          kitty_deflate(d, rect, blen) : 0;
+      if(fbuf_printf(f, "\e_Ga=f,r=1,i=%d,x=%d,y=%d,s=%d,v=%d,X=1,q=2",
+                     s->id, x, y, cols, rows) < 0 ||
+         encode_and_chunkify(f, clen ? d->arena : (const unsigned char*)rect,
+                             clen ? clen : blen, clen != 0)){
+        goto done;
+      }
+      ++runs;
+    }
   }
-  free(cbuf);
+  loginfo("sending %d changed run%s (%" PRIuPTR "/%d px) of %u", runs,
+          runs == 1 ? "" : "s", changedpx, leny * lenx, s->id);
+  ret = 0;
+
+done:
+  if(d){
+    kitty_deflator_put(ke, d);
+  }
+  free(rect);
+  free(changed);
   return ret;
 }
 
+int kitty_init(tinfo* ti, int fd){
+  (void)fd;
+  kitty_engine* ke = malloc(sizeof(*ke));
+  if(ke == NULL){
+    return -1;
+  }
+  pthread_mutex_init(&ke->lock, NULL);
+  ke->idle = NULL;
+  // NOTCURSES_KITTY_THREADS counts threads beyond the calling one
+  ke->threads = ncthread_helpers("NOTCURSES_KITTY_THREADS",
+                                 KITTY_DEFLATE_MAXTHREADS - 1) + 1;
+  ti->kittyengine = ke;
+  return 0;
+}
+
+void kitty_cleanup(tinfo* ti){
+  // called before the image cache is destroyed, and before the tty is closed.
+  if(ti->imgcache && ti->ttyfd >= 0){
+    fbuf f;
+    if(fbuf_init_small(&f) == 0){
+      if(imgcache_purge(ti->imgcache, &f) == 0 && f.used){
+        blocking_write(ti->ttyfd, f.buf, f.used);
+      }
+      fbuf_free(&f);
+    }
+  }
+  kitty_engine* ke = ti->kittyengine;
+  if(ke){
+    kitty_deflator* d;
+    while( (d = ke->idle) ){
+      ke->idle = d->next;
+      kitty_deflator_destroy(d);
+    }
+    pthread_mutex_destroy(&ke->lock);
+    free(ke);
+    ti->kittyengine = NULL;
+  }
+}
+
+// kitty will only delete a t=t file if it lives in a known temporary
+// directory, and its name contains "tty-graphics-protocol". we prefer
+// /dev/shm, so that the transfer never touches a disk.
+int kitty_tempfile(char** path){
+#ifndef __MINGW32__
+  const char* dir = "/dev/shm";
+  if(access(dir, W_OK | X_OK)){
+    if((dir = getenv("TMPDIR")) == NULL || !*dir){
+      dir = "/tmp";
+    }
+  }
+  static const char tmpl[] = "/tty-graphics-protocol-XXXXXX";
+  size_t dlen = strlen(dir);
+  char* p = malloc(dlen + sizeof(tmpl));
+  if(p == NULL){
+    return -1;
+  }
+  memcpy(p, dir, dlen);
+  memcpy(p + dlen, tmpl, sizeof(tmpl));
+  int fd = mkstemp(p);
+  if(fd < 0){
+    logwarn("couldn't create %s (%s)", p, strerror(errno));
+    free(p);
+    return -1;
+  }
+  *path = p;
+  return fd;
+#else
+  (void)path;
+  return -1;
+#endif
+}
+
+// write all of |len| bytes from |buf| to |fd|, and close it.
+static int
+kitty_fill_tempfile(int fd, const void* buf, size_t len){
+  size_t written = 0;
+  while(written < len){
+    ssize_t w = write(fd, (const char*)buf + written, len - written);
+    if(w < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      logwarn("error writing %" PRIuPTR "B (%s)", len, strerror(errno));
+      close(fd);
+      return -1;
+    }
+    written += w;
+  }
+  return close(fd);
+}
+
+// write the base64-encoded |path| into |f|, and close the escape.
+static int
+kitty_put_path(fbuf* f, const char* path){
+  size_t plen = strlen(path);
+  if(fbuf_reserve(f, (plen + 2) / 3 * 4 + 2)){
+    return -1;
+  }
+  f->used += base64_encode((const unsigned char*)path, plen, f->buf + f->used);
+  return fbuf_putn(f, "\x1b\\", 2) < 0 ? -1 : 0;
+}
+
+// ask the terminal (via |f|) whether it can load graphics from our temporary
+// files. on success, the probe's path is written to |*path|.
+static int
+kitty_transport_query(fbuf* f, char** path){
+  int tfd = kitty_tempfile(path);
+  if(tfd < 0){
+    return -1;
+  }
+  // a single RGB pixel. i=2 distinguishes our reply from KITTYQUERY's.
+  static const unsigned char px[3] = { 0, 0, 0 };
+  if(kitty_fill_tempfile(tfd, px, sizeof(px)) == 0){
+    if(fbuf_printf(f, "\x1b_Gi=2,a=q,t=t,f=24,s=1,v=1;") >= 0 && kitty_put_path(f, *path) == 0){
+      return 0;
+    }
+  }
+  unlink(*path);
+  free(*path);
+  *path = NULL;
+  return -1;
+}
+
+void kitty_probe_reap(tinfo* ti){
+  if(ti->kittyprobe){
+    if(unlink(ti->kittyprobe) && errno != ENOENT){
+      logwarn("couldn't remove %s (%s)", ti->kittyprobe, strerror(errno));
+    }
+    free(ti->kittyprobe);
+    ti->kittyprobe = NULL;
+  }
+}
+
+// file transmission is probed for along with the first frame written to the
+// terminal containing an animated kitty bitmap, so that we only leave a file
+// lying around while it might be used. bitmaps are sent inline until the
+// probe has been answered.
+void kitty_probe_frame(tinfo* ti, fbuf* f){
+  if(!ti->kittyprobed){
+    ti->kittyprobed = true;
+    if(kitty_transport_query(f, &ti->kittyprobe)){
+      loginfo("couldn't send kitty file transmission query");
+    }
+  }else if(ti->kittyprobe){
+    const int reply = ti->kittyprobereply; // written by the input thread
+    if(reply){
+      if(reply > 0){
+        loginfo("kitty file transmission is available");
+        ti->kitty_tempfiles = true;
+      }
+      kitty_probe_reap(ti);
+    }
+  }
+}
+
+// write the raw pixels to a temporary file, and direct kitty there, rather
+// than encoding them inline. the terminal deletes the file once it has been
+// loaded, so a new one is used for each transmission. returns -1 (having
+// written nothing) if the file can't be set up, so the caller can fall back
+// to inline transmission.
+static int
+kitty_send_tempfile(sprixel* s, fbuf* f, const void* buf, size_t blen){
+  char* path;
+  int fd = kitty_tempfile(&path);
+  if(fd < 0){
+    return -1;
+  }
+  if(kitty_fill_tempfile(fd, buf, blen)){
+    unlink(path);
+    free(path);
+    return -1;
+  }
+  if(fbuf_printf(f, ",t=t,S=%" PRIuPTR ";", blen) < 0 || kitty_put_path(f, path)){
+    unlink(path);
+    free(path);
+    return -1;
+  }
+  s->transfile = path;
+  loginfo("sent %" PRIuPTR "B via %s", blen, path);
+  return 0;
+}
+
+// base64-encode |count| pixels staged by base64_stage_rgba3() into |f|, and
+// close the chunk.
+static int
+kitty_put_pixels(fbuf* f, const uint32_t* px, int count){
+  const size_t blen = count * sizeof(*px);
+  if(fbuf_reserve(f, (blen + 2) / 3 * 4 + 2)){
+    return -1;
+  }
+  f->used += base64_encode((const unsigned char*)px, blen, f->buf + f->used);
+  memcpy(f->buf + f->used, "\x1b\\", 2);
+  f->used += 2;
+  return 0;
+}
+
 // copy |encodeable| ([1..3]) pixels from |src| to the buffer |dst|, setting
 // alpha along the way according to |wipe|.
 static inline int
@@ -771,24 +1304,40 @@ write_kitty_data(fbuf* f, int linesize, int leny, int lenx, int cols,
   int x = 0;
   int targetout = 0; // number of pixels expected out after this chunk
 //fprintf(stderr, "total: %d chunks = %d, s=%d,v=%d\n", total, chunks, lenx, leny);
-  char out[17]; // three pixels base64 to no more than 17 bytes
+  uint32_t chunkpx[RGBA_MAXLEN]; // pixels staged for the current chunk
+  int chunkn = 0;
+  // a static bitmap is edited in place by wipes and restores, which find
+  // a cell's pixels via the offset of each chunk's payload.
+  unsigned* chunkoffs = NULL;
+  size_t payload = 0; // where the first chunk's payload starts within |f|
+  if(!animated){
+    if((chunkoffs = malloc(sizeof(*chunkoffs) * (chunks ? chunks : 1))) == NULL){
+      goto err;
+    }
+  }
+  int chunkno = 0;
   // set high if we are (1) reloading a frame with (2) annihilated cells copied over
   // from the TAM and (3) we are NCPIXEL_KITTY_SELFREF. calls finalize_multiframe_selfref().
   bool selfref_annihilated = false;
+  // if we've taken over our predecessor's image, we might only need to send
+  // what's changed, in which case there's no a=t header.
+  const bool delta = animated && !s->cached && s->lastpx &&
+                     s->lastpxy == leny && s->lastpxx == lenx;
   while(chunks--){
     // q=2 has been able to go on chunks other than the last chunk since
     // 2021-03, but there's no harm in this small bit of backwards compat.
-    if(totalout == 0){
+    if(totalout == 0 && !delta){
       // older versions of kitty will delete uploaded images when scrolling,
       // alas. see https://github.com/dankamongmen/notcurses/issues/1910 =[.
       // parse_start isn't used in animation mode, so no worries about the
       // fact that this doesn't complete the header in that case.
-      *parse_start = fbuf_printf(f, "\e_Gf=32,s=%d,v=%d,i=%d,p=1,a=t,%s",
-                                 lenx, leny, s->id,
+      *parse_start = fbuf_printf(f, "\e_Gf=32,s=%d,v=%d,i=%u,p=1,a=t,%s",
+                                 lenx, leny, kitty_image_id(s),
                                  animated ? "q=2" : chunks ? "m=1;" : "q=2;");
       if(*parse_start < 0){
         goto err;
       }
+      payload = f->used;
       // so if we're animated, we've printed q=2, but no semicolon to close
       // the control block, since we're not yet sure what m= to write. we've
       // otherwise written q=2; if we're the only chunk, and m=1; otherwise.
@@ -910,29 +1459,60 @@ write_kitty_data(fbuf* f, int linesize, int leny, int lenx, int cols,
       }else{
         // we already took transcolor to alpha 0; there's no need to
         // check it again, so pass 0.
-        base64_rgba3(source, encodeable, out, wipe, 0);
-        if(fbuf_puts(f, out) < 0){
-          goto err;
-        }
+        base64_stage_rgba3(chunkpx + chunkn, source, encodeable, wipe, 0);
+        chunkn += encodeable;
       }
     }
     if(!animated){
-      if(fbuf_putn(f, "\x1b\\", 2) < 0){
+      chunkoffs[chunkno++] = f->used - payload;
+      if(kitty_put_pixels(f, chunkpx, chunkn)){
         goto err;
       }
+      chunkn = 0;
     }
   }
+  if(!animated){
+    free(s->chunkoffs);
+    s->chunkoffs = chunkoffs;
+    chunkoffs = NULL;
+  }
   // we only deflate if we're using animation, since otherwise we need be able
   // to edit the encoded bitmap in-place for wipes/restores.
   if(animated){
-    if(deflate_buf(buf, f, leny, lenx)){
+    // when the terminal shares our filesystem, hand it the uncompressed
+    // pixels via a temporary file; it's cheaper than deflating them.
+    const tinfo* ti = ncplane_pile(s->n) ? &ncplane_notcurses_const(s->n)->tcache : NULL;
+    kitty_engine* ke = ti ? ti->kittyengine : NULL;
+    int dret = delta ? kitty_send_delta(ke, s, f, buf, leny, lenx, cdimy, cdimx) : 1;
+    if(dret < 0){
       goto err;
+    }else if(dret > 0){
+      if(delta){ // too much changed; replace the image wholesale
+        if(fbuf_printf(f, "\e_Gf=32,s=%d,v=%d,i=%d,p=1,a=t,q=2", lenx, leny, s->id) < 0){
+          goto err;
+        }
+      }
+      if(!ti || !ti->kitty_tempfiles || s->transfile ||
+         kitty_send_tempfile(s, f, buf, (size_t)leny * lenx * 4)){
+        if(deflate_buf(ke, s, buf, f, leny, lenx)){
+          goto err;
+        }
+      }
     }
     if(selfref_annihilated){
       if(finalize_multiframe_selfref(s, f)){
         goto err;
       }
     }
+    // a reblitted sprixel keeps what it sent, for its own successor (unless
+    // it sent a cached image, which its successor mustn't modify).
+    if(s->keeppx && !s->cached){
+      free(s->lastpx);
+      s->lastpx = buf;
+      s->lastpxy = leny;
+      s->lastpxx = lenx;
+      buf = NULL;
+    }
   }
   scrub_tam_boundaries(tam, leny, lenx, cdimy, cdimx);
   free(buf);
@@ -941,6 +1521,7 @@ write_kitty_data(fbuf* f, int linesize, int leny, int lenx, int cols,
 err:
   logerror("failed blitting kitty graphics");
   cleanup_tam(tam, (leny + cdimy - 1) / cdimy, (lenx + cdimx - 1) / cdimx);
+  free(chunkoffs);
   free(buf);
   return -1;
 }
@@ -959,6 +1540,7 @@ int kitty_rebuild_selfref(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
   const int xlen = xstart + cellpxx > s->pixx ? s->pixx - xstart : cellpxx;
   const int ylen = ystart + cellpxy > s->pixy ? s->pixy - ystart : cellpxy;
   logdebug("rematerializing %u at %d/%d (%dx%d)", s->id, ycell, xcell, ylen, xlen);
+  s->wiped = true;
   fbuf_printf(f, "\e_Ga=c,x=%d,y=%d,X=%d,Y=%d,w=%d,h=%d,i=%d,r=1,c=2,q=2;\x1b\\",
               xcell * cellpxx, ycell * cellpxy,
               xcell * cellpxx, ycell * cellpxy,
@@ -974,6 +1556,7 @@ int kitty_rebuild_animation(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
   if(init_sprixel_animation(s)){
     return -1;
   }
+  s->wiped = true;
   fbuf* f = &s->glyph;
   const int cellpxy = ncplane_pile(s->n)->cellpxy;
   const int cellpxx = ncplane_pile(s->n)->cellpxx;
@@ -992,7 +1575,9 @@ int kitty_rebuild_animation(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
 //fprintf(stderr, "total: %d chunks = %d, s=%d,v=%d\n", total, chunks, lenx, leny);
   // FIXME this ought be factored out and shared with write_kitty_data()
   logdebug("placing %d/%d at %d/%d", ylen, xlen, ycell * cellpxy, xcell * cellpxx);
+  uint32_t chunkpx[RGBA_MAXLEN]; // pixels staged for the current chunk
   while(chunks--){
+    int chunkn = 0;
     if(totalout == 0){
       const int c = kitty_anim_auxvec_blitsource_p(s, auxvec) ? 2 : 1;
       const int r = kitty_anim_auxvec_blitsource_p(s, auxvec) ? 1 : 2;
@@ -1056,13 +1641,10 @@ int kitty_rebuild_animation(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
         ++x;
       }
       totalout += encodeable;
-      char out[17];
-      base64_rgba3(source, encodeable, out, wipe, 0);
-      if(fbuf_puts(f, out) < 0){
-        return -1;
-      }
+      base64_stage_rgba3(chunkpx + chunkn, source, encodeable, wipe, 0);
+      chunkn += encodeable;
     }
-    if(fbuf_putn(f, "\x1b\\", 2) < 0){
+    if(kitty_put_pixels(f, chunkpx, chunkn)){
       return -1;
     }
   }
@@ -1072,6 +1654,129 @@ int kitty_rebuild_animation(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
 }
 #undef RGBA_MAXLEN
 
+// a sprixel placing a cached image needs an image of its own before its
+// cells can be wiped. we rebuild one from the cached pixels under our own id,
+// deleting our placement of the cached image when it's drawn.
+static int
+kitty_unshare(sprixel* s){
+  imgentry* e = s->cached;
+  // if the cached image is yet to be sent, we hold the only transmission of
+  // it, and nobody else can be placing it. take it as our own image, rather
+  // than encoding those same pixels again.
+  if(!e->loaded){
+    loginfo("sprixel %u adopts unsent image %u", s->id, e->imageid);
+    s->id = e->imageid;
+    s->cached = NULL;
+    imgcache_release(e);
+    return 0;
+  }
+  const ncpixelimpl_e level = ncplane_notcurses_const(s->n)->tcache.pixel_implementation;
+  blitterargs bargs;
+  memset(&bargs, 0, sizeof(bargs));
+  bargs.flags = e->key.flags;
+  bargs.transcolor = e->key.transcolor;
+  bargs.u.pixel.spx = s;
+  bargs.u.pixel.cellpxy = e->key.cellpxy;
+  bargs.u.pixel.cellpxx = e->key.cellpxx;
+  bargs.u.pixel.pxoffy = e->key.pxoffy;
+  bargs.u.pixel.pxoffx = e->key.pxoffx;
+  fbuf f;
+  if(fbuf_init(&f)){
+    return -1;
+  }
+  int prefix = fbuf_printf(&f, "\e_Ga=d,d=i,i=%u,p=%u,q=2\e\\", e->imageid, s->id);
+  if(prefix < 0){
+    fbuf_free(&f);
+    return -1;
+  }
+  // an undrawn glyph's temporary file is of no further use
+  if(s->transfile){
+    unlink(s->transfile);
+    free(s->transfile);
+    s->transfile = NULL;
+  }
+  // the key of a media frame holds its source geometry, not that of the
+  // scaled pixels we kept.
+  const int leny = e->pixy - e->key.pxoffy;
+  const int lenx = e->pixx - e->key.pxoffx;
+  int parse_start = 0;
+  s->cached = NULL;
+  if(write_kitty_data(&f, lenx * 4, leny, lenx, s->dimx,
+                      e->rgba, &bargs, s->n->tam, &parse_start, level)){
+    s->cached = e;
+    fbuf_free(&f);
+    return -1;
+  }
+  loginfo("sprixel %u leaves cached image %u", s->id, e->imageid);
+  imgcache_release(e);
+  fbuf_free(&s->glyph);
+  memcpy(&s->glyph, &f, sizeof(f));
+  fbuf_trim(&s->glyph, FBUF_SMALL_SIZE);
+  s->parse_start = prefix + parse_start;
+  s->animating = level != NCPIXEL_KITTY_STATIC;
+  s->invalidated = SPRIXEL_INVALIDATED;
+  return 0;
+}
+
+// |e| is already loaded; we need only place it. the TAM it produced is
+// taken as our own (there are no annihilated cells, or we wouldn't be here).
+static int
+kitty_blit_cached(ncplane* n, sprixel* s, imgentry* e, ncpixelimpl_e level){
+  cleanup_tam(n->tam, s->dimy, s->dimx);
+  for(unsigned i = 0 ; i < s->dimy * s->dimx ; ++i){
+    n->tam[i].state = e->states[i];
+  }
+  s->cached = e;
+  // an image taken over from our predecessor is no longer wanted
+  if(s->lastpx){
+    if(kitty_remove(s->id, &s->glyph)){
+      goto error;
+    }
+    free(s->lastpx);
+    s->lastpx = NULL;
+  }
+  if(level == NCPIXEL_KITTY_STATIC){
+    s->animating = false;
+  }
+  if(plane_blit_sixel(s, &s->glyph, e->pixy, e->pixx, 0, n->tam, SPRIXEL_UNSEEN) < 0){
+    goto error;
+  }
+  s->pxoffy = e->key.pxoffy;
+  s->pxoffx = e->key.pxoffx;
+  loginfo("sprixel %u places cached image %u", s->id, e->imageid);
+  return 1;
+
+error:
+  s->cached = NULL;
+  imgcache_release(e);
+  fbuf_free(&s->glyph);
+  return -1;
+}
+
+// prepare an entry for the image we're about to send, to be added to the
+// cache once it's been written. the entry keeps a copy of the pixels, which
+// lookups are checked against, and from which sprixels placing the image can
+// build their own if need be. a media frame's are kept at their scaled
+// geometry rather than that of its key.
+static imgentry*
+kitty_cache_entry(struct imgcache* ic, const imgkey* key, const void* data,
+                  int linesize, int leny, int lenx){
+  imgentry* e = imgentry_create(ic, key);
+  if(e == NULL){
+    return NULL;
+  }
+  const size_t linelen = lenx * sizeof(*e->rgba);
+  if((e->rgba = malloc(linelen * leny)) == NULL){
+    imgentry_destroy(e);
+    return NULL;
+  }
+  for(int y = 0 ; y < leny ; ++y){
+    memcpy((char*)e->rgba + linelen * y, (const char*)data + linesize * y, linelen);
+  }
+  e->bytes = linelen * leny;
+  return e;
+}
+
 // Kitty graphics blitter. Kitty can take in up to 4KiB at a time of (optionally
 // deflate-compressed) 24bit RGB. Returns -1 on error, 1 on success.
 static inline int
@@ -1082,14 +1787,54 @@ kitty_blit_core(ncplane* n, int linesize, const void* data, int leny, int lenx,
   if(init_sprixel_animation(s)){
     return -1;
   }
+  // the pixels might already be loaded, or they might have been blitted
+  // recently enough that we ought cache them this time.
+  struct imgcache* ic = imgcache_for(s);
+  imgentry* e = NULL;
+  if(ic){
+    imgkey key;
+    bool admit;
+    imgkey_init(&key, data, linesize, 0, 0, leny, lenx, bargs);
+    if( (e = imgcache_get(ic, &key, data, linesize, &admit)) ){
+      return kitty_blit_cached(n, s, e, level);
+    }
+    if(admit){
+      e = kitty_cache_entry(ic, &key, data, linesize, leny, lenx);
+    }
+  }
   int parse_start = 0;
   fbuf* f = &s->glyph;
   int pxoffx = bargs->u.pixel.pxoffx;
   int pxoffy = bargs->u.pixel.pxoffy;
+  if( (s->cached = e) ){
+    // we load the cached image rather than our own, so any image taken
+    // over from our predecessor is no longer wanted.
+    if(s->lastpx){
+      if(kitty_remove(s->id, f)){
+        goto error;
+      }
+      free(s->lastpx);
+      s->lastpx = NULL;
+    }
+  }
   if(write_kitty_data(f, linesize, leny, lenx, cols, data,
                       bargs, n->tam, &parse_start, level)){
     goto error;
   }
+  if(e){
+    const size_t tamlen = sizeof(*e->states) * s->dimy * s->dimx;
+    if((e->states = malloc(tamlen)) == NULL){
+      goto error;
+    }
+    for(unsigned i = 0 ; i < s->dimy * s->dimx ; ++i){
+      e->states[i] = n->tam[i].state;
+    }
+    e->bytes += tamlen;
+    e->pixy = leny + pxoffy;
+    e->pixx = lenx + pxoffx;
+    imgcache_insert(ic, e);
+    e = NULL; // s->cached now holds our reference
+  }
   // FIXME need set pxoffx and pxoffy in sprixel
   if(level == NCPIXEL_KITTY_STATIC){
     s->animating = false;
@@ -1106,6 +1851,18 @@ kitty_blit_core(ncplane* n, int linesize, const void* data, int leny, int lenx,
 error:
   cleanup_tam(n->tam, bargs->u.pixel.spx->dimy, bargs->u.pixel.spx->dimx);
   fbuf_free(&s->glyph);
+  if(s->transfile){
+    unlink(s->transfile);
+    free(s->transfile);
+    s->transfile = NULL;
+  }
+  if(e){ // never added to the cache
+    s->cached = NULL;
+    imgentry_destroy(e);
+  }else if(s->cached){
+    imgcache_release(s->cached);
+    s->cached = NULL;
+  }
   return -1;
 }
 
@@ -1127,7 +1884,18 @@ int kitty_blit_selfref(ncplane* n, int linesize, const void* data,
                          NCPIXEL_KITTY_SELFREF);
 }
 
+int kitty_unplace(const sprixel* s, fbuf* f){
+  loginfo("removing placement %u of graphic %u", s->id, s->cached->imageid);
+  if(fbuf_printf(f, "\e_Ga=d,d=i,i=%u,p=%u,q=2\e\\", s->cached->imageid, s->id) < 0){
+    return -1;
+  }
+  return 0;
+}
+
 int kitty_remove(int id, fbuf* f){
+  if(id == 0){ // the image was taken over by a successor in kitty_recycle()
+    return 0;
+  }
   loginfo("removing graphic %u", id);
   if(fbuf_printf(f, "\e_Ga=d,d=I,i=%d\e\\", id) < 0){
     return -1;
@@ -1169,23 +1937,40 @@ int kitty_scrub(const ncpile* p, sprixel* s){
 // returns the number of bytes written
 int kitty_draw(const tinfo* ti, const ncpile* p, sprixel* s, fbuf* f,
                int yoff, int xoff){
-  (void)ti;
   (void)p;
   bool animated = false;
   if(s->animating){ // active animation
     s->animating = false;
     animated = true;
   }
+  // images evicted from the cache go before any are loaded
+  if(ti->imgcache && imgcache_flush(ti->imgcache, f)){
+    return -1;
+  }
+  // a cached image is loaded only once; it's never edited, nor resent.
+  const bool dropglyph = animated || s->cached;
   int ret = s->glyph.used;
   logdebug("dumping %" PRIu64 "b for %u at %d %d", s->glyph.used, s->id, yoff, xoff);
   if(ret){
-    if(fbuf_putn(f, s->glyph.buf, s->glyph.used) < 0){
+    // a glyph freed below must be copied
+    if(dropglyph){
+      if(fbuf_putn(f, s->glyph.buf, s->glyph.used) < 0){
+        ret = -1;
+      }
+    }else if(fbuf_splice(f, s->glyph.buf, s->glyph.used) < 0){
       ret = -1;
     }
   }
-  if(animated){
+  if(dropglyph){
     fbuf_free(&s->glyph);
   }
+  if(ret >= 0 && s->cached){
+    imgcache_loaded(s->cached);
+  }
+  if(ret >= 0 && s->transfile){ // the terminal will delete it once loaded
+    free(s->transfile);
+    s->transfile = NULL;
+  }
   s->invalidated = SPRIXEL_LOADED;
   return ret;
 }
@@ -1198,8 +1983,8 @@ int kitty_move(sprixel* s, fbuf* f, unsigned noscroll, int yoff, int xoff){
   int ret = 0;
   if(goto_location(ncplane_notcurses(s->n), f, targy + yoff, targx + xoff, s->n)){
     ret = -1;
-  }else if(fbuf_printf(f, "\e_Ga=p,i=%d,p=1,q=2%s\e\\", s->id,
-                       noscroll ? ",C=1" : "") < 0){
+  }else if(fbuf_printf(f, "\e_Ga=p,i=%u,p=%u,q=2%s\e\\", kitty_image_id(s),
+                       kitty_placement_id(s), noscroll ? ",C=1" : "") < 0){
     ret = -1;
   }
   s->invalidated = SPRIXEL_QUIESCENT;
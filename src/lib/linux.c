@@ -122,6 +122,63 @@ int fbcon_scrub(const struct ncpile* p, sprixel* s){
 #include <linux/kd.h>
 #include <sys/ioctl.h>
 
+// as in base64.h, on x86 we select SSE2 or AVX2 at runtime. AArch64 always
+// has NEON.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NCFBCON_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON) && defined(__ORDER_LITTLE_ENDIAN__) && \
+      __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define NCFBCON_NEON
+#endif
+
+// with page flipping, the console's page is followed by two into which we
+// compose. linux_fb_rows[] has a bit (1 << page) set for each of these which
+// has yet to copy that pixel row from the console's page, and FBROW_COPIED
+// set if the page being composed has just copied it.
+#define FBCON_FLIP_PAGES 3
+#define FBROW_COPIED 0x1u
+#define FBROW_STALE 0x6u
+
+static inline int
+fbcon_rows(const tinfo* ti){
+  return ti->linux_fb_pagelen / ti->linux_fb_stride;
+}
+
+// the console has written to pixel rows [y, y + rows).
+static void
+fbcon_stale_rows(tinfo* ti, int y, int rows){
+  if(ti->linux_fb_pages < FBCON_FLIP_PAGES){
+    return;
+  }
+  if(y < 0){
+    rows += y;
+    y = 0;
+  }
+  if(y + rows > fbcon_rows(ti)){
+    rows = fbcon_rows(ti) - y;
+  }
+  for(int r = y ; r < y + rows ; ++r){
+    ti->linux_fb_rows[r] |= FBROW_STALE;
+  }
+}
+
+// were any of pixel rows [y, y + rows) just copied into the page we're
+// composing, overwriting whatever graphics we'd drawn there?
+static bool
+fbcon_rows_copied(const tinfo* ti, int y, int rows){
+  if(ti->linux_fb_page == 0){
+    return false;
+  }
+  for(int r = y ; r < y + rows ; ++r){
+    if(ti->linux_fb_rows[r] & FBROW_COPIED){
+      return true;
+    }
+  }
+  return false;
+}
+
 int fbcon_rebuild(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
   if(auxvec == NULL){
     return -1;
@@ -161,28 +218,366 @@ int fbcon_rebuild(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
   return 1;
 }
 
+// a glyph pixel (BGRA) is drawn iff its alpha is at least 192 (see
+// rgba_trans_p()), i.e. iff both of alpha's high bits are set.
+static inline bool
+fbcon_opaque_p(const uint8_t* px){
+  return (px[3] & 0xc0) == 0xc0;
+}
+
+#ifdef NCFBCON_X86
+// returns the number of leading pixels of |px| (at most |n|) whose opacity
+// matches |opaque|, testing the alphas of four pixels at a time. the result
+// is exact only where it is less than |n| - |n| % 4.
+__attribute__ ((target("sse2")))
+static inline int
+fbcon_run_sse2(const uint8_t* px, int n, bool opaque){
+  const __m128i mask = _mm_set1_epi32((int)0xc0000000u);
+  const int want = opaque ? 0xf : 0;
+  int i = 0;
+  while(n - i >= 4){
+    const __m128i v = _mm_loadu_si128((const __m128i*)(px + i * 4));
+    const __m128i m = _mm_cmpeq_epi32(_mm_and_si128(v, mask), mask);
+    const int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+    if(bits != want){
+      return i + __builtin_ctz(bits ^ want);
+    }
+    i += 4;
+  }
+  return i;
+}
+
+// the same, eight pixels at a time
+__attribute__ ((target("avx2")))
+static inline int
+fbcon_run_avx2(const uint8_t* px, int n, bool opaque){
+  const __m256i mask = _mm256_set1_epi32((int)0xc0000000u);
+  const int want = opaque ? 0xff : 0;
+  int i = 0;
+  while(n - i >= 8){
+    const __m256i v = _mm256_loadu_si256((const __m256i*)(px + i * 4));
+    const __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(v, mask), mask);
+    const int bits = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+    if(bits != want){
+      return i + __builtin_ctz(bits ^ want);
+    }
+    i += 8;
+  }
+  return i + fbcon_run_sse2(px + i * 4, n - i, opaque);
+}
+#endif
+
+#ifdef NCFBCON_NEON
+// stops at the first group of four containing a mismatch, leaving it to be
+// resolved by fbcon_run().
+static inline int
+fbcon_run_neon(const uint8_t* px, int n, bool opaque){
+  const uint32x4_t mask = vdupq_n_u32(0xc0000000u);
+  const uint32x4_t want = vdupq_n_u32(opaque ? 0xffffffffu : 0);
+  int i = 0;
+  while(n - i >= 4){
+    const uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(px + i * 4));
+    const uint32x4_t m = vceqq_u32(vandq_u32(v, mask), mask);
+    if(vmaxvq_u32(veorq_u32(m, want))){
+      break;
+    }
+    i += 4;
+  }
+  return i;
+}
+#endif
+
+// returns the length of the run of pixels at the start of |px| (at most |n|)
+// which are all opaque, or all transparent, according to |opaque|.
+static inline int
+fbcon_run(const uint8_t* px, int n, bool opaque){
+  int i = 0;
+#ifdef NCFBCON_X86
+  if(__builtin_cpu_supports("avx2")){
+    i = fbcon_run_avx2(px, n, opaque);
+  }else if(__builtin_cpu_supports("sse2")){
+    i = fbcon_run_sse2(px, n, opaque);
+  }
+#elif defined(NCFBCON_NEON)
+  i = fbcon_run_neon(px, n, opaque);
+#endif
+  while(i < n && fbcon_opaque_p(px + i * 4) == opaque){
+    ++i;
+  }
+  return i;
+}
+
+// convert |n| BGRA glyph pixels to the framebuffer's format. framebuffer
+// pixels are little-endian, and at most 32 bits.
+static void
+fbcon_pack(const tinfo* ti, uint8_t* dst, const uint8_t* src, int n){
+  const unsigned bpp = ti->linux_fb_bpp;
+  for(int i = 0 ; i < n ; ++i){
+    uint32_t v = 0;
+    for(int c = 0 ; c < 3 ; ++c){ // red, green, and blue are src[2..0]
+      v |= (uint32_t)(src[2 - c] >> (8 - ti->linux_fb_bits[c])) << ti->linux_fb_shifts[c];
+    }
+    for(unsigned b = 0 ; b < bpp ; ++b){
+      dst[b] = v >> (b * 8);
+    }
+    dst += bpp;
+    src += 4;
+  }
+}
+
+// write the opaque pixels among |n| glyph pixels at |src| to the framebuffer
+// at |dst|. each run of opaque pixels is written in one go. returns the
+// number of bytes written.
+static int
+fbcon_draw_span(const tinfo* ti, uint8_t* dst, const uint8_t* src, int n){
+  const unsigned bpp = ti->linux_fb_bpp;
+  int wrote = 0;
+  int i = 0;
+  while(i < n){
+    i += fbcon_run(src + i * 4, n - i, false);
+    if(i == n){
+      break;
+    }
+    const int run = fbcon_run(src + i * 4, n - i, true);
+    if(ti->linux_fb_native){
+      memcpy(dst + i * 4, src + i * 4, run * 4);
+    }else{
+      fbcon_pack(ti, dst + i * bpp, src + i * 4, run);
+    }
+    wrote += run * bpp;
+    i += run;
+  }
+  return wrote;
+}
+
+// can we get away with drawing only the damaged cells of |s|? only if we
+// drew it last at this position and geometry, since which time nothing's
+// moved the framebuffer about, and no other bitmap overlaps it (one
+// beneath might have been redrawn atop us).
+static bool
+fbcon_damage_only(const tinfo* ti, const ncpile* p, const sprixel* s,
+                  int y, int x){
+  const fbdrawn* d = s->drawn;
+  if(d == NULL || s->invalidated == SPRIXEL_UNSEEN){
+    return false;
+  }
+  if(d->y != y || d->x != x || d->pixy != s->pixy || d->pixx != s->pixx ||
+     d->dimy != s->dimy || d->dimx != s->dimx ||
+     d->generation != ti->linux_fb_gen){
+    return false;
+  }
+  if(p){
+    for(const sprixel* o = p->sprixelcache ; o ; o = o->next){
+      if(o == s || o->n == NULL){
+        continue;
+      }
+      if(o->n->absy < s->n->absy + (int)s->dimy && s->n->absy < o->n->absy + (int)o->dimy &&
+         o->n->absx < s->n->absx + (int)s->dimx && s->n->absx < o->n->absx + (int)o->dimx){
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// prepare s->drawn to record a complete draw at |y|/|x|. on failure, we
+// simply draw everything next time, too.
+static void
+fbcon_remember(const tinfo* ti, sprixel* s, int y, int x){
+  fbdrawn* d = s->drawn;
+  const size_t pxbytes = (size_t)s->pixy * s->pixx * 4;
+  const size_t cells = (size_t)s->dimy * s->dimx;
+  if(d == NULL || d->pixy != s->pixy || d->pixx != s->pixx ||
+     d->dimy != s->dimy || d->dimx != s->dimx){
+    free(s->drawn);
+    if((s->drawn = d = malloc(sizeof(*d) + pxbytes + cells)) == NULL){
+      return;
+    }
+    d->pixy = s->pixy;
+    d->pixx = s->pixx;
+    d->dimy = s->dimy;
+    d->dimx = s->dimx;
+    d->damage = (unsigned char*)d->px + pxbytes;
+  }
+  d->y = y;
+  d->x = x;
+  d->generation = ti->linux_fb_gen;
+  memcpy(d->px, s->glyph.buf, pxbytes);
+  memset(d->damage, ti->linux_fb_page != 0, cells);
+}
+
+// draw those cells of |s| which differ from what we last drew, which had
+// text written atop them, or whose rows were just copied from the console's
+// page. adjacent damaged cells are drawn together. damage counts the pages
+// still needing the cell: when flipping, a changed cell must be drawn into
+// both of those we compose (see fbcon_compose()).
+static int
+fbcon_draw_damage(const tinfo* ti, sprixel* s, uint8_t* fb, int fby, int leny,
+                  int lenx, int cellpxy, int cellpxx){
+  const size_t stride = ti->linux_fb_stride;
+  const unsigned bpp = ti->linux_fb_bpp;
+  const uint8_t* glyph = (const uint8_t*)s->glyph.buf;
+  fbdrawn* d = s->drawn;
+  uint8_t* drawn = (uint8_t*)d->px;
+  const unsigned char fresh = ti->linux_fb_page ? 2 : 1;
+  int wrote = 0;
+  for(int cy = 0 ; cy * cellpxy < leny ; ++cy){
+    const int rows = leny - cy * cellpxy < cellpxy ? leny - cy * cellpxy : cellpxy;
+    unsigned char* damage = d->damage + cy * d->dimx;
+    const bool copied = fbcon_rows_copied(ti, fby + cy * cellpxy, rows);
+    for(int cx = 0 ; cx * cellpxx < lenx ; ++cx){
+      if(damage[cx] == fresh){
+        continue;
+      }
+      // a cell yet to be drawn into the other page might have changed again
+      const int cols = lenx - cx * cellpxx < cellpxx ? lenx - cx * cellpxx : cellpxx;
+      for(int l = 0 ; l < rows ; ++l){
+        const size_t off = ((size_t)(cy * cellpxy + l) * s->pixx + cx * cellpxx) * 4;
+        if(memcmp(glyph + off, drawn + off, cols * 4)){
+          damage[cx] = fresh;
+          break;
+        }
+      }
+      if(copied && !damage[cx]){
+        damage[cx] = 1;
+      }
+    }
+    int cx = 0;
+    while(cx * cellpxx < lenx){
+      if(!damage[cx]){
+        ++cx;
+        continue;
+      }
+      int ex = cx;
+      while(ex * cellpxx < lenx && damage[ex]){
+        --damage[ex++];
+      }
+      const int px = cx * cellpxx;
+      const int pxlen = (ex * cellpxx < lenx ? ex * cellpxx : lenx) - px;
+      for(int l = 0 ; l < rows ; ++l){
+        const int py = cy * cellpxy + l;
+        const size_t off = ((size_t)py * s->pixx + px) * 4;
+        wrote += fbcon_draw_span(ti, fb + py * stride + px * bpp, glyph + off, pxlen);
+        memcpy(drawn + off, glyph + off, pxlen * 4);
+      }
+      cx = ex;
+    }
+  }
+  return wrote;
+}
+
 int fbcon_draw(const tinfo* ti, sprixel* s, int y, int x){
   logdebug("id %" PRIu32 " dest %d/%d", s->id, y, x);
+  const ncpile* p = ncplane_pile(s->n);
+  const int cellpxy = p ? p->cellpxy : ti->cellpxy;
+  const int cellpxx = p ? p->cellpxx : ti->cellpxx;
+  // clip to the visible framebuffer
+  const int fby = y * cellpxy;
+  const int fbx = x * cellpxx;
+  if(fby < 0 || fbx < 0){
+    return 0;
+  }
+  int leny = s->pixy;
+  int lenx = s->pixx;
+  if(fby + leny > (int)ti->pixy){
+    leny = ti->pixy - fby;
+  }
+  if(fbx + lenx > (int)ti->pixx){
+    lenx = ti->pixx - fbx;
+  }
+  if(leny <= 0 || lenx <= 0){
+    return 0;
+  }
+  const size_t stride = ti->linux_fb_stride;
+  uint8_t* fb = ti->linux_fbuffer + ti->linux_fb_page * ti->linux_fb_pagelen +
+                fby * stride + fbx * ti->linux_fb_bpp;
+  if(fbcon_damage_only(ti, p, s, y, x)){
+    return fbcon_draw_damage(ti, s, fb, fby, leny, lenx, cellpxy, cellpxx);
+  }
   int wrote = 0;
-  const int cellpxy = ncplane_pile(s->n) ? ncplane_pile(s->n)->cellpxy : ti->cellpxy;
-  const int cellpxx = ncplane_pile(s->n) ? ncplane_pile(s->n)->cellpxx : ti->cellpxx;
-  for(unsigned l = 0 ; l < (unsigned)s->pixy && l + y * cellpxy < ti->pixy ; ++l){
-    // FIXME pixel size isn't necessarily 4B, line isn't necessarily psize*pixx
-    size_t offset = ((l + y * cellpxy) * ti->pixx + x * cellpxx) * 4;
-    uint8_t* tl = ti->linux_fbuffer + offset;
-    const char* src = (char*)s->glyph.buf + (l * s->pixx * 4);
-    for(unsigned c = 0 ; c < (unsigned)s->pixx && c < ti->pixx ; ++c){
-      uint32_t pixel;
-      memcpy(&pixel, src, 4);
-      if(!rgba_trans_p(pixel, 0)){
-        memcpy(tl, &pixel, 4);
-        wrote += 4;
+  const uint8_t* glyph = (const uint8_t*)s->glyph.buf;
+  for(int l = 0 ; l < leny ; ++l){
+    wrote += fbcon_draw_span(ti, fb + l * stride, glyph + (size_t)l * s->pixx * 4, lenx);
+  }
+  fbcon_remember(ti, s, y, x);
+  return wrote;
+}
+
+// with page flipping, we compose into whichever of the second and third
+// pages isn't displayed. the console writes its text only into the first, so
+// we first copy those rows it has written since this page was last composed.
+// graphics there are redrawn by fbcon_draw(), along with those cells which
+// changed since either page was composed. with no bitmaps, we go back to the
+// first page, and needn't compose at all.
+void fbcon_compose(tinfo* ti, bool any){
+  if(ti->linux_fb_pages < FBCON_FLIP_PAGES || !any){
+    ti->linux_fb_page = 0;
+    return;
+  }
+  ti->linux_fb_page = ti->linux_fb_shown == 1 ? 2 : 1;
+  const uint8_t stale = 1u << ti->linux_fb_page;
+  const size_t stride = ti->linux_fb_stride;
+  uint8_t* page = ti->linux_fbuffer + ti->linux_fb_page * ti->linux_fb_pagelen;
+  const int rows = fbcon_rows(ti);
+  size_t copied = 0;
+  int run = -1; // first row of the run being copied, if any
+  for(int r = 0 ; r <= rows ; ++r){
+    if(r < rows && (ti->linux_fb_rows[r] & stale)){
+      ti->linux_fb_rows[r] = (ti->linux_fb_rows[r] & ~stale) | FBROW_COPIED;
+      if(run < 0){
+        run = r;
       }
-      src += 4;
-      tl += 4;
+      continue;
+    }
+    if(r < rows){
+      ti->linux_fb_rows[r] &= ~FBROW_COPIED;
+    }
+    if(run >= 0){
+      memcpy(page + run * stride, ti->linux_fbuffer + run * stride, (r - run) * stride);
+      copied += r - run;
+      run = -1;
     }
   }
-  return wrote;
+  logdebug("composing page %u, copied %zu/%d rows", ti->linux_fb_page, copied, rows);
+}
+
+// display the page we composed, if it isn't already displayed.
+int fbcon_present(tinfo* ti){
+  if(ti->linux_fb_page == ti->linux_fb_shown){
+    return 0;
+  }
+  struct fb_var_screeninfo fbi = {0};
+  if(ioctl(ti->linux_fb_fd, FBIOGET_VSCREENINFO, &fbi)){
+    logerror("no framebuffer info from %s (%s?)", ti->linux_fb_dev, strerror(errno));
+    return -1;
+  }
+  fbi.xoffset = 0;
+  fbi.yoffset = ti->linux_fb_page * fbi.yres;
+  if(ioctl(ti->linux_fb_fd, FBIOPAN_DISPLAY, &fbi)){
+    logerror("couldn't pan %s to %u (%s?)", ti->linux_fb_dev, fbi.yoffset, strerror(errno));
+    return -1;
+  }
+  ti->linux_fb_shown = ti->linux_fb_page;
+  return 0;
+}
+
+// go back to the console's page, and restore the virtual height we found.
+void fbcon_cleanup(tinfo* ti){
+  if(ti->linux_fb_pages == FBCON_FLIP_PAGES){
+    ti->linux_fb_page = 0;
+    fbcon_present(ti);
+  }
+  if(ti->linux_fb_yvirt){
+    struct fb_var_screeninfo fbi = {0};
+    if(ioctl(ti->linux_fb_fd, FBIOGET_VSCREENINFO, &fbi) == 0){
+      fbi.yres_virtual = ti->linux_fb_yvirt;
+      fbi.yoffset = 0;
+      if(ioctl(ti->linux_fb_fd, FBIOPUT_VSCREENINFO, &fbi)){
+        logwarn("couldn't restore virtual height of %s (%s?)", ti->linux_fb_dev, strerror(errno));
+      }
+    }
+    ti->linux_fb_yvirt = 0;
+  }
 }
 
 // we have some number of (cell) rows we want to scroll. scale by cell height,
@@ -191,15 +586,25 @@ int fbcon_draw(const tinfo* ti, sprixel* s, int y, int x){
 // we're *clearing* N rows at the bottom. every pixel is written to once, and
 // they're written in order. if we're scrolling all rows, we're clearing the
 // entire space; we always clear something (we might not always move anything).
+// with page flipping, we've drawn nothing into the console's page, and the
+// console scrolls its own text. the rows it redraws are copied into the next
+// composed pages, and graphics are redrawn at their new positions.
 void fbcon_scroll(const struct ncpile* p, tinfo* ti, int rows){
   const int cellpxy = p->cellpxy;
-  const int cellpxx = p->cellpxx;
   if(cellpxy < 1){
     return;
   }
   logdebug("scrolling %d", rows);
-  const int rowbytes = cellpxx * p->dimx * 4;
-  const int totalrows = cellpxy * p->dimy;
+  if(ti->linux_fb_pages == FBCON_FLIP_PAGES){
+    fbcon_stale_rows(ti, 0, fbcon_rows(ti));
+    ++ti->linux_fb_gen;
+    return;
+  }
+  const size_t rowbytes = ti->linux_fb_stride;
+  int totalrows = cellpxy * p->dimy;
+  if(totalrows > (int)ti->pixy){
+    totalrows = ti->pixy;
+  }
   int srows = rows * cellpxy; // number of pixel rows being scrolled
   if(srows > totalrows){
     srows = totalrows;
@@ -207,12 +612,18 @@ void fbcon_scroll(const struct ncpile* p, tinfo* ti, int rows){
   // srows is the number of rows we're *losing*
   uint8_t* targ = ti->linux_fbuffer;
   uint8_t* src = ti->linux_fbuffer + srows * rowbytes;
-  unsigned tocopy = rowbytes * (totalrows - srows);
+  size_t tocopy = rowbytes * (totalrows - srows);
   if(tocopy){
     memmove(targ, src, tocopy);
   }
   targ += tocopy;
   memset(targ, 0, (totalrows * rowbytes) - tocopy);
+  // everything drawn has moved; bitmaps must be drawn whole
+  ++ti->linux_fb_gen;
+}
+
+void fbcon_textrow(const struct ncpile* p, tinfo* ti, int y){
+  fbcon_stale_rows(ti, y * p->cellpxy, p->cellpxy);
 }
 
 // each row is a contiguous set of bits, starting at the msb
@@ -726,6 +1137,42 @@ bool is_linux_console(int fd){
   return true;
 }
 
+// make room for two pages below the console's in the virtual framebuffer,
+// if they aren't already there. returns the number of pages available (1 if
+// we can't flip). |fbi| and |fix| are refreshed should we change the mode.
+static unsigned
+fbcon_make_pages(tinfo* ti, struct fb_var_screeninfo* fbi,
+                 struct fb_fix_screeninfo* fix){
+  if(fix->ypanstep == 0 || fbi->yres % fix->ypanstep){
+    loginfo("%s can't pan by %u rows, not flipping", ti->linux_fb_dev, fbi->yres);
+    return 1;
+  }
+  if(fbi->yres_virtual < fbi->yres * FBCON_FLIP_PAGES){
+    struct fb_var_screeninfo v = *fbi;
+    v.yres_virtual = fbi->yres * FBCON_FLIP_PAGES;
+    v.yoffset = 0;
+    if(ioctl(ti->linux_fb_fd, FBIOPUT_VSCREENINFO, &v) ||
+       v.yres_virtual < fbi->yres * FBCON_FLIP_PAGES){
+      loginfo("couldn't grow virtual height of %s, not flipping", ti->linux_fb_dev);
+      return 1;
+    }
+    if(ti->linux_fb_yvirt == 0){
+      ti->linux_fb_yvirt = fbi->yres_virtual;
+    }
+    if(ioctl(ti->linux_fb_fd, FBIOGET_VSCREENINFO, fbi) ||
+       ioctl(ti->linux_fb_fd, FBIOGET_FSCREENINFO, fix)){
+      logerror("no framebuffer info from %s (%s?)", ti->linux_fb_dev, strerror(errno));
+      return 1;
+    }
+    loginfo("grew virtual height of %s to %u", ti->linux_fb_dev, fbi->yres_virtual);
+  }
+  if(fix->smem_len && fix->smem_len < (size_t)fix->line_length * fbi->yres * FBCON_FLIP_PAGES){
+    loginfo("%s has only %uB of memory, not flipping", ti->linux_fb_dev, fix->smem_len);
+    return 1;
+  }
+  return FBCON_FLIP_PAGES;
+}
+
 int get_linux_fb_pixelgeom(tinfo* ti, unsigned* ypix, unsigned *xpix){
   unsigned fakey, fakex;
   if(ypix == NULL){
@@ -740,10 +1187,62 @@ int get_linux_fb_pixelgeom(tinfo* ti, unsigned* ypix, unsigned *xpix){
              ti->linux_fb_fd, strerror(errno));
     return -1;
   }
-  loginfo("linux %s geometry: %dx%d", ti->linux_fb_dev, fbi.yres, fbi.xres);
+  struct fb_fix_screeninfo fix = {0};
+  if(ioctl(ti->linux_fb_fd, FBIOGET_FSCREENINFO, &fix)){
+    logerror("no fixed framebuffer info from %s %d (%s?)", ti->linux_fb_dev,
+             ti->linux_fb_fd, strerror(errno));
+    return -1;
+  }
+  unsigned pages = ti->linux_fb_wantflip ? fbcon_make_pages(ti, &fbi, &fix) : 1;
+  if(fbi.bits_per_pixel != 16 && fbi.bits_per_pixel != 24 && fbi.bits_per_pixel != 32){
+    logerror("unsupported %ubpp framebuffer at %s", fbi.bits_per_pixel, ti->linux_fb_dev);
+    return -1;
+  }
+  loginfo("linux %s geometry: %dx%d %ubpp", ti->linux_fb_dev, fbi.yres, fbi.xres,
+          fbi.bits_per_pixel);
+  const size_t oldstride = ti->linux_fb_stride;
+  const unsigned oldbpp = ti->linux_fb_bpp;
   *ypix = fbi.yres;
   *xpix = fbi.xres;
-  size_t len = *ypix * *xpix * fbi.bits_per_pixel / 8;
+  ti->linux_fb_bpp = fbi.bits_per_pixel / 8;
+  ti->linux_fb_stride = fix.line_length ? fix.line_length : *xpix * ti->linux_fb_bpp;
+  const struct fb_bitfield* fields[] = { &fbi.red, &fbi.green, &fbi.blue, };
+  for(int c = 0 ; c < 3 ; ++c){
+    ti->linux_fb_shifts[c] = fields[c]->offset;
+    ti->linux_fb_bits[c] = fields[c]->length > 8 ? 8 : fields[c]->length;
+  }
+  ti->linux_fb_native = ti->linux_fb_bpp == 4 &&
+                        fbi.red.offset == 16 && fbi.red.length == 8 &&
+                        fbi.green.offset == 8 && fbi.green.length == 8 &&
+                        fbi.blue.offset == 0 && fbi.blue.length == 8;
+  const size_t oldpagelen = ti->linux_fb_pagelen;
+  ti->linux_fb_pagelen = ti->linux_fb_stride * *ypix;
+  // the console pans back to its page when e.g. switching VTs, and might have
+  // redrawn it. we then start over, as we do following a change of geometry
+  // or depth (or the remapping following a font change), which might have
+  // cleared the framebuffer. we're called on each render.
+  const unsigned shown = fbi.yoffset / fbi.yres < pages ? fbi.yoffset / fbi.yres : 0;
+  if(ti->linux_fb_len != ti->linux_fb_pagelen * pages || oldpagelen != ti->linux_fb_pagelen ||
+     oldstride != ti->linux_fb_stride || oldbpp != ti->linux_fb_bpp ||
+     ti->linux_fb_pages != pages || ti->linux_fb_shown != shown){
+    ++ti->linux_fb_gen;
+    if(pages > 1){
+      uint8_t* rows = realloc(ti->linux_fb_rows, *ypix);
+      if(rows == NULL){
+        logwarn("couldn't track %u rows, not flipping", *ypix);
+        pages = 1;
+      }else{
+        memset(rows, FBROW_STALE, *ypix);
+        ti->linux_fb_rows = rows;
+      }
+    }
+  }
+  const size_t len = ti->linux_fb_pagelen * pages;
+  ti->linux_fb_pages = pages;
+  ti->linux_fb_shown = pages > 1 ? shown : 0;
+  if(pages == 1){
+    ti->linux_fb_page = 0;
+  }
   if(ti->linux_fb_len != len){
     if(ti->linux_fbuffer != MAP_FAILED){
       munmap(ti->linux_fbuffer, ti->linux_fb_len);
@@ -773,6 +1272,8 @@ bool is_linux_framebuffer(tinfo* ti){
     return false;
   }
   ti->linux_fb_fd = fd;
+  const char* flip = getenv("NOTCURSES_FBCON_FLIP");
+  ti->linux_fb_wantflip = flip && *flip && strcmp(flip, "0");
   if((ti->linux_fb_dev = strdup(dev)) == NULL){
     close(ti->linux_fb_fd);
     ti->linux_fb_fd = -1;
@@ -810,6 +1311,26 @@ void fbcon_scroll(const struct ncpile* p, tinfo* ti, int rows){
   (void)rows;
 }
 
+void fbcon_textrow(const struct ncpile* p, tinfo* ti, int y){
+  (void)p;
+  (void)ti;
+  (void)y;
+}
+
+void fbcon_compose(tinfo* ti, bool any){
+  (void)ti;
+  (void)any;
+}
+
+int fbcon_present(tinfo* ti){
+  (void)ti;
+  return 0;
+}
+
+void fbcon_cleanup(tinfo* ti){
+  (void)ti;
+}
+
 int get_linux_fb_pixelgeom(tinfo* ti, unsigned* ypix, unsigned *xpix){
   (void)ti;
   (void)ypix;
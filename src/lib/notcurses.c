@@ -122,6 +122,11 @@ notcurses_stop_minimal(void* vnc, void** altstack, int errret){
   notcurses* nc = vnc;
   int ret = 0;
   ret |= drop_signals(nc, altstack);
+  // we might be in a signal handler, so just unlink any outstanding kitty
+  // probe; free_terminfo_cache() (if we get there) releases the path.
+  if(nc->tcache.kittyprobe){
+    unlink(nc->tcache.kittyprobe);
+  }
   // collect output into the memstream buffer, and then dump it directly using
   // blocking_write(), to avoid problems with unreliable fflush().
   fbuf* f = &nc->rstate.f;
@@ -559,7 +564,7 @@ static inline size_t  ncplane_sizeof_cellarray( size_t rows, size_t cols)
 // (as once more is n).
 ncplane* ncplane_new_internal(notcurses* nc, ncplane* n,
                               const ncplane_options* nopts){
-  if(nopts->flags >= (NCPLANE_OPTION_FIXED << 1u)){
+  if(nopts->flags >= (NCPLANE_OPTION_INTERN << 1u)){
     logwarn("provided unsupported flags %016" PRIx64, nopts->flags);
   }
   if(nopts->flags & NCPLANE_OPTION_HORALIGNED || nopts->flags & NCPLANE_OPTION_VERALIGNED){
@@ -652,6 +657,9 @@ ncplane* ncplane_new_internal(notcurses* nc, ncplane* n,
   p->stylemask = 0;
   p->channels = 0;
   egcpool_init(&p->pool);
+  if(nopts->flags & NCPLANE_OPTION_INTERN){
+    egcpool_set_interning(&p->pool);
+  }
   nccell_init(&p->basecell);
   p->userptr = nopts->userptr;
   if(nc == NULL){ // fake ncplane backing ncdirect object
@@ -1221,6 +1229,8 @@ notcurses_early_init(const struct notcurses_options* opts, FILE* fp, unsigned* u
   reset_stats(&ret->stashed_stats);
   ret->ttyfp = fp;
   egcpool_init(&ret->pool);
+  // the last frame sees the same EGCs over and over again, frame after frame
+  egcpool_set_interning(&ret->pool);
   if(ret->loglevel > NCLOGLEVEL_TRACE || ret->loglevel < NCLOGLEVEL_SILENT){
     fprintf(stderr, "invalid loglevel %d", ret->loglevel);
     free(ret);
@@ -1260,6 +1270,9 @@ notcurses* notcurses_core_init(const notcurses_options* opts, FILE* outfp){
     free(ret);
     return NULL;
   }
+  // sprixel glyphs are written directly from their own storage
+  fbuf_set_splicing(&ret->rstate.f, true);
+  ret->stats.s.rasterbufbytes = ret->rstate.f.size;
   if(setup_signals(ret, (ret->flags & NCOPTION_NO_QUIT_SIGHANDLERS),
                    (ret->flags & NCOPTION_NO_WINCH_SIGHANDLER),
                    notcurses_stop_minimal)){
@@ -1383,7 +1396,7 @@ notcurses* notcurses_core_init(const notcurses_options* opts, FILE* outfp){
       goto err;
     }
   }
-  if(ret->rstate.f.used){
+  if(fbuf_total(&ret->rstate.f)){
     if(fbuf_flush(&ret->rstate.f, ret->ttyfp) < 0){
       goto err;
     }
@@ -1394,6 +1407,7 @@ err:{
     void* altstack;
     logpanic("alas, you will not be going to space today.");
     notcurses_stop_minimal(ret, &altstack, -1);
+    ncworkers_unref(); // taken by interrogate_terminfo()
     fbuf_free(&ret->rstate.f);
     if(ret->tcache.ttyfd >= 0 && ret->tcache.tpreserved){
       (void)tcsetattr(ret->tcache.ttyfd, TCSAFLUSH, ret->tcache.tpreserved);
@@ -1466,13 +1480,14 @@ int notcurses_stop(notcurses* nc){
       notcurses_drop_planes(nc);
       free_plane(nc->stdplane);
     }
-    if(nc->tcache.ttyfd >= 0){
-      ret |= close(nc->tcache.ttyfd);
-    }
     egcpool_dump(&nc->pool);
     free(nc->lastframe);
-    // perhaps surprisingly, this stops the input thread
+    // perhaps surprisingly, this stops the input thread. it might yet write
+    // to the tty (to delete cached kitty graphics), so close that afterwards.
     free_terminfo_cache(&nc->tcache);
+    if(nc->tcache.ttyfd >= 0){
+      ret |= close(nc->tcache.ttyfd);
+    }
     // get any current stats loaded into stash_stats
     notcurses_stats_reset(nc, NULL);
     if(!(nc->flags & NCOPTION_SUPPRESS_BANNERS)){
@@ -1839,6 +1854,33 @@ int nccell_load(ncplane* n, nccell* c, const char* gcluster){
   return pool_load_direct(&n->pool, c, gcluster, bytes, cols);
 }
 
+// A wide character obliterates anything to its immediate right (and marks
+// that cell as wide). Any character placed atop one cell of a wide character
+// obliterates all cells. Note that a two-cell glyph can thus obliterate two
+// other two-cell glyphs, totalling four columns. clear out whatever glyph we
+// will be displacing by writing at the cursor, returning the cursor's cell.
+static inline nccell*
+ncplane_displace(ncplane* n){
+  nccell* targ = ncplane_cell_ref_yx(n, n->y, n->x);
+  // we're always starting on the leftmost cell of our output glyph. check the
+  // target, and find the leftmost cell of the glyph it will be displacing.
+  // obliterate as we go along.
+  int idx = n->x;
+  nccell* lmc = targ;
+  while(nccell_wide_right_p(lmc)){
+    nccell_obliterate(n, &n->fb[nfbcellidx(n, n->y, idx)]);
+    lmc = ncplane_cell_ref_yx(n, n->y, --idx);
+  }
+  // we're now on the leftmost cell of the target glyph.
+  int twidth = nccell_cols(lmc);
+  nccell_release(n, lmc);
+  twidth -= n->x - idx;
+  while(--twidth > 0){
+    nccell_obliterate(n, &n->fb[nfbcellidx(n, n->y, n->x + twidth)]);
+  }
+  return targ;
+}
+
 // where the magic happens. write the single EGC completely described by |egc|,
 // occupying |cols| columns, to the ncplane |n| at the coordinate |y|, |x|. if
 // either or both of |y|/|x| is -1, the current cursor location for that
@@ -1904,27 +1946,7 @@ ncplane_put(ncplane* n, int y, int x, const char* egc, int cols,
     scroll_down(n);
     scrolled = true;
   }
-  // A wide character obliterates anything to its immediate right (and marks
-  // that cell as wide). Any character placed atop one cell of a wide character
-  // obliterates all cells. Note that a two-cell glyph can thus obliterate two
-  // other two-cell glyphs, totalling four columns.
-  nccell* targ = ncplane_cell_ref_yx(n, n->y, n->x);
-  // we're always starting on the leftmost cell of our output glyph. check the
-  // target, and find the leftmost cell of the glyph it will be displacing.
-  // obliterate as we go along.
-  int idx = n->x;
-  nccell* lmc = targ;
-  while(nccell_wide_right_p(lmc)){
-    nccell_obliterate(n, &n->fb[nfbcellidx(n, n->y, idx)]);
-    lmc = ncplane_cell_ref_yx(n, n->y, --idx);
-  }
-  // we're now on the leftmost cell of the target glyph.
-  int twidth = nccell_cols(lmc);
-  nccell_release(n, lmc);
-  twidth -= n->x - idx;
-  while(--twidth > 0){
-    nccell_obliterate(n, &n->fb[nfbcellidx(n, n->y, n->x + twidth)]);
-  }
+  nccell* targ = ncplane_displace(n);
   targ->stylemask = stylemask;
   targ->channels = channels;
   // tabs get replaced with spaces, up to the next tab stop. we always try to
@@ -2011,6 +2033,81 @@ int ncplane_putegc_yx(ncplane* n, int y, int x, const char* gclust, size_t* sbyt
   return ncplane_put(n, y, x, gclust, cols, n->stylemask, n->channels, bytes);
 }
 
+// length of the run of printable ASCII (0x20--0x7e) at the front of |s|,
+// examining no more than |len| bytes. we test eight bytes at a time, falling
+// back to bytewise tests only for the word containing the end of the run.
+static inline size_t
+printable_ascii_run(const char* s, size_t len){
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t highs = 0x8080808080808080ull;
+  size_t r = 0;
+  while(r + sizeof(uint64_t) <= len){
+    uint64_t w;
+    memcpy(&w, s + r, sizeof(w));
+    const uint64_t del = w ^ (ones * 0x7f);
+    // high bit set, less than 0x20, or DEL. there can be false positives
+    // only when some byte is a true positive, so 0 is exact.
+    if((w & highs) | ((w - ones * 0x20) & ~w & highs) | ((del - ones) & ~del & highs)){
+      break;
+    }
+    r += sizeof(uint64_t);
+  }
+  while(r < len && s[r] >= 0x20 && s[r] < 0x7f){
+    ++r;
+  }
+  return r;
+}
+
+int ncplane_putegcs_yx(ncplane* n, int y, int x, const char* gclusters,
+                       size_t s, size_t* sbytes){
+  // a run of printable ASCII can be written directly to the framebuffer, one
+  // byte per column, so long as it doesn't cross the end of the line (which
+  // might require scrolling or growth). an ASCII character immediately
+  // followed by a non-ASCII byte might begin a larger EGC (e.g. it could be
+  // followed by a combining character), and is left for full segmentation.
+  size_t run = 0;
+  if(!n->sprite && y >= -1 && x >= -1){
+    unsigned ty = y < 0 ? n->y : (unsigned)y;
+    unsigned tx = x < 0 ? n->x : (unsigned)x;
+    if(ty < n->leny && tx < n->lenx){
+      size_t avail = n->lenx - tx;
+      size_t window = s < avail + 1 ? s : avail + 1;
+      size_t len = strnlen(gclusters, window);
+      run = printable_ascii_run(gclusters, len);
+      bool nextascii; // do we know that the byte following the run is ASCII?
+      if(run < len){
+        nextascii = (unsigned char)gclusters[run] < 0x80;
+      }else{
+        nextascii = len < window; // we found the NUL terminator
+      }
+      if(run && !nextascii){
+        --run;
+      }
+      if(run > avail){
+        run = avail;
+      }
+    }
+  }
+  if(run < 2){
+    return ncplane_putegc_yx(n, y, x, gclusters, sbytes);
+  }
+  if(ncplane_cursor_move_yx(n, y, x)){
+    return -1;
+  }
+  const uint64_t channels = n->channels & ~NC_NOBACKGROUND_MASK;
+  for(size_t i = 0 ; i < run ; ++i){
+    nccell* targ = ncplane_displace(n);
+    targ->stylemask = n->stylemask;
+    targ->channels = channels;
+    // ncplane_displace() released the target, zeroing its gcluster
+    memcpy(&targ->gcluster, gclusters + i, 1);
+    targ->width = 1;
+    ++n->x;
+  }
+  *sbytes = run;
+  return run;
+}
+
 int ncplane_putchar_stained(ncplane* n, char c){
   uint64_t channels = n->channels;
   uint16_t stylemask = n->stylemask;
@@ -2481,6 +2578,12 @@ void ncplane_erase(ncplane* n){
   n->y = n->x = 0;
 }
 
+int ncplane_compact(ncplane* n){
+  loginfo("compacting %dx%d plane (pool %d/%d)", n->leny, n->lenx,
+          n->pool.poolused, n->pool.poolsize);
+  return egcpool_compact(&n->pool, n->fb, (size_t)n->leny * n->lenx, &n->basecell);
+}
+
 int ncplane_erase_region(ncplane* n, int ystart, int xstart, int ylen, int xlen){
   if(ystart == -1){
     ystart = n->y;
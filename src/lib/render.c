@@ -1056,7 +1056,7 @@ rasterize_sprixels(notcurses* nc, ncpile* p, fbuf* f){
       }
     }else if(s->invalidated == SPRIXEL_HIDE){
       if(nc->tcache.pixel_remove){
-        if(nc->tcache.pixel_remove(s->id, f) < 0){
+        if(sprite_remove(&nc->tcache, f, s) < 0){
           return -1;
         }
         if( (*parent = s->next) ){
@@ -1080,6 +1080,9 @@ rasterize_sprixels_post(notcurses* nc, ncpile* p){
     return 0;
   }
   int64_t bytesemitted = 0;
+  if(nc->tcache.pixel_compose){
+    nc->tcache.pixel_compose(&nc->tcache, p->sprixelcache != NULL);
+  }
   sprixel* s;
   sprixel** parent = &p->sprixelcache;
   while( (s = *parent) ){
@@ -1096,6 +1099,11 @@ rasterize_sprixels_post(notcurses* nc, ncpile* p){
     }
     parent = &s->next;
   }
+  if(nc->tcache.pixel_present){
+    if(nc->tcache.pixel_present(&nc->tcache)){
+      return -1;
+    }
+  }
   return bytesemitted;
 }
 
@@ -1118,6 +1126,7 @@ rasterize_core(notcurses* nc, const ncpile* p, fbuf* f, unsigned phase){
   for(unsigned y = nc->margin_t; y < p->dimy + nc->margin_t ; ++y){
     const int innery = y - nc->margin_t;
     bool saw_linefeed = 0;
+    bool wrote = false;
     for(unsigned x = nc->margin_l ; x < p->dimx + nc->margin_l ; ++x){
       const int innerx = x - nc->margin_l;
       const size_t damageidx = innery * nc->lfdimx + innerx;
@@ -1232,6 +1241,7 @@ rasterize_core(notcurses* nc, const ncpile* p, fbuf* f, unsigned phase){
         if(srccell->gcluster == '\n'){
           saw_linefeed = true;
         }
+        wrote = true;
         rvec[damageidx].s.damaged = 0;
         rvec[damageidx].s.p_beats_sprixel = 0;
         nc->rstate.x += srccell->width;
@@ -1265,6 +1275,9 @@ rasterize_core(notcurses* nc, const ncpile* p, fbuf* f, unsigned phase){
     if(saw_linefeed){
       nc->rstate.logendx = 0;
     }
+    if(wrote && nc->tcache.pixel_textrow){
+      nc->tcache.pixel_textrow(p, &nc->tcache, y);
+    }
   }
   return 0;
 }
@@ -1309,7 +1322,7 @@ notcurses_rasterize_inner(notcurses* nc, ncpile* p, fbuf* f, unsigned* asu){
   }
 #define MIN_SUMODE_SIZE BUFSIZ
   if(*asu){
-    if(nc->rstate.f.used >= MIN_SUMODE_SIZE){
+    if(fbuf_total(&nc->rstate.f) >= MIN_SUMODE_SIZE){
       const char* endasu = get_escape(&nc->tcache, ESCAPE_ESUM);
       if(endasu){
         if(fbuf_puts(f, endasu) < 0){
@@ -1323,12 +1336,13 @@ notcurses_rasterize_inner(notcurses* nc, ncpile* p, fbuf* f, unsigned* asu){
     }
   }
 #undef MIN_SUMODE_SIZE
-  return nc->rstate.f.used;
+  return fbuf_total(&nc->rstate.f);
 }
 
 // rasterize the rendered frame, and blockingly write it out to the terminal.
+// |totty| is false when the frame is instead destined for a file.
 static int
-raster_and_write(notcurses* nc, ncpile* p, fbuf* f){
+raster_and_write(notcurses* nc, ncpile* p, fbuf* f, bool totty){
   fbuf_reset(f);
   // will we be using application-synchronized updates? if this comes back as
   // non-zero, we are, and must emit the header. no SUM without a tty, and we
@@ -1342,6 +1356,12 @@ raster_and_write(notcurses* nc, ncpile* p, fbuf* f){
       return -1;
     }
   }
+  // only animated kitty graphics are ever sent via temporary files, and the
+  // probe for them is only of use in a frame the terminal will see.
+  if(totty && p->sprixelcache &&
+     nc->tcache.pixel_implementation >= NCPIXEL_KITTY_ANIMATED){
+    kitty_probe_frame(&nc->tcache, f);
+  }
   if(notcurses_rasterize_inner(nc, p, f, &useasu) < 0){
     return -1;
   }
@@ -1358,17 +1378,18 @@ raster_and_write(notcurses* nc, ncpile* p, fbuf* f){
   int ret = 0;
   sigset_t oldmask;
   block_signals(&oldmask);
-  if(blocking_write(fileno(nc->ttyfp), nc->rstate.f.buf + moffset,
-                    nc->rstate.f.used - moffset)){
+  if(fbuf_write(fileno(nc->ttyfp), &nc->rstate.f, moffset)){
     ret = -1;
   }
   unblock_signals(&oldmask);
-  rasterize_sprixels_post(nc, p);
+  if(rasterize_sprixels_post(nc, p) < 0){
+    ret = -1;
+  }
 //fprintf(stderr, "%lu/%lu %lu/%lu %lu/%lu %d\n", nc->stats.defaultelisions, nc->stats.defaultemissions, nc->stats.fgelisions, nc->stats.fgemissions, nc->stats.bgelisions, nc->stats.bgemissions, ret);
   if(ret < 0){
     return ret;
   }
-  return nc->rstate.f.used;
+  return fbuf_total(&nc->rstate.f);
 }
 
 // if the cursor is enabled, store its location and disable it. then, once done
@@ -1382,7 +1403,9 @@ notcurses_rasterize(notcurses* nc, ncpile* p, fbuf* f){
   if(cursory >= 0){ // either both are good, or neither is
     notcurses_cursor_disable(nc);
   }
-  int ret = raster_and_write(nc, p, f);
+  int ret = raster_and_write(nc, p, f, true);
+  // give back any memory from a spike in output, once it's clearly passed
+  fbuf_trim(f, FBUF_LARGE_SIZE);
   fbuf_reset(f);
   if(cursory >= 0){
     notcurses_cursor_enable(nc, cursory, cursorx);
@@ -1427,6 +1450,10 @@ int notcurses_refresh(notcurses* nc, unsigned* restrict dimy, unsigned* restrict
   if(fbuf_flush(&nc->rstate.f, nc->ttyfp)){
     return -1;
   }
+#ifdef __linux__
+  // the console cleared any framebuffer graphics along with the text
+  ++nc->tcache.linux_fb_gen;
+#endif
   if(nc->lfdimx == 0 || nc->lfdimy == 0){
     return 0;
   }
@@ -1472,7 +1499,7 @@ int ncpile_render_to_file(ncplane* n, FILE* fp){
   for(unsigned i = 0 ; i < count ; ++i){
     p->crender[i].s.damaged = 1;
   }
-  int ret = raster_and_write(nc, p, &f);
+  int ret = raster_and_write(nc, p, &f, false);
   free(p->crender);
   if(ret > 0){
     if(fwrite(f.buf, f.used, 1, fp) == 1){
@@ -1531,6 +1558,7 @@ int ncpile_rasterize(ncplane* n){
     update_raster_bytes(&nc->stats.s, bytes);
     update_raster_stats(&rasterdone, &start, &nc->stats.s);
     update_write_stats(&writedone, &rasterdone, &nc->stats.s, bytes);
+    nc->stats.s.rasterbufbytes = nc->rstate.f.size;
   pthread_mutex_unlock(&nc->stats.lock);
   // we want to refresh if the screen geometry changed (or if we were just
   // woken up from SIGSTOP), but we mustn't do so until after rasterizing
@@ -1542,6 +1570,11 @@ int ncpile_rasterize(ncplane* n){
   if(bytes < 0){
     return -1;
   }
+  // the lastframe is the only user of its pool, so we're free to compact it.
+  // failure just leaves the old pool in place.
+  if(egcpool_compact_wanted(&nc->pool)){
+    egcpool_compact(&nc->pool, nc->lastframe, (size_t)nc->lfdimy * nc->lfdimx, NULL);
+  }
   return 0;
 }
 
@@ -1601,16 +1634,21 @@ int ncpile_render_to_buffer(ncplane* p, char** buf, size_t* buflen){
   notcurses* nc = ncplane_notcurses(p);
   unsigned useasu = false; // no SUM with file
   fbuf_reset(&nc->rstate.f);
+  // the caller gets a single contiguous buffer, so we can't splice
+  fbuf_set_splicing(&nc->rstate.f, false);
   int bytes = notcurses_rasterize_inner(nc, ncplane_pile(p), &nc->rstate.f, &useasu);
   pthread_mutex_lock(&nc->stats.lock);
     update_raster_bytes(&nc->stats.s, bytes);
   pthread_mutex_unlock(&nc->stats.lock);
+  if(bytes >= 0){
+    *buf = nc->rstate.f.buf;
+    *buflen = nc->rstate.f.used;
+  }
+  fbuf_reset(&nc->rstate.f);
+  fbuf_set_splicing(&nc->rstate.f, true);
   if(bytes < 0){
     return -1;
   }
-  *buf = nc->rstate.f.buf;
-  *buflen = nc->rstate.f.used;
-  fbuf_reset(&nc->rstate.f);
   return 0;
 }
 
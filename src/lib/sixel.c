@@ -1,17 +1,10 @@
-#include <math.h>
 #include <stdatomic.h>
 #include "internal.h"
 #include "fbuf.h"
+#include "sixel.h"
 
 #define RGBSIZE 3
 
-// number of worker threads
-// FIXME fit to local machine, but more than 3 never seems to help
-#define POPULATION 3
-
-// a worker can have up to three qstates enqueued for work
-#define WORKERDEPTH 3
-
 // this palette entry is a sentinel for a transparent pixel (and thus caps
 // the palette at 65535 other entries).
 #define TRANS_PALETTE_ENTRY 65535
@@ -50,6 +43,88 @@ typedef struct onode {
   qnode* q[8];
 } onode;
 
+// number of first-order (static) qnodes, see alloc_qstate()
+#define QNODECOUNT 1000
+
+// color extraction is split among threads, each of which accumulates the
+// pixels it examines into its own qhist. a qhist has one qslot for each
+// combination of first-order qnode and onode subkey. once all pixels have
+// been examined, the qhists are merged, and their slots inserted into the
+// octree in the order in which they were first seen. this produces exactly
+// the octree we would have built inserting each pixel in sequence.
+typedef struct qslot {
+  uint64_t first; // one-biased sequence number of first pixel, 0 if unused
+  uint32_t pixel; // first pixel seen
+  uint32_t pop;   // number of pixels seen
+} qslot;
+
+#define QSLOTCOUNT (QNODECOUNT * 8)
+
+typedef struct qhist {
+  qslot slots[QSLOTCOUNT];
+  bool p2trans;   // we require P2=1 (see change_p2())
+} qhist;
+
+// a qslot which maps to no palette entry
+#define QSLOT_NOCOLOR 0xffffu
+
+// how a sixel's palette is chosen, per the ncvisual_options flags. the octree
+// (the default) adapts the palette to the image. median cut adapts it more
+// carefully, at greater cost. the fixed palette requires no analysis at all,
+// and maps each pixel with a few multiplies, optionally dithering it.
+typedef enum {
+  SIXEL_QUANT_OCTREE,
+  SIXEL_QUANT_MEDIANCUT,
+  SIXEL_QUANT_FIXED,
+  SIXEL_QUANT_FIXED_DITHER,
+} sixel_quant_e;
+
+// the fixed palette is a cube of up to FIXED_LEVELS levels per component
+// (fewer if the color registers can't hold it), plus up to FIXED_GREYS greys
+// strictly between black and white.
+#define FIXED_LEVELS 6
+#define FIXED_GREYS 24
+
+// thresholds for ordered dithering of the fixed palette
+static const unsigned char bayer4[4][4] = {
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 },
+};
+
+// median cut runs this many rounds of k-means over the boxes it finds
+#define MEDIANCUT_ROUNDS 4
+
+// a palette, along with the qslot populations from which it was chosen. a
+// sixel sprixel which has been blitted more than once (i.e. an animation)
+// retains the last palette it built, so that subsequent frames can reuse it,
+// so long as their colors haven't drifted too far. this skips octree
+// construction and palette reduction, and keeps colors stable from frame to
+// frame. at some 64KiB apiece, palettes aren't kept for static images.
+typedef struct sixelpalette {
+  sixel_quant_e quant;         // quantizer which built it
+  int colors;                  // entries in table
+  int colorregs;               // color registers available at construction
+  unsigned char* table;        // |colors| x RGBSIZE sixel-scaled components
+  uint64_t pixels;             // sum of pops
+  uint32_t pops[QSLOTCOUNT];   // population of each qslot
+  uint16_t cidx[QSLOTCOUNT];   // palette index of each qslot, or QSLOT_NOCOLOR
+  // qslots unseen by the building frame are mapped to their nearest entries
+  // by whichever later frame first needs them. we remember these mappings,
+  // so that a given pixel always quantizes the same way against a palette.
+  uint16_t nearest[QSLOTCOUNT];
+} sixelpalette;
+
+// a frame can reuse a palette if no more than 1/PALETTE_MISS_DIV of its
+// pixels fall into qslots the palette didn't see (these are mapped to their
+// nearest palette entries), and the L1 distance between its normalized qslot
+// histogram and the palette's (on [0..2]) is no more than PALETTE_DRIFT_MAX.
+// the palette's histogram is that of the frame which built it, so drift
+// can't accumulate over successive reuses.
+#define PALETTE_MISS_DIV 64
+#define PALETTE_DRIFT_MAX 0.25
+
 // we set P2 based on whether there is any transparency in the sixel. if not,
 // use SIXEL_P2_ALLOPAQUE (0), for faster drawing in certain terminals.
 typedef enum {
@@ -63,6 +138,14 @@ typedef enum {
 typedef struct sixelband {
   int size;     // capacity FIXME if same for all, eliminate this
   char** vecs;  // array of vectors, many of which can be NULL
+  uint64_t hash; // hash of the source pixels, 0 if unknown or since wiped
+  // the colors present within each of the band's |cellcols| cell columns,
+  // so that wiping or restoring a cell needn't visit every color vector.
+  // column i's colors are cellcolors[cellcoloff[i]..cellcoloff[i + 1]).
+  // wipes don't remove entries, so these are a superset of what remains.
+  int cellcols;
+  int* cellcoloff;       // cellcols + 1 offsets
+  uint16_t* cellcolors;
 } sixelband;
 
 // across the life of the sixel, we'll need to wipe and restore cells, without
@@ -83,11 +166,27 @@ typedef struct sixelmap {
   int sixelbands;
   sixelband* bands;      // |sixelbands| collections of sixel vectors
   sixel_p2_e p2;         // set to SIXEL_P2_TRANS if we have transparent pixels
+  sixel_quant_e quant;   // how the bands' colors were chosen
 } sixelmap;
 
 typedef struct qstate {
-  int refcount; // initialized to worker count
+  // what each thread working on us ought do, given its job index (the
+  // calling thread need not get job 0).
+  int (*work)(struct qstate*, unsigned);
   atomic_int bandbuilder; // threads take bands as their work unit
+  // during extraction, threads take rows of cells as their work unit, and
+  // each accumulates into its own qhist.
+  atomic_int rowextractor;
+  atomic_int participants; // number of qhists claimed
+  qhist** hists;           // one per possible participant
+  // once the palette has been chosen, pixels are mapped to palette indices
+  // through their qslots. if we're reusing a palette, not all of its entries
+  // might be used; |used| then indicates which are (otherwise, it's NULL).
+  uint16_t slotmap[QSLOTCOUNT];
+  unsigned char* used;
+  // with a fixed palette, pixels are instead mapped arithmetically
+  int fixedlevels;        // levels per component of the color cube
+  int fixedgreys;         // greys following the cube
   // we always work in terms of quantized colors (quantization is the first
   // step of rendering), using indexes into the derived palette. the actual
   // palette need only be stored during the initial render, since the sixel
@@ -103,68 +202,49 @@ typedef struct qstate {
   const uint32_t* data;
   int linesize;
   sixelmap* smap;
+  // the sixelmap of the frame we're replacing, if our palette is the one it
+  // was quantized against. its bands can be taken for any of our bands whose
+  // source pixels are unchanged. |reusedbands| counts how many were taken.
+  sixelmap* prevmap;
+  atomic_int reusedbands;
+  bool recycled; // the sprixel held an earlier frame
   // these are the leny and lenx passed to sixel_blit(), which are likely
   // different from those reachable through bargs->len{y,x}!
   int leny, lenx;
 } qstate;
 
-// a work_queue per worker thread. if used == WORKERDEPTH, this thread is
-// backed up, and we cannot enqueue to it. writeto wraps around the array.
-typedef struct work_queue {
-  qstate* qstates[WORKERDEPTH];
-  unsigned writeto;
-  unsigned used;
-  struct sixel_engine* sengine;
-} work_queue;
-
-// we keep a few worker threads (POPULATION) spun up to assist with
-// quantization. each has an array of up to WORKERDEPTH qstates to work on.
+// the work of extraction and band building is shared with threads of the
+// worker pool (see workers.c). each thread claims units (rows of cells, or
+// bands) through qstate's atomics until none remain, so it doesn't matter
+// how many of them actually join in. the engine merely records how many
+// helpers we may ask for, by default one fewer than the processors
+// available to us, since the blitting thread participates.
 typedef struct sixel_engine {
-  pthread_mutex_t lock;
-  pthread_cond_t cond;
-  work_queue queues[POPULATION];
-  pthread_t tids[POPULATION];
-  bool done;
+  unsigned helpers;        // NOTCURSES_SIXEL_THREADS, < NCWORKERS_MAXTHREADS
 } sixel_engine;
 
-// enqueue |qs| to any workers with available space. the number of workers with
-// a reference will be stored in |qs|->refcount.
+// a job of |qs|'s current work
 static void
-enqueue_to_workers(sixel_engine* eng, qstate* qs){
-  if(eng == NULL){
-    return;
-  }
-  int usecount = 0;
-  pthread_mutex_lock(&eng->lock);
-  for(int i = 0 ; i < POPULATION ; ++i){
-    work_queue* wq = &eng->queues[i];
-    if(wq->used < WORKERDEPTH){
-      wq->qstates[wq->writeto] = qs;
-      ++wq->used;
-      ++usecount;
-      if(++wq->writeto == WORKERDEPTH){
-        wq->writeto = 0;
-      }
-    }
-  }
-  qs->refcount = usecount;
-  pthread_mutex_unlock(&eng->lock);
-  if(usecount){
-    pthread_cond_broadcast(&eng->cond);
-  }
+sixel_worker(void* vqs, unsigned idx){
+  qstate* qs = vqs;
+  qs->work(qs, idx);
 }
 
-// block until all workers have finished up with |qs|
+// run |work| on |qs| with the calling thread and up to |helpers| threads of
+// the pool, returning once all are done with it. without an engine, or with
+// nothing to share, the calling thread does all the work itself.
 static void
-block_on_workers(sixel_engine* eng, qstate* qs){
-  if(eng == NULL){
+run_on_workers(const sixel_engine* eng, qstate* qs, int helpers,
+               int (*work)(qstate*, unsigned)){
+  qs->work = work;
+  if(eng == NULL || helpers <= 0){
+    work(qs, 0);
     return;
   }
-  pthread_mutex_lock(&eng->lock);
-  while(qs->refcount){
-    pthread_cond_wait(&eng->cond, &eng->lock);
+  if(helpers > (int)eng->helpers){
+    helpers = eng->helpers;
   }
-  pthread_mutex_unlock(&eng->lock);
+  ncworkers_run(helpers + 1, helpers + 1, sixel_worker, qs);
 }
 
 // returns the number of individual sixels necessary to represent the specified
@@ -190,6 +270,7 @@ sixelmap_create(int dimy){
   sixelmap* ret = malloc(sizeof(*ret));
   if(ret){
     ret->p2 = SIXEL_P2_ALLOPAQUE;
+    ret->quant = SIXEL_QUANT_OCTREE;
     // they'll be initialized by their workers, possibly in parallel
     ret->sixelbands = sixelbandcount(dimy);
     ret->bands = malloc(sizeof(*ret->bands) * ret->sixelbands);
@@ -199,6 +280,11 @@ sixelmap_create(int dimy){
     }
     for(int i = 0 ; i < ret->sixelbands ; ++i){
       ret->bands[i].size = 0;
+      ret->bands[i].vecs = NULL;
+      ret->bands[i].hash = 0;
+      ret->bands[i].cellcols = 0;
+      ret->bands[i].cellcoloff = NULL;
+      ret->bands[i].cellcolors = NULL;
     }
     ret->colors = 0;
   }
@@ -211,6 +297,8 @@ sixelband_free(sixelband* s){
     free(s->vecs[j]);
   }
   free(s->vecs);
+  free(s->cellcoloff);
+  free(s->cellcolors);
 }
 
 void sixelmap_free(sixelmap *s){
@@ -223,27 +311,103 @@ void sixelmap_free(sixelmap *s){
   }
 }
 
-// convert rgb [0..255] to sixel [0..99]
+// deep copy of |s|, adding its size to |*bytes|.
+static sixelmap*
+sixelmap_dup(const sixelmap* s, size_t* bytes){
+  sixelmap* ret = sixelmap_create(s->sixelbands * 6);
+  if(ret == NULL){
+    return NULL;
+  }
+  ret->colors = s->colors;
+  ret->p2 = s->p2;
+  ret->quant = s->quant;
+  *bytes += sizeof(*ret) + sizeof(*ret->bands) * ret->sixelbands;
+  for(int i = 0 ; i < s->sixelbands ; ++i){
+    const sixelband* sb = &s->bands[i];
+    sixelband* b = &ret->bands[i];
+    b->hash = sb->hash;
+    if(sb->size){
+      if((b->vecs = calloc(sb->size, sizeof(*b->vecs))) == NULL){
+        goto err;
+      }
+      b->size = sb->size;
+      *bytes += sizeof(*b->vecs) * b->size;
+      for(int j = 0 ; j < sb->size ; ++j){
+        if(sb->vecs[j]){
+          if((b->vecs[j] = strdup(sb->vecs[j])) == NULL){
+            goto err;
+          }
+          *bytes += strlen(b->vecs[j]) + 1;
+        }
+      }
+    }
+    if(sb->cellcoloff){
+      const size_t offlen = sizeof(*b->cellcoloff) * (sb->cellcols + 1);
+      const size_t collen = sizeof(*b->cellcolors) * sb->cellcoloff[sb->cellcols];
+      if((b->cellcoloff = malloc(offlen)) == NULL){
+        goto err;
+      }
+      memcpy(b->cellcoloff, sb->cellcoloff, offlen);
+      b->cellcols = sb->cellcols;
+      if(collen){
+        if((b->cellcolors = malloc(collen)) == NULL){
+          goto err;
+        }
+        memcpy(b->cellcolors, sb->cellcolors, collen);
+      }
+      *bytes += offlen + collen;
+    }
+  }
+  return ret;
+
+err:
+  sixelmap_free(ret);
+  return NULL;
+}
+
+// convert rgb [0..255] to sixel [0..99]. this is round(c * 100 / 255), done
+// in integers (c * 100 / 255 is never exactly halfway between two integers).
+#define SSCALE(c) (((c) * 200u + 255u) / 510u > 99 ? 99 : ((c) * 200u + 255u) / 510u)
+
 static inline unsigned
 ss(unsigned c){
-  unsigned r = round(c * 100.0 / 255); // use real [0..100] scaling
-  return r > 99 ? 99: r;
+  return SSCALE(c);
 }
 
+// each scaled component contributes its tens digit to the static qnode key,
+// and whether its ones digit is at least 5 to the onode subkey. we precompute
+// both (as tens << 1 | half) for each possible component value, so that keying
+// a pixel is three lookups rather than three divisions and a dozen more.
+#define QKEYPART(c) ((SSCALE(c) / 10) << 1u | (SSCALE(c) % 10) / 5)
+#define QKP4(c) QKEYPART(c), QKEYPART((c) + 1), QKEYPART((c) + 2), QKEYPART((c) + 3)
+#define QKP16(c) QKP4(c), QKP4((c) + 4), QKP4((c) + 8), QKP4((c) + 12)
+#define QKP64(c) QKP16(c), QKP16((c) + 16), QKP16((c) + 32), QKP16((c) + 48)
+static const unsigned char qkeyparts[256] = {
+  QKP64(0u), QKP64(64u), QKP64(128u), QKP64(192u)
+};
+#undef QKP64
+#undef QKP16
+#undef QKP4
+#undef QKEYPART
+
 // get the keys for an rgb point. the returned value is on [0..999], and maps
 // to a static qnode. the second value is on [0..7], and maps within the
 // fractured onode (if necessary).
 static inline unsigned
 qnode_keys(unsigned r, unsigned g, unsigned b, unsigned *skey){
-  unsigned ssr = ss(r);
-  unsigned ssg = ss(g);
-  unsigned ssb = ss(b);
-  unsigned ret = ssr / 10 * 100 + ssg / 10 * 10 + ssb / 10;
-  *skey = (((ssr % 10) / 5) << 2u) +
-          (((ssg % 10) / 5) << 1u) +
-          ((ssb % 10) / 5);
-//fprintf(stderr, "0x%02x 0x%02x 0x%02x %02u %02u %02u %u %u\n", r, g, b, ssr, ssg, ssb, ret, *skey);
-  return ret;
+  const unsigned kr = qkeyparts[r];
+  const unsigned kg = qkeyparts[g];
+  const unsigned kb = qkeyparts[b];
+  *skey = ((kr & 1u) << 2u) | ((kg & 1u) << 1u) | (kb & 1u);
+  return (kr >> 1u) * 100 + (kg >> 1u) * 10 + (kb >> 1u);
+}
+
+static inline unsigned
+qslot_idx(uint32_t pixel){
+  unsigned skey;
+  const unsigned key = qnode_keys(ncpixel_r(pixel), ncpixel_g(pixel),
+                                  ncpixel_b(pixel), &skey);
+  return key * 8 + skey;
 }
 
 // have we been chosen for the color table?
@@ -263,8 +427,6 @@ qidx(const qnode* q){
   return q->cidx & ~0x8000u;
 }
 
-#define QNODECOUNT 1000
-
 // create+zorch an array of QNODECOUNT qnodes. this is 1000 entries covering
 // 1000 sixel colors each (we pretend 100 doesn't exist, working on [0..99],
 // heh). in addition, at the end we allocate |colorregs| qnodes, to be used
@@ -296,6 +458,9 @@ alloc_qstate(unsigned colorregs){
     // when we pull a dynamic one that it needs its popcount initialized.
     memset(qs->qnodes, 0, sizeof(qnode) * QNODECOUNT);
     qs->table = NULL;
+    qs->used = NULL;
+    qs->fixedlevels = 0;
+    qs->fixedgreys = 0;
   }
   return qs;
 }
@@ -308,6 +473,7 @@ free_qstate(qstate *qs){
     free(qs->qnodes);
     free(qs->onodes);
     free(qs->table);
+    free(qs->used);
     free(qs);
   }
 }
@@ -449,6 +615,7 @@ struct band_extender {
   int rle;    // current rep count of non-zero sixel for this color
   int wrote;  // number of sixels we've written out
   int rep;    // representation, 0..63
+  int cellcol; // one-biased last cell column indexed with this color
 };
 
 // add the supplied rle section to the appropriate vector, which might
@@ -641,10 +808,15 @@ wipe_band(sixelmap* smap, int band, int startx, int endx,
   }
 //fprintf(stderr, "******************** BAND %d MASK 0x%x ********************8\n", band, mask);
   sixelband* b = &smap->bands[band];
-  // offset into map->data where our color starts
-  for(int i = 0 ; i < b->size ; ++i){
-    wiped += wipe_color(b, i, band * 6, endy, startx, endx, mask,
-                        dimx, auxvec, cellpxy, cellpxx);
+  b->hash = 0; // no longer matches its source
+  // only those colors present in the cell's column can be wiped
+  const int col = startx / cellpxx;
+  if(col >= b->cellcols){
+    return 0;
+  }
+  for(int i = b->cellcoloff[col] ; i < b->cellcoloff[col + 1] ; ++i){
+    wiped += wipe_color(b, b->cellcolors[i], band * 6, endy, startx, endx,
+                        mask, dimx, auxvec, cellpxy, cellpxx);
   }
   return wiped;
 }
@@ -941,6 +1113,53 @@ load_color_table(const qstate* qs){
   assert(loaded == qs->smap->colors);
 }
 
+// map |pixel|, at |y|/|x| relative to the origin of the blit, into the fixed
+// palette. each component is taken to its nearest level in the cube, and the
+// pixel's mean to its nearest grey, whichever of the two is closer winning.
+// dithering replaces the rounding threshold with one from bayer4.
+static inline int
+fixed_color(const qstate* qs, uint32_t pixel, int y, int x){
+  const int n = qs->fixedlevels;
+  const int greys = qs->fixedgreys;
+  const int t = qs->smap->quant == SIXEL_QUANT_FIXED_DITHER ?
+                bayer4[y & 3][x & 3] * 16 + 8 : 127;
+  const int r = ncpixel_r(pixel);
+  const int g = ncpixel_g(pixel);
+  const int b = ncpixel_b(pixel);
+  const int lr = (r * (n - 1) + t) / 255;
+  const int lg = (g * (n - 1) + t) / 255;
+  const int lb = (b * (n - 1) + t) / 255;
+  const int cube = (lr * n + lg) * n + lb;
+  // on [0..greys + 1], where the ends are black and white (in the cube)
+  const int gl = ((r + g + b) * (greys + 1) + t * 3) / 765;
+  if(gl == 0 || gl > greys){
+    return cube;
+  }
+  const int gv = gl * 255 / (greys + 1);
+  const int dr = r - lr * 255 / (n - 1);
+  const int dg = g - lg * 255 / (n - 1);
+  const int db = b - lb * 255 / (n - 1);
+  const int cdist = dr * dr + dg * dg + db * db;
+  const int gdist = (r - gv) * (r - gv) + (g - gv) * (g - gv) + (b - gv) * (b - gv);
+  return gdist < cdist ? n * n * n + gl - 1 : cube;
+}
+
+// add |color| to the band's cell color index, growing it as necessary.
+static inline int
+index_cellcolor(sixelband* b, int* count, int* cap, int color){
+  if(*count == *cap){
+    const int ncap = *cap ? *cap * 2 : b->cellcols * 4;
+    uint16_t* tmp = realloc(b->cellcolors, sizeof(*tmp) * ncap);
+    if(tmp == NULL){
+      return -1;
+    }
+    b->cellcolors = tmp;
+    *cap = ncap;
+  }
+  b->cellcolors[(*count)++] = color;
+  return 0;
+}
+
 // build up a sixel band from (up to) 6 rows of the source RGBA.
 static inline int
 build_sixel_band(qstate* qs, int bnum){
@@ -960,6 +1179,15 @@ build_sixel_band(qstate* qs, int bnum){
   }
   memset(b->vecs, 0, bsize);
   memset(meta, 0, mlen);
+  const int cellpxx = qs->bargs->u.pixel.cellpxx;
+  b->cellcols = (qs->bargs->begx + qs->lenx + cellpxx - 1) / cellpxx;
+  if((b->cellcoloff = malloc(sizeof(*b->cellcoloff) * (b->cellcols + 1))) == NULL){
+    free(meta);
+    return -1;
+  }
+  int curcol = -1;   // cell column we're indexing
+  int indexed = 0;   // entries in b->cellcolors
+  int indexcap = 0;  // capacity of b->cellcolors
   const int ystart = qs->bargs->begy + bnum * 6;
   const int endy = (bnum + 1 == qs->smap->sixelbands ?
                                  qs->leny - qs->bargs->begy : ystart + 6);
@@ -980,16 +1208,18 @@ build_sixel_band(qstate* qs, int bnum){
     // this color: possibly a non-zero rep, possibly followed by a zero-rep (we
     // can have zero, either, or both).
     int activepos = 0; // number of active entries used
+    const int col = x / cellpxx;
+    while(curcol < col){
+      b->cellcoloff[++curcol] = indexed;
+    }
     for(int y = ystart ; y < endy ; ++y){
       const uint32_t* rgb = (qs->data + (qs->linesize / 4 * y) + x);
       if(rgba_trans_p(*rgb, qs->bargs->transcolor)){
         continue;
       }
-      int cidx = find_color(qs, *rgb);
-      if(cidx < 0){
-        free(meta);
-        return -1;
-      }
+      const int cidx = qs->fixedlevels ?
+        fixed_color(qs, *rgb, y - qs->bargs->begy, x - qs->bargs->begx) :
+        qs->slotmap[qslot_idx(*rgb)];
       int act;
       for(act = 0 ; act < activepos ; ++act){
         if(active[act].color == cidx){
@@ -1007,6 +1237,13 @@ build_sixel_band(qstate* qs, int bnum){
     // and if not, write out whatever came before us.
     for(int i = 0 ; i < activepos ; ++i){
       const int c = active[i].color;
+      if(meta[c].cellcol != col + 1){
+        if(index_cellcolor(b, &indexed, &indexcap, c)){
+          free(meta);
+          return -1;
+        }
+        meta[c].cellcol = col + 1;
+      }
       if(meta[c].rep == active[i].rep && meta[c].rle + meta[c].wrote == x){
         ++meta[c].rle;
       }else{
@@ -1032,14 +1269,71 @@ build_sixel_band(qstate* qs, int bnum){
       b->vecs[i] = NULL;
     }
   }
+  while(curcol < b->cellcols){
+    b->cellcoloff[++curcol] = indexed;
+  }
   free(meta);
   return 0;
 }
 
+// hash the source pixels of band |bnum|. the band's geometry, the cell width,
+// and the transparent color are mixed in, since they too determine its
+// encoding (or its cell color index). never returns 0, which marks a band
+// as unhashed.
+static uint64_t
+hash_sixel_band(const qstate* qs, int bnum){
+  const int ystart = qs->bargs->begy + bnum * 6;
+  const int endy = (bnum + 1 == qs->smap->sixelbands ?
+                                 qs->leny - qs->bargs->begy : ystart + 6);
+  uint64_t h = ((uint64_t)qs->bargs->u.pixel.cellpxx << 56u) ^
+               ((uint64_t)qs->bargs->transcolor << 32u) ^
+               ((uint64_t)(endy - ystart) << 24u) ^ (uint64_t)qs->lenx;
+  for(int y = ystart ; y < endy ; ++y){
+    const uint32_t* rgb = qs->data + (qs->linesize / 4 * y) + qs->bargs->begx;
+    for(int x = 0 ; x < qs->lenx ; ++x){
+      // each step is a bijection, so no single changed pixel goes unnoticed
+      h = (h ^ rgb[x]) * 0x9e3779b97f4a7c15ull;
+      h ^= h >> 29u;
+    }
+  }
+  return h ? h : 1;
+}
+
+// take band |bnum| from the previous frame's sixelmap, if its source pixels
+// hash the same. returns true if the band was taken.
+static bool
+reuse_sixel_band(qstate* qs, int bnum){
+  sixelmap* prev = qs->prevmap;
+  if(prev == NULL || bnum >= prev->sixelbands){
+    return false;
+  }
+  sixelband* pb = &prev->bands[bnum];
+  if(pb->hash != qs->smap->bands[bnum].hash || pb->size != qs->smap->colors){
+    return false;
+  }
+  sixelband* b = &qs->smap->bands[bnum];
+  b->size = pb->size;
+  b->vecs = pb->vecs;
+  b->cellcols = pb->cellcols;
+  b->cellcoloff = pb->cellcoloff;
+  b->cellcolors = pb->cellcolors;
+  pb->size = 0;
+  pb->vecs = NULL;
+  pb->cellcoloff = NULL;
+  pb->cellcolors = NULL;
+  ++qs->reusedbands;
+  return true;
+}
+
 static int
-bandworker(qstate* qs){
+bandworker(qstate* qs, unsigned idx){
+  (void)idx;
   int b;
   while((b = qs->bandbuilder++) < qs->smap->sixelbands){
+    qs->smap->bands[b].hash = hash_sixel_band(qs, b);
+    if(reuse_sixel_band(qs, b)){
+      continue;
+    }
     if(build_sixel_band(qs, b) < 0){
       return -1;
     }
@@ -1057,20 +1351,20 @@ build_data_table(sixel_engine* sengine, qstate* qs){
     return -1;
   }
   qs->bandbuilder = 0;
-  enqueue_to_workers(sengine, qs);
-  size_t tsize = RGBSIZE * smap->colors;
-  qs->table = malloc(tsize);
-  if(qs->table == NULL){
-    return -1;
+  qs->reusedbands = 0;
+  // we'll be building bands ourselves, so we want at most one fewer helpers
+  run_on_workers(sengine, qs, smap->sixelbands - 1, bandworker);
+  if(qs->prevmap){
+    loginfo("reused %d/%d bands", (int)qs->reusedbands, smap->sixelbands);
   }
-  load_color_table(qs);
-  bandworker(qs);
-  block_on_workers(sengine, qs);
   return 0;
 }
 
-static inline int
-extract_cell_color_table(qstate* qs, long cellid){
+// accumulate the pixels of the cell |cellid| into |h|, and set up its TAM
+// entry. cells are independent of one another, and can thus be extracted in
+// parallel (so long as each thread has its own qhist).
+static inline void
+extract_cell_color_table(qstate* qs, long cellid, qhist* h){
   const int ccols = qs->bargs->u.pixel.spx->dimx;
   const long x = cellid % ccols;
   const long y = cellid / ccols;
@@ -1098,10 +1392,13 @@ extract_cell_color_table(qstate* qs, long cellid){
   // transparent to mixed.
   if(cstarty >= cendy){ // we're entirely transparent sixel overhead
     tam[cellid].state = SPRIXCELL_TRANSPARENT;
-    qs->smap->p2 = SIXEL_P2_TRANS; // even one forces P2=1
+    h->p2trans = true; // even one forces P2=1
     // FIXME need we set rmatrix?
-    return 0;
+    return;
   }
+  // sequence numbers follow a row-major walk of cells, and of pixels within
+  // each cell, so that merged qhists know which pixel came first.
+  const uint64_t seqbase = (uint64_t)cellid * cdimy * cdimx + 1;
   const uint32_t* rgb = (qs->data + (qs->linesize / 4 * cstarty) + cstartx);
   if(tam[cellid].state == SPRIXCELL_ANNIHILATED || tam[cellid].state == SPRIXCELL_ANNIHILATED_TRANS){
     if(rgba_trans_p(*rgb, qs->bargs->transcolor)){
@@ -1148,11 +1445,13 @@ extract_cell_color_table(qstate* qs, long cellid){
         }
       }
 //fprintf(stderr, "vis: %d/%d\n", visy, visx);
-      if(rgba_trans_p(*rgb, qs->bargs->transcolor)){
-        continue;
+      if(rgba_trans_p(*rgb, qs->bargs->transcolor) || qs->fixedlevels){
+        continue; // the fixed palette has no use for a histogram
       }
-      if(insert_color(qs, *rgb)){
-        return -1;
+      qslot* slot = &h->slots[qslot_idx(*rgb)];
+      if(slot->pop++ == 0){
+        slot->first = seqbase + (visy - cstarty) * cdimx + (visx - cstartx);
+        slot->pixel = *rgb;
       }
     }
   }
@@ -1160,11 +1459,560 @@ extract_cell_color_table(qstate* qs, long cellid){
   if(tam[cellid].state == SPRIXCELL_OPAQUE_SIXEL){
     rmatrix[cellid] = 0;
   }else{
-    qs->smap->p2 = SIXEL_P2_TRANS; // even one forces P2=1
+    h->p2trans = true; // even one forces P2=1
+  }
+}
+
+// extract rows of cells into |h| until none remain.
+static void
+extract_rows(qstate* qs, qhist* h){
+  const int crows = qs->bargs->u.pixel.spx->dimy;
+  const int ccols = qs->bargs->u.pixel.spx->dimx;
+  int y;
+  while((y = qs->rowextractor++) < crows){
+    for(int x = 0 ; x < ccols ; ++x){
+      extract_cell_color_table(qs, (long)y * ccols + x, h);
+    }
   }
+}
+
+// a thread's share of extraction. job 0 accumulates into the first qhist,
+// which is always present; other jobs need one of their own. if they can't
+// get it, they just don't participate, and job 0 picks up the slack.
+static int
+extractworker(qstate* qs, unsigned idx){
+  qhist* h = qs->hists[0];
+  if(idx){
+    if((h = calloc(1, sizeof(*h))) == NULL){
+      return -1;
+    }
+    qs->hists[qs->participants++] = h;
+  }
+  extract_rows(qs, h);
   return 0;
 }
 
+static int
+qslotcmp(const void* s1, const void* s2){
+  const qslot* a = s1;
+  const qslot* b = s2;
+  return a->first < b->first ? -1 : a->first > b->first;
+}
+
+// merge the participants' qhists into the first, returning the total number
+// of pixels seen.
+static uint64_t
+merge_qhists(qstate* qs){
+  qhist* h = qs->hists[0];
+  const int participants = qs->participants;
+  for(int p = 1 ; p < participants ; ++p){
+    const qhist* ph = qs->hists[p];
+    h->p2trans |= ph->p2trans;
+    for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+      const qslot* ps = &ph->slots[i];
+      if(ps->pop){
+        qslot* s = &h->slots[i];
+        if(s->pop == 0 || ps->first < s->first){
+          s->first = ps->first;
+          s->pixel = ps->pixel;
+        }
+        s->pop += ps->pop;
+      }
+    }
+  }
+  if(h->p2trans){
+    qs->smap->p2 = SIXEL_P2_TRANS;
+  }
+  uint64_t pixels = 0;
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    pixels += h->slots[i].pop;
+  }
+  return pixels;
+}
+
+// build the octree from the merged qhist |h|, destroying |h|'s indexing. slots
+// are inserted in order of their first pixels, exactly as if we had inserted
+// every pixel in sequence, after which we add their remaining populations.
+// returns the number of slots used, which are left at the front of |h|.
+static int
+build_octree(qstate* qs, qhist* h){
+  // a slot's index can be recovered from its pixel, so compact the used
+  // slots to the front, and sort them into insertion order.
+  unsigned used = 0;
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    if(h->slots[i].pop){
+      h->slots[used++] = h->slots[i];
+    }
+  }
+  qsort(h->slots, used, sizeof(*h->slots), qslotcmp);
+  for(unsigned i = 0 ; i < used ; ++i){
+    if(insert_color(qs, h->slots[i].pixel)){
+      return -1;
+    }
+  }
+  for(unsigned i = 0 ; i < used ; ++i){
+    const uint32_t pixel = h->slots[i].pixel;
+    unsigned skey;
+    const unsigned key = qnode_keys(ncpixel_r(pixel), ncpixel_g(pixel),
+                                    ncpixel_b(pixel), &skey);
+    qnode* q = &qs->qnodes[key];
+    if(q->qlink){ // fractured; every slot seen has its own subnode
+      q = qs->onodes[q->qlink - 1].q[skey];
+    }
+    q->q.pop += h->slots[i].pop - 1;
+  }
+  return used;
+}
+
+void sixelpalette_free(sixelpalette* pal){
+  if(pal){
+    free(pal->table);
+    free(pal);
+  }
+}
+
+// can the frame described by |h| (having |pixels| pixels) reuse |pal|?
+static bool
+palette_reusable(const sixelpalette* pal, const qhist* h, uint64_t pixels,
+                 int colorregs, sixel_quant_e quant){
+  if(pal->quant != quant || pal->colorregs != colorregs ||
+     pixels == 0 || pal->pixels == 0){
+    return false;
+  }
+  uint64_t misses = 0;
+  double drift = 0;
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    const uint32_t pop = h->slots[i].pop;
+    if(pop && pal->cidx[i] == QSLOT_NOCOLOR){
+      misses += pop;
+    }
+    const double d = (double)pop / pixels - (double)pal->pops[i] / pal->pixels;
+    drift += d < 0 ? -d : d;
+  }
+  loginfo("palette drift %.3f, %" PRIu64 "/%" PRIu64 " unseen", drift, misses, pixels);
+  return misses * PALETTE_MISS_DIV <= pixels && drift <= PALETTE_DRIFT_MAX;
+}
+
+// the index of the entry in |table| closest to the sixel-scaled color |rgb|
+static unsigned
+nearest_entry(const unsigned char* table, int colors, const unsigned char* rgb){
+  const int r = rgb[0];
+  const int g = rgb[1];
+  const int b = rgb[2];
+  unsigned best = 0;
+  int bestdist = INT_MAX;
+  for(int i = 0 ; i < colors ; ++i){
+    const unsigned char* e = table + i * RGBSIZE;
+    const int dr = r - e[0];
+    const int dg = g - e[1];
+    const int db = b - e[2];
+    const int dist = dr * dr + dg * dg + db * db;
+    if(dist < bestdist){
+      bestdist = dist;
+      best = i;
+    }
+  }
+  return best;
+}
+
+// the index of the entry in |table| closest to |pixel|
+static unsigned
+nearest_color(const unsigned char* table, int colors, uint32_t pixel){
+  const unsigned char rgb[RGBSIZE] = {
+    ss(ncpixel_r(pixel)), ss(ncpixel_g(pixel)), ss(ncpixel_b(pixel)),
+  };
+  return nearest_entry(table, colors, rgb);
+}
+
+// quantize against the retained palette |pal|.
+static int
+reuse_palette(qstate* qs, sixelpalette* pal, const qhist* h){
+  qs->smap->colors = pal->colors;
+  if((qs->table = malloc(RGBSIZE * pal->colors)) == NULL){
+    return -1;
+  }
+  memcpy(qs->table, pal->table, RGBSIZE * pal->colors);
+  if((qs->used = calloc(pal->colors, sizeof(*qs->used))) == NULL){
+    return -1;
+  }
+  memcpy(qs->slotmap, pal->cidx, sizeof(qs->slotmap));
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    if(h->slots[i].pop){
+      if(qs->slotmap[i] == QSLOT_NOCOLOR){
+        if(pal->nearest[i] == QSLOT_NOCOLOR){
+          pal->nearest[i] = nearest_color(qs->table, pal->colors, h->slots[i].pixel);
+        }
+        qs->slotmap[i] = pal->nearest[i];
+      }
+      qs->used[qs->slotmap[i]] = 1;
+    }
+  }
+  return 0;
+}
+
+// quantize the merged qhist |h| using the octree, destroying |h|.
+static int
+octree_palette(qstate* qs, qhist* h){
+  int used = build_octree(qs, h);
+  if(used < 0){
+    return -1;
+  }
+  loginfo("octree got %"PRIu32" entries", qs->smap->colors);
+  if(merge_color_table(qs)){
+    return -1;
+  }
+  if((qs->table = malloc(RGBSIZE * qs->smap->colors)) == NULL){
+    return -1;
+  }
+  load_color_table(qs);
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    qs->slotmap[i] = QSLOT_NOCOLOR;
+  }
+  for(int i = 0 ; i < used ; ++i){
+    const int cidx = find_color(qs, h->slots[i].pixel);
+    if(cidx < 0){
+      return -1;
+    }
+    qs->slotmap[qslot_idx(h->slots[i].pixel)] = cidx;
+  }
+  return 0;
+}
+
+// a qslot, as seen by median cut. its color is that of its first pixel.
+typedef struct mcpoint {
+  unsigned char rgb[RGBSIZE]; // sixel-scaled
+  uint32_t pop;
+  unsigned slot;
+} mcpoint;
+
+// a box of contiguous mcpoints
+typedef struct mcbox {
+  unsigned first;
+  unsigned count;
+  uint64_t pop;
+  int axis;       // component having the greatest range
+  int range;      // that range; the box can't be split if it's 0
+} mcbox;
+
+static void
+mcbox_measure(mcbox* box, const mcpoint* pts){
+  unsigned char lo[RGBSIZE] = { 255, 255, 255 };
+  unsigned char hi[RGBSIZE] = { 0, 0, 0 };
+  box->pop = 0;
+  for(unsigned i = box->first ; i < box->first + box->count ; ++i){
+    box->pop += pts[i].pop;
+    for(int c = 0 ; c < RGBSIZE ; ++c){
+      if(pts[i].rgb[c] < lo[c]){
+        lo[c] = pts[i].rgb[c];
+      }
+      if(pts[i].rgb[c] > hi[c]){
+        hi[c] = pts[i].rgb[c];
+      }
+    }
+  }
+  box->axis = 0;
+  box->range = 0;
+  for(int c = 0 ; c < RGBSIZE ; ++c){
+    if(hi[c] - lo[c] > box->range){
+      box->range = hi[c] - lo[c];
+      box->axis = c;
+    }
+  }
+}
+
+static int
+mcpointcmp_r(const void* p1, const void* p2){
+  return ((const mcpoint*)p1)->rgb[0] - ((const mcpoint*)p2)->rgb[0];
+}
+
+static int
+mcpointcmp_g(const void* p1, const void* p2){
+  return ((const mcpoint*)p1)->rgb[1] - ((const mcpoint*)p2)->rgb[1];
+}
+
+static int
+mcpointcmp_b(const void* p1, const void* p2){
+  return ((const mcpoint*)p1)->rgb[2] - ((const mcpoint*)p2)->rgb[2];
+}
+
+static int (* const mcpointcmps[RGBSIZE])(const void*, const void*) = {
+  mcpointcmp_r, mcpointcmp_g, mcpointcmp_b,
+};
+
+// split |box| at the weighted median along its longest axis, writing the
+// upper half to |upper|.
+static void
+mcbox_split(mcbox* box, mcbox* upper, mcpoint* pts){
+  qsort(pts + box->first, box->count, sizeof(*pts), mcpointcmps[box->axis]);
+  const uint64_t half = box->pop / 2;
+  uint64_t acc = 0;
+  unsigned lower;
+  for(lower = 1 ; lower < box->count - 1 ; ++lower){
+    if((acc += pts[box->first + lower - 1].pop) >= half){
+      break;
+    }
+  }
+  upper->first = box->first + lower;
+  upper->count = box->count - lower;
+  box->count = lower;
+  mcbox_measure(box, pts);
+  mcbox_measure(upper, pts);
+}
+
+// assign each of the |n| |pts| to its nearest of the |k| entries of |table|,
+// and move each entry to the mean of its points. entries left without any
+// points are kept where they were. populations are written to |pops|.
+static void
+kmeans_round(const mcpoint* pts, unsigned n, unsigned char* table, int k,
+             uint16_t* assign, uint64_t* sums, uint64_t* pops){
+  memset(sums, 0, sizeof(*sums) * RGBSIZE * k);
+  memset(pops, 0, sizeof(*pops) * k);
+  for(unsigned i = 0 ; i < n ; ++i){
+    const unsigned e = nearest_entry(table, k, pts[i].rgb);
+    assign[i] = e;
+    pops[e] += pts[i].pop;
+    for(int c = 0 ; c < RGBSIZE ; ++c){
+      sums[e * RGBSIZE + c] += (uint64_t)pts[i].rgb[c] * pts[i].pop;
+    }
+  }
+  for(int e = 0 ; e < k ; ++e){
+    if(pops[e]){
+      for(int c = 0 ; c < RGBSIZE ; ++c){
+        table[e * RGBSIZE + c] = (sums[e * RGBSIZE + c] + pops[e] / 2) / pops[e];
+      }
+    }
+  }
+}
+
+// quantize the merged qhist |h| using median cut: boxes of qslots are split
+// until we run out of either color registers or boxes which can be split,
+// and the boxes' means then refined by a few rounds of k-means.
+static int
+mediancut_palette(qstate* qs, const qhist* h){
+  unsigned n = 0;
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    n += !!h->slots[i].pop;
+  }
+  if(n == 0){ // wholly transparent
+    qs->smap->colors = 0;
+    return (qs->table = malloc(RGBSIZE)) ? 0 : -1;
+  }
+  const int colorregs = qs->bargs->u.pixel.colorregs;
+  const int maxk = (unsigned)colorregs < n ? colorregs : (int)n;
+  mcpoint* pts = malloc(sizeof(*pts) * n);
+  mcbox* boxes = malloc(sizeof(*boxes) * maxk);
+  uint16_t* assign = malloc(sizeof(*assign) * n);
+  uint64_t* sums = malloc(sizeof(*sums) * RGBSIZE * maxk);
+  uint64_t* pops = malloc(sizeof(*pops) * maxk);
+  unsigned char* table = malloc(RGBSIZE * maxk);
+  int ret = -1;
+  if(!pts || !boxes || !assign || !sums || !pops || !table){
+    goto done;
+  }
+  n = 0;
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    if(h->slots[i].pop){
+      pts[n].rgb[0] = ss(ncpixel_r(h->slots[i].pixel));
+      pts[n].rgb[1] = ss(ncpixel_g(h->slots[i].pixel));
+      pts[n].rgb[2] = ss(ncpixel_b(h->slots[i].pixel));
+      pts[n].pop = h->slots[i].pop;
+      pts[n].slot = i;
+      ++n;
+    }
+  }
+  int k = 1;
+  boxes[0].first = 0;
+  boxes[0].count = n;
+  mcbox_measure(&boxes[0], pts);
+  while(k < maxk){
+    int best = -1;
+    uint64_t bestscore = 0;
+    for(int b = 0 ; b < k ; ++b){
+      const uint64_t score = boxes[b].range * boxes[b].pop;
+      if(score > bestscore){
+        bestscore = score;
+        best = b;
+      }
+    }
+    if(best < 0){
+      break;
+    }
+    mcbox_split(&boxes[best], &boxes[k++], pts);
+  }
+  for(int b = 0 ; b < k ; ++b){
+    for(unsigned i = boxes[b].first ; i < boxes[b].first + boxes[b].count ; ++i){
+      assign[i] = b;
+    }
+  }
+  // seed the k-means with the boxes' means
+  memset(sums, 0, sizeof(*sums) * RGBSIZE * k);
+  for(int b = 0 ; b < k ; ++b){
+    for(unsigned i = boxes[b].first ; i < boxes[b].first + boxes[b].count ; ++i){
+      for(int c = 0 ; c < RGBSIZE ; ++c){
+        sums[b * RGBSIZE + c] += (uint64_t)pts[i].rgb[c] * pts[i].pop;
+      }
+    }
+    for(int c = 0 ; c < RGBSIZE ; ++c){
+      table[b * RGBSIZE + c] = (sums[b * RGBSIZE + c] + boxes[b].pop / 2) / boxes[b].pop;
+    }
+  }
+  for(int r = 0 ; r < MEDIANCUT_ROUNDS ; ++r){
+    kmeans_round(pts, n, table, k, assign, sums, pops);
+  }
+  // final assignment against the refined entries, dropping any left empty
+  for(unsigned i = 0 ; i < n ; ++i){
+    assign[i] = nearest_entry(table, k, pts[i].rgb);
+  }
+  memset(pops, 0, sizeof(*pops) * k);
+  for(unsigned i = 0 ; i < n ; ++i){
+    pops[assign[i]] += pts[i].pop;
+  }
+  if((qs->table = malloc(RGBSIZE * k)) == NULL){
+    goto done;
+  }
+  int colors = 0;
+  for(int e = 0 ; e < k ; ++e){
+    if(pops[e]){
+      memcpy(qs->table + colors * RGBSIZE, table + e * RGBSIZE, RGBSIZE);
+      pops[e] = colors++; // now the entry's final index
+    }
+  }
+  qs->smap->colors = colors;
+  for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+    qs->slotmap[i] = QSLOT_NOCOLOR;
+  }
+  for(unsigned i = 0 ; i < n ; ++i){
+    qs->slotmap[pts[i].slot] = pops[assign[i]];
+  }
+  loginfo("median cut got %d entries from %u slots", colors, n);
+  ret = 0;
+
+done:
+  free(table);
+  free(pops);
+  free(sums);
+  free(assign);
+  free(boxes);
+  free(pts);
+  return ret;
+}
+
+// load the fixed palette's cube and greys into the color table.
+static int
+fixed_palette(qstate* qs){
+  const int n = qs->fixedlevels;
+  const int greys = qs->fixedgreys;
+  qs->smap->colors = n * n * n + greys;
+  if((qs->table = malloc(RGBSIZE * qs->smap->colors)) == NULL){
+    return -1;
+  }
+  unsigned char* rgb = qs->table;
+  for(int r = 0 ; r < n ; ++r){
+    for(int g = 0 ; g < n ; ++g){
+      for(int b = 0 ; b < n ; ++b){
+        *rgb++ = ss(r * 255 / (n - 1));
+        *rgb++ = ss(g * 255 / (n - 1));
+        *rgb++ = ss(b * 255 / (n - 1));
+      }
+    }
+  }
+  for(int i = 1 ; i <= greys ; ++i){
+    const unsigned char v = ss(i * 255 / (greys + 1));
+    *rgb++ = v;
+    *rgb++ = v;
+    *rgb++ = v;
+  }
+  return 0;
+}
+
+// most images draw only part of the fixed palette. once the bands have been
+// built, note which entries they use, so that only those are defined.
+static int
+fixed_palette_used(qstate* qs){
+  if((qs->used = calloc(qs->smap->colors, sizeof(*qs->used))) == NULL){
+    return -1;
+  }
+  for(int b = 0 ; b < qs->smap->sixelbands ; ++b){
+    const sixelband* band = &qs->smap->bands[b];
+    for(int i = 0 ; i < band->size ; ++i){
+      if(band->vecs[i]){
+        qs->used[i] = 1;
+      }
+    }
+  }
+  return 0;
+}
+
+// build a new palette from the merged qhist |h|, having |pixels| pixels. if
+// the sprixel is being reblitted, it retains the palette (if possible) for
+// reuse by subsequent frames.
+static int
+build_palette(qstate* qs, qhist* h, uint64_t pixels){
+  sprixel* spx = qs->bargs->u.pixel.spx;
+  sixelpalette* pal = qs->recycled ? malloc(sizeof(*pal)) : NULL;
+  if(pal){ // capture populations before build_octree() destroys them
+    pal->quant = qs->smap->quant;
+    pal->pixels = pixels;
+    pal->colorregs = qs->bargs->u.pixel.colorregs;
+    pal->table = NULL;
+    for(unsigned i = 0 ; i < QSLOTCOUNT ; ++i){
+      pal->pops[i] = h->slots[i].pop;
+    }
+  }
+  int r;
+  if(qs->smap->quant == SIXEL_QUANT_MEDIANCUT){
+    r = mediancut_palette(qs, h);
+  }else{
+    r = octree_palette(qs, h);
+  }
+  if(r){
+    sixelpalette_free(pal);
+    return -1;
+  }
+  if(pal){
+    pal->colors = qs->smap->colors;
+    memcpy(pal->cidx, qs->slotmap, sizeof(pal->cidx));
+    memset(pal->nearest, 0xff, sizeof(pal->nearest)); // QSLOT_NOCOLOR
+    if((pal->table = malloc(RGBSIZE * pal->colors)) == NULL){
+      sixelpalette_free(pal);
+      pal = NULL;
+    }else{
+      memcpy(pal->table, qs->table, RGBSIZE * pal->colors);
+    }
+  }
+  sixelpalette_free(spx->palette);
+  spx->palette = pal;
+  return 0;
+}
+
+// select the quantizer requested by the blit's flags. the fixed palette needs
+// room for at least a 2x2x2 cube; failing that, we fall back to the octree.
+static void
+choose_quantizer(qstate* qs){
+  const uint64_t flags = qs->bargs->flags;
+  const int colorregs = qs->bargs->u.pixel.colorregs;
+  qs->smap->quant = SIXEL_QUANT_OCTREE;
+  if(flags & NCVISUAL_OPTION_FIXEDPALETTE){
+    int n = FIXED_LEVELS;
+    while(n > 1 && n * n * n > colorregs){
+      --n;
+    }
+    if(n < 2){
+      logwarn("%d color registers can't hold a fixed palette", colorregs);
+      return;
+    }
+    qs->fixedlevels = n;
+    qs->fixedgreys = colorregs - n * n * n;
+    if(qs->fixedgreys > FIXED_GREYS){
+      qs->fixedgreys = FIXED_GREYS;
+    }
+    qs->smap->quant = (flags & NCVISUAL_OPTION_DITHER) ?
+                      SIXEL_QUANT_FIXED_DITHER : SIXEL_QUANT_FIXED;
+  }else if(flags & NCVISUAL_OPTION_MEDIANCUT){
+    qs->smap->quant = SIXEL_QUANT_MEDIANCUT;
+  }
+}
+
 // we have a 4096-element array that takes the 4-5-3 MSBs from the RGB
 // components. once it's complete, we might need to either merge some
 // chunks, or expand them, converging towards the available number of
@@ -1183,22 +2031,50 @@ extract_color_table(sixel_engine* sengine, qstate* qs){
     return -1;
   }
   bargs->u.pixel.spx->needs_refresh = rmatrix;
-  long cellid = 0;
-  for(int y = 0 ; y < crows ; ++y){ // cell row
-    for(int x = 0 ; x < ccols ; ++x){ // cell column
-      if(extract_cell_color_table(qs, cellid)){
-        return -1;
-      }
-      ++cellid;
-    }
+  // one qhist for us, and one for each helper which might join us
+  int helpers = crows - 1;
+  if(helpers > (int)(sengine ? sengine->helpers : 0)){
+    helpers = sengine ? sengine->helpers : 0;
   }
-  loginfo("octree got %"PRIu32" entries", qs->smap->colors);
-  if(merge_color_table(qs)){
+  const int maxhists = helpers + 1;
+  if((qs->hists = calloc(maxhists, sizeof(*qs->hists))) == NULL){
+    return -1;
+  }
+  if((qs->hists[0] = calloc(1, sizeof(**qs->hists))) == NULL){
+    free(qs->hists);
+    qs->hists = NULL;
+    return -1;
+  }
+  qs->participants = 1;
+  qs->rowextractor = 0;
+  run_on_workers(sengine, qs, helpers, extractworker);
+  const uint64_t pixels = merge_qhists(qs);
+  sixelpalette* pal = bargs->u.pixel.spx->palette;
+  int ret;
+  if(qs->fixedlevels){
+    ret = fixed_palette(qs);
+  }else if(pal && palette_reusable(pal, qs->hists[0], pixels,
+                                   bargs->u.pixel.colorregs, qs->smap->quant)){
+    ret = reuse_palette(qs, pal, qs->hists[0]);
+  }else{
+    // the previous frame's bands use some other palette's indices
+    qs->prevmap = NULL;
+    ret = build_palette(qs, qs->hists[0], pixels);
+  }
+  for(int p = 0 ; p < qs->participants ; ++p){
+    free(qs->hists[p]);
+  }
+  free(qs->hists);
+  qs->hists = NULL;
+  if(ret){
     return -1;
   }
   if(build_data_table(sengine, qs)){
     return -1;
   }
+  if(qs->fixedlevels && fixed_palette_used(qs)){
+    return -1;
+  }
   loginfo("final palette: %u/%u colors", qs->smap->colors, qs->bargs->u.pixel.colorregs);
   return 0;
 }
@@ -1286,6 +2162,9 @@ write_sixel_header(qstate* qs, fbuf* f, int leny){
     return -1;
   }
   for(int i = 0 ; i < qs->smap->colors ; ++i){
+    if(qs->used && !qs->used[i]){
+      continue; // a reused palette needn't define registers we don't draw
+    }
     const unsigned char* rgb = qs->table + i * RGBSIZE;
     //fprintf(fp, "#%d;2;%u;%u;%u", i, rgb[0], rgb[1], rgb[2]);
     int rr = write_sixel_creg(f, i, rgb[0], rgb[1], rgb[2]);
@@ -1347,6 +2226,8 @@ sixel_reblit(sprixel* s){
     return -1;
   }
   change_p2(s->glyph.buf, s->smap->p2);
+  // wipes can shrink the payload substantially; don't hold onto the excess
+  fbuf_trim(&s->glyph, FBUF_SMALL_SIZE);
   return 0;
 }
 
@@ -1354,7 +2235,8 @@ sixel_reblit(sprixel* s){
 static inline int
 sixel_blit_inner(qstate* qs, sixelmap* smap, const blitterargs* bargs, tament* tam){
   fbuf f;
-  if(fbuf_init(&f)){
+  // only the header is written here; the payload grows the glyph in reblit
+  if(fbuf_init_small(&f)){
     return -1;
   }
   sprixel* s = bargs->u.pixel.spx;
@@ -1384,6 +2266,90 @@ sixel_blit_inner(qstate* qs, sixelmap* smap, const blitterargs* bargs, tament* t
   return 1;
 }
 
+// take the complete encoding of a cached blit, and a copy of its sixelmap
+// (against which any wipes will be made).
+static int
+sixel_blit_cached(ncplane* n, sprixel* s, const imgentry* e){
+  size_t bytes = 0;
+  sixelmap* smap = sixelmap_dup(e->smap, &bytes);
+  if(smap == NULL){
+    return -1;
+  }
+  fbuf f;
+  if(fbuf_init_small(&f)){
+    sixelmap_free(smap);
+    return -1;
+  }
+  if(fbuf_putn(&f, e->glyph.buf, e->glyph.used) < 0){
+    fbuf_free(&f);
+    sixelmap_free(smap);
+    return -1;
+  }
+  cleanup_tam(n->tam, s->dimy, s->dimx);
+  for(unsigned i = 0 ; i < s->dimy * s->dimx ; ++i){
+    n->tam[i].state = e->states[i];
+  }
+  if(plane_blit_sixel(s, &f, e->pixy, e->pixx, e->parse_start, n->tam,
+                      SPRIXEL_INVALIDATED) < 0){
+    fbuf_free(&f);
+    sixelmap_free(smap);
+    return -1;
+  }
+  // with no annihilated cells, there's nothing for sixel_refresh() to do
+  free(s->needs_refresh);
+  s->needs_refresh = NULL;
+  sixelmap_free(s->smap);
+  s->smap = smap;
+  // the cache doesn't keep palettes. the sprixel's isn't the one against
+  // which smap was quantized, and mustn't be reused along with its bands.
+  sixelpalette_free(s->palette);
+  s->palette = NULL;
+  s->wipes_outstanding = false;
+  loginfo("sprixel %u reuses %" PRIu64 "B of cached sixel", s->id, s->glyph.used);
+  return 1;
+}
+
+// write out the payload of a freshly-blitted sixel now, rather than at draw
+// time, so that it can be added to the cache.
+static int
+sixel_cache(struct imgcache* ic, const imgkey* key, sprixel* s,
+            const void* data, int linesize){
+  if(sixel_reblit(s)){
+    return -1;
+  }
+  s->wipes_outstanding = false;
+  imgentry* e = imgentry_create(ic, key);
+  if(e == NULL){
+    return -1;
+  }
+  const size_t tamlen = sizeof(*e->states) * s->dimy * s->dimx;
+  if((e->states = malloc(tamlen)) == NULL){
+    imgentry_destroy(e);
+    return -1;
+  }
+  for(unsigned i = 0 ; i < s->dimy * s->dimx ; ++i){
+    e->states[i] = s->n->tam[i].state;
+  }
+  e->bytes = tamlen + s->glyph.used;
+  if(fbuf_init_small(&e->glyph) || fbuf_putn(&e->glyph, s->glyph.buf, s->glyph.used) < 0 ||
+     (e->smap = sixelmap_dup(s->smap, &e->bytes)) == NULL){
+    imgentry_destroy(e);
+    return -1;
+  }
+  // lookups by pixels check them against ours. frames are known by index.
+  if(!key->frame && imgentry_keep_pixels(e, data, linesize)){
+    imgentry_destroy(e);
+    return -1;
+  }
+  e->pixy = s->pixy;
+  e->pixx = s->pixx;
+  e->parse_start = s->parse_start;
+  e->loaded = true;
+  imgcache_insert(ic, e);
+  imgcache_release(e);
+  return 0;
+}
+
 // |leny| and |lenx| are the scaled output geometry. we take |leny| up to the
 // nearest multiple of six greater than or equal to |leny|.
 int sixel_blit(ncplane* n, int linesize, const void* data, int leny, int lenx,
@@ -1392,8 +2358,27 @@ int sixel_blit(ncplane* n, int linesize, const void* data, int leny, int lenx,
     logerror("palette too large %d", bargs->u.pixel.colorregs);
     return -1;
   }
+  // the same pixels might have been encoded already, or have been blitted
+  // recently enough that we ought cache them this time.
+  struct imgcache* ic = imgcache_for(bargs->u.pixel.spx);
+  imgkey key;
+  bool admit = false;
+  if(ic){
+    imgkey_init(&key, data, linesize, bargs->begy, bargs->begx, leny, lenx, bargs);
+    imgentry* e = imgcache_get(ic, &key, data, linesize, &admit);
+    if(e){
+      int r = sixel_blit_cached(n, bargs->u.pixel.spx, e);
+      imgcache_release(e);
+      return r;
+    }
+  }
+  // a recycled sprixel retains the sixelmap of the frame we're replacing,
+  // from which unchanged bands can be taken. it goes away once we're done.
+  sixelmap* prevmap = bargs->u.pixel.spx->smap;
+  bargs->u.pixel.spx->smap = NULL;
   sixelmap* smap = sixelmap_create(leny - bargs->begy);
   if(smap == NULL){
+    sixelmap_free(prevmap);
     return -1;
   }
   assert(n->tam);
@@ -1401,16 +2386,23 @@ int sixel_blit(ncplane* n, int linesize, const void* data, int leny, int lenx,
   if((qs = alloc_qstate(bargs->u.pixel.colorregs)) == NULL){
     logerror("couldn't allocate qstate");
     sixelmap_free(smap);
+    sixelmap_free(prevmap);
     return -1;
   }
   qs->bargs = bargs;
   qs->data = data;
   qs->linesize = linesize;
   qs->smap = smap;
+  choose_quantizer(qs);
+  // bands quantized some other way can't be carried over
+  qs->prevmap = prevmap && prevmap->quant == smap->quant ? prevmap : NULL;
+  qs->recycled = prevmap != NULL;
   qs->leny = leny;
   qs->lenx = lenx;
   sixel_engine* sengine = ncplane_pile(n) ? ncplane_notcurses(n)->tcache.sixelengine : NULL;
-  if(extract_color_table(sengine, qs)){
+  int r = extract_color_table(sengine, qs);
+  sixelmap_free(prevmap);
+  if(r){
     free(bargs->u.pixel.spx->needs_refresh);
     bargs->u.pixel.spx->needs_refresh = NULL;
     sixelmap_free(smap);
@@ -1418,7 +2410,7 @@ int sixel_blit(ncplane* n, int linesize, const void* data, int leny, int lenx,
     return -1;
   }
   // takes ownership of sixelmap on success
-  int r = sixel_blit_inner(qs, smap, bargs, n->tam);
+  r = sixel_blit_inner(qs, smap, bargs, n->tam);
   free_qstate(qs);
   if(r < 0){
     sixelmap_free(smap);
@@ -1429,6 +2421,12 @@ int sixel_blit(ncplane* n, int linesize, const void* data, int leny, int lenx,
   // it at sixel_redraw(), thus avoiding a double emission in the case of wipes
   // taking place before it's visible.
   bargs->u.pixel.spx->wipes_outstanding = 1;
+  if(r >= 0 && admit){
+    // failing to cache the sixel doesn't affect its blit
+    if(sixel_cache(ic, &key, bargs->u.pixel.spx, data, linesize)){
+      logwarn("couldn't cache sixel");
+    }
+  }
   return r;
 }
 
@@ -1508,51 +2506,54 @@ int sixel_draw(const tinfo* ti, const ncpile* p, sprixel* s, fbuf* f,
       }
     }
   }
-  if(fbuf_putn(f, s->glyph.buf, s->glyph.used) < 0){
+  // the glyph is stable until we next render, so it can be spliced
+  if(fbuf_splice(f, s->glyph.buf, s->glyph.used) < 0){
     return -1;
   }
   s->invalidated = SPRIXEL_QUIESCENT;
   return s->glyph.used;
 }
 
-// a quantization worker.
-static void *
-sixel_worker(void* v){
-  work_queue* wq = v;
-  sixel_engine *sengine = wq->sengine;
+typedef struct sixeldecoders {
+  sixeldecode* sd;
+  unsigned threads;
+  int ret[NCSIXEL_DECODE_MAXTHREADS];
+} sixeldecoders;
 
-  qstate* qs = NULL;
-  unsigned bufpos = 0; // index into worker queue
-  do{
-    pthread_mutex_lock(&sengine->lock);
-    while(wq->used == 0 && !sengine->done){
-      pthread_cond_wait(&sengine->cond, &sengine->lock);
-    }
-    if(!sengine->done){
-      qs = wq->qstates[bufpos];
-    }else{
-      qs = NULL;
-    }
-    pthread_mutex_unlock(&sengine->lock);
-    if(qs == NULL){
+// decode the |idx|th of |threads| equal runs of bands
+static void
+sixel_decode_worker(void* vsdecs, unsigned idx){
+  sixeldecoders* sdecs = vsdecs;
+  sixeldecode* sd = sdecs->sd;
+  const unsigned first = sd->bandcount * idx / sdecs->threads;
+  const unsigned last = sd->bandcount * (idx + 1) / sdecs->threads;
+  sdecs->ret[idx] = 0;
+  for(unsigned b = first ; b < last ; ++b){
+    if(sixel_decode_band(sd, b)){
+      sdecs->ret[idx] = -1;
       break;
     }
-    bandworker(qs);
-    bool sendsignal = false;
-    pthread_mutex_lock(&sengine->lock);
-    --wq->used;
-    if(--qs->refcount == 0){
-      sendsignal = true;
-    }
-    pthread_mutex_unlock(&sengine->lock);
-    if(sendsignal){
-      pthread_cond_broadcast(&sengine->cond);
-    }
-    if(++bufpos == WORKERDEPTH){
-      bufpos = 0;
-    }
-  }while(1);
-  return NULL;
+  }
+}
+
+int sixel_decode_bands(sixeldecode* sd){
+  sixeldecoders sdecs = {
+    .sd = sd,
+    .threads = ncthread_helpers("NOTCURSES_SIXEL_THREADS",
+                                NCSIXEL_DECODE_MAXTHREADS - 1) + 1,
+  };
+  if(sdecs.threads > sd->bandcount / NCSIXEL_DECODE_MINBANDS){
+    sdecs.threads = sd->bandcount / NCSIXEL_DECODE_MINBANDS;
+  }
+  if(sdecs.threads < 1){
+    sdecs.threads = 1;
+  }
+  ncworkers_run(sdecs.threads, sdecs.threads, sixel_decode_worker, &sdecs);
+  int ret = 0;
+  for(unsigned t = 0 ; t < sdecs.threads ; ++t){
+    ret |= sdecs.ret[t];
+  }
+  return ret;
 }
 
 static int
@@ -1561,20 +2562,11 @@ sixel_init_core(tinfo* ti, const char* initstr, int fd){
     return -1;
   }
   sixel_engine* sengine = ti->sixelengine;
-  pthread_mutex_init(&sengine->lock, NULL);
-  pthread_cond_init(&sengine->cond, NULL);
-  sengine->done = false;
-  const int workers_wanted = sizeof(sengine->tids) / sizeof(*sengine->tids);
-  for(int w = 0 ; w < workers_wanted ; ++w){
-    sengine->queues[w].sengine = sengine;
-    sengine->queues[w].writeto = 0;
-    sengine->queues[w].used = 0;
-    if(pthread_create(&sengine->tids[w], NULL, sixel_worker, &sengine->queues[w])){
-      logerror("couldn't spin up sixel worker %d/%d", w, workers_wanted);
-      // FIXME kill any created workers
-      return -1;
-    }
-  }
+  // the pool's threads are created as they're first needed
+  sengine->helpers = ncthread_helpers("NOTCURSES_SIXEL_THREADS",
+                                      NCWORKERS_MAXTHREADS - 1);
+  loginfo("sixels will use up to %u helper%s", sengine->helpers,
+          sengine->helpers == 1 ? "" : "s");
   return tty_emit(initstr, fd);
 }
 
@@ -1603,92 +2595,78 @@ int sixel_init(tinfo* ti, int fd){
   return sixel_init_core(ti, "\e[?8452h", fd);
 }
 
-// restore the |yoff|th bit of the sixel at |xoff| for the specified vec
-// FIXME this is a very dopey implementation yuck, use RLE at least
+// restore the sixels of |color| at |startx| through |startx + len - 1|, ORing
+// |bits[i]| into the sixel at |startx + i|. the vector is expanded, updated,
+// and reencoded in a single pass.
 static int
-restore_vec(sixelband* b, int color, int bit, int xoff, int dimx){
+restore_color(sixelband* b, int color, const unsigned char* bits, int startx,
+              int len, int dimx){
   if(color >= b->size){
     logpanic("illegal color %d >= %d", color, b->size);
     return -1;
   }
-  char* v = NULL;
+  unsigned char* reps = calloc(dimx, sizeof(*reps));
+  char* v = malloc(dimx + 1);
+  if(reps == NULL || v == NULL){
+    free(reps);
+    free(v);
+    return -1;
+  }
+  int x = 0; // sixels decoded
   const char* vec = b->vecs[color]; // might be NULL
-  if(vec == NULL){ // write this sixel, and we're done
-    struct band_extender bes = {
-      .rle = 1,
-      .rep = bit,
-    };
-    if((v = sixelband_extend(v, &bes, dimx, xoff)) == NULL){
-      return -1;
-    }
-  }else{
-    int rle = 0; // the repetition number for this element
-    int x = 0;
-    int voff = 0;
-    if((v = malloc(dimx + 1)) == NULL){
-      return -1;
-    }
-    while(*vec){
+  if(vec){
+    int rle = 0;
+    for( ; *vec ; ++vec){
       if(isdigit(*vec)){
-        rle *= 10;
-        rle += (*vec - '0');
+        rle = rle * 10 + (*vec - '0');
       }else if(*vec == '!'){
         rle = 0;
       }else{
         if(rle == 0){
           rle = 1;
         }
-        char rep = *vec;
-//fprintf(stderr, "X/RLE/ENDX: %d %d %d\n", x, rle, endx);
-        if(x + rle <= xoff){ // not wiped material; reproduce as-is
-          write_rle(v, &voff, rle, rep);
-          x += rle;
-        }else if(x > xoff){
-          write_rle(v, &voff, rle, rep);
-          x += rle;
-        }else{
-          if(x < xoff){
-            write_rle(v, &voff, xoff - x, rep);
-            rle -= xoff - x;
-            x = xoff;
-          }
-          write_rle(v, &voff, 1, ((rep - 63) | bit) + 63);
-          --rle;
-          ++x;
-          if(rle){
-            write_rle(v, &voff, rle, rep);
-            x += rle;
-          }
+        while(rle-- && x < dimx){
+          reps[x++] = *vec - 63;
         }
         rle = 0;
       }
-      ++vec;
-      if(x > xoff){
-        strcpy(v + voff, vec); // there is always room
-        break;
-      }
     }
   }
+  for(int i = 0 ; i < len ; ++i){
+    reps[startx + i] |= bits[i];
+  }
+  if(x < startx + len){
+    x = startx + len;
+  }
+  int voff = 0;
+  v[0] = '\0';
+  for(int i = 0 ; i < x ; ){
+    int run = 1;
+    while(i + run < x && reps[i + run] == reps[i]){
+      ++run;
+    }
+    write_rle(v, &voff, run, reps[i] + 63);
+    i += run;
+  }
+  free(reps);
   free(b->vecs[color]);
   b->vecs[color] = v;
-//fprintf(stderr, "SET NEW VEC (%zu) [%s]\n", strlen(v), v);
   return 0;
 }
 
 // rebuild the portion of some cell which is within this band, having stored
 // the pixels into the auxvec when the cell was wiped (and updated them if we
-// loaded another frame). we go through the auxvec to the right and down,
-// within the area covered by our band. if the entry is transparent, do
-// nothing. otherwise, it is some color; collect other instances of the color,
-// marking them transparent as we do so, and update that color's band. in
-// the worst case (all pixels different colors), this will be p^2 =\ FIXME.
+// loaded another frame). the auxvec was written by wipe_color(), and thus
+// only holds colors from the band's index for the cell's column. for each
+// of these, we gather its pixels from the auxvec into |bits| (one sixel per
+// column of the cell), and restore them to the color's vector in one pass.
 //
 // returns the number of source-transparent pixels (i.e. pixels which weren't
 // restored), which will be used to update the TAM state.
 static inline int
 restore_band(sixelmap* smap, int band, int startx, int endx,
              int starty, int endy, int dimx, int cellpxy, int cellpxx,
-             uint8_t* auxvec){
+             uint8_t* auxvec, unsigned char* bits){
   int restored = 0;
   const int sy = band * 6 < starty ? starty - band * 6 : 0;
   const int ey = (band + 1) * 6 > endy ? 6 - ((band + 1) * 6 - endy) : 6;
@@ -1697,21 +2675,29 @@ restore_band(sixelmap* smap, int band, int startx, int endx,
   const int totalpixels = width * height;
   sixelband* b = &smap->bands[band];
 //fprintf(stderr, "RESTORING band %d (%d->%d (%d->%d), %d->%d) %d pixels\n", band, sy, ey, starty, endy, startx, endx, totalpixels);
-  int yoff = ((band * 6) + sy - starty) % cellpxy; // we start off on this row of the auxvec
-  int xoff = startx % cellpxx;
-  for(int dy = sy ; dy < ey ; ++dy, ++yoff){
-    const int idx = (yoff * cellpxx + xoff) * AUXVECELEMSIZE;
-    const int bit = 1 << dy;
-//fprintf(stderr, " looking at bandline %d (auxvec row %d idx %d, dy %d)\n", dy, yoff, idx, dy);
-    for(int dx = 0 ; startx + dx < endx ; ++dx){
-      uint16_t color;
-      memcpy(&color, &auxvec[idx + dx * AUXVECELEMSIZE], AUXVECELEMSIZE);
-//fprintf(stderr, "  idx %d (dx %d x %d): %hu\n", idx, dx, dx + startx, color);
-      if(color != TRANS_PALETTE_ENTRY){
-        restore_vec(b, color, bit, startx + dx, dimx);
-        ++restored;
+  const int yoff = ((band * 6) + sy - starty) % cellpxy; // we start off on this row of the auxvec
+  const int xoff = startx % cellpxx;
+  const int col = startx / cellpxx;
+  for(int i = col < b->cellcols ? b->cellcoloff[col] : 0 ;
+      col < b->cellcols && i < b->cellcoloff[col + 1] ; ++i){
+    const uint16_t c = b->cellcolors[i];
+    bool found = false;
+    memset(bits, 0, width);
+    for(int dy = sy ; dy < ey ; ++dy){
+      const int idx = ((yoff + dy - sy) * cellpxx + xoff) * AUXVECELEMSIZE;
+      for(int dx = 0 ; dx < width ; ++dx){
+        uint16_t color;
+        memcpy(&color, &auxvec[idx + dx * AUXVECELEMSIZE], AUXVECELEMSIZE);
+        if(color == c){
+          bits[dx] |= 1u << dy;
+          found = true;
+          ++restored;
+        }
       }
     }
+    if(found && restore_color(b, c, bits, startx, width, dimx)){
+      return -1;
+    }
   }
   (void)smap;
   return totalpixels - restored;
@@ -1742,12 +2728,23 @@ int sixel_rebuild(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
   const int startband = starty / 6;
   const int endband = (endy - 1) / 6;
 //fprintf(stderr, "%d/%d start: %d/%d end: %d/%d bands: %d-%d\n", ycell, xcell, starty, startx, endy, endx, starty / 6, endy / 6);
-  // walk through each color, and wipe the necessary sixels from each band
+  // one sixel for each pixel column of the cell, reused for each color
+  unsigned char* bits = malloc(cellpxx);
+  if(bits == NULL){
+    return -1;
+  }
+  // walk through each band, restoring the colors of the cell
   int w = 0;
   for(int b = startband ; b <= endband ; ++b){
-    w += restore_band(smap, b, startx, endx, starty, endy, s->pixx,
-                      cellpxy, cellpxx, auxvec);
+    const int r = restore_band(smap, b, startx, endx, starty, endy, s->pixx,
+                               cellpxy, cellpxx, auxvec, bits);
+    if(r < 0){
+      free(bits);
+      return -1;
+    }
+    w += r;
   }
+  free(bits);
   s->wipes_outstanding = true;
   sprixcell_e newstate;
   if(w == cellpxx * cellpxy){
@@ -1762,19 +2759,7 @@ int sixel_rebuild(sprixel* s, int ycell, int xcell, uint8_t* auxvec){
 }
 
 void sixel_cleanup(tinfo* ti){
-  sixel_engine* sengine = ti->sixelengine;
-  const unsigned tids = POPULATION;
-  pthread_mutex_lock(&sengine->lock);
-  sengine->done = 1;
-  pthread_mutex_unlock(&sengine->lock);
-  pthread_cond_broadcast(&sengine->cond);
-  loginfo("joining %u sixel thread%s", tids, tids == 1 ? "" : "s");
-  for(unsigned t = 0 ; t < tids ; ++t){
-    pthread_join(sengine->tids[t], NULL);
-  }
-  pthread_mutex_destroy(&sengine->lock);
-  pthread_cond_destroy(&sengine->cond);
-  free(sengine);
+  free(ti->sixelengine);
   loginfo("reaped sixel engine");
   ti->sixelengine = NULL;
   // no way to know what the state was before; we ought use XTSAVE/XTRESTORE
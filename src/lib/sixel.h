@@ -5,196 +5,299 @@
 extern "C" {
 #endif
 
-#include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include "logging.h"
 
-uint32_t* ncsixel_as_rgba(const char *sx, unsigned leny, unsigned lenx){
-  if(!leny || !lenx){
-    logerror("null sixel geometry");
-    return NULL;
-  }
-#define MAXCOLORS 65535
-  // cast is necessary for c++ callers
-  uint32_t* rgba = (uint32_t*)calloc(leny * lenx, sizeof(*rgba));
-  if(rgba == NULL){
-    return NULL;
+// decoding sixel. the data is first scanned once to find where each band of
+// six rows begins, the color register selected there, and the color register
+// definitions. bands are then decoded independently (and in parallel, for
+// large images) straight into RGBA rows.
+
+#define NCSIXEL_MAXCOLORS 65536
+// no more than this many decoding threads, with no fewer than this many
+// bands apiece. a band is six rows, so small images stay on one thread.
+#define NCSIXEL_DECODE_MAXTHREADS 16
+#define NCSIXEL_DECODE_MINBANDS 32
+
+typedef struct sixeldecode {
+  const char** bands;   // start of each band's data
+  unsigned* bandcolors; // color register selected at the start of each band
+  unsigned bandcount;   // bands found, no more than ceil(leny / 6)
+  uint32_t* colors;     // NCSIXEL_MAXCOLORS color registers as RGBA
+  uint32_t* rgba;       // output, 'leny' rows of 'stride' pixels
+  size_t stride;
+  unsigned leny, lenx;
+  bool define;          // apply color definitions as they're decoded
+} sixeldecode;
+
+// parse a decimal parameter (possibly empty, meaning 0), saturating rather
+// than overflowing. returns the first byte past it.
+static inline const char*
+sixel_number(const char* s, unsigned* n){
+  unsigned v = 0;
+  while(*s >= '0' && *s <= '9'){
+    if(v < NCSIXEL_MAXCOLORS){
+      v = v * 10 + (*s - '0');
+    }
+    ++s;
   }
-  // cast is necessary for c++ callers
-  uint32_t* colors = (uint32_t*)calloc(MAXCOLORS, sizeof(*colors));
-  if(colors == NULL){
-    free(rgba);
+  *n = v;
+  return s;
+}
+
+// parse the remainder of a color definition #Pc;Pu;Px;Py;Pz, 's' pointing
+// just past the first semicolon. only RGB (Pu == 2) is supported. returns
+// the first byte past the definition, or NULL on error.
+static inline const char*
+sixel_colorspec(const char* s, uint32_t* color){
+  if(s[0] != '2' || s[1] != ';'){
+    logerror("expected RGB colorspace, got %u", *s);
     return NULL;
   }
-  // first we skip the header. it ends in either a color declaration, or a
-  // transparent line (the only possible colorless line).
-  while(*sx != '#' && *sx != '-'){
-    if(!*sx){
-      logerror("expected octothorpe/hyphen, got eol");
+  s += 2;
+  unsigned rgb[3];
+  for(int i = 0 ; i < 3 ; ++i){
+    if(*s < '0' || *s > '9'){
+      logerror("expected digit, got %u", *s);
       return NULL;
     }
-    ++sx;
+    s = sixel_number(s, &rgb[i]);
+    if(i < 2){
+      if(*s != ';'){
+        logerror("expected semicolon, got %u", *s);
+        return NULL;
+      }
+      ++s;
+    }
+    if(rgb[i] > 100){
+      rgb[i] = 100;
+    }
   }
-  // now we build the color table (form: #Pc;Pu;Px;Py;Pz). data starts with
-  // a color spec lacking a semicolon.
-  enum {
-    STATE_WANT_HASH,
-    STATE_WANT_COLOR,
-    STATE_WANT_COLORSEMI,
-    STATE_WANT_COLORSPACE,
-    STATE_WANT_DATA,
-  } state = STATE_WANT_HASH;
+  *color = 0;
+  ncpixel_set_a(color, 0xff);
+  ncpixel_set_rgb8(color, rgb[0] * 255 / 100, rgb[1] * 255 / 100, rgb[2] * 255 / 100);
+  return s;
+}
+
+// walk the data once, recording the start of each band and the register
+// selected there, and loading the color registers. if a register already
+// defined is redefined after pixels have been drawn, *serial is set: earlier
+// pixels used the old value, so the bands must be decoded in order with the
+// definitions applied as they're met. returns -1 on malformed data.
+static inline int
+sixel_scan(const char* sx, sixeldecode* sd, bool* serial){
+  const unsigned maxbands = (sd->leny + 5) / 6;
+  unsigned count = 1; // bands begun, including any past maxbands
   unsigned color = 0;
-  unsigned x = 0;
-  unsigned y = 0;
-  unsigned rle = 1;
-  while(*sx){
-//fprintf(stderr, "SX: %u 0x%02x %c\n", *sx, *sx, *sx);
-    if(*sx == '\e'){
-      break;
-    }
-    if(state == STATE_WANT_HASH){
-      if(*sx == '-'){
-        x = 0;
-        y += 6;
-      }else if('#' == *sx){
-        state = STATE_WANT_COLOR;
-      }else{
-        logerror("expected octothorpe, got %u", *sx);
-        goto err;
+  bool drawn = false;
+  sd->bands[0] = sx;
+  sd->bandcolors[0] = 0;
+  *serial = false;
+  for(;;){
+    const unsigned char c = *sx;
+    if(c >= '?' && c <= '~'){
+      if(count > maxbands){
+        logerror("too many rows %u > %u", count * 6, maxbands * 6);
+        return -1;
       }
-    }else if(state == STATE_WANT_COLOR){
-      if(!isdigit(*sx)){
-        logerror("expected digit, got %u", *sx);
-        goto err;
+      drawn = true;
+      ++sx;
+    }else if(c == '#'){
+      unsigned reg;
+      sx = sixel_number(sx + 1, &reg);
+      if(reg >= NCSIXEL_MAXCOLORS){
+        logerror("invalid color register %u", reg);
+        return -1;
       }
-      color = 0;
-      do{
-//fprintf(stderr, "SX: %u 0x%02x %c\n", *sx, *sx, *sx);
-        color *= 10;
-        color += *sx - '0';
-        ++sx;
-      }while(isdigit(*sx));
-//std::cerr << "Got color " << color << std::endl;
-      --sx;
-      state = STATE_WANT_COLORSEMI;
-    }else if(state == STATE_WANT_COLORSEMI){
-      // if we get a semicolon, we're a colorspec, otherwise data
       if(*sx == ';'){
-        state = STATE_WANT_COLORSPACE;
+        uint32_t rgba;
+        if((sx = sixel_colorspec(sx + 1, &rgba)) == NULL){
+          return -1;
+        }
+        if(drawn && sd->colors[reg] && sd->colors[reg] != rgba){
+          *serial = true;
+        }
+        sd->colors[reg] = rgba;
       }else{
-        state = STATE_WANT_DATA;
-        rle = 1;
-      }
-    }else if(state == STATE_WANT_COLORSPACE){
-      if('2' != *(sx++)){
-        logerror("expected '2', got %u", *sx);
-        goto err;
-      }
-//fprintf(stderr, "SX: %u 0x%02x %c\n", *sx, *sx, *sx);
-      if(';' != *(sx++)){
-        logerror("expected semicolon, got %u", *sx);
-        goto err;
+        color = reg;
       }
-//fprintf(stderr, "SX: %u 0x%02x %c\n", *sx, *sx, *sx);
-      int r = 0;
-      do{
-        r *= 10;
-        r += *sx - '0';
-        ++sx;
-      }while(isdigit(*sx));
-      if(';' != *(sx++)){
-        logerror("expected semicolon, got %u", *sx);
-        goto err;
+    }else if(c == '!'){
+      unsigned rle;
+      sx = sixel_number(sx + 1, &rle);
+    }else if(c == '-'){
+      if(count < maxbands){
+        sd->bands[count] = sx + 1;
+        sd->bandcolors[count] = color;
       }
-//fprintf(stderr, "SX: %u 0x%02x %c\n", *sx, *sx, *sx);
-      r = r * 255 / 100;
-      int g = 0;
-      do{
-        g *= 10;
-        g += *sx - '0';
-        ++sx;
-      }while(isdigit(*sx));
-      if(';' != *(sx++)){
-        logerror("expected semicolon, got %u", *sx);
-        goto err;
-      }
-//fprintf(stderr, "SX: %u 0x%02x %c\n", *sx, *sx, *sx);
-      g = g * 255 / 100;
-      int b = 0;
-      do{
-        b *= 10;
-        b += *sx - '0';
-        ++sx;
-      }while(isdigit(*sx));
-      b = b * 255 / 100;
-      ncpixel_set_a(&colors[color], 0xff);
-      ncpixel_set_rgb8(&colors[color], r, g, b);
-//fprintf(stderr, "Got color %d: 0x%08x %u %u %u\n", color, colors[color], r, g, b);
-      if(color >= MAXCOLORS){
-        goto err;
-      }
-      state = STATE_WANT_HASH;
-      --sx;
+      ++count;
+      ++sx;
+    }else if(c == '\e' || c == '\0'){
+      break;
+    }else if(c == '$' || c < ' '){ // control characters are ignored
+      ++sx;
+    }else{
+      logerror("unexpected sixel byte %u", c);
+      return -1;
     }
-    // read until we hit next colorspec
-    if(state == STATE_WANT_DATA){
-//fprintf(stderr, "Character %c\n", *sx);
-      if(*sx == '#'){
-        state = STATE_WANT_HASH;
-        --sx;
-      }else if(*sx == '!'){ // RLE
-        ++sx;
-        rle = 0;
-        do{
-          rle *= 10;
-          rle += *sx - '0';
-          ++sx;
-        }while(isdigit(*sx));
-        if(0 == rle){
-          rle = 1;
+  }
+  sd->bandcount = count < maxbands ? count : maxbands;
+  return 0;
+}
+
+// decode a single band into its (no more than six) rows, which are first
+// cleared to transparent.
+static inline int
+sixel_decode_band(sixeldecode* sd, unsigned band){
+  const char* s = sd->bands[band];
+  const unsigned y = band * 6;
+  const unsigned rows = sd->leny - y < 6 ? sd->leny - y : 6;
+  const unsigned rowmask = (1u << rows) - 1;
+  const size_t stride = sd->stride;
+  uint32_t* out = sd->rgba + y * stride;
+  for(unsigned r = 0 ; r < rows ; ++r){
+    memset(out + r * stride, 0, sd->lenx * sizeof(*out));
+  }
+  unsigned color = sd->bandcolors[band];
+  uint32_t c = sd->colors[color];
+  unsigned x = 0;
+  unsigned rle = 1;
+  for(;;){
+    const unsigned char ch = *s;
+    if(ch >= '?' && ch <= '~'){
+      if(x + rle > sd->lenx){
+        logerror("invalid rle %u + %u > %u", x, rle, sd->lenx);
+        return -1;
+      }
+      unsigned bits = (ch - '?') & rowmask;
+      uint32_t* p = out + x;
+      if(rle == 1){
+        // the bits are essentially random, so don't branch on them
+        for(unsigned r = 0 ; r < rows ; ++r, p += stride){
+          const uint32_t m = -(uint32_t)((bits >> r) & 1u);
+          *p = (*p & ~m) | (c & m);
         }
-        --sx;
-      }else if(*sx == '$'){
-        x = 0;
-        state = STATE_WANT_DATA;
-      }else if(*sx == '-'){
-        x = 0;
-        y += 6;
-        state = STATE_WANT_DATA;
       }else{
-//fprintf(stderr, "RLE: %d pos: %d x %d\n", rle, y, x);
-        if(y + 6 > (leny + 5) / 6 * 6){
-          logerror("too many rows %d + 6 > %d", y, (leny + 5) / 6 * 6);
-          goto err;
-        }
-        if(x + rle > lenx){
-          logerror("invalid rle %d + %d > %d", x, rle, lenx);
-          goto err;
-        }
-        for(unsigned xpos = x ; xpos < x + rle ; ++xpos){
-          for(unsigned ypos = y ; ypos < y + 6 ; ++ypos){
-            if((*sx - 63) & (1u << (ypos - y))){
-              // ought be an empty pixel
-//std::cerr << *s << " BMAP[" << ypos << "][" << xpos << "] = " << std::hex << colors[color] << std::dec << std::endl;
-              rgba[ypos * lenx + xpos] = colors[color];
+        for( ; bits ; bits >>= 1u, p += stride){
+          if(bits & 1u){
+            for(unsigned i = 0 ; i < rle ; ++i){
+              p[i] = c;
             }
           }
         }
-        x += rle;
+      }
+      x += rle;
+      rle = 1;
+      ++s;
+    }else if(ch == '#'){
+      unsigned reg;
+      s = sixel_number(s + 1, &reg);
+      if(*s == ';'){
+        uint32_t rgba = 0;
+        s = sixel_colorspec(s + 1, &rgba); // already validated by the scan
+        if(sd->define){
+          sd->colors[reg] = rgba;
+        }
+      }else{
+        color = reg;
+      }
+      c = sd->colors[color];
+      rle = 1;
+    }else if(ch == '!'){
+      s = sixel_number(s + 1, &rle);
+      if(rle == 0){
         rle = 1;
       }
+    }else if(ch == '$'){
+      x = 0;
+      ++s;
+    }else if(ch == '-' || ch == '\e' || ch == '\0'){
+      break;
+    }else{
+      ++s;
+    }
+  }
+  return 0;
+}
+
+// decodes all of sd's bands, in parallel where worthwhile, using the worker
+// pool. NOTCURSES_SIXEL_THREADS, if set, gives the number of additional
+// threads (as it does for encoding). only available within the library.
+int sixel_decode_bands(sixeldecode* sd);
+
+// decode the sixel 'sx' (with or without its DCS introducer and terminator),
+// 'leny' rows of 'lenx' pixels, into 'rgba', having rows of 'stride' pixels.
+// undrawn pixels are transparent. the caller guarantees 'stride' >= 'lenx'.
+// bands are decoded using 'bandfxn' (i.e. sixel_decode_bands()), or serially
+// on the calling thread if it is NULL.
+static inline int
+ncsixel_decode(const char* sx, unsigned leny, unsigned lenx, uint32_t* rgba,
+               size_t stride, int (*bandfxn)(sixeldecode*)){
+  if(!leny || !lenx){
+    logerror("null sixel geometry");
+    return -1;
+  }
+  // first we skip the header. it ends in either a color declaration, or a
+  // transparent line (the only possible colorless line).
+  while(*sx != '#' && *sx != '-'){
+    if(!*sx){
+      logerror("expected octothorpe/hyphen, got eol");
+      return -1;
     }
     ++sx;
   }
-  free(colors);
-  return rgba;
+  const unsigned maxbands = (leny + 5) / 6;
+  sixeldecode sd;
+  memset(&sd, 0, sizeof(sd));
+  sd.leny = leny;
+  sd.lenx = lenx;
+  sd.rgba = rgba;
+  sd.stride = stride;
+  // casts are necessary for c++ callers
+  sd.bands = (const char**)malloc(sizeof(*sd.bands) * maxbands);
+  sd.bandcolors = (unsigned*)malloc(sizeof(*sd.bandcolors) * maxbands);
+  sd.colors = (uint32_t*)calloc(NCSIXEL_MAXCOLORS, sizeof(*sd.colors));
+  int ret = -1;
+  bool serial;
+  if(sd.bands && sd.bandcolors && sd.colors && !sixel_scan(sx, &sd, &serial)){
+    if(serial || bandfxn == NULL){
+      if(serial){
+        memset(sd.colors, 0, sizeof(*sd.colors) * NCSIXEL_MAXCOLORS);
+        sd.define = true;
+      }
+      ret = 0;
+      for(unsigned b = 0 ; b < sd.bandcount && !ret ; ++b){
+        ret = sixel_decode_band(&sd, b);
+      }
+    }else{
+      ret = bandfxn(&sd);
+    }
+    // rows the data never reached are transparent
+    for(unsigned y = sd.bandcount * 6 ; y < leny ; ++y){
+      memset(rgba + y * stride, 0, lenx * sizeof(*rgba));
+    }
+  }
+  free(sd.colors);
+  free(sd.bandcolors);
+  free(sd.bands);
+  return ret;
+}
 
-err:
-  free(rgba);
-  free(colors);
-  return NULL;
-#undef MAXCOLORS
+// decode the sixel 'sx' into a freshly-allocated buffer of 'leny' rows of
+// 'lenx' RGBA pixels, to be free()d by the caller.
+static inline uint32_t*
+ncsixel_as_rgba(const char* sx, unsigned leny, unsigned lenx){
+  // cast is necessary for c++ callers
+  uint32_t* rgba = (uint32_t*)malloc(sizeof(*rgba) * leny * lenx);
+  if(rgba == NULL){
+    return NULL;
+  }
+  if(ncsixel_decode(sx, leny, lenx, rgba, lenx, NULL)){
+    free(rgba);
+    return NULL;
+  }
+  return rgba;
 }
 
 #ifdef __cplusplus
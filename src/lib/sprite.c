@@ -42,7 +42,18 @@ void sprixel_free(sprixel* s){
       s->n->sprite = NULL;
     }
     sixelmap_free(s->smap);
+    sixelpalette_free(s->palette);
     free(s->needs_refresh);
+    free(s->lastpx);
+    free(s->chunkoffs);
+    free(s->drawn);
+    if(s->cached){
+      imgcache_release(s->cached);
+    }
+    if(s->transfile){ // never drawn, so the terminal never saw it
+      unlink(s->transfile);
+      free(s->transfile);
+    }
     fbuf_free(&s->glyph);
     free(s);
   }
@@ -52,14 +63,9 @@ sprixel* sprixel_recycle(ncplane* n){
   assert(n->sprite);
   const notcurses* nc = ncplane_notcurses_const(n);
   if(nc->tcache.pixel_implementation >= NCPIXEL_KITTY_STATIC){
-    sprixel* hides = n->sprite;
-    int dimy = hides->dimy;
-    int dimx = hides->dimx;
-    sprixel_hide(hides);
-    return sprixel_alloc(n, dimy, dimx);
-  }
-  sixelmap_free(n->sprite->smap);
-  n->sprite->smap = NULL;
+    return kitty_recycle(n);
+  }
+  // the sixelmap is retained, so that sixel_blit() can reuse its bands
   return n->sprite;
 }
 
@@ -102,14 +108,20 @@ void sprixel_hide(sprixel* s){
 // y and x are absolute coordinates.
 void sprixel_invalidate(sprixel* s, int y, int x){
 //fprintf(stderr, "INVALIDATING AT %d/%d\n", y, x);
-  if(s->invalidated == SPRIXEL_QUIESCENT && s->n){
+  if((s->invalidated == SPRIXEL_QUIESCENT || s->drawn) && s->n){
     int localy = y - s->n->absy;
     int localx = x - s->n->absx;
 //fprintf(stderr, "INVALIDATING AT %d/%d (%d/%d) TAM: %d\n", y, x, localy, localx, s->n->tam[localy * s->dimx + localx].state);
     if(s->n->tam[localy * s->dimx + localx].state != SPRIXCELL_TRANSPARENT &&
        s->n->tam[localy * s->dimx + localx].state != SPRIXCELL_ANNIHILATED &&
        s->n->tam[localy * s->dimx + localx].state != SPRIXCELL_ANNIHILATED_TRANS){
-      s->invalidated = SPRIXEL_INVALIDATED;
+      if(s->invalidated == SPRIXEL_QUIESCENT){
+        s->invalidated = SPRIXEL_INVALIDATED;
+      }
+      // fbcon must redraw the cell, the console having written text atop it
+      if(s->drawn && (unsigned)localy < s->drawn->dimy && (unsigned)localx < s->drawn->dimx){
+        s->drawn->damage[localy * s->drawn->dimx + localx] = 1;
+      }
     }
   }
 }
@@ -158,6 +170,9 @@ int sprixel_load(sprixel* spx, fbuf* f, unsigned pixy, unsigned pixx,
     fbuf_free(&spx->glyph);
     memcpy(&spx->glyph, f, sizeof(*f));
   }
+  // glyphs are built in large buffers, but usually need much less, and live
+  // as long as their sprixels. give back what we didn't use.
+  fbuf_trim(&spx->glyph, FBUF_SMALL_SIZE);
   spx->invalidated = state;
   spx->pixx = pixx;
   spx->pixy = pixy;
@@ -208,6 +223,403 @@ int sprite_clear_all(const tinfo* t, fbuf* f){
   return t->pixel_clear_all(f);
 }
 
+// a content-addressed cache of the bitmaps blitted with a context, so that
+// identical blits needn't be encoded (or with kitty, transmitted) again.
+// entries live on a list in order of use, most recent first. we don't expect
+// more than a few hundred, so they're found with a walk of that list.
+#define IMGCACHE_BUDGET (320lu * 1024 * 1024 / 4)
+#define IMGCACHE_SEEN 64 // missed keys remembered, for admission
+
+typedef struct imgcache {
+  pthread_mutex_t lock;   // blits and rasterizations of any pile use us
+  imgentry* mru;          // most recently used entry
+  imgentry* lru;          // least recently used entry
+  size_t bytes;           // charged to all entries
+  size_t budget;
+  uint32_t nextimage;     // kitty image id for the next entry
+  uint64_t seen[IMGCACHE_SEEN]; // hashes of keys missed once, or 0
+  unsigned seenidx;
+  uint32_t* evicted;      // kitty images awaiting deletion
+  unsigned evictedcount;
+  unsigned evictedalloc;
+} imgcache;
+
+imgcache* imgcache_create(size_t budget){
+  imgcache* c = malloc(sizeof(*c));
+  if(c == NULL){
+    return NULL;
+  }
+  memset(c, 0, sizeof(*c));
+  if(pthread_mutex_init(&c->lock, NULL)){
+    free(c);
+    return NULL;
+  }
+  c->budget = budget;
+  c->nextimage = 0x1000000u;
+  return c;
+}
+
+void imgentry_destroy(imgentry* e){
+  if(e){
+    free(e->states);
+    free(e->rgba);
+    fbuf_free(&e->glyph);
+    sixelmap_free(e->smap);
+    free(e);
+  }
+}
+
+// sprixels ought all be gone by now, taking their references with them.
+void imgcache_destroy(imgcache* c){
+  if(c){
+    imgentry* e;
+    while( (e = c->mru) ){
+      c->mru = e->next;
+      imgentry_destroy(e);
+    }
+    free(c->evicted);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+  }
+}
+
+// have any of the |dimy|x|dimx| cells of |tam| been annihilated?
+static bool
+tam_annihilated(const tament* tam, unsigned dimy, unsigned dimx){
+  for(unsigned i = 0 ; i < dimy * dimx ; ++i){
+    if(tam[i].state >= SPRIXCELL_ANNIHILATED){
+      return true;
+    }
+  }
+  return false;
+}
+
+imgcache* imgcache_for(const sprixel* s){
+  const ncplane* n = s->n;
+  if(n == NULL || ncplane_pile_const(n) == NULL || n->tam == NULL){
+    return NULL;
+  }
+  imgcache* c = ncplane_notcurses_const(n)->tcache.imgcache;
+  if(c == NULL || tam_annihilated(n->tam, s->dimy, s->dimx)){
+    return NULL;
+  }
+  return c;
+}
+
+void imgkey_init(imgkey* k, const void* data, int linesize, int begy, int begx,
+                 int leny, int lenx, const blitterargs* bargs){
+  memset(k, 0, sizeof(*k));
+  k->cellpxy = bargs->u.pixel.cellpxy;
+  k->cellpxx = bargs->u.pixel.cellpxx;
+  k->pxoffy = bargs->u.pixel.pxoffy;
+  k->pxoffx = bargs->u.pixel.pxoffx;
+  k->colorregs = bargs->u.pixel.colorregs;
+  // flags only affecting where the bitmap goes don't affect its encoding
+  k->flags = bargs->flags & ~(NCVISUAL_OPTION_CHILDPLANE | NCVISUAL_OPTION_NODEGRADE |
+                              NCVISUAL_OPTION_HORALIGNED | NCVISUAL_OPTION_VERALIGNED);
+  k->transcolor = bargs->transcolor;
+  uint64_t h[4] = { 1, 2, 3, 4 };
+  if( (k->frame = bargs->u.pixel.frame) ){
+    // the media engine has told us which frame this is, and the scaled
+    // geometry is folded into that, so we needn't look at the pixels. the
+    // sprixel needn't exist yet (see imgcache_holds()).
+    k->begy = bargs->begy;
+    k->begx = bargs->begx;
+    k->leny = bargs->leny;
+    k->lenx = bargs->lenx;
+    h[0] = k->frame;
+    leny = 0;
+  }else{
+    k->begy = begy;
+    k->begx = begx;
+    k->leny = leny;
+    k->lenx = lenx;
+    k->dimy = bargs->u.pixel.spx->dimy;
+    k->dimx = bargs->u.pixel.spx->dimx;
+  }
+  // four independent lanes, so that the multiplies can overlap. each step
+  // is a bijection, so no single changed pixel goes unnoticed.
+  for(int y = begy ; y < leny ; ++y){
+    const uint32_t* rgba = (const uint32_t*)((const char*)data + linesize * y) + begx;
+    int x = 0;
+    for( ; x + 4 <= lenx ; x += 4){
+      for(int l = 0 ; l < 4 ; ++l){
+        h[l] = (h[l] ^ rgba[x + l]) * 0x9e3779b97f4a7c15ull;
+        h[l] ^= h[l] >> 29u;
+      }
+    }
+    for( ; x < lenx ; ++x){
+      h[0] = (h[0] ^ rgba[x]) * 0x9e3779b97f4a7c15ull;
+      h[0] ^= h[0] >> 29u;
+    }
+  }
+  const uint64_t geom[] = {
+    (uint64_t)k->begy << 32u | (uint32_t)k->begx, (uint64_t)k->leny << 32u | (uint32_t)k->lenx,
+    (uint64_t)k->dimy << 32u | k->dimx, (uint64_t)k->cellpxy << 32u | k->cellpxx,
+    (uint64_t)k->pxoffy << 32u | (uint32_t)k->pxoffx,
+    (uint64_t)k->colorregs << 32u | k->transcolor, k->flags,
+  };
+  uint64_t hash = 0;
+  for(unsigned l = 0 ; l < sizeof(h) / sizeof(*h) ; ++l){
+    hash = (hash ^ h[l]) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29u;
+  }
+  for(unsigned g = 0 ; g < sizeof(geom) / sizeof(*geom) ; ++g){
+    hash = (hash ^ geom[g]) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29u;
+  }
+  k->hash = hash ? hash : 1; // 0 marks an empty slot of imgcache->seen
+}
+
+// unlink |e| from the use list. called with the lock held.
+static void
+imgcache_unlink(imgcache* c, imgentry* e){
+  if(e->prev){
+    e->prev->next = e->next;
+  }else{
+    c->mru = e->next;
+  }
+  if(e->next){
+    e->next->prev = e->prev;
+  }else{
+    c->lru = e->prev;
+  }
+  e->prev = e->next = NULL;
+}
+
+// make |e| the most recently used entry. called with the lock held.
+static void
+imgcache_push(imgcache* c, imgentry* e){
+  e->prev = NULL;
+  if( (e->next = c->mru) ){
+    c->mru->prev = e;
+  }else{
+    c->lru = e;
+  }
+  c->mru = e;
+}
+
+// remove |e| from the cache and destroy it, queueing its kitty image (if it
+// was ever sent) for deletion. called with the lock held.
+static void
+imgcache_evict(imgcache* c, imgentry* e){
+  imgcache_unlink(c, e);
+  c->bytes -= e->bytes;
+  if(e->imageid && e->loaded){
+    if(c->evictedcount == c->evictedalloc){
+      unsigned na = c->evictedalloc ? c->evictedalloc * 2 : 16;
+      uint32_t* tmp = realloc(c->evicted, sizeof(*tmp) * na);
+      if(tmp){
+        c->evicted = tmp;
+        c->evictedalloc = na;
+      }
+    }
+    // if we couldn't grow the list, the image lingers until kitty's quota
+    // forces it out, which is harmless.
+    if(c->evictedcount < c->evictedalloc){
+      c->evicted[c->evictedcount++] = e->imageid;
+    }
+  }
+  loginfo("evicting %" PRIuPTR "B (%" PRIuPTR "B/%" PRIuPTR "B in use)",
+          e->bytes, c->bytes, c->budget);
+  imgentry_destroy(e);
+}
+
+// evict unused entries, least recently used first, until we're within our
+// budget. called with the lock held.
+static void
+imgcache_trim(imgcache* c){
+  imgentry* e = c->lru;
+  while(c->bytes > c->budget && e){
+    imgentry* prev = e->prev;
+    if(e->refs == 0){
+      imgcache_evict(c, e);
+    }
+    e = prev;
+  }
+}
+
+// does |e| hold the pixels hashed into |k|? equal hashes only make that
+// likely, so unless the engine named the frame, we compare the copy kept by
+// the entry against the source in full.
+static bool
+imgentry_matches(const imgentry* e, const imgkey* k, const void* data, int linesize){
+  if(e->key.hash != k->hash || memcmp(&e->key, k, sizeof(*k))){
+    return false;
+  }
+  if(k->frame){
+    return true;
+  }
+  if(e->rgba == NULL){
+    return false;
+  }
+  const size_t linelen = k->lenx * sizeof(*e->rgba);
+  for(int y = k->begy ; y < k->leny ; ++y){
+    const char* src = (const char*)data + linesize * y + k->begx * sizeof(*e->rgba);
+    if(memcmp((const char*)e->rgba + linelen * (y - k->begy), src, linelen)){
+      return false;
+    }
+  }
+  return true;
+}
+
+imgentry* imgcache_get(imgcache* c, const imgkey* k, const void* data,
+                       int linesize, bool* admit){
+  *admit = false;
+  pthread_mutex_lock(&c->lock);
+  imgentry* e;
+  for(e = c->mru ; e ; e = e->next){
+    if(imgentry_matches(e, k, data, linesize)){
+      break;
+    }
+  }
+  if(e){
+    // an entry whose kitty image has yet to be sent can't be placed. it's
+    // still a hit as far as admission goes, lest we add it twice.
+    if(e->loaded){
+      ++e->refs;
+      imgcache_unlink(c, e);
+      imgcache_push(c, e);
+    }else{
+      e = NULL;
+    }
+  }else if(k->frame){
+    *admit = true;
+  }else{
+    unsigned i;
+    for(i = 0 ; i < IMGCACHE_SEEN ; ++i){
+      if(c->seen[i] == k->hash){
+        c->seen[i] = 0;
+        *admit = true;
+        break;
+      }
+    }
+    if(i == IMGCACHE_SEEN){
+      c->seen[c->seenidx++ % IMGCACHE_SEEN] = k->hash;
+    }
+  }
+  pthread_mutex_unlock(&c->lock);
+  return e;
+}
+
+bool imgcache_holds(const ncplane* n, unsigned dimy, unsigned dimx,
+                    const blitterargs* bargs){
+  if(ncplane_pile_const(n) == NULL){
+    return false;
+  }
+  imgcache* c = ncplane_notcurses_const(n)->tcache.imgcache;
+  if(c == NULL){
+    return false;
+  }
+  // a recycled sprixel of the same geometry keeps its TAM, annihilations
+  // and all, and imgcache_for() will refuse it.
+  if(n->sprite && n->tam && n->sprite->dimy == dimy && n->sprite->dimx == dimx){
+    if(tam_annihilated(n->tam, dimy, dimx)){
+      return false;
+    }
+  }
+  imgkey k;
+  imgkey_init(&k, NULL, 0, 0, 0, 0, 0, bargs);
+  pthread_mutex_lock(&c->lock);
+  const imgentry* e;
+  for(e = c->mru ; e ; e = e->next){
+    if(e->key.hash == k.hash && !memcmp(&e->key, &k, sizeof(k))){
+      break;
+    }
+  }
+  bool held = e && e->loaded;
+  pthread_mutex_unlock(&c->lock);
+  return held;
+}
+
+imgentry* imgentry_create(imgcache* c, const imgkey* k){
+  imgentry* e = malloc(sizeof(*e));
+  if(e == NULL){
+    return NULL;
+  }
+  memset(e, 0, sizeof(*e));
+  memcpy(&e->key, k, sizeof(*k));
+  e->cache = c;
+  e->refs = 1;
+  pthread_mutex_lock(&c->lock);
+  e->imageid = c->nextimage++;
+  if(c->nextimage == 0){ // stay clear of sprixel ids
+    c->nextimage = 0x1000000u;
+  }
+  pthread_mutex_unlock(&c->lock);
+  return e;
+}
+
+int imgentry_keep_pixels(imgentry* e, const void* data, int linesize){
+  const imgkey* k = &e->key;
+  const size_t linelen = k->lenx * sizeof(*e->rgba);
+  const int rows = k->leny - k->begy;
+  if((e->rgba = malloc(linelen * rows)) == NULL){
+    return -1;
+  }
+  for(int y = 0 ; y < rows ; ++y){
+    memcpy((char*)e->rgba + linelen * y, (const char*)data + linesize * (k->begy + y)
+           + k->begx * sizeof(*e->rgba), linelen);
+  }
+  e->bytes += linelen * rows;
+  return 0;
+}
+
+void imgcache_insert(imgcache* c, imgentry* e){
+  pthread_mutex_lock(&c->lock);
+  imgcache_push(c, e);
+  c->bytes += e->bytes;
+  imgcache_trim(c);
+  pthread_mutex_unlock(&c->lock);
+}
+
+void imgcache_release(imgentry* e){
+  imgcache* c = e->cache;
+  pthread_mutex_lock(&c->lock);
+  if(--e->refs == 0){
+    if(!e->loaded){ // the image was never sent, and never can be
+      imgcache_evict(c, e);
+    }else{
+      imgcache_trim(c);
+    }
+  }
+  pthread_mutex_unlock(&c->lock);
+}
+
+void imgcache_loaded(imgentry* e){
+  imgcache* c = e->cache;
+  pthread_mutex_lock(&c->lock);
+  e->loaded = true;
+  pthread_mutex_unlock(&c->lock);
+}
+
+int imgcache_flush(imgcache* c, fbuf* f){
+  int ret = 0;
+  pthread_mutex_lock(&c->lock);
+  for(unsigned i = 0 ; i < c->evictedcount ; ++i){
+    if(kitty_remove(c->evicted[i], f)){
+      ret = -1;
+    }
+  }
+  c->evictedcount = 0;
+  pthread_mutex_unlock(&c->lock);
+  return ret;
+}
+
+int imgcache_purge(imgcache* c, fbuf* f){
+  pthread_mutex_lock(&c->lock);
+  imgentry* e = c->mru;
+  while(e){
+    imgentry* next = e->next;
+    if(e->refs == 0){
+      imgcache_evict(c, e);
+    }
+    e = next;
+  }
+  pthread_mutex_unlock(&c->lock);
+  return imgcache_flush(c, f);
+}
+
 // we don't want to seed the process-wide prng, but we do want to stir in a
 // bit of randomness for our purposes. we probably ought just use platform-
 // specific APIs, but for now, throw the timestamp in there, lame FIXME.
@@ -219,7 +631,31 @@ int sprite_init(tinfo* t, int fd){
   if(t->pixel_init == NULL){
     return 0;
   }
-  return t->pixel_init(t, fd);
+  int ret = t->pixel_init(t, fd);
+  if(ret == 0 && t->imgcache == NULL && t->pixel_implementation != NCPIXEL_LINUXFB){
+    // kitty starts evicting images once they exceed a quota of 320MiB, and
+    // it mustn't evict those we've cached. keep them to a quarter of that,
+    // leaving the remainder for the images of our other sprixels.
+    size_t budget = IMGCACHE_BUDGET;
+    const char* env = getenv("NOTCURSES_IMAGE_CACHE");
+    if(env){
+      char* end;
+      long l = strtol(env, &end, 10);
+      if(*env && !*end && l >= 0){
+        budget = (size_t)l << 20u;
+      }else{
+        logwarn("ignoring invalid NOTCURSES_IMAGE_CACHE: %s", env);
+      }
+    }
+    if(budget){
+      if((t->imgcache = imgcache_create(budget)) == NULL){
+        logwarn("couldn't create image cache");
+      }else{
+        ((imgcache*)t->imgcache)->nextimage = 0x1000000u + ((rand() ^ stir) & 0xffffffu);
+      }
+    }
+  }
+  return ret;
 }
 
 int sprixel_rescale(sprixel* spx, unsigned ncellpxy, unsigned ncellpxx){
@@ -16,6 +16,7 @@ struct ncpile;
 struct ncplane;
 struct sixelmap;
 struct blitterargs;
+struct imgcache;
 
 typedef enum {
   SPRIXEL_QUIESCENT,   // up-to-date and visible at the proper place
@@ -128,6 +129,57 @@ typedef struct tament {
   void* auxvector; // palette entries for sixel, alphas for kitty
 } tament;
 
+// what determines a bitmap's encoding: a hash of the source pixels blitted,
+// and the geometry and options with which they were blitted. keys are
+// compared in their entirety, so they must be zeroed before being filled in.
+// a matching key only makes equal pixels likely; see imgcache_get().
+typedef struct imgkey {
+  uint64_t hash;        // source pixels, mixed with everything below
+  uint64_t frame;       // identity of the source, in place of its pixels
+  int begy, begx;       // origin within the source
+  int leny, lenx;       // source pixel geometry
+  int dimy, dimx;       // sprixel cell geometry
+  int cellpxy, cellpxx; // cell-pixel geometry
+  int pxoffy, pxoffx;   // pixel offsets within the origin cell
+  int colorregs;
+  uint64_t flags;
+  uint32_t transcolor;
+} imgkey;
+
+// an entry in a context's image cache (see imgcache_create()). a kitty entry
+// is an image loaded under an id of its own, which sprixels blitting the same
+// pixels place rather than transmitting anew; it's kept alive by those
+// sprixels. a sixel entry is the complete encoding, copied by such blits.
+typedef struct imgentry {
+  imgkey key;
+  struct imgcache* cache;   // owning cache
+  struct imgentry* prev;    // least recently used list
+  struct imgentry* next;
+  size_t bytes;             // charged against the cache's budget
+  unsigned refs;            // sprixels (kitty) or blits (sixel) using us
+  bool loaded;              // can be used (the kitty image has been sent)
+  sprixcell_e* states;      // TAM following the blit
+  int pixy, pixx;           // output pixel geometry
+  int parse_start;
+  uint32_t* rgba;           // source pixels (not kept for a sixel frame)
+  // only used for kitty-based entries
+  uint32_t imageid;         // above the 24 bits of sprixel ids
+  // only used for sixel-based entries
+  fbuf glyph;               // header and payload
+  struct sixelmap* smap;
+} imgentry;
+
+// what fbcon last wrote of a sprixel to the framebuffer (see fbcon_draw()),
+// so that cells which haven't changed needn't be written again.
+typedef struct fbdrawn {
+  int y, x;             // cell position of the origin
+  int pixy, pixx;       // pixel geometry
+  unsigned dimy, dimx;  // cell geometry
+  unsigned generation;  // framebuffer generation (see tinfo) when drawn
+  unsigned char* damage;// one per cell, overwritten by text since drawn
+  uint32_t px[];        // the glyph as drawn
+} fbdrawn;
+
 // a sprixel represents a bitmap, using whatever local protocol is available.
 // there is a list of sprixels per ncpile. there ought never be very many
 // associated with a context (a dozen or so at max). with the kitty protocol,
@@ -151,12 +203,22 @@ typedef struct sprixel {
   int movedfromx;       // so that we can damage old cells when redrawn
   // only used for kitty-based sprixels
   int parse_start;      // where to start parsing for cell wipes
+  unsigned* chunkoffs;  // payload offset of each chunk from parse_start (static)
   int pxoffy, pxoffx;   // X and Y parameters to display command
+  char* transfile;      // temporary file loaded by the undrawn glyph, if any
+  uint32_t* lastpx;     // RGBA last sent, against which to diff the next frame
+  int lastpxy, lastpxx; // geometry of lastpx
+  bool keeppx;          // retain lastpx for a successor (we were reblitted)
+  bool wiped;           // image has been touched by wipes or rebuilds
+  imgentry* cached;     // cached image we place, rather than one of our own
   // only used for sixel-based sprixels
   unsigned char* needs_refresh; // one per cell, whether new frame needs damage
   struct sixelmap* smap;  // copy of palette indices + transparency bits
+  struct sixelpalette* palette; // last palette built, if we've been reblitted
   bool wipes_outstanding; // do we need rebuild the sixel next render?
   bool animating;        // do we have an active animation?
+  // only used for fbcon-based sprixels
+  fbdrawn* drawn;        // what we last wrote to the framebuffer, if anything
 } sprixel;
 
 static inline tament*
@@ -195,6 +257,8 @@ int sixel_scrub(const struct ncpile* p, sprixel* s);
 int kitty_scrub(const struct ncpile* p, sprixel* s);
 int fbcon_scrub(const struct ncpile* p, sprixel* s);
 int kitty_remove(int id, fbuf* f);
+// remove only our placement of a cached image.
+int kitty_unplace(const sprixel* s, fbuf* f);
 int kitty_clear_all(fbuf* f);
 int sixel_init_forcesdm(struct tinfo* ti, int fd);
 int sixel_init_inverted(struct tinfo* ti, int fd);
@@ -202,6 +266,19 @@ int sixel_init(struct tinfo* ti, int fd);
 uint8_t* sixel_trans_auxvec(const struct ncpile* p);
 uint8_t* kitty_trans_auxvec(const struct ncpile* p);
 int kitty_commit(fbuf* f, sprixel* s, unsigned noscroll);
+int kitty_init(struct tinfo* ti, int fd);
+// replace the sprixel on |n| ahead of a reblit. with animation, the
+// replacement takes over the loaded image when it can, so that only changes
+// need be sent.
+sprixel* kitty_recycle(struct ncplane* n);
+// create a temporary file which kitty will delete once it has been loaded,
+// returning its fd and writing its (heap-allocated) path to |*path|.
+int kitty_tempfile(char** path);
+// probe for kitty file transmission as part of the frame being written to
+// |f|, or pick up the answer to an earlier probe.
+void kitty_probe_frame(struct tinfo* ti, fbuf* f);
+// remove the file transmission probe, if one is outstanding.
+void kitty_probe_reap(struct tinfo* ti);
 int sixel_blit(struct ncplane* nc, int linesize, const void* data,
                int leny, int lenx, const struct blitterargs* bargs);
 int kitty_blit(struct ncplane* nc, int linesize, const void* data,
@@ -214,8 +291,55 @@ int fbcon_blit(struct ncplane* nc, int linesize, const void* data,
                int leny, int lenx, const struct blitterargs* bargs);
 int fbcon_draw(const struct tinfo* ti, sprixel* s, int yoff, int xoff);
 void fbcon_scroll(const struct ncpile* p, struct tinfo* ti, int rows);
+void fbcon_textrow(const struct ncpile* p, struct tinfo* ti, int y);
+void fbcon_compose(struct tinfo* ti, bool any);
+int fbcon_present(struct tinfo* ti);
+void fbcon_cleanup(struct tinfo* ti);
 void sixel_refresh(const struct ncpile* p, sprixel* s);
 
+// create a cache of at most |budget| bytes of bitmaps, for the use of pixel
+// blitters. its least recently used entries which aren't in use are evicted
+// to make room. with kitty, evicted images are deleted by imgcache_flush().
+struct imgcache* imgcache_create(size_t budget);
+void imgcache_destroy(struct imgcache* c);
+// the context's image cache, if the blit of |s| can use it. this requires
+// that we're in rendered mode, and that none of its cells are annihilated.
+struct imgcache* imgcache_for(const sprixel* s);
+// hash the source rows [|begy|..|leny|) and columns [|begx|..|begx + lenx|),
+// along with everything else in |bargs| which determines the encoding. if
+// |bargs| identifies the frame, the pixels aren't examined (|data| can be
+// NULL), and the source geometry is taken from |bargs|.
+void imgkey_init(imgkey* k, const void* data, int linesize, int begy, int begx,
+                 int leny, int lenx, const struct blitterargs* bargs);
+// look up |k|, returning a loaded entry with a reference taken, or NULL. an
+// entry matches if its key does, and (unless the key identifies a frame) its
+// pixels match those of |data|, which |k| was made from. on a miss, |*admit|
+// is set if the key was missed recently enough that it ought be added (we
+// don't cache bitmaps until we've seen them a second time), or if it
+// identifies a frame (the media engine expects to see it again).
+imgentry* imgcache_get(struct imgcache* c, const imgkey* k, const void* data,
+                       int linesize, bool* admit);
+// would a blit of the frame identified by |bargs| into |n|, as a sprixel of
+// |dimy|x|dimx| cells, be served from the cache? doesn't touch the entry.
+bool imgcache_holds(const struct ncplane* n, unsigned dimy, unsigned dimx,
+                    const struct blitterargs* bargs);
+// create an entry for |k| holding a single reference, to be filled in and
+// then added with imgcache_insert() (or destroyed with imgentry_destroy()).
+imgentry* imgentry_create(struct imgcache* c, const imgkey* k);
+void imgentry_destroy(imgentry* e);
+// copy into |e| the source pixels its key was made from, against which later
+// lookups are compared.
+int imgentry_keep_pixels(imgentry* e, const void* data, int linesize);
+void imgcache_insert(struct imgcache* c, imgentry* e);
+void imgcache_release(imgentry* e);
+// mark the kitty image of |e| as having been sent.
+void imgcache_loaded(imgentry* e);
+// delete any kitty images which have been evicted.
+int imgcache_flush(struct imgcache* c, fbuf* f);
+// evict every entry not in use, and delete their kitty images. the terminal
+// otherwise holds on to them after we've exited.
+int imgcache_purge(struct imgcache* c, fbuf* f);
+
 // takes ownership of s on success.
 int sprixel_load(sprixel* spx, fbuf* f, unsigned pixy, unsigned pixx,
                  int parse_start, sprixel_e state);
@@ -225,6 +349,7 @@ int sprixel_rescale(sprixel* spx, unsigned ncellpixy, unsigned ncellpixx);
 
 // cleans up the sixel worker threads
 void sixel_cleanup(struct tinfo* ti);
+void kitty_cleanup(struct tinfo* ti);
 
 #ifdef __cplusplus
 }
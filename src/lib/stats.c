@@ -74,6 +74,7 @@ void update_raster_stats(const struct timespec* time1, const struct timespec* ti
 void reset_stats(ncstats* stats){
   uint64_t fbbytes = stats->fbbytes;
   unsigned planes = stats->planes;
+  uint64_t rasterbufbytes = stats->rasterbufbytes;
   memset(stats, 0, sizeof(*stats));
   stats->render_min_ns = 1ull << 62u;
   stats->raster_min_bytes = 1ull << 62u;
@@ -81,6 +82,7 @@ void reset_stats(ncstats* stats){
   stats->writeout_min_ns = 1ull << 62u;
   stats->fbbytes = fbbytes;
   stats->planes = planes;
+  stats->rasterbufbytes = rasterbufbytes;
 }
 
 void notcurses_stats(notcurses* nc, ncstats* stats){
@@ -158,6 +160,7 @@ void notcurses_stats_reset(notcurses* nc, ncstats* stats){
 
     stash->fbbytes = nc->stats.s.fbbytes;
     stash->planes = nc->stats.s.planes;
+    stash->rasterbufbytes = nc->stats.s.rasterbufbytes;
     reset_stats(&nc->stats.s);
   pthread_mutex_unlock(&nc->stats.lock);
 }
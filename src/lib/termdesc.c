@@ -99,9 +99,12 @@ setup_sixel_bitmaps(tinfo* ti, int fd, unsigned forcesdm, unsigned invert80){
   ti->pixel_draw = sixel_draw;
   ti->pixel_refresh = sixel_refresh;
   ti->pixel_draw_late = NULL;
+  ti->pixel_compose = NULL;
+  ti->pixel_present = NULL;
   ti->pixel_commit = NULL;
   ti->pixel_move = NULL;
   ti->pixel_scroll = NULL;
+  ti->pixel_textrow = NULL;
   ti->pixel_wipe = sixel_wipe;
   ti->pixel_clear_all = NULL;
   ti->pixel_rebuild = sixel_rebuild;
@@ -122,11 +125,16 @@ setup_kitty_bitmaps(tinfo* ti, int fd, ncpixelimpl_e level){
   ti->pixel_remove = kitty_remove;
   ti->pixel_draw = kitty_draw;
   ti->pixel_draw_late = NULL;
+  ti->pixel_compose = NULL;
+  ti->pixel_present = NULL;
   ti->pixel_refresh = NULL;
   ti->pixel_commit = kitty_commit;
   ti->pixel_move = kitty_move;
   ti->pixel_scroll = NULL;
+  ti->pixel_textrow = NULL;
   ti->pixel_clear_all = kitty_clear_all;
+  ti->pixel_init = kitty_init;
+  ti->pixel_cleanup = kitty_cleanup;
   if(level == NCPIXEL_KITTY_STATIC){
     ti->pixel_wipe = kitty_wipe;
     ti->pixel_trans_auxvec = kitty_trans_auxvec;
@@ -159,14 +167,18 @@ setup_fbcon_bitmaps(tinfo* ti, int fd){
   ti->pixel_remove = NULL;
   ti->pixel_draw = NULL;
   ti->pixel_draw_late = fbcon_draw;
+  ti->pixel_compose = fbcon_compose;
+  ti->pixel_present = fbcon_present;
   ti->pixel_commit = NULL;
   ti->pixel_refresh = NULL;
   ti->pixel_move = NULL;
   ti->pixel_scroll = fbcon_scroll;
+  ti->pixel_textrow = fbcon_textrow;
   ti->pixel_clear_all = NULL;
   ti->pixel_rebuild = fbcon_rebuild;
   ti->pixel_wipe = fbcon_wipe;
   ti->pixel_trans_auxvec = kitty_trans_auxvec;
+  ti->pixel_cleanup = fbcon_cleanup;
   set_pixel_blitter(fbcon_blit);
   ti->pixel_implementation = NCPIXEL_LINUXFB;
   sprite_init(ti, fd);
@@ -194,12 +206,32 @@ query_rgb(void){
   return rgb;
 }
 
+// NOTCURSES_KITTY_TRANSPORT can be "direct", inhibiting the probe (and thus
+// file transmission), or "tempfile", forcing file transmission without it.
+static void
+kitty_transport_env(tinfo* ti){
+  const char* transport = getenv("NOTCURSES_KITTY_TRANSPORT");
+  if(transport){
+    if(strcmp(transport, "direct") == 0){
+      ti->kittyprobed = true;
+      return;
+    }else if(strcmp(transport, "tempfile") == 0){
+      ti->kitty_tempfiles = true;
+      ti->kittyprobed = true;
+      return;
+    }
+    logwarn("unknown NOTCURSES_KITTY_TRANSPORT value %s", transport);
+  }
+}
+
 void free_terminfo_cache(tinfo* ti){
   stop_inputlayer(ti);
   loginfo("brought down input layer");
   if(ti->pixel_cleanup){
     ti->pixel_cleanup(ti);
   }
+  imgcache_destroy(ti->imgcache);
+  ti->imgcache = NULL;
   free(ti->termversion);
   free(ti->esctable);
 #ifdef __linux__
@@ -207,11 +239,14 @@ void free_terminfo_cache(tinfo* ti){
     close(ti->linux_fb_fd);
   }
   free(ti->linux_fb_dev);
+  free(ti->linux_fb_rows);
   if(ti->linux_fbuffer != MAP_FAILED){
     munmap(ti->linux_fbuffer, ti->linux_fb_len);
   }
 #endif
   free(ti->tpreserved);
+  kitty_probe_reap(ti);
+  ncworkers_unref();
   loginfo("destroyed terminfo cache");
 }
 
@@ -1331,6 +1366,8 @@ int interrogate_terminfo(tinfo* ti, FILE* out, unsigned utf8,
   }
   *cursor_x = *cursor_y = -1;
   ti->sixelengine = NULL;
+  ti->kittyengine = NULL;
+  ti->imgcache = NULL;
   ti->bg_collides_default = 0xfe000000;
   ti->fg_default = 0xff000000;
   ti->kbdlevel = UINT_MAX; // see comment in tinfo definition
@@ -1533,6 +1570,8 @@ int interrogate_terminfo(tinfo* ti, FILE* out, unsigned utf8,
       setup_kitty_bitmaps(ti, ti->ttyfd, NCPIXEL_KITTY_STATIC);
     }
   }
+  kitty_transport_env(ti);
+  ncworkers_ref();
   return 0;
 
 err:
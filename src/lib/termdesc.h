@@ -10,8 +10,12 @@ extern "C" {
 #include "version.h"
 #include "builddef.h"
 #include <stdint.h>
+#include <signal.h>
 #include <pthread.h>
 #include <stdbool.h>
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
 #include <notcurses/notcurses.h>
 #include "sprite.h"
 #include "blit.h"
@@ -131,6 +135,20 @@ typedef struct tinfo {
   // bitmap support. if we support bitmaps, pixel_implementation will be a
   // value other than NCPIXEL_NONE.
   ncpixelimpl_e pixel_implementation;
+  // can kitty graphics be transmitted via temporary files (t=t)? this requires
+  // that the terminal share our filesystem. we probe for it with a file at
+  // kittyprobe, sent along with the first frame written to the terminal to
+  // contain an animated kitty bitmap (see kitty_probe_frame()). the input
+  // layer records the answer in kittyprobereply (1 on success, -1 on
+  // failure), and the file is removed.
+  bool kitty_tempfiles;
+  bool kittyprobed;            // the probe has been sent (or isn't wanted)
+  char* kittyprobe;
+#ifndef __cplusplus
+  atomic_int kittyprobereply;  // written by the input thread
+#else
+  int kittyprobereply;         // C++ (i.e. the tests) never touches it
+#endif
   // wipe out a cell's worth of pixels from within a sprixel. for sixel, this
   // means leaving out the pixels (and likely resizes the string). for kitty,
   // this means dialing down their alpha to 0 (in equivalent space).
@@ -146,6 +164,11 @@ typedef struct tinfo {
   int (*pixel_draw)(const struct tinfo*, const struct ncpile* p,
                     sprixel* s, fbuf* f, int y, int x);
   int (*pixel_draw_late)(const struct tinfo*, sprixel* s, int yoff, int xoff);
+  // bracket the pixel_draw_late pass, for backends which compose graphics out
+  // of sight. only used with fbcon (page flipping). |any| is whether there
+  // are any sprixels to draw.
+  void (*pixel_compose)(struct tinfo*, bool any);
+  int (*pixel_present)(struct tinfo*);
   // execute move (erase old graphic, place at new location) if non-NULL
   int (*pixel_move)(sprixel* s, fbuf* f, unsigned noscroll, int yoff, int xoff);
   int (*pixel_scrub)(const struct ncpile* p, sprixel* s);
@@ -154,6 +177,8 @@ typedef struct tinfo {
   int (*pixel_commit)(fbuf* f, sprixel* s, unsigned noscroll);
   // scroll all graphics up. only used with fbcon.
   void (*pixel_scroll)(const struct ncpile* p, struct tinfo*, int rows);
+  // text was written to (absolute) row |y|. only used with fbcon.
+  void (*pixel_textrow)(const struct ncpile* p, struct tinfo*, int y);
   void (*pixel_cleanup)(struct tinfo*); // called at shutdown
   uint8_t* (*pixel_trans_auxvec)(const struct ncpile* p); // create tranparent auxvec
   // sprixel parameters. there are several different sprixel protocols, of
@@ -172,6 +197,8 @@ typedef struct tinfo {
   unsigned sixel_maxy_pristine; // maximum theoretical sixel height, as queried
   unsigned sprixel_scale_height;// sprixel must be a multiple of this many rows
   void* sixelengine;         // opaque threaded engine used by sixel dispatch
+  void* kittyengine;         // opaque cached compressors used by kitty
+  void* imgcache;            // opaque cache of blitted bitmaps, see sprite.c
   const char* termname;      // terminal name from environment variables/init
   char* termversion;         // terminal version (freeform) from query responses
   queried_terminals_e qterm; // detected terminal class
@@ -199,6 +226,24 @@ typedef struct tinfo {
   char* linux_fb_dev;        // device corresponding to linux_fb_dev
   uint8_t* linux_fbuffer;    // mmap()ed framebuffer
   size_t linux_fb_len;       // size of map
+  size_t linux_fb_stride;    // bytes per framebuffer row
+  unsigned linux_fb_bpp;     // bytes per framebuffer pixel (2, 3, or 4)
+  uint8_t linux_fb_shifts[3];// bit offsets of red, green, and blue
+  uint8_t linux_fb_bits[3];  // bit lengths of red, green, and blue
+  bool linux_fb_native;      // pixels are xRGB8888, as are our glyphs
+  unsigned linux_fb_gen;     // bumped whenever graphics might have been lost
+  // with NOTCURSES_FBCON_FLIP, the virtual framebuffer holds three pages. the
+  // console writes its text into the first, and we never draw there. frames
+  // with graphics are composed into whichever of the other two isn't
+  // displayed, which is then panned to. only those rows which the console
+  // has rewritten since a page was last composed are copied into it.
+  bool linux_fb_wantflip;    // page flipping was requested
+  unsigned linux_fb_pages;   // 3 if we're flipping, otherwise 1
+  size_t linux_fb_pagelen;   // bytes per page
+  unsigned linux_fb_page;    // page being drawn into
+  unsigned linux_fb_shown;   // page being displayed
+  uint32_t linux_fb_yvirt;   // yres_virtual before we grew it, or 0
+  uint8_t* linux_fb_rows;    // per pixel row, pages which need it copied
 #elif defined(__MINGW32__)
   HANDLE inhandle;
   HANDLE outhandle;
@@ -0,0 +1,186 @@
+#include <stdint.h>
+#include "egcpool.h"
+#include "unitables.h"
+
+// Grapheme_Cluster_Break values, as encoded by tools/unicode-tables.py
+enum {
+  NCGCB_OTHER,
+  NCGCB_CR,
+  NCGCB_LF,
+  NCGCB_CONTROL,
+  NCGCB_EXTEND,
+  NCGCB_ZWJ,
+  NCGCB_RI,
+  NCGCB_PREPEND,
+  NCGCB_SPACINGMARK,
+  NCGCB_L,
+  NCGCB_V,
+  NCGCB_T,
+  NCGCB_LV,
+  NCGCB_LVT,
+};
+
+// width classes, as encoded by tools/unicode-tables.py. these match glibc's
+// wcwidth() for a UTF-8 locale built from the same version of Unicode.
+enum {
+  NCUWIDTH_ZERO,
+  NCUWIDTH_ONE,
+  NCUWIDTH_TWO,
+  NCUWIDTH_SPACE, // nonprinting whitespace (tab, newline, etc.)
+  NCUWIDTH_CNTRL, // prohibited control character
+};
+
+static inline unsigned
+ucd_props(uint32_t cp){
+  const unsigned blockmask = (1u << NCUCD_BLOCKSHIFT) - 1;
+  return ucd_stage2[ucd_stage1[cp >> NCUCD_BLOCKSHIFT]][cp & blockmask];
+}
+
+static inline unsigned
+ucd_gcb(unsigned props){
+  return props & 0xfu;
+}
+
+static inline unsigned
+ucd_width(unsigned props){
+  return (props >> 4u) & 0x7u;
+}
+
+static inline bool
+ucd_extpict(unsigned props){
+  return props & 0x80u;
+}
+
+// decode the UTF-8 character at |s| into |*cp|. returns the number of bytes
+// consumed, 0 for the NUL terminator, or -1 for ill-formed UTF-8 (including
+// truncated sequences, overlong encodings, and surrogates).
+static inline int
+utf8_decode(const unsigned char* s, uint32_t* cp){
+  if(*s < 0x80){
+    *cp = *s;
+    return *s ? 1 : 0;
+  }
+  int len;
+  uint32_t min;
+  if((*s & 0xe0) == 0xc0){
+    len = 2;
+    min = 0x80;
+    *cp = *s & 0x1f;
+  }else if((*s & 0xf0) == 0xe0){
+    len = 3;
+    min = 0x800;
+    *cp = *s & 0x0f;
+  }else if((*s & 0xf8) == 0xf0){
+    len = 4;
+    min = 0x10000;
+    *cp = *s & 0x07;
+  }else{
+    return -1;
+  }
+  for(int i = 1 ; i < len ; ++i){
+    if((s[i] & 0xc0) != 0x80){ // catches any NUL terminator
+      return -1;
+    }
+    *cp = (*cp << 6u) | (s[i] & 0x3f);
+  }
+  if(*cp < min || *cp > 0x10ffff || (*cp >= 0xd800 && *cp <= 0xdfff)){
+    return -1;
+  }
+  return len;
+}
+
+// is there an extended grapheme cluster boundary between code points having
+// Grapheme_Cluster_Break values |prev| and |cur|? the rules are those of UAX
+// #29. |gb11| indicates that the text to this point ends with an
+// Extended_Pictographic, zero or more Extend, and a ZWJ, and that |cur| is
+// Extended_Pictographic. |ris| is the number of Regional_Indicators ending the
+// text to this point.
+static inline bool
+gcb_break(unsigned prev, unsigned cur, bool gb11, unsigned ris){
+  if(prev == NCGCB_CR && cur == NCGCB_LF){ // GB3
+    return false;
+  }
+  if(prev == NCGCB_CR || prev == NCGCB_LF || prev == NCGCB_CONTROL){ // GB4
+    return true;
+  }
+  if(cur == NCGCB_CR || cur == NCGCB_LF || cur == NCGCB_CONTROL){ // GB5
+    return true;
+  }
+  if(prev == NCGCB_L){ // GB6
+    if(cur == NCGCB_L || cur == NCGCB_V || cur == NCGCB_LV || cur == NCGCB_LVT){
+      return false;
+    }
+  }else if(prev == NCGCB_LV || prev == NCGCB_V){ // GB7
+    if(cur == NCGCB_V || cur == NCGCB_T){
+      return false;
+    }
+  }else if(prev == NCGCB_LVT || prev == NCGCB_T){ // GB8
+    if(cur == NCGCB_T){
+      return false;
+    }
+  }
+  if(cur == NCGCB_EXTEND || cur == NCGCB_ZWJ || cur == NCGCB_SPACINGMARK){
+    return false; // GB9, GB9a
+  }
+  if(prev == NCGCB_PREPEND){ // GB9b
+    return false;
+  }
+  if(gb11){ // GB11
+    return false;
+  }
+  if(prev == NCGCB_RI && cur == NCGCB_RI){ // GB12, GB13
+    return !(ris % 2);
+  }
+  return true; // GB999
+}
+
+int utf8_egc_len(const char* gcluster, int* colcount){
+  const unsigned char* s = (const unsigned char*)gcluster;
+  *colcount = 0;
+  uint32_t cp;
+  int r = utf8_decode(s, &cp);
+  if(r <= 0){
+    if(r < 0){
+      // FIXME probably ought escape this somehow
+      logerror("invalid UTF8: %s", gcluster);
+    }
+    return r;
+  }
+  unsigned props = ucd_props(cp);
+  unsigned width = ucd_width(props);
+  if(width == NCUWIDTH_SPACE){ // newline or tab
+    *colcount = 1;
+    return r;
+  }else if(width == NCUWIDTH_CNTRL){
+    logerror("prohibited or invalid unicode: 0x%08x", cp);
+    return -1;
+  }
+  // the first code point having nonzero width determines the cluster's width
+  *colcount = width;
+  size_t ret = r;
+  unsigned prev = ucd_gcb(props);
+  unsigned ris = prev == NCGCB_RI;
+  bool pict = ucd_extpict(props); // ExtPict Extend*
+  bool pictzwj = false;           // ExtPict Extend* ZWJ
+  while((r = utf8_decode(s + ret, &cp)) > 0){
+    props = ucd_props(cp);
+    const unsigned gcb = ucd_gcb(props);
+    if(gcb_break(prev, gcb, pictzwj && ucd_extpict(props), ris)){
+      break; // starts a new EGC, exit and do not claim
+    }
+    if(*colcount == 0){
+      width = ucd_width(props);
+      *colcount = width > NCUWIDTH_TWO ? 1 : width;
+    }
+    pictzwj = pict && gcb == NCGCB_ZWJ;
+    pict = ucd_extpict(props) || (pict && gcb == NCGCB_EXTEND);
+    ris = gcb == NCGCB_RI ? ris + 1 : 0;
+    prev = gcb;
+    ret += r;
+  }
+  if(r < 0){
+    logerror("invalid UTF8: %s", gcluster);
+    return -1;
+  }
+  return ret;
+}
@@ -2,6 +2,7 @@
 #include <pwd.h>
 #include <unistd.h>
 #if defined(__linux__) || defined(__gnu_hurd__)
+#include <sched.h>
 #include <sys/utsname.h>
 #include <sys/sysinfo.h>
 #elif !defined(__MINGW32__)
@@ -32,6 +33,46 @@ int set_loglevel_from_env(ncloglevel_e* llptr){
   return 0;
 }
 
+unsigned ncpu_count(void){
+  long cpus = 0;
+#ifdef __MINGW32__
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  cpus = si.dwNumberOfProcessors;
+#else
+#ifdef __linux__
+  // we might be restricted to a subset of the machine (taskset, cpusets)
+  cpu_set_t mask;
+  if(sched_getaffinity(0, sizeof(mask), &mask) == 0){
+    cpus = CPU_COUNT(&mask);
+  }
+#endif
+  if(cpus <= 0){
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+#endif
+  if(cpus <= 0){
+    logwarn("couldn't determine processor count, assuming 1");
+    cpus = 1;
+  }
+  return cpus;
+}
+
+unsigned ncthread_helpers(const char* envvar, unsigned max){
+  unsigned helpers = ncpu_count() - 1;
+  const char* env = getenv(envvar);
+  if(env){
+    char* end;
+    long l = strtol(env, &end, 10);
+    if(*env && !*end && l >= 0){
+      helpers = (unsigned long)l > max ? max : l;
+    }else{
+      logwarn("ignoring invalid %s: %s", envvar, env);
+    }
+  }
+  return helpers > max ? max : helpers;
+}
+
 char* notcurses_accountname(void){
 #ifndef __MINGW32__
   const char* un;
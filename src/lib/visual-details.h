@@ -26,6 +26,12 @@ typedef struct ncvisual {
   // lines are sometimes padded. this many true bytes per row in data.
   unsigned rowstride;
   bool owndata; // we own data iff owndata == true
+  // set by a media engine for the duration of a blit while it's looping,
+  // identifying the frame so that its encoding can be found in the image
+  // cache without examining its pixels. if stale is set, data doesn't hold
+  // this frame, and a pixel blit fails (clearing stale) unless it's cached.
+  uint64_t frametag;
+  bool stale;
 } ncvisual;
 
 static inline void
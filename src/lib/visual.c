@@ -221,9 +221,14 @@ int ncvisual_geom_inner(const tinfo* ti, const ncvisual* n,
     vopts = &fakevopts;
   }
   // check basic vopts preconditions
-  if(vopts->flags >= (NCVISUAL_OPTION_NOINTERPOLATE << 1u)){
+  if(vopts->flags >= (NCVISUAL_OPTION_DITHER << 1u)){
     logwarn("warning: unknown ncvisual options %016" PRIx64, vopts->flags);
   }
+  if((vopts->flags & NCVISUAL_OPTION_FIXEDPALETTE) &&
+     (vopts->flags & NCVISUAL_OPTION_MEDIANCUT)){
+    logerror("requested both fixed and median cut palettes");
+    return -1;
+  }
   if((vopts->flags & NCVISUAL_OPTION_CHILDPLANE) && !vopts->n){
     logerror("requested child plane with NULL n");
     return -1;
@@ -806,14 +811,34 @@ ncvisual* ncvisual_from_rgba(const void* rgba, int rows, int rowstride, int cols
   return ncv;
 }
 
+// decodes directly into the visual's (padded) rows, avoiding an intermediate
+// buffer and copy.
 ncvisual* ncvisual_from_sixel(const char* s, unsigned leny, unsigned lenx){
-  uint32_t* rgba = ncsixel_as_rgba(s, leny, lenx);
-  if(rgba == NULL){
+  if(leny > INT_MAX || lenx > INT_MAX / 4){
+    logerror("invalid sixel geometry %ux%u", leny, lenx);
+    return NULL;
+  }
+  ncvisual* ncv = ncvisual_create();
+  if(ncv == NULL){
+    return NULL;
+  }
+  ncv->rowstride = pad_for_image(lenx * 4, lenx);
+  ncv->pixx = lenx;
+  ncv->pixy = leny;
+  uint32_t* data = malloc(ncv->rowstride * ncv->pixy);
+  if(data == NULL){
+    ncvisual_destroy(ncv);
+    return NULL;
+  }
+  if(ncsixel_decode(s, leny, lenx, data, ncv->rowstride / 4,
+                    sixel_decode_bands)){
     logerror("failed converting sixel to rgba");
+    free(data);
+    ncvisual_destroy(ncv);
     return NULL;
   }
-  ncvisual* ncv = ncvisual_from_rgba(rgba, leny, lenx * sizeof(*rgba), lenx);
-  free(rgba);
+  ncvisual_set_data(ncv, data, true);
+  ncvisual_details_seed(ncv);
   return ncv;
 }
 
@@ -1071,6 +1096,29 @@ ncplane* ncvisual_render_pixels(notcurses* nc, ncvisual* ncv, const struct blits
   bargs.u.pixel.pxoffx = pxoffx;
   bargs.u.pixel.cellpxy = geom->cdimy;
   bargs.u.pixel.cellpxx = geom->cdimx;
+  bargs.u.pixel.spx = NULL;
+  bargs.u.pixel.frame = 0;
+  if(ncv->frametag){
+    // the media engine knows this frame, and will see it again. fold in the
+    // scaled geometry, so that the key needn't depend on the pixels.
+    uint64_t frame = ncv->frametag;
+    const uint64_t scaled[] = {
+      (uint64_t)geom->rpixy << 32u | geom->rpixx,
+      (uint64_t)geom->rcelly << 32u | geom->rcellx,
+    };
+    for(unsigned i = 0 ; i < sizeof(scaled) / sizeof(*scaled) ; ++i){
+      frame = (frame ^ scaled[i]) * 0x9e3779b97f4a7c15ull;
+      frame ^= frame >> 29u;
+    }
+    bargs.u.pixel.frame = frame ? frame : 1;
+    // if we don't have the frame's pixels, it had better be cached. check
+    // before we touch the sprixel, so that the engine can decode and retry.
+    if(ncv->stale && !imgcache_holds(n, geom->rcelly, geom->rcellx, &bargs)){
+      loginfo("frame 0x%016" PRIx64 " isn't cached", ncv->frametag);
+      ncv->stale = false;
+      return NULL;
+    }
+  }
   const ncpile* p = ncplane_pile_const(n);
   if(n->sprite == NULL){
     if((n->sprite = sprixel_alloc(n, geom->rcelly, geom->rcellx)) == NULL){
@@ -1092,7 +1140,13 @@ ncplane* ncvisual_render_pixels(notcurses* nc, ncvisual* ncv, const struct blits
   }
   bargs.u.pixel.spx = n->sprite;
   // FIXME need to pull off the ncpile's sprixellist if anything below fails!
-  if(ncvisual_blit_internal(ncv, geom->rpixy, geom->rpixx, n, bset, &bargs)){
+  if(bargs.u.pixel.frame && ncv->stale){
+    // the blitter will find the frame in the cache, so there's nothing to
+    // scale (nor any valid pixels with which to do so).
+    if(rgba_blit_dispatch(n, bset, 0, NULL, geom->rpixy, geom->rpixx, &bargs) < 0){
+      return NULL;
+    }
+  }else if(ncvisual_blit_internal(ncv, geom->rpixy, geom->rpixx, n, bset, &bargs)){
     return NULL;
   }
   // if we created the plane earlier, placex/placey were taken into account, and
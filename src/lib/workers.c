@@ -0,0 +1,181 @@
+#include "internal.h"
+
+// a process-wide pool of helper threads, shared by all notcurses and ncdirect
+// contexts, for work which is split up anew each frame (banded blitting, the
+// deflation of kitty strips, sixel encoding and decoding). threads are
+// created as they're first needed, and live so long as any context does.
+// without a context, helper threads are created for each batch, and joined
+// at its end.
+
+typedef struct workbatch {
+  void (*fxn)(void*, unsigned);
+  void* curry;
+  unsigned jobs;        // jobs in the batch
+  unsigned next;        // next job to be claimed
+  unsigned helpers;     // pool threads which can still join the batch
+  unsigned active;      // pool threads working on the batch
+  bool queued;          // still available to the pool
+  struct workbatch* nextbatch;
+} workbatch;
+
+static pthread_mutex_t wlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wcond = PTHREAD_COND_INITIALIZER;     // work or exit
+static pthread_cond_t wdonecond = PTHREAD_COND_INITIALIZER; // helper left
+static unsigned wrefs;        // live contexts
+static unsigned wgeneration;  // bumped whenever the pool is torn down
+static unsigned wpopulation;
+static pthread_t wtids[NCWORKERS_MAXTHREADS];
+static workbatch* wqueue;
+
+// remove |b| from the queue, if it's there. call with wlock held.
+static void
+dequeue_batch(workbatch* b){
+  if(b->queued){
+    workbatch** pb = &wqueue;
+    while(*pb != b){
+      pb = &(*pb)->nextbatch;
+    }
+    *pb = b->nextbatch;
+    b->queued = false;
+  }
+}
+
+// run jobs from |b| until none remain unclaimed. call with wlock held.
+static void
+drain_batch(workbatch* b){
+  while(b->next < b->jobs){
+    const unsigned job = b->next++;
+    if(b->next == b->jobs){
+      dequeue_batch(b);
+    }
+    pthread_mutex_unlock(&wlock);
+    b->fxn(b->curry, job);
+    pthread_mutex_lock(&wlock);
+  }
+}
+
+static void*
+ncworker(void* vgen){
+  const unsigned gen = (uintptr_t)vgen;
+  pthread_mutex_lock(&wlock);
+  while(gen == wgeneration){
+    workbatch* b = wqueue;
+    if(b == NULL){
+      pthread_cond_wait(&wcond, &wlock);
+      continue;
+    }
+    ++b->active;
+    if(--b->helpers == 0){
+      dequeue_batch(b);
+    }
+    drain_batch(b);
+    if(--b->active == 0){
+      pthread_cond_broadcast(&wdonecond);
+    }
+  }
+  pthread_mutex_unlock(&wlock);
+  return NULL;
+}
+
+void ncworkers_ref(void){
+  pthread_mutex_lock(&wlock);
+  ++wrefs;
+  pthread_mutex_unlock(&wlock);
+}
+
+void ncworkers_unref(void){
+  pthread_t tids[NCWORKERS_MAXTHREADS];
+  unsigned population = 0;
+  pthread_mutex_lock(&wlock);
+  if(--wrefs == 0){
+    ++wgeneration;
+    population = wpopulation;
+    memcpy(tids, wtids, sizeof(*tids) * population);
+    wpopulation = 0;
+    pthread_cond_broadcast(&wcond);
+  }
+  pthread_mutex_unlock(&wlock);
+  for(unsigned t = 0 ; t < population ; ++t){
+    pthread_join(tids[t], NULL);
+  }
+  if(population){
+    loginfo("joined %u worker%s", population, population == 1 ? "" : "s");
+  }
+}
+
+static void*
+ncworker_transient(void* vb){
+  workbatch* b = vb;
+  pthread_mutex_lock(&wlock);
+  drain_batch(b);
+  pthread_mutex_unlock(&wlock);
+  return NULL;
+}
+
+// without a pool, spin up helpers just for this batch. the calling thread
+// picks up whatever they don't.
+static void
+run_transient(workbatch* b, unsigned helpers){
+  pthread_t tids[NCWORKERS_MAXTHREADS];
+  unsigned spawned = 0;
+  while(spawned < helpers){
+    if(pthread_create(&tids[spawned], NULL, ncworker_transient, b)){
+      break;
+    }
+    ++spawned;
+  }
+  ncworker_transient(b);
+  for(unsigned t = 0 ; t < spawned ; ++t){
+    pthread_join(tids[t], NULL);
+  }
+}
+
+void ncworkers_run(unsigned threads, unsigned jobs,
+                   void (*fxn)(void*, unsigned), void* curry){
+  if(threads > NCWORKERS_MAXTHREADS){
+    threads = NCWORKERS_MAXTHREADS;
+  }
+  if(threads > jobs){
+    threads = jobs;
+  }
+  workbatch b = {
+    .fxn = fxn,
+    .curry = curry,
+    .jobs = jobs,
+    .helpers = threads ? threads - 1 : 0,
+  };
+  if(b.helpers == 0){
+    for(unsigned j = 0 ; j < jobs ; ++j){
+      fxn(curry, j);
+    }
+    return;
+  }
+  pthread_mutex_lock(&wlock);
+  if(wrefs == 0){
+    pthread_mutex_unlock(&wlock);
+    run_transient(&b, b.helpers);
+    return;
+  }
+  while(wpopulation < b.helpers){
+    const uintptr_t gen = wgeneration;
+    if(pthread_create(&wtids[wpopulation], NULL, ncworker, (void*)gen)){
+      // we can make do with however many we've got
+      logwarn("couldn't spin up worker %u/%u", wpopulation, b.helpers);
+      break;
+    }
+    ++wpopulation;
+  }
+  b.queued = true;
+  workbatch** pb = &wqueue;
+  while(*pb){
+    pb = &(*pb)->nextbatch;
+  }
+  *pb = &b;
+  pthread_cond_broadcast(&wcond);
+  drain_batch(&b);
+  dequeue_batch(&b);
+  while(b.active){
+    pthread_cond_wait(&wdonecond, &wlock);
+  }
+  pthread_mutex_unlock(&wlock);
+}
@@ -1,5 +1,6 @@
 #include "builddef.h"
 #ifdef USE_FFMPEG
+#include <stdatomic.h>
 #include <libavutil/error.h>
 #include <libavutil/frame.h>
 #include <libavutil/pixdesc.h>
@@ -27,6 +28,7 @@ typedef struct ncvisual_details {
   struct AVCodecContext* codecctx;     // video codec context
   struct AVCodecContext* subtcodecctx; // subtitle codec context
   struct AVFrame* frame;               // frame as read/loaded/converted
+  struct AVFrame* recvframe;           // frame being received from the decoder
   struct AVCodec* codec;
   struct AVCodec* subtcodec;
   struct AVPacket* packet;
@@ -36,6 +38,18 @@ typedef struct ncvisual_details {
   int stream_index;        // match against this following av_read_frame()
   int sub_stream_index;    // subtitle stream index, can be < 0 if no subtitles
   bool packet_outstanding;
+  bool draining;           // demuxer hit EOF; collecting the decoder's last frames
+  // once a stream has looped, the frames we blit are tagged by their index,
+  // so that the image cache can keep their encodings. subsequent loops
+  // replay such frames without decoding them (see ffmpeg_stream()), leaving
+  // the decoder behind our position in the stream.
+  uint32_t loopserial;     // distinguishes our tags, nonzero once we've looped
+  unsigned framecount;     // index of the current frame, plus one
+  unsigned decoded;        // frames decoded since opening or rewinding
+  unsigned loopframes;     // frames in a loop, once known
+  uint64_t* durations;     // display durations of the frames of a loop
+  unsigned durationsknown; // leading frames whose durations we've recorded
+  unsigned missedloops;    // consecutive loops which couldn't be replayed
 } ncvisual_details;
 
 #define IMGALLOCALIGN 64
@@ -298,6 +312,20 @@ force_rgba(ncvisual* n){
   return 0;
 }
 
+// avcodec_receive_frame() unrefs the frame it's given even when it returns
+// EAGAIN or AVERROR_EOF, and the last frame must survive the end of the
+// stream (it might yet be blitted, or replayed as a loop of one frame).
+// receive into a scratch frame, and take it only once it's been filled.
+static int
+ffmpeg_receive_frame(ncvisual_details* deets){
+  int averr = avcodec_receive_frame(deets->codecctx, deets->recvframe);
+  if(averr >= 0){
+    av_frame_unref(deets->frame);
+    av_frame_move_ref(deets->frame, deets->recvframe);
+  }
+  return averr;
+}
+
 // turn arbitrary input packets into RGBA frames. reads packets until it gets
 // a visual frame. a packet might contain several frames (this is typically
 // true only of audio), and a frame might be carried across several packets.
@@ -306,7 +334,7 @@ force_rgba(ncvisual* n){
 //    be called to extract further frames; in this case, the packet ought
 //    be resubmitted once the existing frames are cleared.
 static int
-ffmpeg_decode(ncvisual* n){
+ffmpeg_decode_frame(ncvisual* n){
   if(n->details->fmtctx == NULL){ // not a file-backed ncvisual
     return -1;
   }
@@ -316,17 +344,21 @@ ffmpeg_decode(ncvisual* n){
   // we've either returned a failure, or we have a frame. averr2ncerr()
   // translates AVERROR_EOF into a return of 1.
   do{
-    if(!n->details->packet_outstanding){
+    if(!n->details->packet_outstanding && !n->details->draining){
       do{
         if(unref){
           av_packet_unref(n->details->packet);
         }
         int averr;
         if((averr = av_read_frame(n->details->fmtctx, n->details->packet)) < 0){
-          /*if(averr != AVERROR_EOF){
-            fprintf(stderr, "Error reading frame info (%s)\n", av_err2str(averr));
-          }*/
-          return averr2ncerr(averr);
+          if(averr != AVERROR_EOF){
+            //fprintf(stderr, "Error reading frame info (%s)\n", av_err2str(averr));
+            return averr2ncerr(averr);
+          }
+          // codecs with delay (e.g. B-frames) are still holding frames. a
+          // NULL packet gets them out; the decoder then returns AVERROR_EOF.
+          n->details->draining = true;
+          break;
         }
         unref = true;
         if(n->details->packet->stream_index == n->details->sub_stream_index){
@@ -338,8 +370,13 @@ ffmpeg_decode(ncvisual* n){
           }
         }
       }while(n->details->packet->stream_index != n->details->stream_index);
-      n->details->packet_outstanding = true;
-      int averr = avcodec_send_packet(n->details->codecctx, n->details->packet);
+      int averr;
+      if(n->details->draining){
+        averr = avcodec_send_packet(n->details->codecctx, NULL);
+      }else{
+        n->details->packet_outstanding = true;
+        averr = avcodec_send_packet(n->details->codecctx, n->details->packet);
+      }
       if(averr < 0){
         n->details->packet_outstanding = false;
         av_packet_unref(n->details->packet);
@@ -347,7 +384,7 @@ ffmpeg_decode(ncvisual* n){
         return averr2ncerr(averr);
       }
     }
-    int averr = avcodec_receive_frame(n->details->codecctx, n->details->frame);
+    int averr = ffmpeg_receive_frame(n->details);
     if(averr >= 0){
       have_frame = true;
     }else if(averr < 0){
@@ -368,9 +405,42 @@ ffmpeg_decode(ncvisual* n){
 //fprintf(stderr, "good decode! %d/%d %d %p\n", n->details->frame->height, n->details->frame->width, n->rowstride, f->data);
   ncvisual_set_data(n, f->data[0], false);
   force_rgba(n);
+  ++n->details->decoded;
+  return 0;
+}
+
+// if we've been replaying frames from the image cache, decode up through
+// the current frame, so that we have its pixels.
+static int
+ffmpeg_catchup(ncvisual* n){
+  ncvisual_details* deets = n->details;
+  while(deets->decoded < deets->framecount){
+    if(ffmpeg_decode_frame(n)){
+      return -1;
+    }
+  }
+  n->stale = false;
   return 0;
 }
 
+static int
+ffmpeg_decode(ncvisual* n){
+  ncvisual_details* deets = n->details;
+  if(deets->decoded != deets->framecount){
+    if(deets->framecount >= deets->loopframes){
+      return 1; // we replayed through to the end
+    }
+    if(ffmpeg_catchup(n)){
+      return -1;
+    }
+  }
+  int r = ffmpeg_decode_frame(n);
+  if(r == 0){
+    deets->framecount = deets->decoded;
+  }
+  return r;
+}
+
 static ncvisual_details*
 ffmpeg_details_init(void){
   ncvisual_details* deets = malloc(sizeof(*deets));
@@ -382,6 +452,11 @@ ffmpeg_details_init(void){
       free(deets);
       return NULL;
     }
+    if((deets->recvframe = av_frame_alloc()) == NULL){
+      av_frame_free(&deets->frame);
+      free(deets);
+      return NULL;
+    }
   }
   return deets;
 }
@@ -481,6 +556,22 @@ err:
   return NULL;
 }
 
+// advance to the next frame. while replaying a loop, we needn't decode the
+// frames the image cache holds; the blit will fail if it doesn't have one.
+static int
+ffmpeg_next(ncvisual* ncv, bool replay){
+  ncvisual_details* deets = ncv->details;
+  if(replay){
+    if(deets->framecount >= deets->loopframes){
+      return 1;
+    }
+    ++deets->framecount;
+    ncv->stale = true;
+    return 0;
+  }
+  return ffmpeg_decode(ncv);
+}
+
 // iterate over the decoded frames, calling streamer() with curry for each.
 // frames carry a presentation time relative to the beginning, so we get an
 // initial timestamp, and check each frame against the elapsed time to sync
@@ -499,6 +590,14 @@ ffmpeg_stream(notcurses* nc, ncvisual* ncv, float timescale,
   ncplane* newn = NULL;
   struct ncvisual_options activevopts;
   memcpy(&activevopts, vopts, sizeof(*vopts));
+  ncvisual_details* deets = ncv->details;
+  // replay requires the duration of every frame, and we don't track the
+  // subtitles we'd otherwise have decoded along the way.
+  const bool replayable = deets->loopserial && deets->loopframes &&
+                          deets->durationsknown == deets->loopframes &&
+                          deets->sub_stream_index < 0 && deets->missedloops < 2;
+  bool replay = false;
+  bool missed = false;
   int ncerr;
   do{
     // codecctx seems to be off by a factor of 2 regularly. instead, go with
@@ -518,7 +617,23 @@ ffmpeg_stream(notcurses* nc, ncvisual* ncv, float timescale,
     ncvgeom geom;
     ncvisual_geom(nc, ncv, &activevopts, &geom);
     activevopts.blitter = geom.blitter;
-    if((newn = ncvisual_blit(nc, ncv, &activevopts)) == NULL){
+    // once we've looped, tag frames so that their bitmaps are cached. we
+    // stop doing so if the cache can't hold the loop.
+    if(deets->loopserial && geom.blitter == NCBLIT_PIXEL && deets->missedloops < 2){
+      ncv->frametag = (uint64_t)deets->loopserial << 32u | deets->framecount;
+    }
+    newn = ncvisual_blit(nc, ncv, &activevopts);
+    if(newn == NULL && ncv->frametag && deets->decoded != deets->framecount && !ncv->stale){
+      // the cache no longer holds this frame, so we need its pixels after
+      // all. decode the remainder of this loop.
+      missed = true;
+      if(ffmpeg_catchup(ncv) == 0){
+        newn = ncvisual_blit(nc, ncv, &activevopts);
+      }
+    }
+    replay = replayable && !missed && ncv->frametag;
+    ncv->frametag = 0;
+    if(newn == NULL){
       if(activevopts.n != vopts->n){
         ncplane_destroy(activevopts.n);
       }
@@ -528,7 +643,16 @@ ffmpeg_stream(notcurses* nc, ncvisual* ncv, float timescale,
       activevopts.n = newn;
     }
     // display duration in units of time_base
-    const uint64_t pktduration = ffmpeg_pkt_duration(ncv->details->frame);
+    uint64_t pktduration;
+    if(deets->decoded != deets->framecount){
+      pktduration = deets->durations[deets->framecount - 1];
+    }else{
+      pktduration = ffmpeg_pkt_duration(deets->frame);
+      if(deets->durations && deets->framecount == deets->durationsknown + 1 &&
+         deets->durationsknown < deets->loopframes){
+        deets->durations[deets->durationsknown++] = pktduration;
+      }
+    }
     uint64_t duration = pktduration * tbase * NANOSECS_IN_SEC;
     double schedns = nsbegin;
     sum_duration += (duration * timescale);
@@ -547,11 +671,14 @@ ffmpeg_stream(notcurses* nc, ncvisual* ncv, float timescale,
       }
       return r;
     }
-  }while((ncerr = ffmpeg_decode(ncv)) == 0);
+  }while((ncerr = ffmpeg_next(ncv, replay)) == 0);
   if(activevopts.n != vopts->n){
     ncplane_destroy(activevopts.n);
   }
   if(ncerr == 1){ // 1 indicates reaching EOF
+    if(replayable){
+      deets->missedloops = missed ? deets->missedloops + 1 : 0;
+    }
     ncerr = 0;
   }
   return ncerr;
@@ -559,12 +686,36 @@ ffmpeg_stream(notcurses* nc, ncvisual* ncv, float timescale,
 
 static int
 ffmpeg_decode_loop(ncvisual* ncv){
+  ncvisual_details* deets = ncv->details;
   int r = ffmpeg_decode(ncv);
   if(r == 1){
-    if(av_seek_frame(ncv->details->fmtctx, ncv->details->stream_index, 0, AVSEEK_FLAG_FRAME) < 0){
+    if(deets->loopserial == 0){
+      // we now know how many frames make up the loop
+      deets->loopframes = deets->framecount;
+      if( (deets->durations = malloc(sizeof(*deets->durations) * deets->loopframes)) ){
+        static atomic_uint loopserials;
+        do{
+          deets->loopserial = atomic_fetch_add(&loopserials, 1) + 1;
+        }while(deets->loopserial == 0);
+      }
+    }
+    if(deets->decoded == 1){
+      // everything after the first frame was replayed from the cache, and
+      // the decoder still holds the first frame.
+      deets->framecount = 1;
+      ncv->stale = false;
+      return r;
+    }
+    if(av_seek_frame(deets->fmtctx, deets->stream_index, 0, AVSEEK_FLAG_FRAME) < 0){
       // FIXME log error
       return -1;
     }
+    // the decoder was drained at EOF, and mustn't hand us anything it held
+    // from before the seek.
+    avcodec_flush_buffers(deets->codecctx);
+    deets->draining = false;
+    deets->framecount = 0;
+    deets->decoded = 0;
     if(ffmpeg_decode(ncv) < 0){
       return -1;
     }
@@ -721,11 +872,13 @@ ffmpeg_details_destroy(ncvisual_details* deets){
   avcodec_free_context(&deets->subtcodecctx);
   avcodec_free_context(&deets->codecctx);
   av_frame_free(&deets->frame);
+  av_frame_free(&deets->recvframe);
   sws_freeContext(deets->rgbactx);
   sws_freeContext(deets->swsctx);
   av_packet_free(&deets->packet);
   avformat_close_input(&deets->fmtctx);
   avsubtitle_free(&deets->subtitle);
+  free(deets->durations);
   free(deets);
 }
 
@@ -100,8 +100,8 @@ auto perframe(struct ncvisual* ncv, struct ncvisual_options* vopts,
     uint32_t keyp;
     ncinput ni;
     if(absnow > nsnow){
-      ns_to_timespec(absnow - nsnow, &interval);
-      keyp = nc.get(&interval, &ni);
+      // the deadline is absolute, not an interval
+      keyp = nc.get(abstime, &ni);
     }else{
       keyp = nc.get(false, &ni);
     }
@@ -0,0 +1,84 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <notcurses/notcurses.h>
+
+// benchmark ncvisual_from_sixel(). synthesizes a sixel resembling our own
+// output (a palette of 256 colors, each band drawn as a series of RLE-heavy
+// color passes), then decodes it repeatedly.
+// usage: sixeldecode [ height [ width [ iterations ] ] ]
+
+static char*
+synthesize(unsigned leny, unsigned lenx, size_t* len){
+  const unsigned bands = (leny + 5) / 6;
+  const unsigned passes = 16; // color passes per band
+  // each pass writes at most "!NNNN" plus a sixel per pixel, and a "$"
+  size_t avail = 64 + 256 * 20 + (size_t)bands * passes * (lenx * 6 + 8);
+  char* s = malloc(avail);
+  if(s == NULL){
+    return NULL;
+  }
+  size_t used = sprintf(s, "\x1bP0;1;0q\"1;1;%u;%u", lenx, leny);
+  for(unsigned c = 0 ; c < 256 ; ++c){
+    used += sprintf(s + used, "#%u;2;%u;%u;%u", c, rand() % 101, rand() % 101, rand() % 101);
+  }
+  for(unsigned b = 0 ; b < bands ; ++b){
+    for(unsigned p = 0 ; p < passes ; ++p){
+      used += sprintf(s + used, "#%u", rand() % 256);
+      unsigned x = 0;
+      while(x < lenx){
+        unsigned run = rand() % 8 ? 1 : rand() % 32 + 1;
+        if(run > lenx - x){
+          run = lenx - x;
+        }
+        if(run > 3){
+          used += sprintf(s + used, "!%u", run);
+        }else{
+          run = 1;
+        }
+        s[used++] = '?' + rand() % 64;
+        x += run;
+      }
+      s[used++] = p + 1 < passes ? '$' : '-';
+    }
+  }
+  used += sprintf(s + used, "\x1b\\");
+  *len = used;
+  return s;
+}
+
+int main(int argc, char** argv){
+  unsigned leny = argc > 1 ? strtoul(argv[1], NULL, 10) : 1080;
+  unsigned lenx = argc > 2 ? strtoul(argv[2], NULL, 10) : 1920;
+  unsigned iterations = argc > 3 ? strtoul(argv[3], NULL, 10) : 50;
+  if(!leny || !lenx || !iterations){
+    fprintf(stderr, "usage: %s [ height [ width [ iterations ] ] ]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t len;
+  char* s = synthesize(leny, lenx, &len);
+  if(s == NULL){
+    return EXIT_FAILURE;
+  }
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(unsigned i = 0 ; i < iterations ; ++i){
+    struct ncvisual* ncv = ncvisual_from_sixel(s, leny, lenx);
+    if(ncv == NULL){
+      fprintf(stderr, "couldn't decode sixel\n");
+      free(s);
+      return EXIT_FAILURE;
+    }
+    ncvisual_destroy(ncv);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%ux%u, %zu bytes of sixel, %u iterations in %.3fs\n",
+         lenx, leny, len, iterations, secs);
+  printf("%.2f ms/frame, %.1f MB/s of sixel, %.1f Mpx/s\n",
+         secs * 1000 / iterations, len * (double)iterations / secs / 1e6,
+         (double)leny * lenx * iterations / secs / 1e6);
+  free(s);
+  return EXIT_SUCCESS;
+}
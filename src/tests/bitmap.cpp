@@ -509,6 +509,49 @@ TEST_CASE("Bitmaps") {
     CHECK(0 == notcurses_render(nc_));
   }
 
+  // wiping a cell deep within a static kitty bitmap and then restoring it
+  // ought leave the encoded bitmap as it was
+  SUBCASE("PixelCellWipeRestore") {
+    if(nc_->tcache.pixel_implementation == NCPIXEL_KITTY_STATIC){
+      auto y = 10 * nc_->tcache.cellpxy;
+      auto x = 10 * nc_->tcache.cellpxx;
+      std::vector<uint32_t> v(x * y, htole(0xffffffff));
+      for(auto& e : v){
+        e -= htole(rand() % 0x1000000);
+      }
+      auto ncv = ncvisual_from_rgba(v.data(), y, sizeof(decltype(v)::value_type) * x, x);
+      REQUIRE(nullptr != ncv);
+      struct ncvisual_options vopts{};
+      vopts.n = n_;
+      vopts.blitter = NCBLIT_PIXEL;
+      vopts.flags = NCVISUAL_OPTION_NODEGRADE | NCVISUAL_OPTION_CHILDPLANE;
+      auto n = ncvisual_blit(nc_, ncv, &vopts);
+      REQUIRE(nullptr != n);
+      auto s = n->sprite;
+      REQUIRE(nullptr != s);
+      CHECK(0 == notcurses_render(nc_));
+      std::string orig(s->glyph.buf + s->parse_start, s->glyph.used - s->parse_start);
+      struct ncplane_options nopts{};
+      nopts.y = 7;
+      nopts.x = 9;
+      nopts.rows = 1;
+      nopts.cols = 1;
+      auto top = ncplane_create(n_, &nopts);
+      REQUIRE(nullptr != top);
+      CHECK(1 == ncplane_putchar(top, 'x'));
+      CHECK(0 == notcurses_render(nc_));
+      CHECK(SPRIXCELL_ANNIHILATED == n->tam[7 * s->dimx + 9].state);
+      CHECK(orig != std::string(s->glyph.buf + s->parse_start, s->glyph.used - s->parse_start));
+      CHECK(0 == ncplane_destroy(top));
+      CHECK(0 == notcurses_render(nc_));
+      CHECK(SPRIXCELL_ANNIHILATED != n->tam[7 * s->dimx + 9].state);
+      CHECK(orig == std::string(s->glyph.buf + s->parse_start, s->glyph.used - s->parse_start));
+      CHECK(0 == ncplane_destroy(n));
+      ncvisual_destroy(ncv);
+      CHECK(0 == notcurses_render(nc_));
+    }
+  }
+
   // verify that the sprixel's TAM is properly initialized
   SUBCASE("PixelTAMSetup") {
     // first, assemble a visual equivalent to 54 cells
@@ -612,6 +655,84 @@ TEST_CASE("Bitmaps") {
   }
 #endif
 
+  // the first blit of an image is remembered, the second is cached, and the
+  // third ought be served from the cache. wiping one mustn't disturb the rest.
+  SUBCASE("BitmapCacheReuse") {
+    if(nullptr == nc_->tcache.imgcache){
+      return;
+    }
+    auto y = 2 * nc_->tcache.cellpxy;
+    auto x = 2 * nc_->tcache.cellpxx;
+    std::vector<uint32_t> v(x * y);
+    for(unsigned i = 0 ; i < v.size() ; ++i){
+      v[i] = htole(0xff000000 | (i * 2654435761u));
+    }
+    auto ncv = ncvisual_from_rgba(v.data(), y, sizeof(decltype(v)::value_type) * x, x);
+    REQUIRE(nullptr != ncv);
+    struct ncvisual_options vopts{};
+    vopts.n = n_;
+    vopts.blitter = NCBLIT_PIXEL;
+    vopts.flags = NCVISUAL_OPTION_NODEGRADE | NCVISUAL_OPTION_CHILDPLANE;
+    ncplane* ns[3];
+    for(int i = 0 ; i < 3 ; ++i){
+      vopts.x = i * 3;
+      ns[i] = ncvisual_blit(nc_, ncv, &vopts);
+      REQUIRE(nullptr != ns[i]);
+      REQUIRE(nullptr != ns[i]->sprite);
+      if(nc_->tcache.pixel_implementation >= NCPIXEL_KITTY_STATIC){
+        CHECK((i > 0) == (nullptr != ns[i]->sprite->cached));
+      }else if(i == 2){
+        CHECK(ns[1]->sprite->glyph.used == ns[2]->sprite->glyph.used);
+      }
+      CHECK(0 == notcurses_render(nc_));
+    }
+    ncplane_move_bottom(ns[2]);
+    CHECK(1 == ncplane_putchar_yx(n_, 0, 6, 'x'));
+    CHECK(0 == notcurses_render(nc_));
+    CHECK(nullptr == ns[2]->sprite->cached);
+    for(int i = 0 ; i < 3 ; ++i){
+      CHECK(0 == ncplane_destroy(ns[i]));
+    }
+    ncvisual_destroy(ncv);
+    CHECK(0 == notcurses_render(nc_));
+  }
+
+  // a frame tagged by a media engine is cached on its first blit, and can
+  // then be blitted without its pixels. an uncached frame can't.
+  SUBCASE("BitmapFrameReplay") {
+    if(nullptr == nc_->tcache.imgcache){
+      return;
+    }
+    auto y = 2 * nc_->tcache.cellpxy;
+    auto x = 2 * nc_->tcache.cellpxx;
+    std::vector<uint32_t> v(x * y, htole(0xff40c080));
+    auto ncv = ncvisual_from_rgba(v.data(), y, sizeof(decltype(v)::value_type) * x, x);
+    REQUIRE(nullptr != ncv);
+    struct ncvisual_options vopts{};
+    vopts.n = n_;
+    vopts.blitter = NCBLIT_PIXEL;
+    vopts.flags = NCVISUAL_OPTION_NODEGRADE | NCVISUAL_OPTION_CHILDPLANE;
+    ncv->frametag = 0x1234ull << 32u | 1;
+    auto n = ncvisual_blit(nc_, ncv, &vopts);
+    REQUIRE(nullptr != n);
+    CHECK(0 == notcurses_render(nc_));
+    vopts.n = n;
+    vopts.flags = NCVISUAL_OPTION_NODEGRADE;
+    // the pixels no longer match the frame, and mustn't be used
+    std::fill(v.begin(), v.end(), htole(0xff0000ff));
+    ncv->stale = true;
+    CHECK(n == ncvisual_blit(nc_, ncv, &vopts));
+    CHECK(ncv->stale);
+    CHECK(0 == notcurses_render(nc_));
+    ncv->frametag = 0x1234ull << 32u | 2;
+    CHECK(nullptr == ncvisual_blit(nc_, ncv, &vopts));
+    CHECK(!ncv->stale);
+    ncv->frametag = 0;
+    CHECK(0 == ncplane_destroy(n));
+    ncvisual_destroy(ncv);
+    CHECK(0 == notcurses_render(nc_));
+  }
+
   SUBCASE("BitmapMoveOffscreenLeft") {
     // first, assemble a visual equivalent to 2x2 cells
     auto y = nc_->tcache.cellpxy * 2;
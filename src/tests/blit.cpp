@@ -252,5 +252,224 @@ TEST_CASE("Blit") {
     }
   }
 
+  // put cells of two colors apiece through the sextant and octant blitters,
+  // read them back, and check equality. each cell ought be solved exactly.
+  SUBCASE("HiresRoundtrip") {
+    const struct {
+      ncblitter_e blitter;
+      bool usable;
+    } hires[] = {
+      { NCBLIT_3x2, notcurses_cansextant(nc_), },
+      { NCBLIT_4x2, notcurses_canoctant(nc_), },
+    };
+    for(const auto& h : hires){
+      if(!h.usable){
+        continue;
+      }
+      const int rows = h.blitter == NCBLIT_3x2 ? 3 : 4;
+      const int cols = 64;
+      std::vector<uint32_t> data(rows * cols);
+      uint32_t seed = 0x2545f491;
+      for(int cell = 0 ; cell < cols / 2 ; ++cell){
+        uint32_t colors[2];
+        for(auto& c : colors){
+          seed = seed * 1103515245 + 12345;
+          c = htole(0xff000000u | (seed >> 8));
+        }
+        seed = seed * 1103515245 + 12345;
+        for(int px = 0 ; px < rows * 2 ; ++px){
+          data[(px / 2) * cols + cell * 2 + px % 2] = colors[(seed >> (px + 8)) & 1];
+        }
+      }
+      auto ncv = ncvisual_from_rgba(data.data(), rows, cols * 4, cols);
+      REQUIRE(nullptr != ncv);
+      struct ncvisual_options vopts{};
+      vopts.blitter = h.blitter;
+      vopts.n = n_;
+      vopts.flags = NCVISUAL_OPTION_CHILDPLANE;
+      auto p = ncvisual_blit(nc_, ncv, &vopts);
+      REQUIRE(nullptr != p);
+      CHECK(1 == ncplane_dim_y(p));
+      CHECK(cols / 2 == ncplane_dim_x(p));
+      unsigned pxdimy, pxdimx;
+      auto edata = ncplane_as_rgba(p, vopts.blitter, 0, 0, 0, 0, &pxdimy, &pxdimx);
+      REQUIRE(nullptr != edata);
+      for(size_t i = 0 ; i < data.size() ; ++i){
+        CHECK(edata[i] == data[i]);
+      }
+      free(edata);
+      CHECK(0 == ncplane_destroy(p));
+      ncvisual_destroy(ncv);
+    }
+  }
+
+  // cells of three or more colors can't be reproduced exactly. check the
+  // glyph and colors of each against those found by the scalar solver, which
+  // the vector solvers (if present) must match. the first cell of each is a
+  // tie between two partitions, which goes to the first in partition order.
+  SUBCASE("HiresSolver") {
+    const uint32_t k = htole(0xff000000u); // black
+    const uint32_t g = htole(0xff646464u); // 100 grey
+    const uint32_t w = htole(0xffc8c8c8u); // 200 grey
+    struct expect {
+      const char* egc;
+      uint32_t fg, bg;
+    };
+    const struct {
+      ncblitter_e blitter;
+      bool usable;
+      int rows;
+      std::vector<uint32_t> tie; // row-major
+      std::vector<expect> cells;
+    } hires[] = {
+      { NCBLIT_3x2, notcurses_cansextant(nc_), 3, { k, k, g, g, w, w, }, {
+          { "🬂", 0x000000, 0x969696, },
+          { "🬢", 0x13f630, 0x57da59, },
+          { "🬉", 0xa60131, 0xb5dba4, },
+          { "🬓", 0xc8ba37, 0x3da25e, },
+          { "🬢", 0x1f40f8, 0xbc7b74, },
+          { "🬦", 0x4fb911, 0x8493b1, },
+          { "🬗", 0xd45f8d, 0x92eda5, },
+          { "🬀", 0xebbf63, 0x7b597b, },
+          { "🬦", 0xb15027, 0x55a79f, },
+        }, },
+      { NCBLIT_4x2, notcurses_canoctant(nc_), 4, { k, k, k, g, g, w, w, w, }, {
+          { "𜴂", 0x000000, 0xa0a0a0, },
+          { "𜴜", 0x13f630, 0x57da59, },
+          { "𜷌", 0xb2f7ad, 0x5b775d, },
+          { "𜴸", 0x4a7449, 0xd06993, },
+          { "🯧", 0x4fb911, 0x6eadcf, },
+          { "𜺫", 0xe757cb, 0xdbcc55, },
+          { "𜶝", 0x5f6bbf, 0x54a460, },
+          { "𜶗", 0xa7c065, 0x373762, },
+          { "🮂", 0x6d26f1, 0xbbe64c, },
+          { "𜴿", 0xc8e4c0, 0x5e42a1, },
+          { "▝", 0xe436cb, 0x689322, },
+          { "𜵋", 0x6e4130, 0x96b584, },
+          { "𜶜", 0xe3d073, 0x4c7278, },
+        }, },
+    };
+    for(const auto& h : hires){
+      if(!h.usable){
+        continue;
+      }
+      // after the tie, two cells of each count of distinct colors from 3
+      const int pixels = h.rows * 2;
+      const int cells = 1 + (pixels - 2) * 2;
+      const int cols = cells * 2;
+      REQUIRE(cells == (int)h.cells.size());
+      std::vector<uint32_t> data(h.rows * cols);
+      for(int px = 0 ; px < pixels ; ++px){
+        data[(px / 2) * cols + px % 2] = h.tie[px];
+      }
+      uint32_t seed = 0x9e3779b9;
+      auto next = [&seed](){
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+      };
+      for(int cell = 1 ; cell < cells ; ++cell){
+        const int count = 3 + (cell - 1) / 2;
+        uint32_t colors[8];
+        for(int c = 0 ; c < count ; ++c){
+          colors[c] = htole(0xff000000u | next());
+        }
+        for(int px = 0 ; px < pixels ; ++px){
+          const uint32_t c = px < count ? colors[px] : colors[next() % count];
+          data[(px / 2) * cols + cell * 2 + px % 2] = c;
+        }
+      }
+      auto ncv = ncvisual_from_rgba(data.data(), h.rows, cols * 4, cols);
+      REQUIRE(nullptr != ncv);
+      struct ncvisual_options vopts{};
+      vopts.blitter = h.blitter;
+      vopts.n = n_;
+      vopts.flags = NCVISUAL_OPTION_CHILDPLANE;
+      auto p = ncvisual_blit(nc_, ncv, &vopts);
+      REQUIRE(nullptr != p);
+      CHECK(1 == ncplane_dim_y(p));
+      CHECK(cells == (int)ncplane_dim_x(p));
+      for(int x = 0 ; x < cells ; ++x){
+        uint16_t stylemask;
+        uint64_t channels;
+        auto egc = ncplane_at_yx(p, 0, x, &stylemask, &channels);
+        REQUIRE(nullptr != egc);
+        CHECK(0 == strcmp(h.cells[x].egc, egc));
+        CHECK(h.cells[x].fg == ncchannels_fg_rgb(channels));
+        CHECK(h.cells[x].bg == ncchannels_bg_rgb(channels));
+        free(egc);
+      }
+      CHECK(0 == ncplane_destroy(p));
+      ncvisual_destroy(ncv);
+    }
+  }
+
+  // blit a large visual, which might be split among threads, and check it
+  // against visuals made from a few cell rows of it at a time.
+  SUBCASE("BandedBlit") {
+    const struct {
+      ncblitter_e blitter;
+      bool usable;
+      int cellheight;
+    } blits[] = {
+      { NCBLIT_2x2, notcurses_canquadrant(nc_), 2, },
+      { NCBLIT_3x2, notcurses_cansextant(nc_), 3, },
+      { NCBLIT_4x2, notcurses_canoctant(nc_), 4, },
+      { NCBLIT_BRAILLE, notcurses_canbraille(nc_), 4, },
+    };
+    const int rows = 192;
+    const int cols = 256;
+    std::vector<uint32_t> data(rows * cols);
+    uint32_t seed = 0x9e3779b9;
+    for(auto& px : data){
+      seed = seed * 1103515245 + 12345;
+      px = htole((seed & 0x1f000000) ? 0xff000000u | (seed >> 8) : 0);
+    }
+    auto ncv = ncvisual_from_rgba(data.data(), rows, cols * 4, cols);
+    REQUIRE(nullptr != ncv);
+    for(const auto& b : blits){
+      if(!b.usable){
+        continue;
+      }
+      struct ncvisual_options vopts{};
+      vopts.blitter = b.blitter;
+      vopts.n = n_;
+      vopts.flags = NCVISUAL_OPTION_CHILDPLANE;
+      auto whole = ncvisual_blit(nc_, ncv, &vopts);
+      REQUIRE(nullptr != whole);
+      unsigned dimy, dimx;
+      ncplane_dim_yx(whole, &dimy, &dimx);
+      CHECK(rows / b.cellheight == (int)dimy);
+      for(unsigned y = 0 ; y < dimy ; y += 4){
+        const int begy = y * b.cellheight;
+        const int sliceh = rows - begy < 4 * b.cellheight ? rows - begy : 4 * b.cellheight;
+        auto sv = ncvisual_from_rgba(data.data() + begy * cols, sliceh, cols * 4, cols);
+        REQUIRE(nullptr != sv);
+        auto slice = ncvisual_blit(nc_, sv, &vopts);
+        ncvisual_destroy(sv);
+        REQUIRE(nullptr != slice);
+        unsigned sdimy, sdimx;
+        ncplane_dim_yx(slice, &sdimy, &sdimx);
+        CHECK(dimx == sdimx);
+        for(unsigned sy = 0 ; sy < sdimy ; ++sy){
+          for(unsigned x = 0 ; x < sdimx ; ++x){
+            uint16_t wstyle, sstyle;
+            uint64_t wchannels, schannels;
+            char* wegc = ncplane_at_yx(whole, y + sy, x, &wstyle, &wchannels);
+            char* segc = ncplane_at_yx(slice, sy, x, &sstyle, &schannels);
+            REQUIRE(nullptr != wegc);
+            REQUIRE(nullptr != segc);
+            CHECK(0 == strcmp(wegc, segc));
+            CHECK(wchannels == schannels);
+            free(wegc);
+            free(segc);
+          }
+        }
+        CHECK(0 == ncplane_destroy(slice));
+      }
+      CHECK(0 == ncplane_destroy(whole));
+    }
+    ncvisual_destroy(ncv);
+  }
+
   CHECK(!notcurses_stop(nc_));
 }
@@ -2,6 +2,7 @@
 #include "main.h"
 #include "lib/egcpool.h"
 #include "lib/egcpool.c"
+#include "lib/unicode.c"
 
 TEST_CASE("EGCpool") {
   egcpool pool_{};
@@ -212,6 +213,263 @@ TEST_CASE("EGCpool") {
 
 }
 
+TEST_CASE("EGCpoolInterned") {
+  egcpool pool_{};
+  egcpool_set_interning(&pool_);
+
+  SUBCASE("AddTwiceShares") {
+    const char* wstr = "\U0001F408\u200D\u2B1B"; // black cat (zwj sequence)
+    size_t ulen = strlen(wstr);
+    int o1 = egcpool_stash(&pool_, wstr, ulen);
+    int o2 = egcpool_stash(&pool_, wstr, ulen);
+    REQUIRE(0 <= o1);
+    CHECK(o1 == o2);
+    CHECK(ulen + 1 == pool_.poolused);
+    CHECK(1 == pool_.slotsused);
+    egcpool_release(&pool_, o1);
+    CHECK(!strcmp(pool_.pool + o2, wstr)); // still referenced
+    CHECK(ulen + 1 == pool_.poolused);
+    egcpool_release(&pool_, o2);
+    CHECK('\0' == pool_.pool[o2]);
+    CHECK(0 == pool_.poolused);
+    CHECK(0 == pool_.slotsused);
+  }
+
+  SUBCASE("DistinctClusters") {
+    const char* w1 = "\U0001F44D\U0001F3FD"; // thumbs up, medium skin tone
+    const char* w2 = "\U0001F44D\U0001F3FE"; // thumbs up, medium-dark
+    int o1 = egcpool_stash(&pool_, w1, strlen(w1));
+    int o2 = egcpool_stash(&pool_, w2, strlen(w2));
+    REQUIRE(0 <= o1);
+    REQUIRE(0 <= o2);
+    CHECK(o1 != o2);
+    CHECK(!strcmp(pool_.pool + o1, w1));
+    CHECK(!strcmp(pool_.pool + o2, w2));
+    CHECK(2 == pool_.slotsused);
+    // a stash of the second must find it even after removal of the first
+    egcpool_release(&pool_, o1);
+    CHECK(o2 == egcpool_stash(&pool_, w2, strlen(w2)));
+    egcpool_release(&pool_, o2);
+    egcpool_release(&pool_, o2);
+    CHECK(0 == pool_.poolused);
+    CHECK(0 == pool_.slotsused);
+  }
+
+  // stash many distinct clusters, each many times, forcing growth of both
+  // the pool and the index, and verify they all survive and are shared.
+  SUBCASE("ForceIndexGrowth") {
+    std::vector<int> offsets;
+    for(auto i = 0u ; i < 0x1000u ; ++i){
+      char mb[MB_LEN_MAX + 1];
+      wchar_t wcs = i + 0x4e00;
+      auto r = wctomb(mb, wcs);
+      REQUIRE(0 < r);
+      mb[r] = '\0';
+      int o = egcpool_stash(&pool_, mb, r);
+      REQUIRE(0 <= o);
+      CHECK(o == egcpool_stash(&pool_, mb, r));
+      offsets.push_back(o);
+    }
+    CHECK(0x1000u == pool_.slotsused);
+    for(auto i = 0u ; i < offsets.size() ; ++i){
+      char mb[MB_LEN_MAX + 1];
+      wchar_t wcs = i + 0x4e00;
+      auto r = wctomb(mb, wcs);
+      mb[r] = '\0';
+      CHECK(!strcmp(mb, pool_.pool + offsets[i]));
+      CHECK(offsets[i] == egcpool_stash(&pool_, mb, r));
+      egcpool_release(&pool_, offsets[i]);
+      egcpool_release(&pool_, offsets[i]);
+      egcpool_release(&pool_, offsets[i]);
+    }
+    CHECK(0 == pool_.poolused);
+    CHECK(0 == pool_.slotsused);
+  }
+
+  SUBCASE("DumpKeepsInterning") {
+    const char* wstr = "\U0001F408\u200D\u2B1B";
+    REQUIRE(0 <= egcpool_stash(&pool_, wstr, strlen(wstr)));
+    egcpool_dump(&pool_);
+    CHECK(pool_.interning);
+    CHECK(0 == pool_.slotsused);
+    int o1 = egcpool_stash(&pool_, wstr, strlen(wstr));
+    CHECK(o1 == egcpool_stash(&pool_, wstr, strlen(wstr)));
+  }
+
+  SUBCASE("PlaneCellsShare") {
+    auto nc_ = testing_notcurses();
+    REQUIRE(nullptr != nc_);
+    if(notcurses_canutf8(nc_)){
+      struct ncplane_options nopts{};
+      nopts.rows = 2;
+      nopts.cols = 20;
+      nopts.flags = NCPLANE_OPTION_INTERN;
+      auto n = ncplane_create(notcurses_stdplane(nc_), &nopts);
+      REQUIRE(nullptr != n);
+      const char* wstr = "\U0001F408\u200D\u2B1B";
+      for(int x = 0 ; x < 10 ; ++x){
+        CHECK(0 < ncplane_putegc_yx(n, 0, x * 2, wstr, nullptr));
+      }
+      CHECK(strlen(wstr) + 1 == (size_t)n->pool.poolused);
+      auto dup = ncplane_dup(n, nullptr);
+      REQUIRE(nullptr != dup);
+      CHECK(dup->pool.interning);
+      ncplane_erase(n);
+      CHECK(0 == n->pool.poolused);
+      CHECK(n->pool.interning);
+      char* egc = ncplane_at_yx(dup, 0, 18, nullptr, nullptr);
+      REQUIRE(nullptr != egc);
+      CHECK(!strcmp(egc, wstr));
+      free(egc);
+      CHECK(0 == ncplane_destroy(dup));
+      CHECK(0 == ncplane_destroy(n));
+    }
+    CHECK(0 == notcurses_stop(nc_));
+  }
+
+  egcpool_dump(&pool_);
+}
+
+TEST_CASE("EGCpoolCompact") {
+  egcpool pool_{};
+
+  // fill a pool well past its minimum, release most of it, and compact
+  SUBCASE("CompactShrinks") {
+    std::vector<nccell> cells(2048);
+    char egc[16];
+    for(size_t i = 0 ; i < cells.size() ; ++i){
+      cells[i] = NCCELL_TRIVIAL_INITIALIZER;
+      snprintf(egc, sizeof(egc), "%04zu\u0301", i); // keep each cluster distinct
+      int o = egcpool_stash(&pool_, egc, strlen(egc));
+      REQUIRE(0 <= o);
+      set_gcluster_egc(&cells[i], o);
+    }
+    CHECK(POOL_MINIMUM_ALLOC < pool_.poolsize);
+    for(size_t i = 8 ; i < cells.size() ; ++i){
+      egcpool_release(&pool_, cell_egc_idx(&cells[i]));
+      cells[i] = NCCELL_TRIVIAL_INITIALIZER;
+    }
+    CHECK(egcpool_compact_wanted(&pool_));
+    REQUIRE(0 == egcpool_compact(&pool_, cells.data(), cells.size(), nullptr));
+    CHECK(POOL_MINIMUM_ALLOC == pool_.poolsize);
+    CHECK(8 * (strlen(egc) + 1) == (size_t)pool_.poolused);
+    for(size_t i = 0 ; i < 8 ; ++i){
+      snprintf(egc, sizeof(egc), "%04zu\u0301", i);
+      CHECK(!strcmp(egc, egcpool_extended_gcluster(&pool_, &cells[i])));
+    }
+  }
+
+  // an empty pool compacts to nothing at all
+  SUBCASE("CompactEmpty") {
+    nccell c = NCCELL_TRIVIAL_INITIALIZER;
+    int o = egcpool_stash(&pool_, "\u00e9\u0301", strlen("\u00e9\u0301"));
+    REQUIRE(0 <= o);
+    egcpool_release(&pool_, o);
+    REQUIRE(0 == egcpool_compact(&pool_, &c, 1, nullptr));
+    CHECK(!pool_.pool);
+    CHECK(!pool_.poolsize);
+  }
+
+  SUBCASE("PlaneCompact") {
+    auto nc_ = testing_notcurses();
+    if(nc_){
+      struct ncplane_options nopts{};
+      nopts.rows = 40;
+      nopts.cols = 40;
+      auto n = ncplane_create(notcurses_stdplane(nc_), &nopts);
+      REQUIRE(nullptr != n);
+      const char* wstr = "\U0001F408\u200D\u2B1B";
+      CHECK(0 < ncplane_set_base(n, wstr, 0, 0));
+      for(int y = 0 ; y < 40 ; ++y){
+        for(int x = 0 ; x < 20 ; ++x){
+          CHECK(0 < ncplane_putegc_yx(n, y, x * 2, wstr, nullptr));
+        }
+      }
+      auto grown = n->pool.poolsize;
+      CHECK(0 == ncplane_erase_region(n, 1, 0, INT_MAX, 0));
+      CHECK(0 == ncplane_compact(n));
+      CHECK(grown > n->pool.poolsize);
+      CHECK(21 * (strlen(wstr) + 1) == (size_t)n->pool.poolused);
+      char* egc = ncplane_at_yx(n, 0, 38, nullptr, nullptr);
+      REQUIRE(nullptr != egc);
+      CHECK(!strcmp(egc, wstr));
+      free(egc);
+      nccell base = NCCELL_TRIVIAL_INITIALIZER;
+      CHECK(0 <= ncplane_base(n, &base));
+      CHECK(!strcmp(nccell_extended_gcluster(n, &base), wstr));
+      nccell_release(n, &base);
+      CHECK(0 == ncplane_destroy(n));
+    }
+    CHECK(0 == notcurses_stop(nc_));
+  }
+
+  egcpool_dump(&pool_);
+}
+
+// segmentation follows UAX #29, with widths from our generated tables
+TEST_CASE("EGCSegmentation") {
+  int cols;
+
+  SUBCASE("SimpleClusters") {
+    CHECK(0 == utf8_egc_len("", &cols));
+    CHECK(0 == cols);
+    CHECK(1 == utf8_egc_len("ab", &cols));
+    CHECK(1 == cols);
+    CHECK(2 == utf8_egc_len("\u00b5x", &cols));
+    CHECK(1 == cols);
+    CHECK(3 == utf8_egc_len("\u5168\u5168", &cols));
+    CHECK(2 == cols);
+    CHECK(1 == utf8_egc_len("\t", &cols));
+    CHECK(1 == cols);
+    CHECK(-1 == utf8_egc_len("\x07", &cols));
+  }
+
+  SUBCASE("CombiningClusters") {
+    CHECK(3 == utf8_egc_len("e\u0301x", &cols));
+    CHECK(1 == cols);
+    CHECK(5 == utf8_egc_len("e\u0301\u0302", &cols));
+    CHECK(1 == cols);
+    // a ZWJ extends anything, but only joins pictographs
+    CHECK(4 == utf8_egc_len("a\u200db", &cols));
+    CHECK(1 == cols);
+  }
+
+  SUBCASE("HangulJamo") {
+    CHECK(9 == utf8_egc_len("\u1100\u1161\u11a8\u1100", &cols));
+    CHECK(2 == cols);
+    CHECK(3 == utf8_egc_len("\u11a8\u1100", &cols));
+  }
+
+  SUBCASE("EmojiSequences") {
+    // woman, ZWJ, woman, ZWJ, girl
+    CHECK(18 == utf8_egc_len("\U0001F469\u200D\U0001F469\u200D\U0001F467x", &cols));
+    CHECK(2 == cols);
+    // white flag, VS16, ZWJ, rainbow
+    CHECK(14 == utf8_egc_len("\U0001F3F3\uFE0F\u200D\U0001F308x", &cols));
+    CHECK(1 <= cols);
+    // heart, VS16
+    CHECK(6 == utf8_egc_len("\u2764\uFE0Fa", &cols));
+    // thumbs up, skin tone modifier
+    CHECK(8 == utf8_egc_len("\U0001F44D\U0001F3FD\U0001F44D", &cols));
+    CHECK(2 == cols);
+  }
+
+  SUBCASE("RegionalIndicators") {
+    const char* flags = "\U0001F1FA\U0001F1F8\U0001F1EC\U0001F1E7\U0001F1EB";
+    CHECK(8 == utf8_egc_len(flags, &cols));
+    CHECK(8 == utf8_egc_len(flags + 8, &cols));
+    CHECK(4 == utf8_egc_len(flags + 16, &cols));
+  }
+
+  SUBCASE("InvalidUTF8") {
+    CHECK(-1 == utf8_egc_len("\xc3", &cols));        // truncated
+    CHECK(-1 == utf8_egc_len("\xc0\xaf", &cols));    // overlong
+    CHECK(-1 == utf8_egc_len("\xed\xa0\x80", &cols)); // surrogate
+    CHECK(-1 == utf8_egc_len("\xf4\x90\x80\x80", &cols)); // > U+10FFFF
+    CHECK(-1 == utf8_egc_len("\xff", &cols));
+  }
+}
+
 TEST_CASE("EGCpoolLong" * doctest::skip(true)) {
   egcpool pool_{};
 
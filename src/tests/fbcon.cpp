@@ -0,0 +1,126 @@
+#include "main.h"
+#include <vector>
+#ifdef __linux__
+#include <linux/fb.h>
+#include <sys/ioctl.h>
+
+// these only run on a Linux framebuffer console (vfb will do), and exercise
+// page flipping when NOTCURSES_FBCON_FLIP is set.
+
+// the page being displayed, according to the device
+static unsigned
+shown_page(const tinfo* ti){
+  struct fb_var_screeninfo fbi{};
+  if(ioctl(ti->linux_fb_fd, FBIOGET_VSCREENINFO, &fbi) || fbi.yres == 0){
+    return ~0u;
+  }
+  return fbi.yoffset / fbi.yres;
+}
+
+static const uint8_t*
+page_row(const tinfo* ti, unsigned page, int py){
+  return ti->linux_fbuffer + page * ti->linux_fb_pagelen + py * ti->linux_fb_stride;
+}
+
+// does the displayed pixel at |py|/|px| match |r|/|g|/|b|, to the precision
+// of the framebuffer?
+static bool
+shown_pixel_p(const tinfo* ti, int py, int px, unsigned r, unsigned g, unsigned b){
+  const unsigned page = shown_page(ti);
+  if(page >= ti->linux_fb_pages){
+    return false;
+  }
+  const uint8_t* p = page_row(ti, page, py) + px * ti->linux_fb_bpp;
+  uint32_t v = 0;
+  for(unsigned i = 0 ; i < ti->linux_fb_bpp ; ++i){
+    v |= static_cast<uint32_t>(p[i]) << (8 * i);
+  }
+  const unsigned want[3] = { r, g, b };
+  for(int c = 0 ; c < 3 ; ++c){
+    const unsigned bits = ti->linux_fb_bits[c];
+    const unsigned got = (v >> ti->linux_fb_shifts[c]) & ((1u << bits) - 1);
+    if(got != want[c] >> (8 - bits)){
+      return false;
+    }
+  }
+  return true;
+}
+
+static ncplane*
+solid_bitmap(notcurses* nc, ncplane* n, int y, int x, uint32_t rgba, unsigned flags){
+  const auto& ti = nc->tcache;
+  const int leny = static_cast<int>(ti.cellpxy) * 2;
+  const int lenx = static_cast<int>(ti.cellpxx) * 2;
+  std::vector<uint32_t> v(leny * lenx, htole(rgba));
+  auto ncv = ncvisual_from_rgba(v.data(), leny, sizeof(decltype(v)::value_type) * lenx, lenx);
+  if(ncv == nullptr){
+    return nullptr;
+  }
+  struct ncvisual_options vopts{};
+  vopts.n = n;
+  vopts.y = y;
+  vopts.x = x;
+  vopts.blitter = NCBLIT_PIXEL;
+  vopts.flags = NCVISUAL_OPTION_NODEGRADE | flags;
+  auto ret = ncvisual_blit(nc, ncv, &vopts);
+  ncvisual_destroy(ncv);
+  return ret;
+}
+
+TEST_CASE("Fbcon") {
+  auto nc_ = testing_notcurses();
+  REQUIRE(nullptr != nc_);
+  auto n_ = notcurses_stdplane(nc_);
+  REQUIRE(n_);
+  if(notcurses_check_pixel_support(nc_) != NCPIXEL_LINUXFB){
+    CHECK(!notcurses_stop(nc_));
+    return;
+  }
+  const tinfo* ti = &nc_->tcache;
+  const bool flipping = ti->linux_fb_pages > 1;
+  // the center of a bitmap placed at cell 1/1
+  const int cy = static_cast<int>(ti->cellpxy) * 2;
+  const int cx = static_cast<int>(ti->cellpxx) * 2;
+
+  // each frame is composed in a different page; both must show the bitmap
+  SUBCASE("FbconBitmapShown") {
+    auto n = solid_bitmap(nc_, n_, 1, 1, 0xe61c28ff, NCVISUAL_OPTION_CHILDPLANE);
+    REQUIRE(nullptr != n);
+    for(int i = 0 ; i < 3 ; ++i){
+      CHECK(0 == notcurses_render(nc_));
+      if(flipping){
+        CHECK(0 != shown_page(ti));
+      }
+      CHECK(shown_pixel_p(ti, cy, cx, 0xe6, 0x1c, 0x28));
+    }
+    CHECK(n == solid_bitmap(nc_, n, 0, 0, 0x28e61cff, 0));
+    for(int i = 0 ; i < 3 ; ++i){
+      CHECK(0 == notcurses_render(nc_));
+      CHECK(shown_pixel_p(ti, cy, cx, 0x28, 0xe6, 0x1c));
+    }
+    CHECK(0 == ncplane_destroy(n));
+    CHECK(0 == notcurses_render(nc_));
+    CHECK(0 == shown_page(ti));
+  }
+
+  // text written alongside a bitmap must reach the page being displayed
+  SUBCASE("FbconTextShown") {
+    auto n = solid_bitmap(nc_, n_, 1, 1, 0xe61c28ff, NCVISUAL_OPTION_CHILDPLANE);
+    REQUIRE(nullptr != n);
+    CHECK(0 == notcurses_render(nc_));
+    for(const char* s : { "flip", "flop", "flap" }){
+      CHECK(0 < ncplane_putstr_yx(n_, 0, 0, s));
+      CHECK(0 == notcurses_render(nc_));
+      const unsigned page = shown_page(ti);
+      REQUIRE(page < ti->linux_fb_pages);
+      for(int py = 0 ; py < cy / 2 ; ++py){
+        CHECK(0 == memcmp(page_row(ti, page, py), page_row(ti, 0, py), ti->linux_fb_stride));
+      }
+      CHECK(shown_pixel_p(ti, cy, cx, 0xe6, 0x1c, 0x28));
+    }
+    CHECK(0 == ncplane_destroy(n));
+  }
+
+  CHECK(!notcurses_stop(nc_));
+}
+#endif
@@ -1,3 +1,5 @@
+#include <string>
+#include <vector>
 #include "main.h"
 #include "lib/fbuf.h"
 
@@ -80,5 +82,75 @@ TEST_CASE("Fbuf") {
     fbuf_free(&f);
   }
 
+  // a spike is given back only once usage stays low, and contents persist
+  SUBCASE("FbufTrim") {
+    fbuf f{};
+    CHECK(0 == fbuf_init_small(&f));
+    const size_t floor = f.size;
+    std::vector<char> big(floor * 64, 'X');
+    CHECK(static_cast<int>(big.size()) == fbuf_putn(&f, big.data(), big.size()));
+    CHECK(0 == fbuf_trim(&f, floor));
+    const size_t spiked = f.size;
+    CHECK(big.size() <= spiked);
+    fbuf_reset(&f);
+    CHECK(3 == fbuf_puts(&f, "abc"));
+    CHECK(0 == fbuf_trim(&f, floor)); // the first low frame keeps our memory
+    CHECK(spiked == f.size);
+    int trims = 0;
+    while(f.size > floor){
+      REQUIRE(trims < 1000);
+      CHECK(0 <= fbuf_trim(&f, floor));
+      ++trims;
+    }
+    CHECK(10 < trims);
+    CHECK(floor == f.size);
+    CHECK(3 == f.used);
+    CHECK(0 == memcmp(f.buf, "abc", 3));
+    CHECK(0 == fbuf_trim(&f, floor)); // never below the floor
+    // we can still grow afterwards
+    CHECK(static_cast<int>(big.size()) == fbuf_putn(&f, big.data(), big.size()));
+    CHECK(0 == memcmp(f.buf, "abc", 3));
+    fbuf_free(&f);
+  }
+
+#ifndef __MINGW32__
+  // large external buffers are referenced when splicing, and written in place
+  SUBCASE("FbufSplice") {
+    fbuf f{};
+    CHECK(0 == fbuf_init(&f));
+    fbuf_set_splicing(&f, true);
+    std::vector<char> ext(FBUF_SPLICE_MIN * 2, 'X');
+    CHECK(3 == fbuf_puts(&f, "abc"));
+    CHECK(static_cast<int>(ext.size()) == fbuf_splice(&f, ext.data(), ext.size()));
+    CHECK(3 == fbuf_puts(&f, "def"));
+    CHECK(2 == fbuf_splice(&f, "gh", 2)); // too small; copied
+    CHECK(static_cast<int>(ext.size()) == fbuf_splice(&f, ext.data(), ext.size()));
+    CHECK(8 == f.used);
+    CHECK(2 == f.splicecount);
+    CHECK(8 + 2 * ext.size() == fbuf_total(&f));
+    int fds[2];
+    REQUIRE(0 == pipe(fds));
+    CHECK(0 == fbuf_write(fds[1], &f, 1));
+    close(fds[1]);
+    std::string expected = "bc" + std::string(ext.data(), ext.size()) + "defgh" +
+                           std::string(ext.data(), ext.size());
+    std::string got;
+    char buf[BUFSIZ];
+    ssize_t r;
+    while((r = read(fds[0], buf, sizeof(buf))) > 0){
+      got.append(buf, r);
+    }
+    close(fds[0]);
+    CHECK(expected == got);
+    // chopping drops any splices beyond the chop point
+    fbuf_chop(&f, 5);
+    CHECK(1 == f.splicecount);
+    CHECK(5 + ext.size() == fbuf_total(&f));
+    fbuf_reset(&f);
+    CHECK(0 == fbuf_total(&f));
+    fbuf_free(&f);
+  }
+#endif
+
   CHECK(0 == notcurses_stop(nc_));
 }
@@ -1,7 +1,10 @@
 #include "main.h"
 #include "lib/visual-details.h"
+#include <deque>
+#include <string>
 #include <vector>
 #include <cmath>
+#include <cstdlib>
 
 // only run through this many frames of video
 constexpr auto FRAMECOUNT = 100;
@@ -411,3 +414,215 @@ TEST_CASE("Media") {
 
   CHECK(!notcurses_stop(nc_));
 }
+
+// what a looping ncvisual_stream() showed us
+struct loopstate {
+  std::vector<uint64_t> digests; // pixels of each frame, from the first loop
+  std::vector<int64_t> offsets;  // schedule of each frame, from the first loop
+  unsigned frame;                // current frame within this loop
+  unsigned replayed;             // frames shown without being decoded
+  unsigned mismatched;           // decoded frames differing from the first loop
+  unsigned misscheduled;         // frames scheduled differently than the first loop
+  unsigned evictat;              // empty the image cache after this frame, if nonzero
+  ncplane* label;                // if non-NULL, drawn atop each frame
+  int64_t firstns;               // schedule of the first frame of this loop
+};
+
+static uint64_t
+frame_digest(const ncvisual* ncv){
+  uint64_t h = 0xcbf29ce484222325ull;
+  for(unsigned y = 0 ; y < ncv->pixy ; ++y){
+    auto row = reinterpret_cast<const unsigned char*>(ncv->data) + y * ncv->rowstride;
+    for(unsigned x = 0 ; x < ncv->pixx * 4 ; ++x){
+      h = (h ^ row[x]) * 0x100000001b3ull;
+    }
+  }
+  return h;
+}
+
+// blit distinct frames until the image cache has forced out everything
+// older. a tagged frame lacking pixels can only be blitted from the cache, so
+// we can ask whether one is still held. asking renews it, so always ask of
+// the least recently used, which will be the first of ours to go.
+static void
+flood_imgcache(notcurses* nc){
+  unsigned dimy, dimx;
+  ncplane_dim_yx(notcurses_stdplane(nc), &dimy, &dimx);
+  // bitmaps mustn't reach the last row, lest they scroll the screen
+  const int leny = (dimy - 1) * nc->tcache.cellpxy;
+  const int lenx = dimx * nc->tcache.cellpxx;
+  // noise, so that it's costly to keep with any pixel backend
+  std::vector<uint32_t> v(leny * lenx);
+  unsigned seed = 1;
+  for(auto& p : v){
+    p = htole(0xff000000u | (rand_r(&seed) % 16) * 0x111111u);
+  }
+  auto ncv = ncvisual_from_rgba(v.data(), leny, sizeof(decltype(v)::value_type) * lenx, lenx);
+  REQUIRE(nullptr != ncv);
+  struct ncvisual_options vopts{};
+  vopts.n = notcurses_stdplane(nc);
+  vopts.blitter = NCBLIT_PIXEL;
+  vopts.flags = NCVISUAL_OPTION_CHILDPLANE | NCVISUAL_OPTION_NODEGRADE;
+  std::deque<uint64_t> lru;
+  for(uint64_t tag = 0xffffffffull << 32u ; ; ++tag){
+    ncv->frametag = tag;
+    ncv->stale = false;
+    auto n = ncvisual_blit(nc, ncv, &vopts);
+    REQUIRE(nullptr != n);
+    CHECK(0 == notcurses_render(nc));
+    CHECK(0 == ncplane_destroy(n));
+    CHECK(0 == notcurses_render(nc));
+    lru.push_back(tag);
+    ncv->frametag = lru.front();
+    ncv->stale = true;
+    if((n = ncvisual_blit(nc, ncv, &vopts)) == nullptr){
+      break;
+    }
+    CHECK(0 == ncplane_destroy(n));
+    CHECK(0 == notcurses_render(nc));
+    lru.push_back(lru.front());
+    lru.pop_front();
+  }
+  CHECK(!ncv->stale);
+  ncv->frametag = 0;
+  ncvisual_destroy(ncv);
+}
+
+static int
+loop_streamer(ncvisual* ncv, ncvisual_options* vopts, const struct timespec* abstime, void* curry){
+  auto ls = static_cast<loopstate*>(curry);
+  const int64_t ns = timespec_to_ns(abstime);
+  if(ls->frame == 0){
+    ls->firstns = ns;
+  }
+  if(ncv->stale){
+    ++ls->replayed;
+  }else if(ls->frame == ls->digests.size()){
+    ls->digests.push_back(frame_digest(ncv));
+  }else if(ls->frame > ls->digests.size() || ls->digests[ls->frame] != frame_digest(ncv)){
+    ++ls->mismatched;
+  }
+  // schedules are computed in floating point, so allow some rounding
+  if(ls->frame == ls->offsets.size()){
+    ls->offsets.push_back(ns - ls->firstns);
+  }else if(ls->frame > ls->offsets.size() || std::llabs(ls->offsets[ls->frame] - (ns - ls->firstns)) > 1000){
+    ++ls->misscheduled;
+  }
+  // like ncplayer's frame counter, wiping part of the bitmap
+  if(ls->label && ncplane_printf_yx(ls->label, 0, 0, "%u", ls->frame % 10) < 0){
+    return -1;
+  }
+  auto nc = ncplane_notcurses(vopts->n);
+  if(notcurses_render(nc)){
+    return -1;
+  }
+  if(++ls->frame == ls->evictat){
+    flood_imgcache(nc);
+  }
+  return 0;
+}
+
+// stream a loop, returning the number of frames shown
+static unsigned
+stream_loop(notcurses* nc, ncvisual* ncv, ncplane* n, loopstate* ls){
+  ls->frame = 0;
+  ls->replayed = 0;
+  struct ncvisual_options vopts{};
+  vopts.n = n;
+  vopts.scaling = NCSCALE_STRETCH;
+  vopts.blitter = NCBLIT_PIXEL;
+  vopts.flags = NCVISUAL_OPTION_NODEGRADE;
+  CHECK(0 == ncvisual_stream(nc, ncv, 1, loop_streamer, &vopts, ls));
+  return ls->frame;
+}
+
+// once a visual has looped, the bitmaps of streamed frames are cached, and
+// later loops replay them without decoding. the cache is given a known size,
+// large enough for a loop of small frames, but quickly flooded.
+TEST_CASE("MediaLoop") {
+  std::string budget = getenv("NOTCURSES_IMAGE_CACHE") ? getenv("NOTCURSES_IMAGE_CACHE") : "";
+  setenv("NOTCURSES_IMAGE_CACHE", "32", 1);
+  auto nc_ = testing_notcurses();
+  if(budget.empty()){
+    unsetenv("NOTCURSES_IMAGE_CACHE");
+  }else{
+    setenv("NOTCURSES_IMAGE_CACHE", budget.c_str(), 1);
+  }
+  REQUIRE(nullptr != nc_);
+  if(!notcurses_canopen_videos(nc_) || notcurses_check_pixel_support(nc_) <= 0 ||
+     nullptr == nc_->tcache.imgcache){
+    CHECK(!notcurses_stop(nc_));
+    return;
+  }
+  // small enough that the cache holds every frame of a loop
+  struct ncplane_options nopts{};
+  nopts.rows = 1;
+  nopts.cols = 2;
+  auto n = ncplane_create(notcurses_stdplane(nc_), &nopts);
+  REQUIRE(nullptr != n);
+
+  SUBCASE("LoopVideoReplay") {
+    auto ncv = ncvisual_from_file(find_data("samoa.avi").get());
+    REQUIRE(ncv);
+    loopstate ls{};
+    const unsigned frames = stream_loop(nc_, ncv, n, &ls);
+    CHECK(1 < frames);
+    CHECK(0 == ls.replayed);
+    // the second loop decodes, caching its frames
+    CHECK(1 == ncvisual_decode_loop(ncv));
+    CHECK(frames == stream_loop(nc_, ncv, n, &ls));
+    CHECK(0 == ls.replayed);
+    // the third replays all but the first from the cache
+    CHECK(1 == ncvisual_decode_loop(ncv));
+    CHECK(frames == stream_loop(nc_, ncv, n, &ls));
+    CHECK(frames - 1 == ls.replayed);
+    // emptying the cache midway, the remainder must be decoded
+    CHECK(1 == ncvisual_decode_loop(ncv));
+    ls.evictat = frames / 2;
+    CHECK(frames == stream_loop(nc_, ncv, n, &ls));
+    CHECK(frames / 2 - 1 == ls.replayed);
+    ls.evictat = 0;
+    // the decoder must have been left at the right place
+    CHECK(1 == ncvisual_decode_loop(ncv));
+    CHECK(frames == stream_loop(nc_, ncv, n, &ls));
+    CHECK(0 == ls.mismatched);
+    CHECK(0 == ls.misscheduled);
+    ncvisual_destroy(ncv);
+  }
+
+  // a still image is a loop of one frame. it's never replayed, but its
+  // bitmap is cached all the same. once that's been drawn, drawing atop it
+  // requires a bitmap of our own, built from the cached (scaled) pixels.
+  SUBCASE("LoopOneFrame") {
+    auto ncv = ncvisual_from_file(find_data("changes.jpg").get());
+    REQUIRE(ncv);
+    // larger than the image, but short of the last row, lest we scroll
+    unsigned dimy, dimx;
+    ncplane_dim_yx(notcurses_stdplane(nc_), &dimy, &dimx);
+    struct ncplane_options bopts{};
+    bopts.rows = dimy - 1;
+    bopts.cols = dimx;
+    auto bign = ncplane_create(notcurses_stdplane(nc_), &bopts);
+    REQUIRE(nullptr != bign);
+    // at the far end of the bitmap, where a truncated one would end short
+    nopts.y = bopts.rows - 1;
+    nopts.x = bopts.cols - 1;
+    nopts.cols = 1;
+    auto label = ncplane_create(notcurses_stdplane(nc_), &nopts);
+    REQUIRE(nullptr != label);
+    loopstate ls{};
+    for(int i = 0 ; i < 4 ; ++i){
+      ls.label = i > 1 ? label : nullptr;
+      CHECK(1 == stream_loop(nc_, ncv, bign, &ls));
+      CHECK(0 == ls.replayed);
+      CHECK(1 == ncvisual_decode_loop(ncv));
+    }
+    CHECK(0 == ls.mismatched);
+    CHECK(0 == ncplane_destroy(label));
+    CHECK(0 == ncplane_destroy(bign));
+    ncvisual_destroy(ncv);
+  }
+
+  CHECK(0 == ncplane_destroy(n));
+  CHECK(!notcurses_stop(nc_));
+}
@@ -1048,6 +1048,86 @@ TEST_CASE("Plane") {
     }while(c != 127);
   }
 
+  // runs of printable ASCII are written in bulk
+  SUBCASE("PutstrASCIIRun") {
+    const char* str = "The quick brown fox jumps over the lazy dog";
+    CHECK(strlen(str) == ncplane_putstr_yx(n_, 1, 2, str));
+    unsigned y, x;
+    ncplane_cursor_yx(n_, &y, &x);
+    CHECK(1 == y);
+    CHECK(2 + strlen(str) == x);
+    for(size_t i = 0 ; i < strlen(str) ; ++i){
+      uint16_t stylemask;
+      uint64_t channels;
+      char* egc = ncplane_at_yx(n_, 1, 2 + i, &stylemask, &channels);
+      REQUIRE(egc);
+      CHECK(str[i] == egc[0]);
+      CHECK('\0' == egc[1]);
+      free(egc);
+    }
+    CHECK(0 == notcurses_render(nc_));
+  }
+
+  // an ASCII character followed by a combining character must be segmented
+  SUBCASE("PutstrASCIICombining") {
+    CHECK(6 == ncplane_putstr_yx(n_, 0, 0, "abcde\u0301f"));
+    char* egc = ncplane_at_yx(n_, 0, 4, nullptr, nullptr);
+    REQUIRE(egc);
+    CHECK(0 == strcmp(egc, "e\u0301"));
+    free(egc);
+    egc = ncplane_at_yx(n_, 0, 5, nullptr, nullptr);
+    REQUIRE(egc);
+    CHECK(0 == strcmp(egc, "f"));
+    free(egc);
+    // a cluster straddling the byte limit is written whole
+    CHECK(4 == ncplane_putnstr_yx(n_, 1, 0, 4, "abcd\u0301"));
+    egc = ncplane_at_yx(n_, 1, 3, nullptr, nullptr);
+    REQUIRE(egc);
+    CHECK(0 == strcmp(egc, "d\u0301"));
+    free(egc);
+    CHECK(0 == notcurses_render(nc_));
+  }
+
+  // an ASCII run overwriting part of a wide glyph obliterates all of it
+  SUBCASE("PutstrASCIIAtopWide") {
+    CHECK(2 == ncplane_putstr_yx(n_, 0, 3, "\u5168"));
+    CHECK(2 == ncplane_putstr_yx(n_, 0, 7, "\u5168"));
+    CHECK(5 == ncplane_putstr_yx(n_, 0, 0, "abcde"));
+    CHECK(1 == ncplane_putstr_yx(n_, 0, 8, "z"));
+    nccell c = NCCELL_TRIVIAL_INITIALIZER;
+    CHECK(0 < ncplane_at_yx_cell(n_, 0, 3, &c));
+    CHECK(0 == strcmp("d", nccell_extended_gcluster(n_, &c)));
+    CHECK(!nccell_double_wide_p(&c));
+    ncplane_at_yx_cell(n_, 0, 5, &c);
+    CHECK(0 == c.gcluster);
+    CHECK(!nccell_double_wide_p(&c));
+    ncplane_at_yx_cell(n_, 0, 7, &c);
+    CHECK(0 == c.gcluster);
+    CHECK(!nccell_double_wide_p(&c));
+    CHECK(0 == notcurses_render(nc_));
+  }
+
+  // runs stop at the end of the line, where we either scroll or fail
+  SUBCASE("PutstrASCIILineEnd") {
+    struct ncplane_options nopts{};
+    nopts.rows = 2;
+    nopts.cols = 10;
+    auto n = ncplane_create(n_, &nopts);
+    REQUIRE(n);
+    CHECK(-10 == ncplane_putstr_yx(n, 0, 0, "0123456789AB"));
+    ncplane_set_scrolling(n, true);
+    CHECK(12 == ncplane_putstr_yx(n, 0, 0, "0123456789AB"));
+    unsigned y, x;
+    ncplane_cursor_yx(n, &y, &x);
+    CHECK(1 == y);
+    CHECK(2 == x);
+    char* egc = ncplane_at_yx(n, 1, 1, nullptr, nullptr);
+    REQUIRE(egc);
+    CHECK(0 == strcmp(egc, "B"));
+    free(egc);
+    CHECK(0 == ncplane_destroy(n));
+  }
+
   // relative moves
   SUBCASE("RelativePlaneMoves") {
     struct ncplane_options nopts{};
@@ -49,6 +49,53 @@ TEST_CASE("Sixels") {
     ncvisual_destroy(ncv);
   }
 
+  // enough bands to be decoded in parallel, with a height that isn't a
+  // multiple of six, RLE, and carriage returns overlaying a second color
+  SUBCASE("LoadTallSixel") {
+    const unsigned leny = 601;
+    const unsigned lenx = 40;
+    std::string sx = "\x1bPq\"1;1;40;601#1;2;100;0;0#2;2;0;0;100";
+    for(unsigned b = 0 ; b < (leny + 5) / 6 ; ++b){
+      sx += "#1!" + std::to_string(b % lenx + 1) + "~$#2";
+      for(unsigned x = 0 ; x < lenx ; ++x){
+        sx += static_cast<char>('?' + (1u << (x % 6)));
+      }
+      if(b + 1 < (leny + 5) / 6){
+        sx += "-";
+      }
+    }
+    sx += "\x1b\\";
+    // decoded in parallel by ncvisual_from_sixel(), and serially otherwise
+    auto ncv = ncvisual_from_sixel(sx.c_str(), leny, lenx);
+    REQUIRE(ncv);
+    auto rgba = ncsixel_as_rgba(sx.c_str(), leny, lenx);
+    REQUIRE(rgba);
+    for(unsigned y = 0 ; y < leny ; ++y){
+      for(unsigned x = 0 ; x < lenx ; ++x){
+        uint32_t p;
+        CHECK(0 == ncvisual_at_yx(ncv, y, x, &p));
+        CHECK(rgba[y * lenx + x] == p);
+        if(x % 6 == y % 6){
+          CHECK(0xff == ncpixel_b(p));
+        }else if(x < y / 6 % lenx + 1){
+          CHECK(0xff == ncpixel_r(p));
+        }else{
+          CHECK(0 == ncpixel_a(p));
+        }
+      }
+    }
+    free(rgba);
+    ncvisual_destroy(ncv);
+    // a register redefined after use only affects subsequent pixels
+    rgba = ncsixel_as_rgba("\x1bPq#1;2;100;0;0#1~-#1;2;0;0;100#1~\x1b\\", 12, 1);
+    REQUIRE(rgba);
+    CHECK(0xff == ncpixel_r(rgba[5]));
+    CHECK(0xff == ncpixel_b(rgba[6]));
+    free(rgba);
+    // too many bands for the geometry
+    CHECK(nullptr == ncsixel_as_rgba("\x1bPq#1;2;100;0;0#1~-~\x1b\\", 6, 1));
+  }
+
   // remaining tests can only run with a Sixel backend
   if(notcurses_check_pixel_support(nc_) <= 0){
     CHECK(0 == notcurses_stop(nc_));
@@ -129,5 +176,326 @@ TEST_CASE("Sixels") {
   }
 #endif
 
+  // bands whose pixels are unchanged are carried over from the previous
+  // frame; make sure the result is what we'd have gotten otherwise
+  SUBCASE("SixelReblitChangedBands") {
+    const int pixy = 60;
+    const int pixx = 40;
+    std::vector<uint32_t> rgba(pixy * pixx);
+    auto paint = [&](int bluerows){
+      for(int y = 0 ; y < pixy ; ++y){
+        for(int x = 0 ; x < pixx ; ++x){
+          uint32_t px = 0;
+          ncpixel_set_a(&px, 0xff);
+          if(y < pixy / 2 || y >= pixy - bluerows){
+            ncpixel_set_b(&px, 0xff);
+          }else{
+            ncpixel_set_g(&px, 0xff);
+          }
+          rgba[y * pixx + x] = px;
+        }
+      }
+    };
+    auto blit = [&](ncplane* n, uint64_t flags){
+      auto ncv = ncvisual_from_rgba(rgba.data(), pixy, pixx * 4, pixx);
+      REQUIRE(ncv);
+      struct ncvisual_options vopts{};
+      vopts.n = n;
+      vopts.blitter = NCBLIT_PIXEL;
+      vopts.flags = NCVISUAL_OPTION_NODEGRADE | flags;
+      auto newn = ncvisual_blit(nc_, ncv, &vopts);
+      ncvisual_destroy(ncv);
+      REQUIRE(newn);
+      CHECK(0 == notcurses_render(nc_));
+      return newn;
+    };
+    paint(0);
+    auto newn = blit(n_, NCVISUAL_OPTION_CHILDPLANE);
+    const int spy = newn->sprite->pixy;
+    const int spx = newn->sprite->pixx;
+    auto first = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+    REQUIRE(first);
+    paint(6); // only the final band changes
+    CHECK(newn == blit(newn, 0));
+    auto second = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+    REQUIRE(second);
+    for(int y = 0 ; y < pixy ; ++y){
+      for(int x = 0 ; x < pixx ; ++x){
+        if(y < pixy - 6){
+          CHECK(first[y * spx + x] == second[y * spx + x]);
+        }else{
+          CHECK(ncpixel_b(second[y * spx + x]) > ncpixel_g(second[y * spx + x]));
+        }
+      }
+    }
+    paint(0);
+    CHECK(newn == blit(newn, 0));
+    auto third = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+    REQUIRE(third);
+    CHECK(0 == memcmp(first, third, sizeof(*first) * spy * spx));
+    free(third);
+    free(second);
+    free(first);
+    CHECK(0 == ncplane_destroy(newn));
+  }
+
+  // the cache keeps no palettes, so a frame served from it leaves the sprixel
+  // without one. otherwise, a later frame could reuse bands quantized against
+  // one palette while reusing a different palette.
+  SUBCASE("SixelReblitAfterCached") {
+    if(nc_->tcache.imgcache){
+      const int pixy = 60;
+      const int pixx = 40;
+      std::vector<uint32_t> rgba(pixy * pixx);
+      // blue through the top half and the final |bluerows| rows, green
+      // otherwise, with a patch of |patch| pixels up top.
+      auto paint = [&](uint32_t patch, int patchlen, int bluerows){
+        for(int y = 0 ; y < pixy ; ++y){
+          for(int x = 0 ; x < pixx ; ++x){
+            uint32_t px = 0;
+            ncpixel_set_a(&px, 0xff);
+            if(y == 0 && x < patchlen){
+              px = patch;
+            }else if(y < pixy / 2 || y >= pixy - bluerows){
+              ncpixel_set_b(&px, 0xff);
+            }else{
+              ncpixel_set_g(&px, 0xff);
+            }
+            rgba[y * pixx + x] = px;
+          }
+        }
+      };
+      auto blit = [&](ncplane* n, uint64_t flags){
+        auto ncv = ncvisual_from_rgba(rgba.data(), pixy, pixx * 4, pixx);
+        REQUIRE(ncv);
+        struct ncvisual_options vopts{};
+        vopts.n = n;
+        vopts.blitter = NCBLIT_PIXEL;
+        vopts.flags = NCVISUAL_OPTION_NODEGRADE | flags;
+        auto newn = ncvisual_blit(nc_, ncv, &vopts);
+        ncvisual_destroy(ncv);
+        REQUIRE(newn);
+        CHECK(0 == notcurses_render(nc_));
+        return newn;
+      };
+      const uint32_t red = htole(0xff0000ffu);
+      const uint32_t black = htole(0xff000000u);
+      // what the final frame ought look like, blitted afresh
+      paint(red, 30, 6);
+      auto refn = blit(n_, NCVISUAL_OPTION_CHILDPLANE);
+      const int spy = refn->sprite->pixy;
+      const int spx = refn->sprite->pixx;
+      auto ref = ncsixel_as_rgba(refn->sprite->glyph.buf, spy, spx);
+      REQUIRE(ref);
+      CHECK(0 == ncplane_destroy(refn));
+      // the third blit of this frame is served from the cache
+      paint(red, 30, 0);
+      auto newn = blit(n_, NCVISUAL_OPTION_CHILDPLANE);
+      CHECK(newn == blit(newn, 0));
+      CHECK(newn == blit(newn, 0));
+      // too much black for that palette; this builds a new one, with as
+      // many colors, but black where the old one had red.
+      paint(black, 40, 6);
+      CHECK(newn == blit(newn, 0));
+      paint(red, 30, 0);
+      CHECK(newn == blit(newn, 0)); // cached
+      // all but the final band can be taken from the cached frame, but they
+      // mustn't be interpreted using the black palette.
+      paint(red, 30, 6);
+      CHECK(newn == blit(newn, 0));
+      auto out = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+      REQUIRE(out);
+      CHECK(0 == memcmp(ref, out, sizeof(*ref) * spy * spx));
+      free(out);
+      free(ref);
+      CHECK(0 == ncplane_destroy(newn));
+    }
+  }
+
+  // a palette is retained only by a sprixel being reblitted. it's reused by
+  // frames whose histograms lie near that of the frame which built it, and
+  // rebuilt once they drift too far (an L1 distance beyond 0.25).
+  SUBCASE("SixelPaletteDrift") {
+    const int pixy = 60;
+    const int pixx = 40;
+    std::vector<uint32_t> rgba(pixy * pixx);
+    // blue through the first |bluerows| rows, and green below
+    auto paint = [&](int bluerows){
+      for(int y = 0 ; y < pixy ; ++y){
+        for(int x = 0 ; x < pixx ; ++x){
+          uint32_t px = 0;
+          ncpixel_set_a(&px, 0xff);
+          if(y < bluerows){
+            ncpixel_set_b(&px, 0xff);
+          }else{
+            ncpixel_set_g(&px, 0xff);
+          }
+          rgba[y * pixx + x] = px;
+        }
+      }
+    };
+    auto blit = [&](ncplane* n, uint64_t flags){
+      auto ncv = ncvisual_from_rgba(rgba.data(), pixy, pixx * 4, pixx);
+      REQUIRE(ncv);
+      struct ncvisual_options vopts{};
+      vopts.n = n;
+      vopts.blitter = NCBLIT_PIXEL;
+      vopts.flags = NCVISUAL_OPTION_NODEGRADE | flags;
+      auto newn = ncvisual_blit(nc_, ncv, &vopts);
+      ncvisual_destroy(ncv);
+      REQUIRE(newn);
+      CHECK(0 == notcurses_render(nc_));
+      return newn;
+    };
+    paint(30);
+    auto newn = blit(n_, NCVISUAL_OPTION_CHILDPLANE);
+    CHECK(nullptr == newn->sprite->palette); // a static image keeps none
+    paint(32);
+    CHECK(newn == blit(newn, 0));
+    auto pal = newn->sprite->palette;
+    REQUIRE(nullptr != pal);
+    paint(34); // drift of 4/60 against the palette's frame
+    CHECK(newn == blit(newn, 0));
+    CHECK(pal == newn->sprite->palette);
+    paint(48); // drift of 32/60, with no new colors
+    CHECK(newn == blit(newn, 0));
+    CHECK(nullptr != newn->sprite->palette);
+    CHECK(pal != newn->sprite->palette);
+    auto out = ncsixel_as_rgba(newn->sprite->glyph.buf, newn->sprite->pixy,
+                               newn->sprite->pixx);
+    REQUIRE(out);
+    for(int y = 0 ; y < pixy ; ++y){
+      const uint32_t px = out[y * newn->sprite->pixx];
+      if(y < 48){
+        CHECK(ncpixel_b(px) > ncpixel_g(px));
+      }else{
+        CHECK(ncpixel_g(px) > ncpixel_b(px));
+      }
+    }
+    free(out);
+    CHECK(0 == ncplane_destroy(newn));
+  }
+
+  // wiping a cell ought clear exactly its pixels, and restoring it ought
+  // bring them all back
+  SUBCASE("SixelWipeRestore") {
+    const int pixy = 60;
+    const int pixx = 40;
+    std::vector<uint32_t> rgba(pixy * pixx);
+    for(int y = 0 ; y < pixy ; ++y){
+      for(int x = 0 ; x < pixx ; ++x){
+        uint32_t px = 0;
+        ncpixel_set_a(&px, 0xff);
+        ncpixel_set_r(&px, (x * 37 + y * 11) % 256);
+        ncpixel_set_g(&px, (y * 53) % 256);
+        ncpixel_set_b(&px, (x * y) % 256);
+        rgba[y * pixx + x] = px;
+      }
+    }
+    auto ncv = ncvisual_from_rgba(rgba.data(), pixy, pixx * 4, pixx);
+    REQUIRE(ncv);
+    struct ncvisual_options vopts{};
+    vopts.n = n_;
+    vopts.blitter = NCBLIT_PIXEL;
+    vopts.flags = NCVISUAL_OPTION_NODEGRADE | NCVISUAL_OPTION_CHILDPLANE;
+    auto newn = ncvisual_blit(nc_, ncv, &vopts);
+    ncvisual_destroy(ncv);
+    REQUIRE(newn);
+    CHECK(0 == notcurses_render(nc_));
+    const int spy = newn->sprite->pixy;
+    const int spx = newn->sprite->pixx;
+    auto orig = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+    REQUIRE(orig);
+    const int cdimy = ncplane_pile(newn)->cellpxy;
+    const int cdimx = ncplane_pile(newn)->cellpxx;
+    struct ncplane_options nopts{};
+    nopts.y = 1;
+    nopts.x = 1;
+    nopts.rows = 1;
+    nopts.cols = 1;
+    auto top = ncplane_create(n_, &nopts);
+    REQUIRE(top);
+    CHECK(1 == ncplane_putchar_yx(top, 0, 0, 'x'));
+    CHECK(0 == notcurses_render(nc_));
+    auto wiped = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+    REQUIRE(wiped);
+    for(int y = 0 ; y < pixy ; ++y){
+      for(int x = 0 ; x < pixx ; ++x){
+        if(y / cdimy == 1 && x / cdimx == 1){
+          CHECK(0 == ncpixel_a(wiped[y * spx + x]));
+        }else{
+          CHECK(orig[y * spx + x] == wiped[y * spx + x]);
+        }
+      }
+    }
+    CHECK(0 == ncplane_destroy(top));
+    CHECK(0 == notcurses_render(nc_));
+    auto restored = ncsixel_as_rgba(newn->sprite->glyph.buf, spy, spx);
+    REQUIRE(restored);
+    CHECK(0 == memcmp(orig, restored, sizeof(*orig) * spy * spx));
+    free(restored);
+    free(wiped);
+    free(orig);
+    CHECK(0 == ncplane_destroy(newn));
+  }
+
+  // each quantizer ought reproduce a smooth gradient reasonably well
+  SUBCASE("SixelQuantizers") {
+    const int pixy = 60;
+    const int pixx = 80;
+    std::vector<uint32_t> rgba(pixy * pixx);
+    for(int y = 0 ; y < pixy ; ++y){
+      for(int x = 0 ; x < pixx ; ++x){
+        uint32_t px = 0;
+        ncpixel_set_a(&px, 0xff);
+        ncpixel_set_r(&px, x * 255 / pixx);
+        ncpixel_set_g(&px, y * 255 / pixy);
+        ncpixel_set_b(&px, (x + y) * 255 / (pixx + pixy));
+        rgba[y * pixx + x] = px;
+      }
+    }
+    const uint64_t quantizers[] = {
+      0,
+      NCVISUAL_OPTION_FIXEDPALETTE,
+      NCVISUAL_OPTION_FIXEDPALETTE | NCVISUAL_OPTION_DITHER,
+      NCVISUAL_OPTION_MEDIANCUT,
+    };
+    auto ncv = ncvisual_from_rgba(rgba.data(), pixy, pixx * 4, pixx);
+    REQUIRE(ncv);
+    for(auto q : quantizers){
+      struct ncvisual_options vopts{};
+      vopts.n = n_;
+      vopts.blitter = NCBLIT_PIXEL;
+      vopts.flags = NCVISUAL_OPTION_NODEGRADE | NCVISUAL_OPTION_CHILDPLANE | q;
+      auto newn = ncvisual_blit(nc_, ncv, &vopts);
+      REQUIRE(newn);
+      CHECK(0 == notcurses_render(nc_));
+      const int spx = newn->sprite->pixx;
+      auto out = ncsixel_as_rgba(newn->sprite->glyph.buf, newn->sprite->pixy, spx);
+      REQUIRE(out);
+      long err = 0;
+      for(int y = 0 ; y < pixy ; ++y){
+        for(int x = 0 ; x < pixx ; ++x){
+          const uint32_t i = rgba[y * pixx + x];
+          const uint32_t o = out[y * spx + x];
+          err += abs((int)ncpixel_r(i) - (int)ncpixel_r(o));
+          err += abs((int)ncpixel_g(i) - (int)ncpixel_g(o));
+          err += abs((int)ncpixel_b(i) - (int)ncpixel_b(o));
+        }
+      }
+      CHECK(err < 3l * pixy * pixx * 16);
+      free(out);
+      CHECK(0 == ncplane_destroy(newn));
+    }
+    // the fixed and median cut palettes are mutually exclusive
+    struct ncvisual_options vopts{};
+    vopts.n = n_;
+    vopts.blitter = NCBLIT_PIXEL;
+    vopts.flags = NCVISUAL_OPTION_CHILDPLANE | NCVISUAL_OPTION_FIXEDPALETTE |
+                  NCVISUAL_OPTION_MEDIANCUT;
+    CHECK(nullptr == ncvisual_blit(nc_, ncv, &vopts));
+    ncvisual_destroy(ncv);
+  }
+
   CHECK(!notcurses_stop(nc_));
 }
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+
+# Generate src/lib/unitables.h from the Unicode Character Database. Point it
+# at an unpacked UCD (https://www.unicode.org/Public/<version>/ucd/), and
+# redirect its output:
+#
+#   tools/unicode-tables.py /path/to/ucd > src/lib/unitables.h
+#
+# We need UnicodeData.txt, EastAsianWidth.txt, PropList.txt,
+# auxiliary/GraphemeBreakProperty.txt, and emoji/emoji-data.txt. Each code
+# point gets one byte of properties: its Grapheme_Cluster_Break value, a
+# width class, and whether it is Extended_Pictographic. These are stored in
+# a two-stage table of 256-codepoint blocks, with identical blocks shared.
+#
+# Widths follow the rules glibc uses to generate wcwidth() (see glibc's
+# localedata/unicode-gen/utf8_gen.py), so that our results match those of a
+# UTF-8 locale built from the same Unicode version.
+
+import os
+import re
+import sys
+
+MAXCP = 0x110000
+BLOCKSHIFT = 8
+BLOCKSIZE = 1 << BLOCKSHIFT
+
+# must match the NCGCB_* enumeration in unicode.c
+GCBS = ["Other", "CR", "LF", "Control", "Extend", "ZWJ",
+        "Regional_Indicator", "Prepend", "SpacingMark",
+        "L", "V", "T", "LV", "LVT"]
+
+# width classes, must match the NCUWIDTH_* values in unicode.c
+WIDTH_ZERO = 0
+WIDTH_ONE = 1
+WIDTH_TWO = 2
+WIDTH_SPACE = 3  # nonprinting whitespace: tab, newline, etc.
+WIDTH_CNTRL = 4  # prohibited control character
+
+def usage():
+  sys.stderr.write("usage: %s ucd-dir\n" % os.path.basename(sys.argv[0]))
+  sys.exit(1)
+
+# yield (first, last, fields) for each data line of a UCD properties file
+def ucdranges(path):
+  with open(path, encoding="utf-8") as f:
+    for line in f:
+      line = line.split("#", 1)[0].strip()
+      if not line:
+        continue
+      fields = [x.strip() for x in line.split(";")]
+      cps = fields[0].split("..")
+      first = int(cps[0], 16)
+      last = int(cps[-1], 16)
+      yield first, last, fields[1:]
+
+# returns a dictionary of general category and bidi class by code point,
+# expanding the <..., First>/<..., Last> ranges.
+def unicodedata(path):
+  cats = {}
+  with open(path, encoding="utf-8") as f:
+    rangestart = None
+    for line in f:
+      fields = line.strip().split(";")
+      if len(fields) < 5:
+        continue
+      cp = int(fields[0], 16)
+      if fields[1].endswith(", First>"):
+        rangestart = cp
+        continue
+      if fields[1].endswith(", Last>"):
+        for c in range(rangestart, cp + 1):
+          cats[c] = (fields[2], fields[4])
+        rangestart = None
+        continue
+      cats[cp] = (fields[2], fields[4])
+  return cats
+
+def widths(ucd, cats):
+  # unassigned code points aren't printable, but neither are they controls
+  w = [WIDTH_ONE] * MAXCP
+  for first, last, fields in ucdranges(os.path.join(ucd, "EastAsianWidth.txt")):
+    if fields[0] in ("W", "F"):
+      for cp in range(first, last + 1):
+        if cp in cats:
+          w[cp] = WIDTH_TWO
+  for cp, (gc, bidi) in cats.items():
+    if bidi == "NSM" or gc in ("Cf", "Me", "Mn"):
+      w[cp] = WIDTH_ZERO
+  for first, last, fields in ucdranges(os.path.join(ucd, "PropList.txt")):
+    if fields[0] == "Prepended_Concatenation_Mark":
+      for cp in range(first, last + 1):
+        w[cp] = WIDTH_ONE
+  # special cases, as made by glibc
+  w[0x00ad] = WIDTH_ONE # soft hyphen
+  # hangul medial vowels and final consonants
+  for cp in list(range(0x1160, 0x1200)) + list(range(0xd7b0, 0xd800)):
+    if cp in cats:
+      w[cp] = WIDTH_ZERO
+  for cp in range(0x3248, 0x3250): # circled numbers on black squares
+    w[cp] = WIDTH_TWO
+  for cp in range(0x4dc0, 0x4e00): # yijing hexagram symbols
+    w[cp] = WIDTH_TWO
+  # control characters and separators never print. whitespace among them
+  # is admitted as a single column; everything else is prohibited.
+  spaces = (0x09, 0x0a, 0x0b, 0x0c, 0x0d)
+  for cp, (gc, bidi) in cats.items():
+    if gc in ("Cc", "Zl", "Zp"):
+      w[cp] = WIDTH_SPACE if cp in spaces or gc != "Cc" else WIDTH_CNTRL
+    elif gc == "Cs":
+      w[cp] = WIDTH_CNTRL
+  w[0] = WIDTH_ZERO
+  return w
+
+def gcbs(ucd):
+  g = [0] * MAXCP
+  path = os.path.join(ucd, "auxiliary", "GraphemeBreakProperty.txt")
+  for first, last, fields in ucdranges(path):
+    v = GCBS.index(fields[0])
+    for cp in range(first, last + 1):
+      g[cp] = v
+  return g
+
+def extpicts(ucd):
+  e = [False] * MAXCP
+  for first, last, fields in ucdranges(os.path.join(ucd, "emoji", "emoji-data.txt")):
+    if fields[0] == "Extended_Pictographic":
+      for cp in range(first, last + 1):
+        e[cp] = True
+  return e
+
+def version(ucd):
+  with open(os.path.join(ucd, "auxiliary", "GraphemeBreakProperty.txt"), encoding="utf-8") as f:
+    m = re.search(r"GraphemeBreakProperty-([0-9.]+)\.txt", f.readline())
+  return m.group(1) if m else "unknown"
+
+def emit(props, ver):
+  blocks = []
+  blockidx = {}
+  stage1 = []
+  for b in range(MAXCP // BLOCKSIZE):
+    block = tuple(props[b * BLOCKSIZE:(b + 1) * BLOCKSIZE])
+    if block not in blockidx:
+      blockidx[block] = len(blocks)
+      blocks.append(block)
+    stage1.append(blockidx[block])
+  if len(blocks) > 256:
+    sys.stderr.write("too many distinct blocks (%d)\n" % len(blocks))
+    sys.exit(1)
+  out = sys.stdout
+  out.write("// generated by tools/unicode-tables.py from Unicode %s data. do not edit.\n" % ver)
+  out.write("// %d stage 1 entries, %d distinct blocks of %d.\n\n" % (len(stage1), len(blocks), BLOCKSIZE))
+  out.write("#ifndef NOTCURSES_UNITABLES\n#define NOTCURSES_UNITABLES\n\n")
+  out.write("#define NCUCD_VERSION \"%s\"\n" % ver)
+  out.write("#define NCUCD_BLOCKSHIFT %d\n\n" % BLOCKSHIFT)
+  out.write("static const uint8_t ucd_stage1[%d] = {\n" % len(stage1))
+  for i in range(0, len(stage1), 16):
+    out.write("  " + ",".join("%d" % x for x in stage1[i:i + 16]) + ",\n")
+  out.write("};\n\n")
+  out.write("static const uint8_t ucd_stage2[%d][%d] = {\n" % (len(blocks), BLOCKSIZE))
+  for block in blocks:
+    out.write("  {\n")
+    for i in range(0, BLOCKSIZE, 16):
+      out.write("    " + ",".join("0x%02x" % x for x in block[i:i + 16]) + ",\n")
+    out.write("  },\n")
+  out.write("};\n\n#endif\n")
+
+def main():
+  if len(sys.argv) != 2:
+    usage()
+  ucd = sys.argv[1]
+  cats = unicodedata(os.path.join(ucd, "UnicodeData.txt"))
+  w = widths(ucd, cats)
+  g = gcbs(ucd)
+  e = extpicts(ucd)
+  # low nibble: grapheme cluster break. bits 4--6: width class. bit 7:
+  # extended pictographic.
+  props = [g[cp] | (w[cp] << 4) | (0x80 if e[cp] else 0) for cp in range(MAXCP)]
+  emit(props, version(ucd))
+
+if __name__ == "__main__":
+  main()